@@ -0,0 +1,395 @@
+/**************************************************************
+ * Debounce replay bench (Linux)
+ *
+ *  Replays raw input traces captured on a node (/api/trace, format in
+ *  inputtrace.h; tools/trace.py fetches them) through the firmware's
+ *  debouncer (debounce.h) for each algorithm and window, and reports
+ *  the latency it adds and the toggles it gets wrong.
+ *
+ *  Replay is deterministic and follows the control task: update() on
+ *  every raw edge with millis() = edge_us / 1000, and again when wait()
+ *  expires. Latency is measured from the first raw edge of a transition
+ *  to the debounced change, so it is what the algorithm adds; the
+ *  task wake-up (tens of us) is not modelled.
+ *
+ *  Reference ("what the user did") is taken from the whole trace,
+ *  looking ahead: a level counts once it is held for --settle ms, and a
+ *  transition starts at the first edge after the previous settled
+ *  level. Anything shorter is bounce or noise.
+ *    toggles  press transitions (the default rule toggles on press)
+ *    missed   reference presses with no debounced press before the
+ *             next reference transition
+ *    false    debounced presses beyond those (double toggles, noise)
+ *  Releases are scored the same way; they matter for "input short"
+ *  and "input long" rules.
+ *
+ *  pio run -e native_bench && .pio/build/native_bench/program *.trace
+ **************************************************************/
+#include "../debounce.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// -------------------- Options --------------------
+struct Options {
+  std::vector<DebounceCfg> configs;   // empty = default sweep
+  uint32_t settleMs = 20;
+  const char* csv = nullptr;
+  bool perTrace = false;
+  bool verbose = false;
+};
+
+static const uint16_t SWEEP_MS[] = { 2, 5, 10, 20, 30, 50, 80 };
+
+// -------------------- Samples --------------------
+struct Samples {
+  std::vector<uint32_t> us;
+  void add(uint64_t v) { us.push_back(v > UINT32_MAX ? UINT32_MAX : (uint32_t)v); }
+  void add(const Samples &o) { us.insert(us.end(), o.us.begin(), o.us.end()); }
+  // Nearest-rank percentile in ms (0 if empty). Sorts in place.
+  double pct(double p) {
+    if (us.empty()) return 0;
+    std::sort(us.begin(), us.end());
+    size_t i = (size_t)(p * us.size() + 0.5);
+    if (i < 1) i = 1;
+    if (i > us.size()) i = us.size();
+    return us[i - 1] / 1000.0;
+  }
+  double max() { return us.empty() ? 0 : *std::max_element(us.begin(), us.end()) / 1000.0; }
+};
+
+// -------------------- Traces --------------------
+struct Trace {
+  std::string name;
+  uint32_t periodUs = 0;
+  int      level = 1;                // at t=0
+  uint64_t endUs = 0;
+  std::string debounce;              // the node's config when dumped
+  std::vector<uint32_t> edges;       // us since the start
+};
+
+struct Transition {
+  uint64_t us;
+  int      level;
+};
+
+static bool loadTrace(const char* path, Trace &t) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  t.name = path;
+  uint64_t samples = 0;
+  char line[128];
+  unsigned lineNo = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    lineNo++;
+    line[strcspn(line, "\r\n")] = 0;
+    if (!line[0] || line[0] == '#') continue;
+    char* eq = strchr(line, '=');
+    if (eq) {
+      *eq = 0;
+      const char* v = eq + 1;
+      if (!strcmp(line, "period_us"))     t.periodUs = (uint32_t)strtoul(v, nullptr, 10);
+      else if (!strcmp(line, "level"))    t.level = atoi(v) ? 1 : 0;
+      else if (!strcmp(line, "samples"))  samples = strtoull(v, nullptr, 10);
+      else if (!strcmp(line, "debounce")) t.debounce = v;
+      else if (!strcmp(line, "overflow") && atoi(v)) fprintf(stderr, "%s: capture buffer overflowed, trace is cut short\n", path);
+      continue;
+    }
+    char* end;
+    const unsigned long us = strtoul(line, &end, 10);
+    if (*end || (!t.edges.empty() && us <= t.edges.back())) {
+      fprintf(stderr, "%s:%u: bad edge \"%s\"\n", path, lineNo, line);
+      ok = false;
+    }
+    t.edges.push_back((uint32_t)us);
+  }
+  fclose(f);
+  if (!ok) return false;
+  if (!t.periodUs) {
+    fprintf(stderr, "%s: no period_us (not a trace?)\n", path);
+    return false;
+  }
+  t.endUs = samples * t.periodUs;
+  if (!t.edges.empty() && t.endUs <= t.edges.back()) t.endUs = t.edges.back() + 1;
+  return true;
+}
+
+static inline int levelAfter(const Trace &t, size_t edge) {
+  return t.level ^ (int)((edge + 1) & 1);
+}
+
+struct TraceInfo {
+  std::vector<Transition> ref;
+  Samples  pressBounce, releaseBounce;   // first to last edge of a transition
+  uint32_t longestGlitchUs = 0;          // longest unsettled level
+};
+
+// Reference transitions: segment k is the level between edge k-1 and
+// edge k (segment 0 starts the trace and counts as settled).
+static void reference(const Trace &t, uint32_t settleUs, TraceInfo &info) {
+  const size_t n = t.edges.size();
+  int cur = t.level;
+  uint64_t settledEnd = n ? t.edges[0] : t.endUs;
+  for (size_t k = 1; k <= n; k++) {
+    const uint64_t start = t.edges[k - 1];
+    const uint64_t end = (k < n) ? t.edges[k] : t.endUs;
+    const int level = levelAfter(t, k - 1);
+    if (end - start < settleUs) {
+      info.longestGlitchUs = std::max(info.longestGlitchUs, (uint32_t)(end - start));
+      continue;
+    }
+    if (level != cur) {
+      info.ref.push_back({ settledEnd, level });
+      (level ? info.releaseBounce : info.pressBounce).add(start - settledEnd);
+      cur = level;
+    }
+    settledEnd = end;
+  }
+}
+
+// -------------------- Replay --------------------
+static void replay(const Trace &t, const DebounceCfg &cfg, std::vector<Transition> &out) {
+  Debouncer d;
+  d.begin(cfg, t.level, 0);
+  uint64_t wakeUs = 0;   // 0 = none
+
+  auto run = [&](int level, uint64_t us) {
+    const uint32_t ms = (uint32_t)(us / 1000);
+    if (d.update(level, ms)) out.push_back({ us, d.stable() });
+    wakeUs = d.wait() ? (uint64_t)(ms + d.wait()) * 1000 : 0;
+  };
+  auto runWakes = [&](uint64_t untilUs) {
+    while (wakeUs && wakeUs <= untilUs) run(d.raw(), wakeUs);
+  };
+
+  for (size_t k = 0; k < t.edges.size(); k++) {
+    runWakes(t.edges[k]);
+    run(levelAfter(t, k), t.edges[k]);
+  }
+  runWakes(t.endUs);
+}
+
+// -------------------- Scoring --------------------
+struct Score {
+  uint32_t presses = 0, releases = 0;
+  uint32_t missedPress = 0, missedRelease = 0;
+  uint32_t falsePress = 0, falseRelease = 0;
+  Samples  pressLat, releaseLat;
+
+  void add(const Score &o) {
+    presses += o.presses;
+    releases += o.releases;
+    missedPress += o.missedPress;
+    missedRelease += o.missedRelease;
+    falsePress += o.falsePress;
+    falseRelease += o.falseRelease;
+    pressLat.add(o.pressLat);
+    releaseLat.add(o.releaseLat);
+  }
+  uint32_t pressErrors() const { return missedPress + falsePress; }
+};
+
+// Interval i runs from reference transition i to the next one; the
+// first debounced change towards its level there is the match.
+static Score score(const Trace &t, const DebounceCfg &cfg, const std::vector<Transition> &ref,
+                   const std::vector<Transition> &out, bool verbose) {
+  Score s;
+  size_t j = 0;
+  for (size_t i = 0; i <= ref.size(); i++) {
+    const bool head = (i == 0);   // before the first transition: nothing is expected
+    const uint64_t start = head ? 0 : ref[i - 1].us;
+    const uint64_t end = (i < ref.size()) ? ref[i].us : UINT64_MAX;
+    const int target = head ? t.level : ref[i - 1].level;
+    bool matched = head;
+
+    for (; j < out.size() && out[j].us < end; j++) {
+      const Transition &o = out[j];
+      if (!matched && o.level == target) {
+        matched = true;
+        (target ? s.releaseLat : s.pressLat).add(o.us - start);
+        continue;
+      }
+      (o.level ? s.falseRelease : s.falsePress)++;
+      if (verbose) {
+        printf("  %s %s/%u: false %s at %.3f ms\n", t.name.c_str(), debounceAlgoName(cfg.algo), cfg.ms,
+               o.level ? "release" : "press", o.us / 1000.0);
+      }
+    }
+
+    if (head) continue;
+    (target ? s.releases : s.presses)++;
+    if (!matched) {
+      (target ? s.missedRelease : s.missedPress)++;
+      if (verbose) {
+        printf("  %s %s/%u: missed %s at %.3f ms\n", t.name.c_str(), debounceAlgoName(cfg.algo), cfg.ms,
+               target ? "release" : "press", start / 1000.0);
+      }
+    }
+  }
+  return s;
+}
+
+// -------------------- Report --------------------
+static std::string cfgStr(const DebounceCfg &c) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%s/%u", debounceAlgoName(c.algo), c.ms);
+  return buf;
+}
+
+static void printTable(const char* title, const std::vector<DebounceCfg> &cfgs, std::vector<Score> &scores,
+                       const std::string &deviceCfg) {
+  size_t best = 0;
+  for (size_t i = 1; i < scores.size(); i++) {
+    const uint32_t e = scores[i].pressErrors(), be = scores[best].pressErrors();
+    if (e < be || (e == be && scores[i].pressLat.pct(0.99) < scores[best].pressLat.pct(0.99))) best = i;
+  }
+
+  printf("\n%s\n", title);
+  printf("  %-15s %7s %6s %6s %8s %8s %8s | %7s %6s %6s %8s\n", "config", "toggles", "missed", "false", "p50 ms",
+         "p99 ms", "max ms", "release", "missed", "false", "p50 ms");
+  for (size_t i = 0; i < cfgs.size(); i++) {
+    Score &s = scores[i];
+    const std::string name = cfgStr(cfgs[i]);
+    const char mark = (i == best) ? '*' : (name == deviceCfg ? '<' : ' ');
+    printf("%c %-15s %7u %6u %6u %8.1f %8.1f %8.1f | %7u %6u %6u %8.1f\n", mark, name.c_str(), s.presses,
+           s.missedPress, s.falsePress, s.pressLat.pct(0.5), s.pressLat.pct(0.99), s.pressLat.max(), s.releases,
+           s.missedRelease, s.falseRelease, s.releaseLat.pct(0.5));
+  }
+  printf("  * fewest missed + false toggles, then lowest p99%s\n",
+         deviceCfg.empty() ? "" : "; < the node's config when the trace was taken");
+}
+
+static void writeCsvRows(FILE* f, const char* trace, const std::vector<DebounceCfg> &cfgs, std::vector<Score> &scores) {
+  for (size_t i = 0; i < cfgs.size(); i++) {
+    Score &s = scores[i];
+    fprintf(f, "%s,%s,%u,%u,%u,%u,%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f\n", trace, cfgStr(cfgs[i]).c_str(), s.presses,
+            s.missedPress, s.falsePress, s.releases, s.missedRelease, s.falseRelease, s.pressLat.pct(0.5),
+            s.pressLat.pct(0.99), s.pressLat.max(), s.releaseLat.pct(0.5), s.releaseLat.pct(0.99));
+  }
+}
+
+// -------------------- CLI --------------------
+static void usage() {
+  fprintf(stderr,
+    "usage: debouncebench [options] TRACE...\n"
+    "  --debounce LIST  configs to replay: ALGO/MS[,ALGO/MS...]\n"
+    "                   (default: stable, lockout and integrate at 2-80 ms)\n"
+    "  --settle MS      a level held this long is intentional (20)\n"
+    "  --per-trace      a table per trace as well as the total\n"
+    "  --verbose        list every missed and false transition\n"
+    "  --csv FILE       one row per trace and config\n");
+}
+
+static bool parseConfigs(const char* s, std::vector<DebounceCfg> &out) {
+  std::string list(s);
+  size_t pos = 0;
+  while (pos <= list.size()) {
+    const size_t comma = list.find(',', pos);
+    const std::string item = list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+    DebounceCfg c;
+    if (!debounceParse(item.c_str(), c)) {
+      fprintf(stderr, "bad config \"%s\" (ALGO/MS, ALGO = stable|lockout|integrate)\n", item.c_str());
+      return false;
+    }
+    out.push_back(c);
+    if (comma == std::string::npos) break;
+    pos = comma + 1;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  static const option longOpts[] = {
+    { "debounce", required_argument, nullptr, 'D' },
+    { "settle", required_argument, nullptr, 's' },
+    { "per-trace", no_argument, nullptr, 'p' },
+    { "verbose", no_argument, nullptr, 'v' },
+    { "csv", required_argument, nullptr, 'C' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
+  };
+
+  Options o;
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOpts, nullptr)) != -1) {
+    switch (c) {
+      case 'D': if (!parseConfigs(optarg, o.configs)) return 2; break;
+      case 's': o.settleMs = (uint32_t)atol(optarg); break;
+      case 'p': o.perTrace = true; break;
+      case 'v': o.verbose = true; break;
+      case 'C': o.csv = optarg; break;
+      default: usage(); return c == 'h' ? 0 : 2;
+    }
+  }
+  if (optind >= argc || !o.settleMs) {
+    usage();
+    return 2;
+  }
+  if (o.configs.empty()) {
+    for (uint8_t a = 0; a < DEB__COUNT; a++) {
+      for (uint16_t ms : SWEEP_MS) {
+        DebounceCfg cfg;
+        cfg.algo = a;
+        cfg.ms = ms;
+        o.configs.push_back(cfg);
+      }
+    }
+  }
+
+  FILE* csv = nullptr;
+  if (o.csv) {
+    csv = fopen(o.csv, "w");
+    if (!csv) { perror(o.csv); return 1; }
+    fprintf(csv, "trace,config,toggles,missed,false,releases,missed_release,false_release,"
+                 "p50_ms,p99_ms,max_ms,release_p50_ms,release_p99_ms\n");
+  }
+
+  std::vector<Score> total(o.configs.size());
+  std::string deviceCfg;
+  uint32_t traces = 0;
+  for (int a = optind; a < argc; a++) {
+    Trace t;
+    if (!loadTrace(argv[a], t)) return 1;
+    TraceInfo info;
+    reference(t, o.settleMs * 1000, info);
+    if (traces++ == 0) deviceCfg = t.debounce;
+    else if (deviceCfg != t.debounce) deviceCfg.clear();
+
+    printf("%s: %.1f s at %u us, %zu edges, %zu transitions, press bounce p50 %.2f max %.2f ms, "
+           "release bounce p50 %.2f max %.2f ms, longest glitch %.2f ms\n",
+           t.name.c_str(), t.endUs / 1e6, t.periodUs, t.edges.size(), info.ref.size(), info.pressBounce.pct(0.5),
+           info.pressBounce.max(), info.releaseBounce.pct(0.5), info.releaseBounce.max(),
+           info.longestGlitchUs / 1000.0);
+
+    std::vector<Score> scores;
+    std::vector<Transition> out;
+    for (const DebounceCfg &cfg : o.configs) {
+      out.clear();
+      replay(t, cfg, out);
+      scores.push_back(score(t, cfg, info.ref, out, o.verbose));
+    }
+    for (size_t i = 0; i < scores.size(); i++) total[i].add(scores[i]);
+    if (o.perTrace) printTable(t.name.c_str(), o.configs, scores, t.debounce);
+    if (csv) writeCsvRows(csv, t.name.c_str(), o.configs, scores);
+  }
+
+  char title[64];
+  snprintf(title, sizeof(title), "%u trace(s), settle %u ms", traces, o.settleMs);
+  printTable(title, o.configs, total, deviceCfg);
+  if (csv) {
+    writeCsvRows(csv, "all", o.configs, total);
+    fclose(csv);
+    printf("CSV: %s\n", o.csv);
+  }
+  return 0;
+}
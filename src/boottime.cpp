@@ -0,0 +1,47 @@
+#include "boottime.h"
+#include "log.h"
+
+#include <atomic>
+
+// -------------------- State --------------------
+// Written by setup() only; bootDone() publishes with a release store.
+static BootPhase phases[BOOT_PHASES_MAX];
+static uint8_t   phase_count = 0;
+static std::atomic<uint32_t> ready_us{0};
+
+// -------------------- API --------------------
+uint8_t bootPhaseBegin(const char* name) {
+  if (phase_count >= BOOT_PHASES_MAX) return BOOT_PHASES_MAX;
+  phases[phase_count] = { name, (uint32_t)micros(), 0 };
+  return phase_count++;
+}
+
+void bootPhaseEnd(uint8_t id) {
+  if (id >= phase_count) return;
+  const uint32_t d = (uint32_t)micros() - phases[id].startUs;
+  phases[id].durUs = d ? d : 1;
+}
+
+void bootDone() {
+  const uint32_t now = micros();
+
+  char line[LOG_MSG_MAX];
+  size_t n = 0;
+  for (uint8_t i = 0; i < phase_count && n < sizeof(line); i++) {
+    n += snprintf(line + n, sizeof(line) - n, "%s%s %.1f", i ? ", " : "", phases[i].name, phases[i].durUs / 1000.0f);
+  }
+  if (!phase_count) line[0] = 0;
+  LOGI("BOOT", "ready in %.1f ms (%s)", now / 1000.0f, line);
+
+  ready_us.store(now, std::memory_order_release);
+}
+
+uint8_t bootPhases(BootPhase* out) {
+  if (!ready_us.load(std::memory_order_acquire)) return 0;
+  memcpy(out, phases, phase_count * sizeof(BootPhase));
+  return phase_count;
+}
+
+uint32_t bootReadyUs() {
+  return ready_us.load(std::memory_order_acquire);
+}
@@ -0,0 +1,35 @@
+/**************************************************************
+ * Boot phase timing
+ *
+ *  - setup() brackets each phase with bootPhaseBegin()/bootPhaseEnd().
+ *    Phases may overlap (the Wi-Fi join runs while the file system
+ *    mounts and config loads).
+ *  - Times are micros() since the app started, so the first phase's
+ *    start includes the ROM/bootloader hand-off.
+ *  - bootDone() marks the node ready to serve and logs a one-line
+ *    summary. Phases are reported at /api/boot and as
+ *    switchnode_boot_phase_seconds in /metrics, so boot-time
+ *    regressions show up per phase.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef BOOT_PHASES_MAX
+#define BOOT_PHASES_MAX 16
+#endif
+
+struct BootPhase {
+  const char* name;      // string literal
+  uint32_t    startUs;
+  uint32_t    durUs;     // 0 while running
+};
+
+// setup() only. Returns the phase id for bootPhaseEnd().
+uint8_t bootPhaseBegin(const char* name);
+void bootPhaseEnd(uint8_t id);
+void bootDone();
+
+// Any task, after bootDone(); `out` holds BOOT_PHASES_MAX entries.
+uint8_t bootPhases(BootPhase* out);
+uint32_t bootReadyUs();   // 0 until bootDone()
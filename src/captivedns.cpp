@@ -0,0 +1,184 @@
+#include "captivedns.h"
+#include "log.h"
+
+#include <AsyncUDP.h>
+#include <string.h>
+
+// -------------------- Protocol --------------------
+static const size_t   DNS_HEADER_LEN  = 12;
+static const size_t   DNS_MAX_PACKET  = 512;
+static const size_t   DNS_CACHE_ENTRY = 192;   // larger responses are not cached
+static const uint32_t DNS_TTL_S       = 60;
+
+enum DnsType : uint16_t {
+  DNS_TYPE_A     = 1,
+  DNS_TYPE_SOA   = 6,
+  DNS_TYPE_AAAA  = 28,
+  DNS_TYPE_HTTPS = 65,
+  DNS_TYPE_ANY   = 255,
+};
+
+static const uint8_t DNS_RCODE_NOERROR = 0;
+static const uint8_t DNS_RCODE_FORMERR = 1;
+static const uint8_t DNS_RCODE_NOTIMP  = 4;
+
+// -------------------- State --------------------
+// Everything below is touched only by the AsyncUDP task.
+struct CacheEntry {
+  uint16_t qlen;    // question bytes (name + type + class) at offset 12
+  uint16_t len;     // whole response
+  uint8_t  data[DNS_CACHE_ENTRY];
+};
+
+static AsyncUDP dns_udp;
+static uint8_t portal_ip[4];
+static CacheEntry dns_cache[CAPTIVE_DNS_CACHE_SLOTS];
+static uint8_t dns_cache_next = 0;
+static CaptiveDnsStats dns_stats = {};
+
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = (uint8_t)v; }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, v >> 16); put16(p + 2, (uint16_t)v); }
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+// Length of the uncompressed QNAME at p (incl. the root label), 0 if invalid.
+static size_t qnameLen(const uint8_t* p, size_t avail) {
+  size_t i = 0;
+  while (i < avail) {
+    const uint8_t l = p[i];
+    if (l == 0) return i + 1;
+    if (l & 0xC0) return 0;   // no compression in questions
+    i += 1 + l;
+    if (i > 255) return 0;
+  }
+  return 0;
+}
+
+// Header-only reply (errors): echoes ID and RD, no sections.
+static void replyRcode(AsyncUDPPacket &pkt, const uint8_t* q, uint8_t rcode) {
+  uint8_t out[DNS_HEADER_LEN] = {};
+  out[0] = q[0];
+  out[1] = q[1];
+  out[2] = 0x80 | (q[2] & 0x79);   // QR + echo opcode/RD
+  out[3] = rcode;
+  pkt.write(out, sizeof(out));
+}
+
+// Builds the full response for a single-question query into out.
+static size_t encode(const uint8_t* q, size_t qlen, uint16_t qtype, uint8_t* out) {
+  memset(out, 0, DNS_HEADER_LEN);
+  out[2] = 0x84;   // QR, AA
+  out[3] = DNS_RCODE_NOERROR;
+  put16(out + 4, 1);   // QDCOUNT
+  memcpy(out + DNS_HEADER_LEN, q + DNS_HEADER_LEN, qlen);
+  size_t n = DNS_HEADER_LEN + qlen;
+
+  if (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) {
+    put16(out + 6, 1);   // ANCOUNT
+    put16(out + n, 0xC00C);  n += 2;   // name -> question
+    put16(out + n, DNS_TYPE_A); n += 2;
+    put16(out + n, 1);       n += 2;   // IN
+    put32(out + n, DNS_TTL_S); n += 4;
+    put16(out + n, 4);       n += 2;
+    memcpy(out + n, portal_ip, 4); n += 4;
+    return n;
+  }
+
+  // NODATA: SOA in the authority section sets the negative-cache TTL.
+  put16(out + 8, 1);   // NSCOUNT
+  put16(out + n, 0xC00C);  n += 2;
+  put16(out + n, DNS_TYPE_SOA); n += 2;
+  put16(out + n, 1);       n += 2;
+  put32(out + n, DNS_TTL_S); n += 4;
+  put16(out + n, 2 + 2 + 5 * 4); n += 2;
+  put16(out + n, 0xC00C);  n += 2;   // MNAME
+  put16(out + n, 0xC00C);  n += 2;   // RNAME
+  put32(out + n, 1);       n += 4;   // serial
+  put32(out + n, 3600);    n += 4;   // refresh
+  put32(out + n, 600);     n += 4;   // retry
+  put32(out + n, 86400);   n += 4;   // expire
+  put32(out + n, DNS_TTL_S); n += 4; // minimum (negative TTL)
+  return n;
+}
+
+static const CacheEntry* cacheFind(const uint8_t* q, size_t qlen) {
+  for (uint8_t i = 0; i < CAPTIVE_DNS_CACHE_SLOTS; i++) {
+    const CacheEntry &e = dns_cache[i];
+    if (e.len && e.qlen == qlen && memcmp(e.data + DNS_HEADER_LEN, q + DNS_HEADER_LEN, qlen) == 0) return &e;
+  }
+  return nullptr;
+}
+
+static void cacheStore(size_t qlen, const uint8_t* resp, size_t len) {
+  if (len > DNS_CACHE_ENTRY) return;
+  CacheEntry &e = dns_cache[dns_cache_next];
+  dns_cache_next = (dns_cache_next + 1) % CAPTIVE_DNS_CACHE_SLOTS;
+  memcpy(e.data, resp, len);
+  e.qlen = (uint16_t)qlen;
+  e.len = (uint16_t)len;
+}
+
+static void onQuery(AsyncUDPPacket &pkt) {
+  const uint8_t* q = pkt.data();
+  const size_t len = pkt.length();
+  dns_stats.queries++;
+
+  if (len < DNS_HEADER_LEN || len > DNS_MAX_PACKET || (q[2] & 0x80)) {   // runt, oversize or a response
+    dns_stats.malformed++;
+    return;
+  }
+  if (((q[2] >> 3) & 0x0F) != 0) {   // opcode != QUERY
+    replyRcode(pkt, q, DNS_RCODE_NOTIMP);
+    return;
+  }
+
+  const size_t nameLen = qnameLen(q + DNS_HEADER_LEN, len - DNS_HEADER_LEN);
+  const size_t qlen = nameLen + 4;
+  if (get16(q + 4) != 1 || !nameLen || DNS_HEADER_LEN + qlen > len) {
+    dns_stats.malformed++;
+    replyRcode(pkt, q, DNS_RCODE_FORMERR);
+    return;
+  }
+  const uint16_t qtype = get16(q + DNS_HEADER_LEN + nameLen);
+
+  uint8_t out[DNS_HEADER_LEN + 260 + 64];
+  size_t n;
+  const CacheEntry* hit = cacheFind(q, qlen);
+  if (hit) {
+    dns_stats.cacheHits++;
+    n = hit->len;
+    memcpy(out, hit->data, n);
+  } else {
+    n = encode(q, qlen, qtype, out);
+    cacheStore(qlen, out, n);
+  }
+
+  out[0] = q[0];
+  out[1] = q[1];
+  out[2] = (out[2] & ~0x01) | (q[2] & 0x01);   // echo RD
+  pkt.write(out, n);
+
+  if (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) dns_stats.answered++;
+  else dns_stats.nodata++;
+}
+
+bool captiveDnsBegin(const IPAddress &ip, uint16_t port) {
+  for (int i = 0; i < 4; i++) portal_ip[i] = ip[i];
+  memset(dns_cache, 0, sizeof(dns_cache));
+  dns_cache_next = 0;
+
+  if (!dns_udp.listen(port)) {
+    LOGE("DNS", "listen on %u failed", port);
+    return false;
+  }
+  dns_udp.onPacket(onQuery);
+  LOGI("DNS", "captive responder on :%u -> %s", port, ip.toString().c_str());
+  return true;
+}
+
+void captiveDnsStop() {
+  dns_udp.close();
+}
+
+CaptiveDnsStats captiveDnsStats() {
+  return dns_stats;
+}
@@ -0,0 +1,31 @@
+/**************************************************************
+ * Captive-portal DNS responder (AP mode)
+ *
+ *  - Driven by the AsyncUDP receive callback: every query is answered
+ *    as soon as it arrives, no polling from a loop.
+ *  - A / ANY queries resolve any name to the portal IP.
+ *  - AAAA, HTTPS and every other type get NOERROR with no answers plus
+ *    an SOA (negative TTL), so clients cache the "no such record"
+ *    instead of retrying. Non-QUERY opcodes get NOTIMP.
+ *  - Encoded responses are cached by question; a hit only patches the
+ *    transaction ID.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef CAPTIVE_DNS_CACHE_SLOTS
+#define CAPTIVE_DNS_CACHE_SLOTS 8
+#endif
+
+struct CaptiveDnsStats {
+  uint32_t queries;
+  uint32_t answered;     // A / ANY
+  uint32_t nodata;       // AAAA, HTTPS, ...
+  uint32_t cacheHits;
+  uint32_t malformed;
+};
+
+bool captiveDnsBegin(const IPAddress &ip, uint16_t port = 53);
+void captiveDnsStop();
+CaptiveDnsStats captiveDnsStats();
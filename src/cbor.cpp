@@ -0,0 +1,224 @@
+#include "cbor.h"
+
+#include <math.h>
+#include <string.h>
+
+enum CborMajor : uint8_t {
+  CBOR_UINT   = 0,
+  CBOR_NEGINT = 1,
+  CBOR_BYTES  = 2,
+  CBOR_TEXT   = 3,
+  CBOR_ARRAY  = 4,
+  CBOR_MAP    = 5,
+  CBOR_TAG    = 6,
+  CBOR_SIMPLE = 7,
+};
+
+// -------------------- Encoder --------------------
+static size_t writeHead(Print &out, uint8_t major, uint64_t v) {
+  uint8_t b[9];
+  size_t n;
+  const uint8_t m = (uint8_t)(major << 5);
+  if (v < 24) {
+    b[0] = m | (uint8_t)v; n = 1;
+  } else if (v <= 0xFF) {
+    b[0] = m | 24; b[1] = (uint8_t)v; n = 2;
+  } else if (v <= 0xFFFF) {
+    b[0] = m | 25; n = 3;
+  } else if (v <= 0xFFFFFFFFULL) {
+    b[0] = m | 26; n = 5;
+  } else {
+    b[0] = m | 27; n = 9;
+  }
+  for (size_t i = 1; n > 2 && i < n; i++) b[i] = (uint8_t)(v >> (8 * (n - 1 - i)));
+  return out.write(b, n);
+}
+
+static size_t writeText(Print &out, const char* s, size_t len) {
+  return writeHead(out, CBOR_TEXT, len) + out.write((const uint8_t*)s, len);
+}
+
+static size_t writeFloat(Print &out, double d) {
+  uint8_t b[9];
+  const float f = (float)d;
+  if ((double)f == d) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    b[0] = 0xFA;
+    for (int i = 0; i < 4; i++) b[1 + i] = (uint8_t)(u >> (24 - 8 * i));
+    return out.write(b, 5);
+  }
+  uint64_t u;
+  memcpy(&u, &d, sizeof(u));
+  b[0] = 0xFB;
+  for (int i = 0; i < 8; i++) b[1 + i] = (uint8_t)(u >> (56 - 8 * i));
+  return out.write(b, 9);
+}
+
+size_t serializeCbor(JsonVariantConst v, Print &out) {
+  if (v.is<JsonObjectConst>()) {
+    JsonObjectConst o = v.as<JsonObjectConst>();
+    size_t n = writeHead(out, CBOR_MAP, o.size());
+    for (JsonPairConst kv : o) {
+      n += writeText(out, kv.key().c_str(), kv.key().size());
+      n += serializeCbor(kv.value(), out);
+    }
+    return n;
+  }
+  if (v.is<JsonArrayConst>()) {
+    JsonArrayConst a = v.as<JsonArrayConst>();
+    size_t n = writeHead(out, CBOR_ARRAY, a.size());
+    for (JsonVariantConst e : a) n += serializeCbor(e, out);
+    return n;
+  }
+  if (v.is<bool>()) return out.write((uint8_t)(v.as<bool>() ? 0xF5 : 0xF4));
+  if (v.is<unsigned long long>()) return writeHead(out, CBOR_UINT, v.as<unsigned long long>());
+  if (v.is<long long>()) return writeHead(out, CBOR_NEGINT, (uint64_t)(-1 - v.as<long long>()));
+  if (v.is<double>()) return writeFloat(out, v.as<double>());
+  if (v.is<const char*>()) {
+    const char* s = v.as<const char*>();
+    return writeText(out, s, strlen(s));
+  }
+  return out.write((uint8_t)0xF6);   // null
+}
+
+// -------------------- Decoder --------------------
+namespace {
+
+struct Reader {
+  const uint8_t* p;
+  const uint8_t* end;
+  char text[CBOR_MAX_STRING + 1];
+
+  bool take(size_t n, uint64_t &v) {
+    if ((size_t)(end - p) < n) return false;
+    v = 0;
+    for (size_t i = 0; i < n; i++) v = (v << 8) | *p++;
+    return true;
+  }
+
+  // Reads an initial byte + argument. Returns an error code or Ok.
+  DeserializationError::Code head(uint8_t &major, uint8_t &info, uint64_t &arg) {
+    if (p >= end) return DeserializationError::IncompleteInput;
+    const uint8_t ib = *p++;
+    major = ib >> 5;
+    info = ib & 0x1F;
+    if (info < 24) { arg = info; return DeserializationError::Ok; }
+    if (info > 27) return DeserializationError::InvalidInput;   // reserved / indefinite
+    const size_t n = (size_t)1 << (info - 24);
+    return take(n, arg) ? DeserializationError::Ok : DeserializationError::IncompleteInput;
+  }
+
+  DeserializationError::Code string(uint64_t len) {
+    if (len > CBOR_MAX_STRING) return DeserializationError::NoMemory;
+    if ((uint64_t)(end - p) < len) return DeserializationError::IncompleteInput;
+    memcpy(text, p, (size_t)len);
+    text[len] = 0;
+    p += len;
+    return DeserializationError::Ok;
+  }
+
+  DeserializationError::Code item(JsonVariant dst, uint8_t depth);
+};
+
+static double halfToDouble(uint16_t h) {
+  const int exp = (h >> 10) & 0x1F;
+  const int mant = h & 0x3FF;
+  double v;
+  if (exp == 0)       v = ldexp(mant, -24);
+  else if (exp != 31) v = ldexp(mant + 1024, exp - 25);
+  else                v = mant ? NAN : INFINITY;
+  return (h & 0x8000) ? -v : v;
+}
+
+DeserializationError::Code Reader::item(JsonVariant dst, uint8_t depth) {
+  if (depth > CBOR_MAX_DEPTH) return DeserializationError::TooDeep;
+
+  uint8_t major, info;
+  uint64_t arg;
+  DeserializationError::Code err = head(major, info, arg);
+  if (err != DeserializationError::Ok) return err;
+
+  switch (major) {
+    case CBOR_UINT:
+      dst.set((unsigned long long)arg);
+      return DeserializationError::Ok;
+
+    case CBOR_NEGINT:
+      if (arg > (uint64_t)INT64_MAX) return DeserializationError::InvalidInput;
+      dst.set(-1 - (long long)arg);
+      return DeserializationError::Ok;
+
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+      err = string(arg);
+      if (err == DeserializationError::Ok) dst.set((char*)text);   // char* => copied
+      return err;
+
+    case CBOR_ARRAY: {
+      JsonArray a = dst.to<JsonArray>();
+      for (uint64_t i = 0; i < arg; i++) {
+        err = item(a.add(), depth + 1);
+        if (err != DeserializationError::Ok) return err;
+      }
+      return DeserializationError::Ok;
+    }
+
+    case CBOR_MAP: {
+      JsonObject o = dst.to<JsonObject>();
+      for (uint64_t i = 0; i < arg; i++) {
+        uint8_t kMajor, kInfo;
+        uint64_t kLen;
+        err = head(kMajor, kInfo, kLen);
+        if (err != DeserializationError::Ok) return err;
+        if (kMajor != CBOR_TEXT) return DeserializationError::InvalidInput;
+        err = string(kLen);
+        if (err != DeserializationError::Ok) return err;
+        err = item(o[(char*)text].to<JsonVariant>(), depth + 1);
+        if (err != DeserializationError::Ok) return err;
+      }
+      return DeserializationError::Ok;
+    }
+
+    case CBOR_SIMPLE:
+      switch (info) {
+        case 20: dst.set(false); return DeserializationError::Ok;
+        case 21: dst.set(true);  return DeserializationError::Ok;
+        case 22:
+        case 23: dst.clear();    return DeserializationError::Ok;   // null / undefined
+        case 25: dst.set(halfToDouble((uint16_t)arg)); return DeserializationError::Ok;
+        case 26: {
+          const uint32_t u = (uint32_t)arg;
+          float f;
+          memcpy(&f, &u, sizeof(f));
+          dst.set(f);
+          return DeserializationError::Ok;
+        }
+        case 27: {
+          double d;
+          memcpy(&d, &arg, sizeof(d));
+          dst.set(d);
+          return DeserializationError::Ok;
+        }
+        default: return DeserializationError::InvalidInput;
+      }
+
+    default:   // tags
+      return DeserializationError::InvalidInput;
+  }
+}
+
+}  // namespace
+
+DeserializationError deserializeCbor(JsonDocument &doc, const uint8_t* data, size_t len) {
+  doc.clear();
+  if (!data || !len) return DeserializationError::EmptyInput;
+
+  Reader rd;
+  rd.p = data;
+  rd.end = data + len;
+  const DeserializationError::Code err = rd.item(doc.to<JsonVariant>(), 0);
+  if (err != DeserializationError::Ok) return err;
+  if (doc.overflowed()) return DeserializationError::NoMemory;
+  return DeserializationError::Ok;
+}
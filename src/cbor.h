@@ -0,0 +1,26 @@
+/**************************************************************
+ * CBOR (RFC 8949) for ArduinoJson documents
+ *
+ *  - serializeCbor()/deserializeCbor() mirror serializeJson()/
+ *    deserializeJson(), so API handlers build one JsonDocument and pick
+ *    the wire format per request (Accept / Content-Type).
+ *  - Covers the JSON data model: maps with text keys, arrays, text,
+ *    integers, floats, true/false/null. Byte strings decode as text.
+ *  - Indefinite-length items and tags are rejected (InvalidInput).
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef CBOR_MAX_DEPTH
+#define CBOR_MAX_DEPTH 8
+#endif
+
+#ifndef CBOR_MAX_STRING
+#define CBOR_MAX_STRING 128
+#endif
+
+size_t serializeCbor(JsonVariantConst src, Print &out);
+
+DeserializationError deserializeCbor(JsonDocument &doc, const uint8_t* data, size_t len);
@@ -0,0 +1,443 @@
+#include "coap.h"
+
+#include <string.h>
+#include <strings.h>
+
+static const char* const COAP_LINKS =
+  "</relay>;rt=\"switchnode.relay\";if=\"core.a\";ct=0;obs,"
+  "</input>;rt=\"switchnode.input\";if=\"core.s\";ct=0;obs";
+
+// -------------------- Codec --------------------
+static uint32_t readUint(const uint8_t* p, size_t n) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < n; i++) v = (v << 8) | p[i];
+  return v;
+}
+
+// Reads an option delta/length nibble plus its extension bytes.
+static bool readExt(uint32_t nib, const uint8_t* buf, size_t len, size_t &i, uint32_t &out) {
+  if (nib < 13) { out = nib; return true; }
+  if (nib == 13) {
+    if (i + 1 > len) return false;
+    out = buf[i++] + 13;
+    return true;
+  }
+  if (nib == 14) {
+    if (i + 2 > len) return false;
+    out = ((uint32_t)buf[i] << 8 | buf[i + 1]) + 269;
+    i += 2;
+    return true;
+  }
+  return false;   // 15 is reserved for the payload marker
+}
+
+bool coapParse(const uint8_t* buf, size_t len, CoapMsg &m) {
+  if (len < 4 || (buf[0] >> 6) != 1) return false;
+  m.type = (buf[0] >> 4) & 0x03;
+  m.tkl = buf[0] & 0x0F;
+  m.code = buf[1];
+  m.mid = (uint16_t)(buf[2] << 8 | buf[3]);
+  if (m.tkl > 8 || 4u + m.tkl > len) return false;
+  memcpy(m.token, buf + 4, m.tkl);
+
+  m.observe = COAP_NONE;
+  m.accept = COAP_NONE;
+  m.block2 = COAP_NONE;
+  m.path[0] = 0;
+  m.badOption = false;
+  m.payload = nullptr;
+  m.payloadLen = 0;
+
+  if (m.code == COAP_EMPTY) return m.tkl == 0 && len == 4;
+
+  size_t i = 4 + m.tkl;
+  size_t pathLen = 0;
+  uint32_t opt = 0;
+  while (i < len) {
+    const uint8_t b = buf[i++];
+    if (b == 0xFF) {
+      if (i == len) return false;   // marker without payload
+      m.payload = buf + i;
+      m.payloadLen = len - i;
+      break;
+    }
+    uint32_t delta, olen;
+    if (!readExt(b >> 4, buf, len, i, delta)) return false;
+    if (!readExt(b & 0x0F, buf, len, i, olen)) return false;
+    if (i + olen > len) return false;
+    opt += delta;
+    const uint8_t* val = buf + i;
+    i += olen;
+
+    switch (opt) {
+      case COAP_OPT_OBSERVE:
+        if (olen > 3) return false;
+        m.observe = readUint(val, olen);
+        break;
+      case COAP_OPT_URI_PATH:
+        if (pathLen + 1 + olen >= sizeof(m.path)) {
+          m.path[0] = 0;
+          pathLen = sizeof(m.path);   // too long: matches no resource
+          break;
+        }
+        m.path[pathLen++] = '/';
+        memcpy(m.path + pathLen, val, olen);
+        pathLen += olen;
+        m.path[pathLen] = 0;
+        break;
+      case COAP_OPT_ACCEPT:
+        if (olen > 2) return false;
+        m.accept = readUint(val, olen);
+        break;
+      case COAP_OPT_BLOCK2:
+        if (olen > 3) return false;
+        m.block2 = readUint(val, olen);
+        break;
+      case 3:    // Uri-Host
+      case 7:    // Uri-Port
+      case COAP_OPT_CONTENT_FORMAT:
+      case COAP_OPT_URI_QUERY:
+        break;
+      default:
+        if (opt & 1) m.badOption = true;   // critical and unknown
+        break;
+    }
+  }
+  return true;
+}
+
+void CoapWriter::put(const void* p, size_t n) {
+  if (!ok_ || len_ + n > cap_) { ok_ = false; return; }
+  memcpy(buf_ + len_, p, n);
+  len_ += n;
+}
+
+void CoapWriter::header(uint8_t type, uint8_t code, uint16_t mid, const uint8_t* token, uint8_t tkl) {
+  const uint8_t h[4] = { (uint8_t)(0x40 | (type << 4) | tkl), code, (uint8_t)(mid >> 8), (uint8_t)mid };
+  len_ = 0;
+  last_opt_ = 0;
+  ok_ = true;
+  put(h, sizeof(h));
+  put(token, tkl);
+}
+
+static uint8_t nibble(uint32_t v, uint8_t* ext, size_t &n) {
+  if (v < 13) return (uint8_t)v;
+  if (v < 269) { ext[n++] = (uint8_t)(v - 13); return 13; }
+  v -= 269;
+  ext[n++] = (uint8_t)(v >> 8);
+  ext[n++] = (uint8_t)v;
+  return 14;
+}
+
+void CoapWriter::option(uint16_t num, const void* val, size_t len) {
+  if (num < last_opt_) { ok_ = false; return; }
+  uint8_t head[5];
+  uint8_t ext[4];
+  size_t n = 0;
+  const uint8_t d = nibble(num - last_opt_, ext, n);
+  const uint8_t l = nibble((uint32_t)len, ext, n);
+  head[0] = (uint8_t)(d << 4 | l);
+  memcpy(head + 1, ext, n);
+  put(head, 1 + n);
+  put(val, len);
+  last_opt_ = num;
+}
+
+void CoapWriter::optionUint(uint16_t num, uint32_t v) {
+  uint8_t b[4];
+  size_t n = 0;
+  for (int s = 24; s >= 0; s -= 8) {
+    if (n || (v >> s) & 0xFF) b[n++] = (uint8_t)(v >> s);
+  }
+  option(num, b, n);
+}
+
+void CoapWriter::payload(const void* data, size_t len) {
+  if (!len) return;
+  const uint8_t marker = 0xFF;
+  put(&marker, 1);
+  put(data, len);
+}
+
+// -------------------- Server --------------------
+static inline bool sameAddr(const CoapAddr &a, const CoapAddr &b) {
+  return a.ip == b.ip && a.port == b.port;
+}
+
+void CoapServer::begin(const CoapHost &host, bool confirmable) {
+  host_ = host;
+  confirmable_ = confirmable;
+  next_mid_ = (uint16_t)host_.random(host_.ctx);
+  clearObservers();
+  memset(dedup_, 0, sizeof(dedup_));
+  st_ = {};
+}
+
+void CoapServer::clearObservers() {
+  memset(obs_, 0, sizeof(obs_));
+}
+
+uint32_t CoapServer::ackTimeout() {
+  // ACK_TIMEOUT * [1, ACK_RANDOM_FACTOR = 1.5)
+  return COAP_ACK_TIMEOUT_MS + host_.random(host_.ctx) % (COAP_ACK_TIMEOUT_MS / 2);
+}
+
+CoapServer::Observer* CoapServer::findObserver(const CoapAddr &a, const uint8_t* token, uint8_t tkl) {
+  for (Observer &o : obs_) {
+    if (o.used && sameAddr(o.addr, a) && o.tkl == tkl && !memcmp(o.token, token, tkl)) return &o;
+  }
+  return nullptr;
+}
+
+void CoapServer::dropObserver(Observer &o) {
+  o.used = false;
+  o.pending = false;
+}
+
+void CoapServer::stateText(uint8_t resource, char out[2]) {
+  const bool on = (resource == COAP_RES_RELAY) ? host_.relay(host_.ctx) : host_.inputPressed(host_.ctx);
+  out[0] = on ? '1' : '0';
+  out[1] = 0;
+}
+
+// With block2 set, only that block of `body` goes out (the caller checked
+// that it starts inside the body).
+void CoapServer::respond(const CoapAddr &to, const CoapMsg &req, uint8_t code, uint16_t cf,
+                         const char* body, uint32_t observe, uint32_t block2) {
+  uint8_t buf[COAP_MSG_MAX];
+  CoapWriter w(buf, sizeof(buf));
+  const bool con = (req.type == COAP_CON);
+  w.header(con ? COAP_ACK : COAP_NON, code, con ? req.mid : next_mid_++, req.token, req.tkl);
+  if (observe != COAP_NONE) w.optionUint(COAP_OPT_OBSERVE, observe & 0xFFFFFF);
+  if (body) {
+    size_t len = strlen(body);
+    w.optionUint(COAP_OPT_CONTENT_FORMAT, cf);
+    if (block2 != COAP_NONE) {
+      const size_t size = (size_t)16 << (block2 & 0x07);
+      const size_t off = (block2 >> 4) * size;
+      const bool more = off + size < len;
+      body += off;
+      len = more ? size : len - off;
+      w.optionUint(COAP_OPT_BLOCK2, (block2 & ~0x0Fu) | (more ? 0x08 : 0) | (block2 & 0x07));
+    }
+    w.payload(body, len);
+  }
+  const size_t n = w.size();
+  if (!n) return;
+  host_.send(host_.ctx, to, buf, n);
+
+  Dedup &d = dedup_[dedup_next_];
+  dedup_next_ = (dedup_next_ + 1) % COAP_DEDUP_SLOTS;
+  d.used = true;
+  d.addr = to;
+  d.mid = req.mid;
+  d.len = (n <= sizeof(d.resp)) ? (uint8_t)n : 0;
+  if (d.len) memcpy(d.resp, buf, n);
+}
+
+size_t CoapServer::buildState(uint8_t* buf, size_t cap, uint8_t type, uint16_t mid, const Observer &o) {
+  char text[2];
+  stateText(o.resource, text);
+  CoapWriter w(buf, cap);
+  w.header(type, COAP_CONTENT, mid, o.token, o.tkl);
+  w.optionUint(COAP_OPT_OBSERVE, obs_seq_[o.resource]);
+  w.optionUint(COAP_OPT_CONTENT_FORMAT, COAP_CF_TEXT);
+  w.payload(text, 1);
+  return w.size();
+}
+
+void CoapServer::handleRequest(const CoapAddr &from, const CoapMsg &m) {
+  st_.requests++;
+  if (m.badOption) { respond(from, m, COAP_BAD_OPTION, 0, nullptr, COAP_NONE); return; }
+
+  if (!strcmp(m.path, "/.well-known/core")) {
+    if (m.code != COAP_GET) { respond(from, m, COAP_NOT_ALLOWED, 0, nullptr, COAP_NONE); return; }
+    if (m.accept != COAP_NONE && m.accept != COAP_CF_LINK) {
+      respond(from, m, COAP_NOT_ACCEPTABLE, 0, nullptr, COAP_NONE);
+      return;
+    }
+    if (m.block2 != COAP_NONE) {
+      const uint8_t szx = m.block2 & 0x07;
+      if (szx == 7) { respond(from, m, COAP_BAD_REQUEST, 0, nullptr, COAP_NONE); return; }   // BERT: TCP only
+      if ((m.block2 >> 4) * ((size_t)16 << szx) >= strlen(COAP_LINKS)) {
+        respond(from, m, COAP_BAD_OPTION, 0, nullptr, COAP_NONE);
+        return;
+      }
+    }
+    respond(from, m, COAP_CONTENT, COAP_CF_LINK, COAP_LINKS, COAP_NONE, m.block2);
+    return;
+  }
+
+  uint8_t res;
+  if (!strcmp(m.path, "/relay"))      res = COAP_RES_RELAY;
+  else if (!strcmp(m.path, "/input")) res = COAP_RES_INPUT;
+  else { respond(from, m, COAP_NOT_FOUND, 0, nullptr, COAP_NONE); return; }
+
+  if (m.code == COAP_GET) {
+    if (m.accept != COAP_NONE && m.accept != COAP_CF_TEXT) {
+      respond(from, m, COAP_NOT_ACCEPTABLE, 0, nullptr, COAP_NONE);
+      return;
+    }
+    // A one-byte state is always block 0 and needs no Block2 in the reply.
+    if (m.block2 != COAP_NONE && (m.block2 >> 4) != 0) {
+      respond(from, m, COAP_BAD_OPTION, 0, nullptr, COAP_NONE);
+      return;
+    }
+    uint32_t observe = COAP_NONE;
+    Observer* o = findObserver(from, m.token, m.tkl);
+    if (m.observe == 0) {
+      if (!o) {
+        for (Observer &f : obs_) {
+          if (!f.used) { o = &f; break; }
+        }
+      }
+      if (o) {   // full table: plain response, the client sees no Observe
+        *o = {};
+        o->used = true;
+        o->addr = from;
+        o->tkl = m.tkl;
+        memcpy(o->token, m.token, m.tkl);
+        o->resource = res;
+        observe = obs_seq_[res];
+      }
+    } else if (m.observe == 1 && o) {
+      dropObserver(*o);
+    }
+    char text[2];
+    stateText(res, text);
+    respond(from, m, COAP_CONTENT, COAP_CF_TEXT, text, observe);
+    return;
+  }
+
+  if (res != COAP_RES_RELAY || (m.code != COAP_PUT && m.code != COAP_POST)) {
+    respond(from, m, COAP_NOT_ALLOWED, 0, nullptr, COAP_NONE);
+    return;
+  }
+
+  bool queued;
+  if (m.code == COAP_POST) {
+    queued = host_.toggle(host_.ctx);
+  } else {
+    char v[8] = {};
+    if (!m.payloadLen || m.payloadLen >= sizeof(v)) {
+      respond(from, m, COAP_BAD_REQUEST, 0, nullptr, COAP_NONE);
+      return;
+    }
+    memcpy(v, m.payload, m.payloadLen);
+    if (!strcasecmp(v, "1") || !strcasecmp(v, "on") || !strcasecmp(v, "true"))        queued = host_.setRelay(host_.ctx, true);
+    else if (!strcasecmp(v, "0") || !strcasecmp(v, "off") || !strcasecmp(v, "false")) queued = host_.setRelay(host_.ctx, false);
+    else if (!strcasecmp(v, "toggle"))                                               queued = host_.toggle(host_.ctx);
+    else { respond(from, m, COAP_BAD_REQUEST, 0, nullptr, COAP_NONE); return; }
+  }
+  respond(from, m, queued ? COAP_CHANGED : COAP_UNAVAILABLE, 0, nullptr, COAP_NONE);
+}
+
+void CoapServer::onPacket(const CoapAddr &from, const uint8_t* data, size_t len) {
+  CoapMsg m;
+  if (!coapParse(data, len, m)) {
+    st_.malformed++;
+    // A malformed CON is rejected with RST (same MID)
+    if (len >= 4 && (data[0] >> 6) == 1 && ((data[0] >> 4) & 0x03) == COAP_CON) {
+      uint8_t rst[4];
+      CoapWriter w(rst, sizeof(rst));
+      w.header(COAP_RST, COAP_EMPTY, (uint16_t)(data[2] << 8 | data[3]), nullptr, 0);
+      host_.send(host_.ctx, from, rst, w.size());
+    }
+    return;
+  }
+
+  if (m.type == COAP_ACK || m.type == COAP_RST) {
+    for (Observer &o : obs_) {
+      if (!o.used || !sameAddr(o.addr, from) || o.mid != m.mid) continue;
+      if (m.type == COAP_RST) {
+        dropObserver(o);   // client no longer interested
+      } else {
+        o.pending = false;
+        o.retries = 0;
+      }
+    }
+    return;
+  }
+
+  // Ping (empty CON) or a response sent to us: RST.
+  if (m.code == COAP_EMPTY || (m.code >> 5) != 0) {
+    if (m.type == COAP_CON) {
+      uint8_t rst[4];
+      CoapWriter w(rst, sizeof(rst));
+      w.header(COAP_RST, COAP_EMPTY, m.mid, nullptr, 0);
+      host_.send(host_.ctx, from, rst, w.size());
+    }
+    return;
+  }
+
+  for (const Dedup &d : dedup_) {
+    if (!d.used || d.mid != m.mid || !sameAddr(d.addr, from)) continue;
+    st_.duplicates++;
+    if (m.type == COAP_CON && d.len) host_.send(host_.ctx, from, d.resp, d.len);
+    return;
+  }
+
+  handleRequest(from, m);
+}
+
+void CoapServer::notify(uint8_t resource) {
+  if (resource >= COAP_RES_COUNT) return;
+  obs_seq_[resource] = (obs_seq_[resource] + 1) & 0xFFFFFF;
+  const uint32_t now = host_.nowMs(host_.ctx);
+
+  for (Observer &o : obs_) {
+    if (!o.used || o.resource != resource) continue;
+    o.sent++;
+    // A notification still waiting for its ACK is replaced by this one
+    // and keeps its retransmission state.
+    const bool con = confirmable_ || o.pending || (o.sent % COAP_CON_EVERY) == 0;
+    o.mid = next_mid_++;
+    o.len = (uint8_t)buildState(o.msg, sizeof(o.msg), con ? COAP_CON : COAP_NON, o.mid, o);
+    if (!o.len) continue;
+    if (con) {
+      if (!o.pending) {
+        o.retries = 0;
+        o.timeout = ackTimeout();
+        o.due = now + o.timeout;
+      }
+      o.pending = true;
+    }
+    host_.send(host_.ctx, o.addr, o.msg, o.len);
+    st_.notifications++;
+  }
+}
+
+uint32_t CoapServer::poll() {
+  const uint32_t now = host_.nowMs(host_.ctx);
+  uint32_t wait = 0;
+  for (Observer &o : obs_) {
+    if (!o.used || !o.pending) continue;
+    const int32_t left = (int32_t)(o.due - now);
+    if (left > 0) {
+      if (!wait || (uint32_t)left < wait) wait = (uint32_t)left;
+      continue;
+    }
+    if (o.retries >= COAP_MAX_RETRANSMIT) {
+      dropObserver(o);
+      st_.dropped++;
+      continue;
+    }
+    o.retries++;
+    o.timeout *= 2;
+    o.due = now + o.timeout;
+    host_.send(host_.ctx, o.addr, o.msg, o.len);
+    st_.retransmits++;
+    if (!wait || o.timeout < wait) wait = o.timeout;
+  }
+  return wait;
+}
+
+CoapStats CoapServer::stats() const {
+  CoapStats s = st_;
+  s.observers = 0;
+  for (const Observer &o : obs_) {
+    if (o.used) s.observers++;
+  }
+  return s;
+}
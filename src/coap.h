@@ -0,0 +1,195 @@
+/**************************************************************
+ * CoAP (RFC 7252) server core with Observe (RFC 7641)
+ *
+ *  Resources
+ *    /relay   GET (text/plain "1"/"0"), PUT "1"|"0"|"on"|"off"|"toggle",
+ *             POST toggles; observable
+ *    /input   GET "1" pressed / "0" open; observable
+ *    /.well-known/core   link-format discovery; Block2 (RFC 7959) on
+ *             request, for clients that fetch it in small blocks
+ *
+ *  - One datagram each way: a CON request gets a piggybacked ACK, a NON
+ *    request a NON response. Retransmitted CONs are answered from a small
+ *    dedup cache, so a repeated "toggle" is not applied twice.
+ *  - GET with Observe=0 registers (endpoint, token) for a resource.
+ *    Notifications are NON, or CON when `confirmable` is set. A NON
+ *    stream still sends every COAP_CON_EVERY-th notification as CON to
+ *    detect clients that went away. An unacknowledged CON is retried
+ *    with exponential back-off (2 s, 4 s, ...). After COAP_MAX_RETRANSMIT
+ *    retries, or on RST, the observer is dropped. A newer state replaces
+ *    a notification still waiting for its ACK.
+ *  - Portable: I/O, clock and relay access go through CoapHost.
+ *    Not thread-safe: callers serialize onPacket / notify / poll.
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef COAP_OBSERVERS_MAX
+#define COAP_OBSERVERS_MAX 8
+#endif
+#ifndef COAP_DEDUP_SLOTS
+#define COAP_DEDUP_SLOTS 4
+#endif
+
+static const uint16_t COAP_DEFAULT_PORT   = 5683;
+static const uint8_t  COAP_CON_EVERY      = 8;
+static const uint8_t  COAP_MAX_RETRANSMIT = 4;
+static const uint32_t COAP_ACK_TIMEOUT_MS = 2000;
+static const size_t   COAP_MSG_MAX        = 256;
+
+enum CoapType : uint8_t { COAP_CON, COAP_NON, COAP_ACK, COAP_RST };
+
+enum CoapCode : uint8_t {
+  COAP_EMPTY        = 0x00,
+  COAP_GET          = 0x01,
+  COAP_POST         = 0x02,
+  COAP_PUT          = 0x03,
+  COAP_DELETE       = 0x04,
+  COAP_CHANGED      = 0x44,   // 2.04
+  COAP_CONTENT      = 0x45,   // 2.05
+  COAP_BAD_REQUEST  = 0x80,   // 4.00
+  COAP_BAD_OPTION   = 0x82,   // 4.02
+  COAP_NOT_FOUND    = 0x84,   // 4.04
+  COAP_NOT_ALLOWED  = 0x85,   // 4.05
+  COAP_NOT_ACCEPTABLE = 0x86, // 4.06
+  COAP_UNAVAILABLE  = 0xA3,   // 5.03
+};
+
+enum CoapOption : uint16_t {
+  COAP_OPT_OBSERVE        = 6,
+  COAP_OPT_URI_PATH       = 11,
+  COAP_OPT_CONTENT_FORMAT = 12,
+  COAP_OPT_URI_QUERY      = 15,
+  COAP_OPT_ACCEPT         = 17,
+  COAP_OPT_BLOCK2         = 23,   // RFC 7959
+};
+
+static const uint16_t COAP_CF_TEXT      = 0;
+static const uint16_t COAP_CF_LINK      = 40;
+static const uint32_t COAP_NONE         = 0xFFFFFFFF;
+
+enum CoapResource : uint8_t { COAP_RES_RELAY, COAP_RES_INPUT, COAP_RES_COUNT };
+
+struct CoapMsg {
+  uint8_t        type;
+  uint8_t        code;
+  uint16_t       mid;
+  uint8_t        tkl;
+  uint8_t        token[8];
+  uint32_t       observe;          // COAP_NONE if absent
+  uint32_t       accept;           // COAP_NONE if absent
+  uint32_t       block2;           // NUM << 4 | M << 3 | SZX; COAP_NONE if absent
+  char           path[40];         // "/relay"
+  bool           badOption;        // unrecognized critical option
+  const uint8_t* payload;
+  size_t         payloadLen;
+};
+
+// False if `buf` is not a well-formed CoAP message.
+bool coapParse(const uint8_t* buf, size_t len, CoapMsg &m);
+
+// Builds a message; options must be added in increasing number order.
+class CoapWriter {
+public:
+  CoapWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap) {}
+  void header(uint8_t type, uint8_t code, uint16_t mid, const uint8_t* token, uint8_t tkl);
+  void option(uint16_t num, const void* val, size_t len);
+  void optionUint(uint16_t num, uint32_t v);
+  void payload(const void* data, size_t len);
+  size_t size() const { return ok_ ? len_ : 0; }
+
+private:
+  void put(const void* p, size_t n);
+  uint8_t* buf_;
+  size_t   cap_;
+  size_t   len_ = 0;
+  uint16_t last_opt_ = 0;
+  bool     ok_ = true;
+};
+
+struct CoapAddr {
+  uint32_t ip;     // network order, as stored by the socket layer
+  uint16_t port;
+};
+
+struct CoapHost {
+  void* ctx;
+  void     (*send)(void* ctx, const CoapAddr &to, const uint8_t* data, size_t len);
+  uint32_t (*nowMs)(void* ctx);
+  uint32_t (*random)(void* ctx);
+  bool     (*relay)(void* ctx);
+  bool     (*inputPressed)(void* ctx);
+  bool     (*setRelay)(void* ctx, bool on);   // false = could not queue
+  bool     (*toggle)(void* ctx);
+};
+
+struct CoapStats {
+  uint32_t requests;
+  uint32_t malformed;
+  uint32_t duplicates;
+  uint32_t notifications;
+  uint32_t retransmits;
+  uint32_t dropped;       // observers removed (RST / no ACK)
+  uint8_t  observers;
+};
+
+class CoapServer {
+public:
+  void begin(const CoapHost &host, bool confirmable);
+  void setConfirmable(bool on) { confirmable_ = on; }
+  void clearObservers();
+
+  void onPacket(const CoapAddr &from, const uint8_t* data, size_t len);
+  // The resource's state changed: notify its observers.
+  void notify(uint8_t resource);
+  // Retransmits pending CON notifications. Returns ms until the next
+  // deadline (0 = none).
+  uint32_t poll();
+
+  CoapStats stats() const;
+
+private:
+  struct Observer {
+    bool     used;
+    CoapAddr addr;
+    uint8_t  token[8];
+    uint8_t  tkl;
+    uint8_t  resource;
+    uint8_t  sent;        // notifications, for the periodic CON
+    bool     pending;     // CON waiting for ACK
+    uint16_t mid;
+    uint8_t  retries;
+    uint32_t timeout;
+    uint32_t due;
+    uint8_t  len;
+    uint8_t  msg[40];
+  };
+
+  struct Dedup {
+    CoapAddr addr;
+    uint16_t mid;
+    bool     used;
+    uint8_t  len;
+    uint8_t  resp[64];
+  };
+
+  void handleRequest(const CoapAddr &from, const CoapMsg &m);
+  void respond(const CoapAddr &to, const CoapMsg &req, uint8_t code, uint16_t cf,
+               const char* body, uint32_t observe, uint32_t block2 = COAP_NONE);
+  size_t buildState(uint8_t* buf, size_t cap, uint8_t type, uint16_t mid, const Observer &o);
+  void stateText(uint8_t resource, char out[2]);
+  Observer* findObserver(const CoapAddr &a, const uint8_t* token, uint8_t tkl);
+  void dropObserver(Observer &o);
+  uint32_t ackTimeout();
+
+  CoapHost host_ = {};
+  bool     confirmable_ = false;
+  uint16_t next_mid_ = 0;
+  uint32_t obs_seq_[COAP_RES_COUNT] = {};
+  Observer obs_[COAP_OBSERVERS_MAX] = {};
+  Dedup    dedup_[COAP_DEDUP_SLOTS] = {};
+  uint8_t  dedup_next_ = 0;
+  CoapStats st_ = {};
+};
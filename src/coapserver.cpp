@@ -0,0 +1,107 @@
+#include "coapserver.h"
+#include "log.h"
+
+#include <AsyncUDP.h>
+#include <WiFi.h>
+#include "esp_system.h"
+
+// -------------------- State --------------------
+// CoapServer is not thread-safe: the AsyncUDP task (requests) and the
+// net task (notify / poll) take `lock`. A mutex rather than a critical
+// section because the server sends from inside its calls.
+static CoapCfg cfg;
+static portMUX_TYPE cfg_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static AsyncUDP coap_udp;
+static CoapServer coap;
+static SemaphoreHandle_t lock = nullptr;
+static bool listening = false;
+
+struct CoapLock {
+  CoapLock()  { xSemaphoreTake(lock, portMAX_DELAY); }
+  ~CoapLock() { xSemaphoreGive(lock); }
+};
+
+// -------------------- Host --------------------
+static void hostSend(void*, const CoapAddr &to, const uint8_t* data, size_t len) {
+  coap_udp.writeTo(data, len, IPAddress(to.ip), to.port);
+}
+
+static uint32_t hostNow(void*)    { return millis(); }
+static uint32_t hostRandom(void*) { return esp_random(); }
+static bool hostRelay(void*)      { return controlRelayState(); }
+static bool hostPressed(void*)    { return !controlSnapshot().inputOpen; }
+static bool hostSet(void*, bool on) { return controlSetRelay(on, SRC_COAP); }
+static bool hostToggle(void*)     { return controlToggleRelay(SRC_COAP); }
+
+static const CoapHost HOST = { nullptr, hostSend, hostNow, hostRandom, hostRelay, hostPressed, hostSet, hostToggle };
+
+// -------------------- Receive (AsyncUDP task) --------------------
+static void onPacket(AsyncUDPPacket &pkt) {
+  const CoapAddr from = { (uint32_t)pkt.remoteIP(), pkt.remotePort() };
+  CoapLock l;
+  coap.onPacket(from, pkt.data(), pkt.length());
+}
+
+// -------------------- Lifecycle --------------------
+void coapStop() {
+  if (!listening) return;
+  coap_udp.close();
+  listening = false;
+  CoapLock l;
+  coap.clearObservers();
+}
+
+void coapStart() {
+  const CoapCfg c = coapConfig();
+  coapStop();
+  if (!c.enabled || !WiFi.isConnected()) return;
+  if (!coap_udp.listen(COAP_DEFAULT_PORT)) {
+    LOGE("COAP", "listen on %u failed", COAP_DEFAULT_PORT);
+    return;
+  }
+  coap_udp.onPacket(onPacket);
+  listening = true;
+  LOGI("COAP", "listening on udp/%u (%s notifications)", COAP_DEFAULT_PORT, c.confirmable ? "CON" : "NON");
+}
+
+void coapConfigure(const CoapCfg &c) {
+  if (!lock) {
+    lock = xSemaphoreCreateMutex();
+    coap.begin(HOST, c.confirmable);
+  }
+  portENTER_CRITICAL(&cfg_mux);
+  cfg = c;
+  portEXIT_CRITICAL(&cfg_mux);
+  {
+    CoapLock l;
+    coap.setConfirmable(c.confirmable);
+  }
+  coapStart();
+}
+
+CoapCfg coapConfig() {
+  portENTER_CRITICAL(&cfg_mux);
+  const CoapCfg c = cfg;
+  portEXIT_CRITICAL(&cfg_mux);
+  return c;
+}
+
+// -------------------- Net task --------------------
+void coapNotify(const ControlEvent &ev) {
+  if (!listening) return;
+  CoapLock l;
+  coap.notify(ev.type == EV_RELAY ? COAP_RES_RELAY : COAP_RES_INPUT);
+}
+
+void coapPoll() {
+  if (!listening) return;
+  CoapLock l;
+  coap.poll();
+}
+
+CoapStats coapStats() {
+  if (!lock) return {};
+  CoapLock l;
+  return coap.stats();
+}
@@ -0,0 +1,38 @@
+/**************************************************************
+ * CoAP endpoint (coap.h) on UDP 5683
+ *
+ *  - /relay and /input with GET, PUT/POST (relay) and Observe, so a
+ *    client switches the relay or learns its new state with one
+ *    datagram each way.
+ *  - Requests arrive in the AsyncUDP task and are submitted to the
+ *    control queue like any other source (SRC_COAP). Notifications are
+ *    sent from the net task when the control task reports a change.
+ *  - No authentication (CoAP has no Basic Auth; DTLS is out of scope),
+ *    so it is off by default and meant for a trusted LAN.
+ *
+ * Quick check: coap-client -m get coap://<node>/relay
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "coap.h"
+#include "control.h"
+
+struct CoapCfg {
+  bool enabled = false;
+  bool confirmable = false;   // CON notifications (else NON, every 8th CON)
+};
+
+// Applies the config; (re)binds when enabled and Wi-Fi is up.
+// Safe from any task.
+void coapConfigure(const CoapCfg &cfg);
+CoapCfg coapConfig();
+// Call when the station (re)connects.
+void coapStart();
+void coapStop();
+
+// Net task: notify observers of a relay/input change, drive retransmits.
+void coapNotify(const ControlEvent &ev);
+void coapPoll();
+
+CoapStats coapStats();
@@ -0,0 +1,129 @@
+#include "connguard.h"
+#include "log.h"
+#include "metrics.h"
+
+// An LRU victim must have been quiet at least this long.
+static const uint32_t HTTP_EVICT_MIN_IDLE_MS = 1000;
+
+void ConnGuard::configure(const ConnGuardCfg &cfg) {
+  _cfg = cfg;
+  if (_cfg.maxConnections == 0 || _cfg.maxConnections > HTTP_GUARD_SLOTS) _cfg.maxConnections = HTTP_GUARD_SLOTS;
+}
+
+void ConnGuard::addStreamingPrefix(const char* prefix) {
+  if (_streamingCount < sizeof(_streaming) / sizeof(_streaming[0])) _streaming[_streamingCount++] = prefix;
+}
+
+bool ConnGuard::isStreaming(const String &url) const {
+  for (uint8_t i = 0; i < _streamingCount; i++) {
+    if (url.startsWith(_streaming[i])) return true;
+  }
+  return false;
+}
+
+int ConnGuard::find(AsyncClient* c) const {
+  for (uint8_t i = 0; i < HTTP_GUARD_SLOTS; i++) {
+    if (_slots[i].client == c) return i;
+  }
+  return -1;
+}
+
+void ConnGuard::forget(AsyncClient* c) {
+  const int i = find(c);
+  if (i < 0) return;
+  _slots[i].client = nullptr;
+  _active--;
+}
+
+void ConnGuard::touch(AsyncClient* c) {
+  const int i = find(c);
+  if (i >= 0) _slots[i].lastMs = millis();
+}
+
+void ConnGuard::hold(AsyncClient* c) {
+  const int i = find(c);
+  if (i < 0) return;
+  _slots[i].held = true;
+  _slots[i].lastMs = millis();
+}
+
+// Closes the least-recently-active connection that is not held; returns
+// its slot or -1.
+int ConnGuard::evictLru(uint32_t now) {
+  int lru = -1;
+  for (uint8_t i = 0; i < HTTP_GUARD_SLOTS; i++) {
+    Slot &s = _slots[i];
+    if (!s.client || s.held) continue;
+    // Acked response data frees send buffer: the client is still reading.
+    const size_t space = s.client->space();
+    if (space != s.space) {
+      s.space = space;
+      s.lastMs = now;
+    }
+    if (lru < 0 || (int32_t)(s.lastMs - _slots[lru].lastMs) < 0) lru = i;
+  }
+  if (lru < 0 || now - _slots[lru].lastMs < HTTP_EVICT_MIN_IDLE_MS) return -1;
+
+  AsyncClient* victim = _slots[lru].client;
+  _slots[lru].client = nullptr;
+  _active--;
+  metricsInc(CNT_HTTP_EVICTED);
+  victim->close(true);
+  return lru;
+}
+
+bool ConnGuard::canHandle(AsyncWebServerRequest *r) {
+  _reject = REJECT_NONE;
+
+  if (ESP.getFreeHeap() < _cfg.minFreeHeap || ESP.getMaxAllocHeap() < _cfg.minMaxAlloc) {
+    _reject = REJECT_HEAP;
+    metricsInc(CNT_HTTP_REJECT_HEAP);
+    return true;
+  }
+
+  // Streams hand their socket to another owner (e.g. AsyncEventSource frees
+  // the request), so the disconnect hook below would never fire for them.
+  if (isStreaming(r->url())) return false;
+
+  AsyncClient* c = r->client();
+  const uint32_t now = millis();
+
+  int i = find(c);
+  if (i >= 0) {
+    _slots[i].lastMs = now;
+    return false;
+  }
+
+  if (_active >= _cfg.maxConnections && evictLru(now) < 0) {
+    _reject = REJECT_BUSY;
+    metricsInc(CNT_HTTP_REJECT_BUSY);
+    return true;
+  }
+
+  i = find(nullptr);
+  if (i < 0) {
+    _reject = REJECT_BUSY;
+    metricsInc(CNT_HTTP_REJECT_BUSY);
+    return true;
+  }
+  _slots[i].client = c;
+  _slots[i].lastMs = now;
+  _slots[i].space = c->space();
+  _slots[i].held = false;
+  _active++;
+
+  c->setRxTimeout(_cfg.idleTimeoutS);
+  r->onDisconnect([this, c](){ forget(c); });
+  return false;
+}
+
+void ConnGuard::handleRequest(AsyncWebServerRequest *r) {
+  const bool heap = (_reject == REJECT_HEAP);
+  LOGD("HTTP", "503 %s (%s)", r->url().c_str(), heap ? "low heap" : "too many connections");
+
+  AsyncWebServerResponse *resp = r->beginResponse(503, "application/json",
+      heap ? "{\"ok\":false,\"err\":\"low_memory\"}" : "{\"ok\":false,\"err\":\"busy\"}");
+  resp->addHeader("Retry-After", heap ? "2" : "1");
+  resp->addHeader("Connection", "close");
+  r->send(resp);
+}
@@ -0,0 +1,80 @@
+/**************************************************************
+ * HTTP connection guard
+ *
+ *  - First handler on the server: it sees every request before routing
+ *    and only "handles" the ones it rejects (503 + Retry-After).
+ *  - Tracks connections with a request in flight. Over the limit, the
+ *    least-recently-active one is closed if it has been idle long
+ *    enough; otherwise the new request is rejected.
+ *  - Activity is the request itself, every body chunk (touch()) and
+ *    response data being acknowledged (the socket's send buffer moved
+ *    since the last look). Uploads are held (hold()): they count
+ *    against the limit but are never evicted. Parked /api/status
+ *    long-polls are released (release()) and capped by their handler.
+ *  - Sockets get an RX idle timeout so stalled clients are reaped by
+ *    AsyncTCP. Streaming endpoints (addStreamingPrefix, i.e. SSE) are
+ *    neither tracked nor timed out; they are bounded by their own
+ *    handlers.
+ *  - Requests are rejected early when free heap or the largest free
+ *    block falls under the configured floor.
+ *  All callbacks run on the async_tcp task, so no locking is needed.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#ifndef HTTP_GUARD_SLOTS
+#define HTTP_GUARD_SLOTS 16   // hard upper bound for maxConnections
+#endif
+
+struct ConnGuardCfg {
+  uint8_t  maxConnections = 8;
+  uint16_t idleTimeoutS   = 10;
+  uint32_t minFreeHeap    = 24 * 1024;
+  uint32_t minMaxAlloc    = 8 * 1024;
+};
+
+class ConnGuard : public AsyncWebHandler {
+public:
+  void configure(const ConnGuardCfg &cfg);
+  const ConnGuardCfg &config() const { return _cfg; }
+
+  // URL prefixes that hold the connection open on purpose (not tracked).
+  void addStreamingPrefix(const char* prefix);
+
+  // Marks the connection active now (body chunks, streamed output).
+  void touch(AsyncClient* c);
+  // Exempts the connection from eviction until it closes.
+  void hold(AsyncClient* c);
+  // Stops tracking the connection (its handler bounds it instead).
+  void release(AsyncClient* c) { forget(c); }
+
+  bool canHandle(AsyncWebServerRequest *r) override;
+  void handleRequest(AsyncWebServerRequest *r) override;
+  bool isRequestHandlerTrivial() override { return true; }
+
+  uint8_t active() const { return _active; }
+
+private:
+  struct Slot {
+    AsyncClient* client;
+    uint32_t lastMs;
+    size_t   space;   // send buffer free at the last look (acks move it)
+    bool     held;
+  };
+
+  enum Reject : uint8_t { REJECT_NONE, REJECT_BUSY, REJECT_HEAP };
+
+  bool isStreaming(const String &url) const;
+  int  find(AsyncClient* c) const;
+  int  evictLru(uint32_t now);
+  void forget(AsyncClient* c);
+
+  ConnGuardCfg _cfg;
+  Slot _slots[HTTP_GUARD_SLOTS] = {};
+  uint8_t _active = 0;
+  const char* _streaming[4] = {};
+  uint8_t _streamingCount = 0;
+  Reject _reject = REJECT_NONE;
+};
@@ -0,0 +1,526 @@
+#include "control.h"
+#include "debounce.h"
+#include "log.h"
+#include "probe.h"
+#include "mpsc.h"
+#include "powerstate.h"
+#include "seqlock.h"
+#include "spsc.h"
+#include "taskcfg.h"
+#include "taskload.h"
+
+#include <atomic>
+
+// -------------------- Tuning --------------------
+static const uint32_t CONTROL_STACK   = 3072;
+static const uint32_t CONTROL_POLL_MS = 100;   // safety net for missed edges
+
+// -------------------- Queues -------------------
+enum ControlOp : uint8_t {
+  OP_SET,
+  OP_TOGGLE,
+  OP_BATCH,   // runs batch_ops
+  OP_RULES,   // switch to the staged rule program
+  OP_RULE_MSG,   // arg = MQTT payload hash
+  OP_DEBOUNCE,   // switch to debounce_cfg
+};
+
+struct ControlCmd {
+  uint8_t  op;
+  uint8_t  source;
+  bool     value;
+  uint32_t arg;
+};
+
+static MpscQueue<ControlCmd, 16>   commands;   // any task -> control
+static SpscQueue<ControlEvent, 32> events;     // control -> net
+
+static std::atomic<uint32_t> events_dropped{0};
+static std::atomic<uint32_t> cmds_dropped{0};
+
+// -------------------- Batch --------------------
+// One batch slot. The caller owns it while PENDING. The control task moves
+// it to RUNNING before the first op; from then on the batch runs to the
+// end and the caller waits for it. A caller that times out while still
+// PENDING marks it ABANDONED and the control task skips it entirely, so
+// a batch either runs completely or not at all.
+enum BatchState : uint8_t {
+  BATCH_IDLE,
+  BATCH_PENDING,
+  BATCH_RUNNING,
+  BATCH_DONE,
+  BATCH_ABANDONED,
+};
+
+static ControlBatchOp  batch_ops[CONTROL_BATCH_MAX];
+static ControlSnapshot batch_results[CONTROL_BATCH_MAX];
+static uint8_t batch_count = 0;
+static uint8_t batch_source = SRC_WEB;
+static std::atomic<uint8_t> batch_state{BATCH_IDLE};
+static SemaphoreHandle_t batch_done = nullptr;
+
+// -------------------- State -------------------
+// Owned by the control task; published through `snapshot`.
+static ControlSnapshot state = {0, 0, false, true, SRC_BOOT};
+static Seqlock<ControlSnapshot> snapshot;
+
+static TaskHandle_t control_task = nullptr;
+static std::atomic<TaskHandle_t> event_listener{nullptr};
+static std::atomic<void (*)(const ControlEvent &)> event_hook{nullptr};
+static TaskLoadMeter control_load("control", CORE_CONTROL);
+
+// Pending pulse revert, control task only
+static bool     pulse_armed = false;
+static bool     pulse_revert_to = false;
+static uint8_t  pulse_source = SRC_WEB;
+static uint32_t pulse_due_ms = 0;
+
+// -------------------- Rules --------------------
+// Double buffer: writers stage into the inactive program while
+// rules_pending is held; the control task flips rule_active.
+static RuleProgram rule_progs[2];
+static uint8_t rule_active = 0;
+static std::atomic<bool> rules_pending{false};
+static bool rules_staged = false;   // a program was given before controlBegin()
+static bool rules_booted = false;
+
+// Control task only
+static uint8_t  rule_src = SRC_RULE;   // source for actions of the running rule
+static uint32_t long_th[RULES_LONG_MAX];
+static uint8_t  long_n = 0;
+static uint8_t  long_fired = 0;        // bit i = long_th[i] fired this press
+static uint32_t press_ms = 0;
+static uint32_t timer_due[RULES_TIMERS];
+static uint8_t  timers_armed = 0;
+
+static std::atomic<uint32_t> rule_events{0};
+static std::atomic<uint32_t> rule_actions{0};
+static std::atomic<uint32_t> rule_last_us{0};
+static std::atomic<uint32_t> rule_max_us{0};
+
+// Debounced input (INPUT_PULLUP), control task only. debounce_cfg is
+// written by controlSetDebounce() and picked up on OP_DEBOUNCE.
+static Debouncer input_deb;
+static std::atomic<uint32_t> debounce_cfg{DEB_STABLE << 16 | INPUT_DEBOUNCE_MS};
+
+static DebounceCfg unpackDebounce(uint32_t v) {
+  DebounceCfg c;
+  c.algo = (uint8_t)(v >> 16);
+  c.ms = (uint16_t)v;
+  return c;
+}
+
+const char* relaySourceStr(uint8_t src) {
+  switch (src) {
+    case SRC_BOOT:  return "boot";
+    case SRC_WEB:   return "web";
+    case SRC_MQTT:  return "mqtt";
+    case SRC_INPUT: return "input";
+    case SRC_GROUP: return "group";
+    case SRC_PEER:  return "peer";
+    case SRC_RULE:  return "rule";
+    case SRC_COAP:  return "coap";
+    default: return "unknown";
+  }
+}
+
+// Control task only (and setup() before the task starts).
+static void postEvent(ControlEventType type, uint8_t source, bool value) {
+  const ControlEvent ev = { (uint8_t)type, source, value, millis() };
+  void (*hook)(const ControlEvent &) = event_hook.load(std::memory_order_acquire);
+  if (hook) hook(ev);
+  if (!events.push(ev)) {
+    events_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  TaskHandle_t l = event_listener.load(std::memory_order_acquire);
+  if (l) xTaskNotifyGive(l);
+}
+
+// -------------------- Relay --------------------
+static inline int relayLevel(bool on) {
+  return RELAY_ACTIVE_LOW ? (on ? LOW : HIGH) : (on ? HIGH : LOW);
+}
+
+static void probeRelayWritten(uint8_t src) {
+  if (src == SRC_INPUT) PROBE_END(PROBE_INPUT_TO_GPIO);
+  if (src == SRC_MQTT)  PROBE_END(PROBE_MQTT_TO_GPIO);
+  PROBE_MARK(PROBE_GPIO_TO_PUBLISH);
+}
+
+static void publishState() {
+  state.version++;
+  state.changedMs = millis();
+  snapshot.write(state);
+}
+
+static void fireRules(uint8_t trigger, uint32_t arg, uint8_t src);
+
+// Single writer: the control task (or setup() before it starts).
+// Any explicit change cancels a pending pulse revert.
+static void applyRelay(bool on, uint8_t src) {
+  const bool changed = (on != state.relay);
+  pulse_armed = false;
+  digitalWrite(RELAY_PIN, relayLevel(on));
+  state.relay = on;
+  state.lastSource = src;
+  publishState();
+  probeRelayWritten(src);
+  LOGD("RELAY", "%s (%s) -> GPIO=%d", on ? "ON" : "OFF", relaySourceStr(src), relayLevel(on));
+  postEvent(EV_RELAY, src, on);
+  powerStateRecord(on);   // after the GPIO and the event: a flash write takes ~50 us
+
+  // Rule-driven changes do not trigger relay rules again (bounded depth).
+  if (changed && src != SRC_RULE) fireRules(on ? TRIG_RELAY_ON : TRIG_RELAY_OFF, 0, SRC_RULE);
+}
+
+static bool submit(const ControlCmd &c) {
+  if (!commands.push(c)) {
+    cmds_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (control_task) xTaskNotifyGive(control_task);
+  return true;
+}
+
+bool controlSetRelay(bool on, RelaySource src) {
+  if (src == SRC_BOOT && !control_task) {
+    applyRelay(on, src);
+    return true;
+  }
+  return submit({ OP_SET, (uint8_t)src, on, 0 });
+}
+
+bool controlToggleRelay(RelaySource src) {
+  return submit({ OP_TOGGLE, (uint8_t)src, false, 0 });
+}
+
+bool controlLoadRules(const RuleProgram &p) {
+  if (!control_task) {   // before controlBegin(): the program the task starts with
+    rule_progs[rule_active] = p;
+    rules_staged = true;
+    return true;
+  }
+  bool expected = false;
+  if (!rules_pending.compare_exchange_strong(expected, true)) return false;
+  rule_progs[rule_active ^ 1] = p;   // rule_active cannot move while we hold rules_pending
+  if (!submit({ OP_RULES, SRC_RULE, false, 0 })) {
+    rules_pending.store(false);
+    return false;
+  }
+  return true;
+}
+
+bool controlRuleMessage(const char* payload, size_t len) {
+  return submit({ OP_RULE_MSG, SRC_RULE, false, rulesHash(payload, len) });
+}
+
+bool controlSetDebounce(const DebounceCfg &cfg) {
+  if (cfg.algo >= DEB__COUNT || cfg.ms > DEBOUNCE_MAX_MS) return false;
+  debounce_cfg.store((uint32_t)cfg.algo << 16 | cfg.ms);
+  if (!control_task) return true;   // controlBegin() picks it up
+  return submit({ OP_DEBOUNCE, SRC_INPUT, false, 0 });
+}
+
+DebounceCfg controlDebounce() {
+  return unpackDebounce(debounce_cfg.load());
+}
+
+ControlRuleStats controlRuleStats() {
+  return {
+    rule_events.load(std::memory_order_relaxed),
+    rule_actions.load(std::memory_order_relaxed),
+    rule_last_us.load(std::memory_order_relaxed),
+    rule_max_us.load(std::memory_order_relaxed),
+  };
+}
+
+ControlSnapshot controlSnapshot() {
+  return snapshot.read();
+}
+
+bool controlRelayState() {
+  return snapshot.read().relay;
+}
+
+bool controlInputOpen() {
+  return snapshot.read().inputOpen;
+}
+
+bool controlRunBatch(const ControlBatchOp* ops, uint8_t n, RelaySource src,
+                     ControlSnapshot* results, uint32_t timeoutMs) {
+  if (!n || n > CONTROL_BATCH_MAX || !batch_done) return false;
+
+  uint8_t expected = BATCH_IDLE;
+  if (!batch_state.compare_exchange_strong(expected, BATCH_PENDING)) return false;
+
+  memcpy(batch_ops, ops, n * sizeof(ControlBatchOp));
+  batch_count = n;
+  batch_source = src;
+  xSemaphoreTake(batch_done, 0);   // clear a stale give
+
+  if (!submit({ OP_BATCH, (uint8_t)src, false, 0 })) {
+    batch_state.store(BATCH_IDLE);
+    return false;
+  }
+
+  if (xSemaphoreTake(batch_done, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+    expected = BATCH_PENDING;
+    if (batch_state.compare_exchange_strong(expected, BATCH_ABANDONED)) return false;   // nothing ran
+    // Already running (at most CONTROL_BATCH_MAX relay writes) or done:
+    // the results are real, wait for them.
+    xSemaphoreTake(batch_done, portMAX_DELAY);
+  }
+
+  memcpy(results, batch_results, n * sizeof(ControlSnapshot));
+  batch_state.store(BATCH_IDLE);
+  return true;
+}
+
+static void armPulse(bool on, uint16_t ms, uint8_t src) {
+  const bool prev = state.relay;
+  applyRelay(on, src);
+  pulse_revert_to = prev;
+  pulse_source = src;
+  pulse_due_ms = millis() + ms;
+  pulse_armed = true;
+}
+
+// Returns ms until the pending pulse reverts (0 = none pending).
+static uint32_t pulseStep() {
+  if (!pulse_armed) return 0;
+  const int32_t left = (int32_t)(pulse_due_ms - millis());
+  if (left > 0) return (uint32_t)left;
+  applyRelay(pulse_revert_to, pulse_source);
+  return 0;
+}
+
+static void runBatch() {
+  uint8_t expected = BATCH_PENDING;
+  if (!batch_state.compare_exchange_strong(expected, BATCH_RUNNING)) {
+    batch_state.store(BATCH_IDLE);   // caller gave up before it started
+    return;
+  }
+
+  for (uint8_t i = 0; i < batch_count; i++) {
+    const ControlBatchOp &op = batch_ops[i];
+    switch (op.type) {
+      case BATCH_SET:    applyRelay(op.value, batch_source); break;
+      case BATCH_TOGGLE: applyRelay(!state.relay, batch_source); break;
+      case BATCH_PULSE:  armPulse(op.value, op.ms, batch_source); break;
+      default: break;
+    }
+    batch_results[i] = state;
+  }
+
+  batch_state.store(BATCH_DONE);
+  xSemaphoreGive(batch_done);
+}
+
+// -------------------- Rule VM host --------------------
+static bool hostRelay(void*) { return state.relay; }
+static bool hostInputClosed(void*) { return !state.inputOpen; }
+static void hostSetRelay(void*, bool on) { applyRelay(on, rule_src); }
+static void hostToggle(void*) { applyRelay(!state.relay, rule_src); }
+
+static void hostPulse(void*, uint32_t ms) {
+  armPulse(true, (uint16_t)ms, rule_src);
+}
+
+static void hostTimerStart(void*, uint8_t t, uint32_t ms) {
+  timer_due[t] = millis() + ms;
+  timers_armed |= (1 << t);
+}
+
+static void hostTimerCancel(void*, uint8_t t) {
+  timers_armed &= ~(1 << t);
+}
+
+static const RuleHost rule_host = {
+  nullptr, hostRelay, hostInputClosed, hostSetRelay, hostToggle, hostPulse, hostTimerStart, hostTimerCancel,
+};
+
+static void fireRules(uint8_t trigger, uint32_t arg, uint8_t src) {
+  const uint8_t outer = rule_src;   // relay rules nest inside input rules
+  rule_src = src;
+  const uint32_t t0 = micros();
+  const uint16_t n = rulesRun(rule_progs[rule_active], trigger, arg, rule_host);
+  const uint32_t us = micros() - t0;
+  rule_src = outer;
+
+  rule_events.fetch_add(1, std::memory_order_relaxed);
+  if (n) rule_actions.fetch_add(n, std::memory_order_relaxed);
+  rule_last_us.store(us, std::memory_order_relaxed);
+  if (us > rule_max_us.load(std::memory_order_relaxed)) rule_max_us.store(us, std::memory_order_relaxed);
+}
+
+static void installRules() {
+  rule_active ^= 1;
+  long_n = rulesLongThresholds(rule_progs[rule_active], long_th);
+  long_fired = 0;
+  timers_armed = 0;
+  rules_pending.store(false);
+  LOGI("RULES", "%u rule(s), %u bytes", rule_progs[rule_active].rules, rule_progs[rule_active].len);
+
+  if (!rules_booted) {
+    rules_booted = true;
+    fireRules(TRIG_BOOT, 0, SRC_RULE);
+  }
+}
+
+// Returns ms until the next timer or long-press threshold (0 = none).
+static uint32_t rulesStep() {
+  const uint32_t now = millis();
+  uint32_t wait = 0;
+  auto consider = [&wait](uint32_t left) { if (!wait || left < wait) wait = left; };
+
+  for (uint8_t t = 0; t < RULES_TIMERS; t++) {
+    if (!(timers_armed & (1 << t))) continue;
+    const int32_t left = (int32_t)(timer_due[t] - now);
+    if (left > 0) { consider((uint32_t)left); continue; }
+    timers_armed &= ~(1 << t);
+    fireRules(TRIG_TIMER, t, SRC_RULE);
+  }
+
+  if (input_deb.stable() == LOW) {   // held: long-press thresholds
+    const uint32_t held = now - press_ms;
+    for (uint8_t i = 0; i < long_n; i++) {
+      if (long_fired & (1 << i)) continue;
+      if (held < long_th[i]) { consider(long_th[i] - held); break; }
+      long_fired |= (1 << i);
+      fireRules(TRIG_LONG, long_th[i], SRC_INPUT);
+    }
+  }
+  return wait;
+}
+
+static void execute(const ControlCmd &c) {
+  if (c.op == OP_BATCH) {
+    runBatch();
+    return;
+  }
+  if (c.op == OP_RULES) {
+    installRules();
+    return;
+  }
+  if (c.op == OP_RULE_MSG) {
+    fireRules(TRIG_MQTT, c.arg, SRC_RULE);
+    return;
+  }
+  if (c.op == OP_DEBOUNCE) {
+    // Restart settled at the current output; debounceStep() reads the pin next.
+    input_deb.begin(unpackDebounce(debounce_cfg.load()), input_deb.stable(), millis());
+    return;
+  }
+  const bool on = (c.op == OP_TOGGLE) ? !state.relay : c.value;
+  applyRelay(on, c.source);
+}
+
+static void drainCommands() {
+  ControlCmd c;
+  while (commands.pop(c)) execute(c);
+}
+
+// -------------------- Input --------------------
+static void IRAM_ATTR onInputEdge() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(control_task, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// Returns ms until the pending debounce window closes (0 = nothing pending).
+static uint32_t debounceStep() {
+  const int level = digitalRead(INPUT_PIN);
+  const uint32_t now = millis();
+
+  if (level != input_deb.raw()) {
+    if (level != input_deb.stable()) PROBE_MARK_FIRST(PROBE_INPUT_TO_GPIO);
+    else                             PROBE_CANCEL(PROBE_INPUT_TO_GPIO);   // bounced back
+  }
+
+  if (!input_deb.update(level, now)) return input_deb.wait();
+
+  const bool isOpen = (input_deb.stable() == HIGH);
+  state.inputOpen = isOpen;
+  publishState();
+
+  // Press/release go through the rules; the default rule toggles on
+  // press (close, LOW) only, so a release never double-toggles.
+  if (!isOpen) {
+    press_ms = now;
+    long_fired = 0;
+    fireRules(TRIG_PRESS, 0, SRC_INPUT);
+  } else {
+    fireRules(TRIG_RELEASE, 0, SRC_INPUT);
+    if (!long_fired) fireRules(TRIG_SHORT, 0, SRC_INPUT);
+  }
+  PROBE_CANCEL(PROBE_INPUT_TO_GPIO);   // no-op if a rule already wrote the relay
+
+  postEvent(EV_INPUT, SRC_INPUT, isOpen);
+  LOGD("DIN", "stable change -> %s", isOpen ? "OPEN(HIGH)" : "CLOSED(LOW)");
+  return input_deb.wait();   // lockout still running
+}
+
+static void controlTask(void*) {
+  uint32_t waitMs = CONTROL_POLL_MS;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    control_load.enter();
+    drainCommands();
+    const uint32_t pending = debounceStep();
+    const uint32_t pulse = pulseStep();
+    const uint32_t rules = rulesStep();
+    control_load.leave();
+    waitMs = CONTROL_POLL_MS;
+    if (pending && pending < waitMs) waitMs = pending;
+    if (pulse && pulse < waitMs) waitMs = pulse;
+    if (rules && rules < waitMs) waitMs = rules;
+    if (!pending && !pulse) powerStateIdle();   // a sector erase takes tens of ms
+  }
+}
+
+void controlBegin(bool relayOn) {
+  // Latch the level before enabling the output so a restored "on" does
+  // not glitch off first.
+  digitalWrite(RELAY_PIN, relayLevel(relayOn));
+  pinMode(RELAY_PIN, OUTPUT);
+  pinMode(INPUT_PIN, INPUT_PULLUP);
+
+  input_deb.begin(unpackDebounce(debounce_cfg.load()), digitalRead(INPUT_PIN), millis());
+  state.inputOpen = (input_deb.stable() == HIGH);
+
+  controlSetRelay(relayOn, SRC_BOOT);
+  batch_done = xSemaphoreCreateBinary();
+
+  // Presses work from the first tick; "boot" rules wait for the first
+  // controlLoadRules() after this, once the configuration is loaded.
+  if (!rules_staged) {
+    RuleError err;
+    rulesCompile(RULES_DEFAULT, rule_progs[rule_active], err);
+  }
+  long_n = rulesLongThresholds(rule_progs[rule_active], long_th);
+
+  taskLoadRegister(&control_load);
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_STACK, nullptr, PRIO_CONTROL, &control_task, CORE_CONTROL);
+  attachInterrupt(digitalPinToInterrupt(INPUT_PIN), onInputEdge, CHANGE);
+}
+
+bool controlPollEvent(ControlEvent &ev) {
+  return events.pop(ev);
+}
+
+void controlSetEventListener(TaskHandle_t task) {
+  event_listener.store(task, std::memory_order_release);
+}
+
+void controlSetEventHook(void (*fn)(const ControlEvent &ev)) {
+  event_hook.store(fn, std::memory_order_release);
+}
+
+uint32_t controlEventsDropped() {
+  return events_dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t controlCommandsDropped() {
+  return cmds_dropped.load(std::memory_order_relaxed);
+}
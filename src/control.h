@@ -0,0 +1,147 @@
+/**************************************************************
+ * Local control fast path (relay GPIO + debounced input)
+ *
+ *  - An input-pin interrupt wakes a high-priority control task that
+ *    debounces the contact (debounce.h) and toggles the relay. It
+ *    touches only GPIO, so the wall switch responds the same whether
+ *    or not Wi-Fi/MQTT are healthy.
+ *  - The control task is pinned to its own core (taskcfg.h) and is the
+ *    single owner of relay state. Every source (web, MQTT, input, ...)
+ *    submits commands through one lock-free MPSC queue (mpsc.h).
+ *  - State is published as a versioned snapshot (seqlock.h); readers
+ *    such as /api/status take consistent copies without locks.
+ *  - Batches (controlRunBatch) execute back-to-back inside the control
+ *    task, so no other command source can interleave with them.
+ *  - Every relay/input change is posted as a ControlEvent on an SPSC
+ *    queue; the net task drains them and publishes asynchronously.
+ *    Posting never blocks: a full queue drops and counts the event.
+ *  - Local rules (rules.h) run in the control task: input presses,
+ *    long presses, relay changes, timers and MQTT messages trigger
+ *    bytecode evaluated without allocation. The classic "press toggles
+ *    the relay" is the default rule.
+ *  - Relay changes are journaled to flash (powerstate.h) so the
+ *    power-on policy can restore the last state.
+ *  - An optional event hook sees each event first, in the control task
+ *    (peer bindings use it to react without waiting for the net task).
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "debounce.h"
+#include "rules.h"
+
+// -------------------- GPIO --------------------
+#define RELAY_PIN 16
+#define INPUT_PIN 25
+#define RELAY_ACTIVE_LOW 0   // 0 = ACTIVE HIGH, 1 = ACTIVE LOW
+
+// -------------------- Debounce ----------------
+// Default; the algorithm and window are runtime config (debounce.h).
+static const uint16_t INPUT_DEBOUNCE_MS = 50;
+
+enum RelaySource : uint8_t {
+  SRC_BOOT,
+  SRC_WEB,
+  SRC_MQTT,
+  SRC_INPUT,
+  SRC_GROUP,   // multicast group command (groupcmd.h)
+  SRC_PEER,    // peer binding (peerbind.h)
+  SRC_RULE,    // rule triggered by a relay change, timer, MQTT or boot
+  SRC_COAP,    // CoAP PUT/POST (coapserver.h)
+};
+
+enum ControlEventType : uint8_t {
+  EV_RELAY,   // value = relay on
+  EV_INPUT,   // value = input open (HIGH)
+};
+
+struct ControlSnapshot {
+  uint32_t version;      // bumps on every relay/input change
+  uint32_t changedMs;    // millis() of the last change
+  bool     relay;
+  bool     inputOpen;
+  uint8_t  lastSource;   // RelaySource of the last relay change
+};
+
+enum ControlBatchOpType : uint8_t {
+  BATCH_SET,      // value = relay on
+  BATCH_TOGGLE,
+  BATCH_PULSE,    // relay = value for ms, then back to the previous state
+  BATCH_STATUS,   // no-op; result is the state at this point
+};
+
+struct ControlBatchOp {
+  uint8_t  type;
+  bool     value;
+  uint16_t ms;
+};
+
+#ifndef CONTROL_BATCH_MAX
+#define CONTROL_BATCH_MAX 16
+#endif
+
+static const uint16_t CONTROL_PULSE_MIN_MS = 10;
+static const uint16_t CONTROL_PULSE_MAX_MS = 60000;
+
+struct ControlEvent {
+  uint8_t  type;
+  uint8_t  source;   // RelaySource for EV_RELAY
+  bool     value;
+  uint32_t ms;
+};
+
+// Configures GPIO, drives the relay to `relayOn` (power-on policy,
+// powerstate.h) and starts the control task + ISR, already running the
+// initial rule program.
+void controlBegin(bool relayOn);
+
+// Queues a command for the control task (safe from any task).
+// Returns false if the queue is full.
+bool controlSetRelay(bool on, RelaySource src);
+bool controlToggleRelay(RelaySource src);
+
+// Runs `n` ops atomically in the control task and waits for them.
+// results[i] is the state right after op i. One batch at a time; returns
+// false if another batch is running, the queue is full or it timed out
+// before starting. False means no op ran; true means all of them did.
+bool controlRunBatch(const ControlBatchOp* ops, uint8_t n, RelaySource src,
+                     ControlSnapshot* results, uint32_t timeoutMs);
+
+// Installs a rule program (copied); the control task switches to it
+// between events. The first program installed also fires "boot" rules.
+// False while a previous install is still pending. Before controlBegin()
+// it sets the program the task starts with (RULES_DEFAULT otherwise),
+// without firing "boot" rules.
+bool controlLoadRules(const RuleProgram &p);
+// Feeds an MQTT payload to "on mqtt" rules.
+bool controlRuleMessage(const char* payload, size_t len);
+
+struct ControlRuleStats {
+  uint32_t events;    // rule evaluations
+  uint32_t actions;
+  uint32_t lastUs;    // duration of the last evaluation
+  uint32_t maxUs;
+};
+
+ControlRuleStats controlRuleStats();
+
+// Switches the input debouncer (safe from any task; before controlBegin()
+// it sets the initial config). False if `cfg` is out of range or the
+// queue is full.
+bool controlSetDebounce(const DebounceCfg &cfg);
+DebounceCfg controlDebounce();
+
+ControlSnapshot controlSnapshot();
+bool controlRelayState();
+bool controlInputOpen();
+
+// Network side: pops the next pending event (non-blocking). Single consumer.
+bool controlPollEvent(ControlEvent &ev);
+// Task notified (xTaskNotifyGive) whenever an event is posted.
+void controlSetEventListener(TaskHandle_t task);
+// Called from the control task for every event; must not block.
+void controlSetEventHook(void (*fn)(const ControlEvent &ev));
+uint32_t controlEventsDropped();
+uint32_t controlCommandsDropped();
+
+const char* relaySourceStr(uint8_t src);
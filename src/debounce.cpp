@@ -0,0 +1,107 @@
+#include "debounce.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char* const ALGO_NAMES[DEB__COUNT] = { "stable", "lockout", "integrate" };
+
+const char* debounceAlgoName(uint8_t algo) {
+  return algo < DEB__COUNT ? ALGO_NAMES[algo] : "unknown";
+}
+
+uint8_t debounceParseAlgo(const char* s) {
+  for (uint8_t i = 0; i < DEB__COUNT; i++) {
+    if (!strcmp(s, ALGO_NAMES[i])) return i;
+  }
+  return DEB__COUNT;
+}
+
+bool debounceParse(const char* s, DebounceCfg &out) {
+  const char* slash = strchr(s, '/');
+  if (!slash || slash == s || (size_t)(slash - s) >= 16 || !slash[1]) return false;
+  char name[16];
+  memcpy(name, s, slash - s);
+  name[slash - s] = 0;
+  char* end;
+  const unsigned long ms = strtoul(slash + 1, &end, 10);
+  const uint8_t algo = debounceParseAlgo(name);
+  if (*end || algo >= DEB__COUNT || ms > DEBOUNCE_MAX_MS) return false;
+  out.algo = algo;
+  out.ms = (uint16_t)ms;
+  return true;
+}
+
+void Debouncer::begin(const DebounceCfg &cfg, int level, uint32_t nowMs) {
+  _cfg = cfg;
+  if (_cfg.algo >= DEB__COUNT) _cfg.algo = DEB_STABLE;
+  if (_cfg.ms > DEBOUNCE_MAX_MS) _cfg.ms = DEBOUNCE_MAX_MS;
+  _raw = _stable = level ? 1 : 0;
+  _changeMs = _lastMs = nowMs;
+  _acc = _stable ? _cfg.ms : 0;
+  _locked = false;
+  _wait = 0;
+}
+
+bool Debouncer::update(int level, uint32_t nowMs) {
+  level = level ? 1 : 0;
+
+  if (_cfg.algo == DEB_INTEGRATE) {
+    // The pin held _raw since the last update (every edge is an update).
+    const uint32_t dt = nowMs - _lastMs;
+    _lastMs = nowMs;
+    if (_raw) _acc = (dt >= _cfg.ms - _acc) ? _cfg.ms : _acc + dt;
+    else      _acc = (dt >= _acc) ? 0 : _acc - dt;
+    _raw = level;
+    return settle(nowMs);
+  }
+
+  if (level != _raw) {
+    _raw = level;
+    if (_cfg.algo == DEB_STABLE) _changeMs = nowMs;
+  }
+  return settle(nowMs);
+}
+
+bool Debouncer::settle(uint32_t nowMs) {
+  _wait = 0;
+  switch (_cfg.algo) {
+    case DEB_LOCKOUT: {
+      if (_locked) {
+        const uint32_t held = nowMs - _changeMs;
+        if (held < _cfg.ms) {
+          _wait = _cfg.ms - held;
+          return false;
+        }
+        _locked = false;
+      }
+      if (_raw == _stable) return false;
+      _stable = _raw;
+      _changeMs = nowMs;
+      _locked = (_cfg.ms > 0);
+      _wait = _cfg.ms;
+      return true;
+    }
+
+    case DEB_INTEGRATE: {
+      int next = _stable;
+      if (!_cfg.ms)                next = _raw;
+      else if (_acc >= _cfg.ms)    next = 1;
+      else if (_acc == 0)          next = 0;
+      const bool changed = (next != _stable);
+      _stable = next;
+      if (_raw != _stable) _wait = _raw ? _cfg.ms - _acc : _acc;
+      return changed;
+    }
+
+    default: {   // DEB_STABLE
+      if (_raw == _stable) return false;
+      const uint32_t held = nowMs - _changeMs;
+      if (held <= _cfg.ms) {
+        _wait = _cfg.ms - held + 1;
+        return false;
+      }
+      _stable = _raw;
+      return true;
+    }
+  }
+}
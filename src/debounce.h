@@ -0,0 +1,69 @@
+/**************************************************************
+ * Input debouncer (portable; control task, simulator, replay bench)
+ *
+ *  Algorithms, all driven by update(level, nowMs) on every raw edge and
+ *  again after wait() ms while a decision is pending:
+ *    stable     Accept a level once it has been held for more than `ms`
+ *               (the original control.cpp behaviour). Adds `ms` of
+ *               latency; any bounce restarts the window.
+ *    lockout    Accept the first edge at once, then ignore the pin for
+ *               `ms`; the level at the end of the lockout is taken if it
+ *               differs. No added latency, but a single noise spike is
+ *               a full press.
+ *    integrate  Counter that runs up while the pin is HIGH and down
+ *               while LOW (in ms, clamped to [0, ms]); the output flips
+ *               at the rails. A bounce only costs the time it spent on
+ *               the wrong side instead of restarting the window.
+ *
+ *  Times are uint32 ms (millis()) and may wrap. Levels are 0 = LOW
+ *  (closed, INPUT_PULLUP) and 1 = HIGH (open).
+ **************************************************************/
+#pragma once
+
+#include <stdint.h>
+
+enum DebounceAlgo : uint8_t {
+  DEB_STABLE,
+  DEB_LOCKOUT,
+  DEB_INTEGRATE,
+  DEB__COUNT
+};
+
+static const uint16_t DEBOUNCE_MAX_MS = 1000;
+
+struct DebounceCfg {
+  uint8_t  algo = DEB_STABLE;
+  uint16_t ms   = 50;   // window, lockout or integrator depth; 0..DEBOUNCE_MAX_MS
+};
+
+const char* debounceAlgoName(uint8_t algo);
+// Returns DEB__COUNT if `s` is not an algorithm name.
+uint8_t debounceParseAlgo(const char* s);
+// "<algo>/<ms>", e.g. "integrate/20". False if malformed or out of range.
+bool debounceParse(const char* s, DebounceCfg &out);
+
+class Debouncer {
+public:
+  // Starts settled at `level` (no pending decision).
+  void begin(const DebounceCfg &cfg, int level, uint32_t nowMs);
+  // Feeds the raw pin level. Returns true if the debounced level changed.
+  bool update(int level, uint32_t nowMs);
+  // ms until update() must run again without an edge (0 = nothing pending).
+  uint32_t wait() const { return _wait; }
+
+  int stable() const { return _stable; }
+  int raw() const { return _raw; }
+  const DebounceCfg &cfg() const { return _cfg; }
+
+private:
+  bool settle(uint32_t nowMs);
+
+  DebounceCfg _cfg;
+  int      _raw = 1;
+  int      _stable = 1;
+  uint32_t _changeMs = 0;   // stable: last raw edge; lockout: lockout start
+  uint32_t _lastMs = 0;     // integrate: last update
+  uint32_t _acc = 0;        // integrate: ms towards HIGH
+  bool     _locked = false;
+  uint32_t _wait = 0;
+};
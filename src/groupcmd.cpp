@@ -0,0 +1,276 @@
+#include "groupcmd.h"
+#include "control.h"
+#include "log.h"
+#include "mpsc.h"
+
+#include <AsyncUDP.h>
+#include <WiFi.h>
+#include <atomic>
+#include "esp_system.h"
+
+// -------------------- State --------------------
+// `cfg` is written by HTTP handlers and read by the AsyncUDP and net
+// tasks; copies are taken under cfg_mux. group_udp and group_ip belong
+// to the net task. The replay window is touched only by the AsyncUDP
+// task.
+static GroupCfg cfg;
+static portMUX_TYPE cfg_mux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<bool> cfg_dirty{false};
+
+static AsyncUDP group_udp;
+static std::atomic<bool> listening{false};
+static IPAddress group_ip;
+static GroupReplayWindow replay;
+
+struct SendReq {
+  uint16_t group;
+  uint8_t  cmd;
+  uint8_t  arg;
+};
+static MpscQueue<SendReq, 8> send_q;
+
+// Net task writes, the AsyncUDP task reads them to answer challenges.
+static std::atomic<uint32_t> own_sender{0};
+static uint32_t own_seq = 0;
+static std::atomic<uint32_t> own_last_seq{0};
+static std::atomic<uint32_t> own_last_ms{0};
+
+static std::atomic<uint32_t> st_rx{0};
+static std::atomic<uint32_t> st_applied{0};
+static std::atomic<uint32_t> st_ignored{0};
+static std::atomic<uint32_t> st_bad{0};
+static std::atomic<uint32_t> st_dup{0};
+static std::atomic<uint32_t> st_stale{0};
+static std::atomic<uint32_t> st_challenged{0};
+static std::atomic<uint32_t> st_sent{0};
+
+static inline void bump(std::atomic<uint32_t> &c) {
+  c.fetch_add(1, std::memory_order_relaxed);
+}
+
+static bool isMember(const GroupCfg &c, uint16_t group) {
+  if (group == 0) return true;
+  for (uint16_t g : c.groups) {
+    if (g == group) return true;
+  }
+  return false;
+}
+
+// Returns false if the command maps to nothing on this node.
+static bool apply(const GroupCfg &c, const GroupMsg &m) {
+  uint8_t cmd = m.cmd;
+  if (cmd == GROUP_SCENE) {
+    switch (c.scenes[m.arg]) {
+      case '1': cmd = GROUP_ON; break;
+      case '0': cmd = GROUP_OFF; break;
+      case 't': cmd = GROUP_TOGGLE; break;
+      default: return false;
+    }
+  }
+  if (cmd == GROUP_TOGGLE) return controlToggleRelay(SRC_GROUP);
+  return controlSetRelay(cmd == GROUP_ON, SRC_GROUP);
+}
+
+// -------------------- Receive (AsyncUDP task) --------------------
+static void run(const GroupCfg &c, const GroupMsg &m) {
+  if (!isMember(c, m.group) || !apply(c, m)) {
+    bump(st_ignored);
+    return;
+  }
+  bump(st_applied);
+  LOGD("GROUP", "%s(%u) group=%u from %08lx seq=%lu", groupCmdStr(m.cmd), m.arg, m.group,
+       (unsigned long)m.sender, (unsigned long)m.seq);
+}
+
+static void onCommand(AsyncUDPPacket &pkt, const GroupCfg &c, const uint8_t* key, size_t keyLen) {
+  GroupMsg m;
+  if (!groupMsgDecode(pkt.data(), pkt.length(), key, keyLen, m)) {
+    bump(st_bad);
+    return;
+  }
+  const uint32_t self = own_sender.load();
+  if (m.sender == self) return;   // our own datagram looped back; applied when sent
+
+  switch (replay.check(m.sender, m.seq, millis())) {
+    case GROUP_DUPLICATE: bump(st_dup); return;
+    case GROUP_STALE:     bump(st_stale); return;
+    case GROUP_UNKNOWN: {
+      // Held until the sender proves it sent this just now.
+      const GroupChallenge ch = { self, m.sender, replay.challenge(m, esp_random(), millis()) };
+      uint8_t buf[GROUP_MSG_LEN];
+      groupChallengeEncode(ch, key, keyLen, buf);
+      pkt.write(buf, sizeof(buf));
+      bump(st_challenged);
+      return;
+    }
+    default: break;
+  }
+  run(c, m);
+}
+
+// Vouches for our latest command if it is recent; silence otherwise.
+static void onChallenge(AsyncUDPPacket &pkt, const uint8_t* key, size_t keyLen) {
+  GroupChallenge ch;
+  if (!groupChallengeDecode(pkt.data(), pkt.length(), key, keyLen, ch)) {
+    bump(st_bad);
+    return;
+  }
+  GroupResponse r;
+  if (!groupVouch(ch, own_sender.load(), own_last_seq.load(), own_last_ms.load(), millis(), r)) return;
+
+  uint8_t buf[GROUP_MSG_LEN];
+  groupResponseEncode(r, key, keyLen, buf);
+  pkt.write(buf, sizeof(buf));
+}
+
+static void onResponse(AsyncUDPPacket &pkt, const GroupCfg &c, const uint8_t* key, size_t keyLen) {
+  GroupResponse r;
+  if (!groupResponseDecode(pkt.data(), pkt.length(), key, keyLen, r)) {
+    bump(st_bad);
+    return;
+  }
+  GroupMsg m;
+  if (replay.answer(r, millis(), m)) run(c, m);
+}
+
+static void onPacket(AsyncUDPPacket &pkt) {
+  bump(st_rx);
+
+  GroupCfg c;
+  portENTER_CRITICAL(&cfg_mux);
+  c = cfg;
+  portEXIT_CRITICAL(&cfg_mux);
+  const uint8_t* key = (const uint8_t*)c.key;
+  const size_t keyLen = strlen(c.key);
+
+  switch (groupFrameKind(pkt.data(), pkt.length())) {
+    case GROUP_FRAME_CMD:       onCommand(pkt, c, key, keyLen); break;
+    case GROUP_FRAME_CHALLENGE: onChallenge(pkt, key, keyLen); break;
+    case GROUP_FRAME_RESPONSE:  onResponse(pkt, c, key, keyLen); break;
+    default: bump(st_bad); break;
+  }
+}
+
+// -------------------- Lifecycle (net task) --------------------
+void groupStop() {
+  if (!listening.load()) return;
+  listening.store(false);
+  group_udp.close();
+}
+
+void groupStart() {
+  cfg_dirty.store(false);   // this start uses the latest config
+  GroupCfg c = groupConfig();
+  groupStop();
+  if (!c.enabled || !WiFi.isConnected()) return;
+  if (!c.key[0]) {
+    LOGW("GROUP", "enabled without a key, not listening");
+    return;
+  }
+  if (!group_ip.fromString(c.addr) || group_ip[0] < 224 || group_ip[0] > 239) {
+    LOGW("GROUP", "bad multicast address %s", c.addr);
+    return;
+  }
+
+  uint32_t self = own_sender.load();
+  while (!self) self = esp_random();
+  own_sender.store(self);
+
+  if (!group_udp.listenMulticast(group_ip, c.port)) {
+    LOGE("GROUP", "join %s:%u failed", c.addr, c.port);
+    return;
+  }
+  group_udp.onPacket(onPacket);
+  listening.store(true);
+  LOGI("GROUP", "listening on %s:%u, groups %s", c.addr, c.port, groupListStr(c.groups).c_str());
+}
+
+void groupConfigure(const GroupCfg &c) {
+  portENTER_CRITICAL(&cfg_mux);
+  cfg = c;
+  portEXIT_CRITICAL(&cfg_mux);
+  cfg_dirty.store(true);
+}
+
+GroupCfg groupConfig() {
+  portENTER_CRITICAL(&cfg_mux);
+  const GroupCfg c = cfg;
+  portEXIT_CRITICAL(&cfg_mux);
+  return c;
+}
+
+bool groupReady() {
+  return listening.load();
+}
+
+// -------------------- Send --------------------
+bool groupSend(uint16_t group, uint8_t cmd, uint8_t arg) {
+  return listening.load() && send_q.push({ group, cmd, arg });
+}
+
+static void sendNow(const SendReq &req) {
+  const GroupCfg c = groupConfig();
+  const GroupMsg m = { own_sender.load(), ++own_seq, req.group, req.cmd, req.arg };
+  uint8_t buf[GROUP_MSG_LEN];
+  groupMsgEncode(m, (const uint8_t*)c.key, strlen(c.key), buf);
+  own_last_ms.store(millis());
+  own_last_seq.store(m.seq);
+
+  // Local first: the datagram may or may not loop back to us.
+  if (isMember(c, req.group)) apply(c, m);
+
+  bool ok = false;
+  for (uint8_t i = 0; i < c.repeat; i++) {
+    ok |= group_udp.writeTo(buf, sizeof(buf), group_ip, c.port) == sizeof(buf);
+  }
+  if (ok) bump(st_sent);
+}
+
+void groupPoll() {
+  if (cfg_dirty.load()) groupStart();
+  SendReq req;
+  while (send_q.pop(req)) {
+    if (listening.load()) sendNow(req);
+  }
+}
+
+// -------------------- Helpers --------------------
+bool groupParseList(const char* s, uint16_t out[GROUP_MEMBERSHIPS]) {
+  uint16_t tmp[GROUP_MEMBERSHIPS] = {};
+  uint8_t n = 0;
+  while (s && *s) {
+    while (*s == ' ' || *s == ',') s++;
+    if (!*s) break;
+    char* end = nullptr;
+    const long v = strtol(s, &end, 10);
+    if (end == s || v < 1 || v > 65535 || n == GROUP_MEMBERSHIPS) return false;
+    tmp[n++] = (uint16_t)v;
+    s = end;
+    if (*s && *s != ',' && *s != ' ') return false;
+  }
+  memcpy(out, tmp, sizeof(tmp));
+  return true;
+}
+
+String groupListStr(const uint16_t groups[GROUP_MEMBERSHIPS]) {
+  String s;
+  for (uint8_t i = 0; i < GROUP_MEMBERSHIPS; i++) {
+    if (!groups[i]) continue;
+    if (s.length()) s += ',';
+    s += groups[i];
+  }
+  return s;
+}
+
+GroupStats groupStats() {
+  return {
+    st_rx.load(std::memory_order_relaxed),
+    st_applied.load(std::memory_order_relaxed),
+    st_ignored.load(std::memory_order_relaxed),
+    st_bad.load(std::memory_order_relaxed),
+    st_dup.load(std::memory_order_relaxed),
+    st_stale.load(std::memory_order_relaxed),
+    st_challenged.load(std::memory_order_relaxed),
+    st_sent.load(std::memory_order_relaxed),
+  };
+}
@@ -0,0 +1,72 @@
+/**************************************************************
+ * Multicast group commands (fleet-wide switching in one datagram)
+ *
+ *  - Nodes join one multicast address and belong to up to
+ *    GROUP_MEMBERSHIPS group numbers (group 0 = everyone listening).
+ *  - Commands (groupmsg.h) are HMAC-signed with a shared key and carry
+ *    a per-sender sequence number; copies and replays are dropped. A
+ *    sender this node does not know yet is challenged first (one
+ *    unicast round trip), so a captured datagram cannot be replayed
+ *    after a reboot or once its sender fell out of the table.
+ *  - Handled in the AsyncUDP receive callback and submitted straight
+ *    to the control queue, so every member switches when the frame
+ *    arrives (Wi-Fi delivers one multicast frame to all stations).
+ *  - The socket is owned by the net task: start/stop, config changes
+ *    and outgoing commands all run in groupPoll().
+ *  - Scenes map a scene number to on / off / toggle / ignore per node.
+ *
+ * Quick check: python3 tools/groupcmd.py --key <key> on --group 1
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "groupmsg.h"
+
+#ifndef GROUP_MEMBERSHIPS
+#define GROUP_MEMBERSHIPS 4
+#endif
+
+static const uint8_t GROUP_REPEAT_MAX = 5;
+
+struct GroupCfg {
+  bool     enabled = false;
+  char     addr[16] = "239.255.83.78";
+  uint16_t port = 4210;
+  uint16_t groups[GROUP_MEMBERSHIPS] = {};   // 0 = unused slot
+  char     scenes[GROUP_SCENES + 1] = "--------";   // per scene: '1' on, '0' off, 't' toggle, '-' ignore
+  char     key[65] = "";
+  uint8_t  repeat = 3;                      // copies per sent command
+};
+
+struct GroupStats {
+  uint32_t received;
+  uint32_t applied;
+  uint32_t ignored;      // not a member / scene not mapped
+  uint32_t badMac;       // bad length, magic, command or signature
+  uint32_t duplicate;
+  uint32_t stale;
+  uint32_t challenged;   // unknown senders asked to vouch
+  uint32_t sent;
+};
+
+// Stores the config; the net task (re)joins the group with it on its
+// next groupPoll(). Safe from any task.
+void groupConfigure(const GroupCfg &cfg);
+GroupCfg groupConfig();
+// Net task only: call when the station (re)connects, and every loop.
+void groupStart();
+void groupStop();
+void groupPoll();
+
+// True while listening (enabled, keyed, joined).
+bool groupReady();
+// Queues a command; the net task signs and multicasts it (repeat
+// copies) and applies it locally if this node is a member. False if
+// not listening or the queue is full. Safe from any task.
+bool groupSend(uint16_t group, uint8_t cmd, uint8_t arg);
+
+// "1,5,12" <-> groups[]; false on a malformed list.
+bool groupParseList(const char* s, uint16_t out[GROUP_MEMBERSHIPS]);
+String groupListStr(const uint16_t groups[GROUP_MEMBERSHIPS]);
+
+GroupStats groupStats();
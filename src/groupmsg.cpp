@@ -0,0 +1,183 @@
+#include "groupmsg.h"
+
+#include <string.h>
+#include "hmac.h"
+
+static const size_t BODY_LEN = GROUP_MSG_LEN - GROUP_MAC_LEN;
+
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = v >> 8; p[1] = (uint8_t)v; }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, v >> 16); put16(p + 2, (uint16_t)v); }
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+static inline uint32_t get32(const uint8_t* p) { return ((uint32_t)get16(p) << 16) | get16(p + 2); }
+
+// Signs bytes 0..15 of `out` into 16..31.
+static void seal(const uint8_t* key, size_t keyLen, uint8_t* out) {
+  uint8_t full[HMAC_SHA256_LEN];
+  if (hmacSha256(key, keyLen, out, BODY_LEN, full)) memcpy(out + BODY_LEN, full, GROUP_MAC_LEN);
+  else memset(out + BODY_LEN, 0, GROUP_MAC_LEN);
+}
+
+static bool verify(const uint8_t* in, size_t len, const char* magic, const uint8_t* key, size_t keyLen) {
+  if (len != GROUP_MSG_LEN || memcmp(in, magic, 4) != 0) return false;
+  uint8_t want[HMAC_SHA256_LEN];
+  return hmacSha256(key, keyLen, in, BODY_LEN, want) && hmacEqual(want, in + BODY_LEN, GROUP_MAC_LEN);
+}
+
+const char* groupCmdStr(uint8_t cmd) {
+  switch (cmd) {
+    case GROUP_OFF:    return "off";
+    case GROUP_ON:     return "on";
+    case GROUP_TOGGLE: return "toggle";
+    case GROUP_SCENE:  return "scene";
+    default: return "unknown";
+  }
+}
+
+bool groupParseCmd(const char* s, uint8_t &cmd) {
+  for (uint8_t c = GROUP_OFF; c <= GROUP_SCENE; c++) {
+    if (s && !strcmp(s, groupCmdStr(c))) { cmd = c; return true; }
+  }
+  return false;
+}
+
+GroupFrame groupFrameKind(const uint8_t* in, size_t len) {
+  if (len != GROUP_MSG_LEN) return GROUP_FRAME_BAD;
+  if (!memcmp(in, "SNG1", 4)) return GROUP_FRAME_CMD;
+  if (!memcmp(in, "SNC1", 4)) return GROUP_FRAME_CHALLENGE;
+  if (!memcmp(in, "SNR1", 4)) return GROUP_FRAME_RESPONSE;
+  return GROUP_FRAME_BAD;
+}
+
+void groupMsgEncode(const GroupMsg &m, const uint8_t* key, size_t keyLen, uint8_t* out) {
+  memcpy(out, "SNG1", 4);
+  put32(out + 4, m.sender);
+  put32(out + 8, m.seq);
+  put16(out + 12, m.group);
+  out[14] = m.cmd;
+  out[15] = m.arg;
+  seal(key, keyLen, out);
+}
+
+bool groupMsgDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupMsg &m) {
+  if (!verify(in, len, "SNG1", key, keyLen)) return false;
+  m.sender = get32(in + 4);
+  m.seq = get32(in + 8);
+  m.group = get16(in + 12);
+  m.cmd = in[14];
+  m.arg = in[15];
+  return m.cmd <= GROUP_SCENE && (m.cmd != GROUP_SCENE || m.arg < GROUP_SCENES);
+}
+
+void groupChallengeEncode(const GroupChallenge &c, const uint8_t* key, size_t keyLen, uint8_t* out) {
+  memcpy(out, "SNC1", 4);
+  put32(out + 4, c.challenger);
+  put32(out + 8, c.sender);
+  put32(out + 12, c.nonce);
+  seal(key, keyLen, out);
+}
+
+bool groupChallengeDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupChallenge &c) {
+  if (!verify(in, len, "SNC1", key, keyLen)) return false;
+  c.challenger = get32(in + 4);
+  c.sender = get32(in + 8);
+  c.nonce = get32(in + 12);
+  return true;
+}
+
+void groupResponseEncode(const GroupResponse &r, const uint8_t* key, size_t keyLen, uint8_t* out) {
+  memcpy(out, "SNR1", 4);
+  put32(out + 4, r.sender);
+  put32(out + 8, r.nonce);
+  put32(out + 12, r.seq);
+  seal(key, keyLen, out);
+}
+
+bool groupResponseDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupResponse &r) {
+  if (!verify(in, len, "SNR1", key, keyLen)) return false;
+  r.sender = get32(in + 4);
+  r.nonce = get32(in + 8);
+  r.seq = get32(in + 12);
+  return true;
+}
+
+bool groupVouch(const GroupChallenge &ch, uint32_t self, uint32_t lastSeq, uint32_t lastMs,
+                uint32_t nowMs, GroupResponse &out) {
+  if (ch.sender != self || !lastSeq || nowMs - lastMs >= GROUP_VOUCH_MS) return false;
+  out = { self, ch.nonce, lastSeq };
+  return true;
+}
+
+// -------------------- Replay window --------------------
+GroupVerdict GroupReplayWindow::check(uint32_t sender, uint32_t seq, uint32_t nowMs) {
+  Entry* e = nullptr;
+  for (Entry &x : _e) {
+    if (x.used && x.sender == sender) { e = &x; break; }
+  }
+  if (!e) return GROUP_UNKNOWN;
+
+  e->lastMs = nowMs;
+  if (seq > e->top) {
+    const uint32_t shift = seq - e->top;
+    e->seen = shift >= 64 ? 0 : e->seen << shift;
+    e->seen |= 1;
+    e->top = seq;
+    return GROUP_FRESH;
+  }
+
+  const uint32_t back = e->top - seq;
+  if (back >= 64) return GROUP_STALE;
+  const uint64_t bit = (uint64_t)1 << back;
+  if (e->seen & bit) return GROUP_DUPLICATE;
+  e->seen |= bit;
+  return GROUP_FRESH;
+}
+
+void GroupReplayWindow::establish(uint32_t sender, uint32_t seq, uint32_t nowMs) {
+  Entry* e = nullptr;
+  Entry* victim = &_e[0];
+  for (Entry &x : _e) {
+    if (x.used && x.sender == sender) { e = &x; break; }
+    if (!x.used) victim = &x;
+    else if (victim->used && (int32_t)(x.lastMs - victim->lastMs) < 0) victim = &x;
+  }
+  if (!e) e = victim;
+  e->used = true;
+  e->sender = sender;
+  e->top = seq;
+  e->seen = ~(uint64_t)0;   // nothing before the vouched seq is known to be fresh
+  e->lastMs = nowMs;
+}
+
+uint32_t GroupReplayWindow::challenge(const GroupMsg &m, uint32_t nonce, uint32_t nowMs) {
+  Pending* free = nullptr;
+  Pending* oldest = &_p[0];
+  for (Pending &x : _p) {
+    const bool live = x.used && nowMs - x.sinceMs < GROUP_CHALLENGE_MS;
+    if (live && x.msg.sender == m.sender) {   // repeat copy or a newer command
+      if (m.seq > x.msg.seq) x.msg = m;
+      return x.nonce;
+    }
+    if (!live) free = &x;
+    else if ((int32_t)(x.sinceMs - oldest->sinceMs) < 0) oldest = &x;
+  }
+
+  Pending* p = free ? free : oldest;
+  p->used = true;
+  p->msg = m;
+  p->nonce = nonce;
+  p->sinceMs = nowMs;
+  return nonce;
+}
+
+bool GroupReplayWindow::answer(const GroupResponse &r, uint32_t nowMs, GroupMsg &out) {
+  for (Pending &p : _p) {
+    if (!p.used || p.msg.sender != r.sender || p.nonce != r.nonce) continue;
+    p.used = false;
+    if (nowMs - p.sinceMs >= GROUP_CHALLENGE_MS) return false;
+    establish(r.sender, r.seq, nowMs);
+    if (p.msg.seq != r.seq) return false;
+    out = p.msg;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,137 @@
+/**************************************************************
+ * Group command datagrams (wire format + replay protection)
+ *
+ *  32 bytes, big-endian: 4-byte magic, 12-byte body, then
+ *  HMAC-SHA256(key, bytes 0..15) truncated to 16 bytes.
+ *    Command   "SNG1" u32 sender, u32 seq, u16 group, u8 cmd, u8 arg
+ *    Challenge "SNC1" u32 challenger, u32 sender, u32 nonce
+ *    Response  "SNR1" u32 sender, u32 nonce, u32 seq
+ *
+ *  Senders repeat each command a few times (multicast over Wi-Fi is
+ *  not acknowledged); receivers drop the copies with a per-sender
+ *  64-entry sliding window, which also rejects replays of anything
+ *  older.
+ *  - The windows live in RAM, so a sender a receiver does not know
+ *    (first contact, after a reboot, or evicted from the table) could
+ *    be an old capture. Its command is held and the receiver unicasts
+ *    a challenge with a fresh nonce. The sender answers only if it
+ *    sent a command in the last GROUP_VOUCH_MS, with that command's
+ *    seq. A response matching the nonce opens the window at that seq
+ *    (everything older counts as seen), and the held command runs if
+ *    it is the one vouched for.
+ *  Portable: no Arduino dependencies (hmac.h).
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t GROUP_MSG_LEN = 32;
+static const size_t GROUP_MAC_LEN = 16;
+static const uint8_t GROUP_SCENES = 8;
+
+static const uint32_t GROUP_CHALLENGE_MS = 2000;   // a challenge stays open this long
+static const uint32_t GROUP_VOUCH_MS     = 2000;   // senders vouch for commands this recent
+
+enum GroupCmd : uint8_t {
+  GROUP_OFF,
+  GROUP_ON,
+  GROUP_TOGGLE,
+  GROUP_SCENE,   // arg = scene 0..GROUP_SCENES-1
+};
+
+enum GroupFrame : uint8_t {
+  GROUP_FRAME_BAD,
+  GROUP_FRAME_CMD,
+  GROUP_FRAME_CHALLENGE,
+  GROUP_FRAME_RESPONSE,
+};
+
+struct GroupMsg {
+  uint32_t sender;
+  uint32_t seq;
+  uint16_t group;
+  uint8_t  cmd;
+  uint8_t  arg;
+};
+
+struct GroupChallenge {
+  uint32_t challenger;   // the receiver's own sender id
+  uint32_t sender;       // the sender being asked
+  uint32_t nonce;
+};
+
+struct GroupResponse {
+  uint32_t sender;
+  uint32_t nonce;
+  uint32_t seq;          // the sender's latest command
+};
+
+// By length and magic only; the decoders check the MAC.
+GroupFrame groupFrameKind(const uint8_t* in, size_t len);
+
+// Encode and sign into out[GROUP_MSG_LEN]. Decoders return false if the
+// length, magic, MAC (or command) is wrong.
+void groupMsgEncode(const GroupMsg &m, const uint8_t* key, size_t keyLen, uint8_t* out);
+bool groupMsgDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupMsg &m);
+void groupChallengeEncode(const GroupChallenge &c, const uint8_t* key, size_t keyLen, uint8_t* out);
+bool groupChallengeDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupChallenge &c);
+void groupResponseEncode(const GroupResponse &r, const uint8_t* key, size_t keyLen, uint8_t* out);
+bool groupResponseDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, GroupResponse &r);
+
+// Sender side: the response to `ch` if it asks `self` and our latest
+// command (lastSeq, sent at lastMs) is recent enough to vouch for.
+bool groupVouch(const GroupChallenge &ch, uint32_t self, uint32_t lastSeq, uint32_t lastMs,
+                uint32_t nowMs, GroupResponse &out);
+
+const char* groupCmdStr(uint8_t cmd);
+bool groupParseCmd(const char* s, uint8_t &cmd);
+
+#ifndef GROUP_REPLAY_SENDERS
+#define GROUP_REPLAY_SENDERS 8
+#endif
+#ifndef GROUP_CHALLENGES_MAX
+#define GROUP_CHALLENGES_MAX 4
+#endif
+
+enum GroupVerdict : uint8_t {
+  GROUP_FRESH,
+  GROUP_DUPLICATE,   // already seen (repeat copy or replay inside the window)
+  GROUP_STALE,       // older than the window
+  GROUP_UNKNOWN,     // no window for this sender: challenge it first
+};
+
+// Sliding window per sender (IPsec-style) plus the open challenges.
+// The least recently heard sender is forgotten when the table is full
+// and has to pass a challenge again. Single-threaded.
+class GroupReplayWindow {
+public:
+  GroupVerdict check(uint32_t sender, uint32_t seq, uint32_t nowMs);
+
+  // Holds `m` (from an unknown sender) and returns the nonce to send
+  // in the challenge; a newer command replaces the held one.
+  uint32_t challenge(const GroupMsg &m, uint32_t nonce, uint32_t nowMs);
+  // A response matching an open challenge opens the sender's window at
+  // r.seq. True (with the held command in `out`) if that command is
+  // the one the sender vouched for and should run now.
+  bool answer(const GroupResponse &r, uint32_t nowMs, GroupMsg &out);
+
+private:
+  struct Entry {
+    uint32_t sender;
+    uint32_t top;      // highest seq seen
+    uint64_t seen;     // bit i = top - i seen
+    uint32_t lastMs;
+    bool     used;
+  };
+  struct Pending {
+    GroupMsg msg;
+    uint32_t nonce;
+    uint32_t sinceMs;
+    bool     used;
+  };
+  void establish(uint32_t sender, uint32_t seq, uint32_t nowMs);
+
+  Entry   _e[GROUP_REPLAY_SENDERS] = {};
+  Pending _p[GROUP_CHALLENGES_MAX] = {};
+};
@@ -0,0 +1,73 @@
+/**************************************************************
+ * Fixed-bucket log2 latency histogram
+ *
+ *  - Bucket i counts samples in (2^(i-1), 2^i] microseconds
+ *    (bucket 0 = <= 1 us), plus one overflow bucket.
+ *  - record() is a handful of relaxed atomic adds: safe from any
+ *    task, no allocation. The counters are lock-free. The 64-bit sum
+ *    is not on Xtensa: libatomic wraps it in a short critical section.
+ *    It stays 64-bit so the exported _sum never wraps like a counter
+ *    reset would.
+ *  - Header-only and Arduino-free so host builds use the same code.
+ **************************************************************/
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+class LatencyHistogram {
+public:
+  static const uint8_t BUCKETS = 24;               // 1 us .. ~8.4 s
+  static const uint8_t SLOTS   = BUCKETS + 1;      // + overflow
+
+  static uint8_t bucketFor(uint32_t us) {
+    if (us <= 1) return 0;
+    const uint8_t i = (uint8_t)(32 - __builtin_clz(us - 1));
+    return i < BUCKETS ? i : BUCKETS;
+  }
+
+  // Inclusive upper bound of bucket i in us (overflow => UINT32_MAX).
+  static uint32_t bucketUpper(uint8_t i) {
+    return i < BUCKETS ? (1UL << i) : UINT32_MAX;
+  }
+
+  void record(uint32_t us) {
+    _b[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(us, std::memory_order_relaxed);
+    uint32_t m = _max.load(std::memory_order_relaxed);
+    while (us > m && !_max.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < SLOTS; i++) _b[i].store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+  uint32_t bucket(uint8_t i) const { return _b[i].load(std::memory_order_relaxed); }
+  uint32_t count() const { return _count.load(std::memory_order_relaxed); }
+  uint64_t sumUs() const { return _sum.load(std::memory_order_relaxed); }
+  uint32_t maxUs() const { return _max.load(std::memory_order_relaxed); }
+
+  // Upper bound of the bucket holding the p-quantile (0 < p <= 1).
+  uint32_t percentileUs(float p) const {
+    const uint32_t n = count();
+    if (!n) return 0;
+    uint32_t want = (uint32_t)(p * n + 0.5f);
+    if (want < 1) want = 1;
+    uint32_t acc = 0;
+    for (uint8_t i = 0; i < SLOTS; i++) {
+      acc += bucket(i);
+      if (acc >= want) return i < BUCKETS ? bucketUpper(i) : maxUs();
+    }
+    return maxUs();
+  }
+
+private:
+  std::atomic<uint32_t> _b[SLOTS] = {};
+  std::atomic<uint32_t> _count{0};
+  std::atomic<uint64_t> _sum{0};   // libatomic (critical section) on Xtensa
+  std::atomic<uint32_t> _max{0};
+};
@@ -0,0 +1,262 @@
+#include "history.h"
+#include "log.h"
+#include "ota.h"
+
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <sys/time.h>
+#include <atomic>
+
+static_assert(sizeof(HistEntry) == 16, "history file format");
+
+// -------------------- Tuning --------------------
+static const char*    HISTORY_FILE = "/history.bin";
+static const char*    HISTORY_TMP  = "/history.tmp";
+static const uint32_t HIST_EPOCH_MIN = 1700000000;   // anything earlier = clock not set
+
+// -------------------- State --------------------
+// The ring is written by the net task only; readers copy under ring_mux.
+static HistEntry ring[HISTORY_CAPACITY];
+static uint32_t  next_seq = 0;
+static uint32_t  oldest_seq = 0;
+static portMUX_TYPE ring_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Net task only
+static uint16_t boot_no = 0;
+static bool     last_relay = false;
+static bool     last_pressed = false;
+static bool     clock_set = false;
+static uint32_t flushed_seq = 0;      // first seq not on flash yet
+static uint32_t pending_since = 0;    // millis() of the oldest unflushed entry
+static uint32_t last_flush_ms = 0;
+static uint32_t file_records = 0;
+static bool     rewrite_pending = false;
+
+static std::atomic<uint32_t> st_flushes{0};
+static std::atomic<uint32_t> st_bytes{0};
+static std::atomic<uint32_t> st_lost{0};
+static std::atomic<uint32_t> st_flushed{0};
+static std::atomic<bool>     st_clock{false};
+
+static inline HistEntry &slot(uint32_t seq) {
+  return ring[seq % HISTORY_CAPACITY];
+}
+
+static bool epochMs(int64_t &out) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < (time_t)HIST_EPOCH_MIN) return false;
+  out = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  return true;
+}
+
+// -------------------- Flash --------------------
+static void loadFile() {
+  File f = LittleFS.open(HISTORY_FILE, "r");
+  if (!f) return;
+
+  const uint32_t total = f.size() / sizeof(HistEntry);
+  const uint32_t skip = total > HISTORY_CAPACITY ? total - HISTORY_CAPACITY : 0;
+  f.seek(skip * sizeof(HistEntry));
+
+  uint32_t loaded = 0;
+  HistEntry e;
+  while (f.read((uint8_t*)&e, sizeof(e)) == sizeof(e)) {
+    if (loaded && e.seq != next_seq) break;   // torn or foreign tail
+    if (!loaded) oldest_seq = e.seq;
+    slot(e.seq) = e;
+    next_seq = e.seq + 1;
+    loaded++;
+  }
+  f.close();
+
+  flushed_seq = next_seq;
+  file_records = total;
+  if (loaded != total - skip) rewrite_pending = true;
+  LOGI("HIST", "%lu event(s) restored, next seq %lu", (unsigned long)loaded, (unsigned long)next_seq);
+}
+
+static size_t writeRange(File &f, uint32_t from, uint32_t to) {
+  size_t bytes = 0;
+  for (uint32_t s = from; s != to; s++) bytes += f.write((const uint8_t*)&slot(s), sizeof(HistEntry));
+  return bytes;
+}
+
+// Appends what is pending, or rewrites the file with the ring when it has
+// grown to twice the ring (or holds entries that changed since).
+static void flushNow() {
+  if (otaFsOffline()) return;   // LittleFS unmounted for an FS image; the next poll retries
+  const uint32_t first = next_seq - oldest_seq > HISTORY_CAPACITY ? next_seq - HISTORY_CAPACITY : oldest_seq;
+  uint32_t from = flushed_seq;
+  if ((int32_t)(first - from) > 0) {
+    st_lost.fetch_add(first - from, std::memory_order_relaxed);
+    from = first;
+  }
+  const uint32_t n = next_seq - from;
+  size_t bytes = 0;
+
+  if (rewrite_pending || file_records + n > 2 * HISTORY_CAPACITY) {
+    File f = LittleFS.open(HISTORY_TMP, "w");
+    if (!f) { LOGW("HIST", "cannot write %s", HISTORY_TMP); return; }
+    bytes = writeRange(f, first, next_seq);
+    f.close();
+    if (!LittleFS.rename(HISTORY_TMP, HISTORY_FILE)) { LOGW("HIST", "rename failed"); return; }
+    file_records = next_seq - first;
+    rewrite_pending = false;
+  } else {
+    File f = LittleFS.open(HISTORY_FILE, "a");
+    if (!f) { LOGW("HIST", "cannot append %s", HISTORY_FILE); return; }
+    bytes = writeRange(f, from, next_seq);
+    f.close();
+    file_records += n;
+  }
+
+  flushed_seq = next_seq;
+  last_flush_ms = millis();
+  st_flushes.fetch_add(1, std::memory_order_relaxed);
+  st_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  st_flushed.store(flushed_seq, std::memory_order_relaxed);
+  LOGD("HIST", "flushed %lu event(s), %u bytes", (unsigned long)n, (unsigned)bytes);
+}
+
+// Converts this boot's uptime stamps once SNTP has set the clock.
+static void fixClock() {
+  int64_t now;
+  if (clock_set || !epochMs(now)) return;
+  clock_set = true;
+  st_clock.store(true);
+
+  // This task is the only writer, so entries are read without the lock;
+  // the 64-bit math runs on a copy and only the store back is locked.
+  const int64_t offset = now - (int64_t)millis();
+  const uint32_t first = next_seq - oldest_seq > HISTORY_CAPACITY ? next_seq - HISTORY_CAPACITY : oldest_seq;
+  for (uint32_t s = first; s != next_seq; s++) {
+    HistEntry e = slot(s);
+    if (e.boot != boot_no || !(e.flags & HIST_UPTIME)) continue;
+    const int64_t t = (int64_t)e.sec * 1000 + e.ms + offset;
+    e.sec = (uint32_t)(t / 1000);
+    e.ms = (uint16_t)(t % 1000);
+    e.flags &= ~HIST_UPTIME;
+
+    portENTER_CRITICAL(&ring_mux);
+    slot(s) = e;
+    portEXIT_CRITICAL(&ring_mux);
+    if ((int32_t)(flushed_seq - s) > 0) rewrite_pending = true;
+  }
+}
+
+// -------------------- API --------------------
+void historyBegin(const ControlSnapshot &st) {
+  Preferences p;
+  p.begin("hist", false);
+  boot_no = p.getUShort("boot", 0) + 1;
+  p.putUShort("boot", boot_no);
+  p.end();
+
+  last_relay = st.relay;
+  last_pressed = !st.inputOpen;
+  loadFile();
+  last_flush_ms = millis();
+  st_flushed.store(flushed_seq);
+}
+
+void historyRecord(const ControlEvent &ev) {
+  HistEntry e = {};
+  e.boot = boot_no;
+  e.type = ev.type;
+  e.source = ev.source;
+
+  bool &last = (ev.type == EV_INPUT) ? last_pressed : last_relay;
+  const bool now = (ev.type == EV_INPUT) ? !ev.value : ev.value;
+  if (last) e.flags |= HIST_OLD;
+  if (now)  e.flags |= HIST_NEW;
+  last = now;
+
+  int64_t t;
+  if (clock_set && epochMs(t)) {
+    t -= (int32_t)(millis() - ev.ms);   // queued a moment ago
+  } else {
+    t = ev.ms;
+    e.flags |= HIST_UPTIME;
+  }
+  e.sec = (uint32_t)(t / 1000);
+  e.ms = (uint16_t)(t % 1000);
+
+  if (flushed_seq == next_seq) pending_since = millis();
+
+  portENTER_CRITICAL(&ring_mux);
+  e.seq = next_seq;
+  slot(next_seq) = e;
+  next_seq++;
+  portEXIT_CRITICAL(&ring_mux);
+}
+
+void historyPoll() {
+  fixClock();
+
+  const uint32_t pending = next_seq - flushed_seq;
+  if (!pending && !rewrite_pending) return;
+
+  const uint32_t now = millis();
+  if (now - last_flush_ms < HISTORY_FLUSH_MIN_S * 1000) return;
+  if (pending < HISTORY_FLUSH_BATCH && now - pending_since < HISTORY_FLUSH_MAX_S * 1000 && !rewrite_pending) return;
+  flushNow();
+}
+
+void historyFlush() {
+  if (next_seq != flushed_seq || rewrite_pending) flushNow();
+}
+
+size_t historyRead(uint32_t after, HistEntry* out, size_t max) {
+  size_t n = 0;
+  portENTER_CRITICAL(&ring_mux);
+  const uint32_t first = next_seq - oldest_seq > HISTORY_CAPACITY ? next_seq - HISTORY_CAPACITY : oldest_seq;
+  uint32_t s = first;
+  if ((int32_t)(after + 1 - first) > 0) s = after + 1;
+  for (; s != next_seq && (int32_t)(next_seq - s) > 0 && n < max; s++) out[n++] = slot(s);
+  portEXIT_CRITICAL(&ring_mux);
+  return n;
+}
+
+HistStats historyStats() {
+  HistStats s;
+  portENTER_CRITICAL(&ring_mux);
+  s.next = next_seq;
+  s.oldest = next_seq - oldest_seq > HISTORY_CAPACITY ? next_seq - HISTORY_CAPACITY : oldest_seq;
+  portEXIT_CRITICAL(&ring_mux);
+  s.flushed = st_flushed.load(std::memory_order_relaxed);
+  s.flushes = st_flushes.load(std::memory_order_relaxed);
+  s.bytesWritten = st_bytes.load(std::memory_order_relaxed);
+  s.lost = st_lost.load(std::memory_order_relaxed);
+  s.boot = boot_no;
+  s.clockSet = st_clock.load();
+  return s;
+}
+
+// -------------------- Binary export --------------------
+static size_t putVar(uint8_t* out, uint64_t v) {
+  size_t n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    out[n++] = b | (v ? 0x80 : 0);
+  } while (v);
+  return n;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+size_t historyEncode(HistEncoder &enc, const HistEntry &e, uint8_t* out) {
+  const int64_t tms = (int64_t)e.sec * 1000 + e.ms;
+  size_t n = 0;
+  n += putVar(out + n, (uint32_t)(e.seq - enc.seq));
+  n += putVar(out + n, zigzag((int16_t)(e.boot - enc.boot)));
+  n += putVar(out + n, zigzag(tms - enc.tms));
+  out[n++] = (e.type & 0x01) | ((e.flags & 0x07) << 1) | ((e.source & 0x0F) << 4);
+  enc.seq = e.seq;
+  enc.boot = e.boot;
+  enc.tms = tms;
+  return n;
+}
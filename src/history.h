@@ -0,0 +1,89 @@
+/**************************************************************
+ * Relay / input event history
+ *
+ *  - Every control event (control.h) is recorded by the net task into a
+ *    fixed RAM ring: timestamp, boot number, source (web, mqtt, input,
+ *    rule, ...) and the old/new state.
+ *  - Timestamps are Unix time once SNTP has synced. Before that they are
+ *    seconds since boot, flagged HIST_UPTIME; entries of the current
+ *    boot are converted as soon as the clock is set.
+ *  - The ring is appended to /history.bin on LittleFS at most once per
+ *    HISTORY_FLUSH_MIN_S, and only when HISTORY_FLUSH_BATCH entries are
+ *    waiting or the oldest one is HISTORY_FLUSH_MAX_S old. The file is
+ *    compacted once it holds twice the ring, so a busy relay costs a few
+ *    small appends per hour rather than one flash write per toggle.
+ *  - Reads copy entries under a short critical section and can run on
+ *    any task (HTTP handlers stream them in chunks).
+ *  - historyEncode() writes the compact export: varint deltas of
+ *    seq / boot / time plus one packed byte, about 5 bytes per event.
+ *
+ * Decode: python3 tools/history.py <host>
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "control.h"
+
+#ifndef HISTORY_CAPACITY
+#define HISTORY_CAPACITY 512
+#endif
+
+static const uint32_t HISTORY_FLUSH_MIN_S  = 60;
+static const uint32_t HISTORY_FLUSH_MAX_S  = 600;
+static const uint16_t HISTORY_FLUSH_BATCH  = 64;
+static const size_t   HISTORY_ENCODED_MAX  = 24;   // bytes per entry, worst case
+
+enum HistFlags : uint8_t {
+  HIST_OLD    = 0x01,   // state before (relay on / input pressed)
+  HIST_NEW    = 0x02,   // state after
+  HIST_UPTIME = 0x04,   // sec/ms count from boot, clock was not set
+};
+
+struct HistEntry {
+  uint32_t seq;
+  uint32_t sec;
+  uint16_t ms;
+  uint16_t boot;
+  uint8_t  type;     // ControlEventType
+  uint8_t  source;   // RelaySource
+  uint8_t  flags;
+  uint8_t  reserved;
+};
+
+struct HistStats {
+  uint32_t next;       // seq of the next event
+  uint32_t oldest;     // oldest seq still in RAM
+  uint32_t flushed;    // events up to here are on flash
+  uint32_t flushes;
+  uint32_t bytesWritten;
+  uint32_t lost;       // overwritten before they were flushed
+  uint16_t boot;
+  bool     clockSet;
+};
+
+// Loads the tail of /history.bin (LittleFS must be mounted) and seeds the
+// old/new tracking with the current state.
+void historyBegin(const ControlSnapshot &st);
+// Net task: records one control event.
+void historyRecord(const ControlEvent &ev);
+// Net task: clock fix-up and the flush policy.
+void historyPoll();
+// Writes pending entries now (before a restart).
+void historyFlush();
+
+// Copies up to `max` entries with seq > after, oldest first. Any task.
+size_t historyRead(uint32_t after, HistEntry* out, size_t max);
+HistStats historyStats();
+
+// Delta state for historyEncode(); zero-initialize per export.
+struct HistEncoder {
+  uint32_t seq;
+  uint16_t boot;
+  int64_t  tms;
+};
+
+// Appends one entry in the binary export format; returns its length
+// (at most HISTORY_ENCODED_MAX).
+size_t historyEncode(HistEncoder &enc, const HistEntry &e, uint8_t* out);
+
+static const char HISTORY_BIN_MAGIC[4] = { 'S', 'N', 'H', '1' };
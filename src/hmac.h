@@ -0,0 +1,20 @@
+/**************************************************************
+ * HMAC-SHA256 for the signed node-to-node messages
+ *
+ *  - On the ESP32 this is mbedtls (hardware SHA); host builds
+ *    (env:native: simulator and tests) use a small portable SHA-256
+ *    so groupmsg / peerlink run unchanged there.
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const size_t HMAC_SHA256_LEN = 32;
+
+// False only if the backend failed.
+bool hmacSha256(const uint8_t* key, size_t keyLen, const uint8_t* msg, size_t len,
+                uint8_t out[HMAC_SHA256_LEN]);
+
+// Constant-time comparison for MAC checks.
+bool hmacEqual(const uint8_t* a, const uint8_t* b, size_t len);
@@ -0,0 +1,116 @@
+#include "httpbody.h"
+
+static const uint8_t CHUNK_SIZE_DIGITS = 8;   // chunks over 4 GB are not an OTA image
+
+static int hexDigit(uint8_t c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void HttpBodyDecoder::begin(bool chunked, int64_t length, HttpBodySink sink, void* ctx) {
+  _sink = sink;
+  _ctx = ctx;
+  _error = nullptr;
+  _produced = 0;
+  _digits = 0;
+  if (chunked) {
+    _state = S_SIZE;
+    _left = 0;
+  } else {
+    _state = length == 0 ? S_DONE : S_IDENTITY;
+    _left = length < 0 ? -1 : length;
+  }
+}
+
+bool HttpBodyDecoder::emit(const uint8_t* p, size_t n) {
+  if (!n) return true;
+  if (!_sink(p, n, _ctx)) return fail("sink");
+  _produced += n;
+  return true;
+}
+
+bool HttpBodyDecoder::write(const uint8_t* data, size_t len) {
+  if (_state == S_FAILED) return false;
+
+  size_t i = 0;
+  while (i < len && _state != S_DONE) {
+    const uint8_t c = data[i];
+    switch (_state) {
+      case S_IDENTITY: {
+        size_t n = len - i;
+        if (_left >= 0 && (int64_t)n > _left) n = (size_t)_left;
+        if (!emit(data + i, n)) return false;
+        i += n;
+        if (_left >= 0 && (_left -= n) == 0) _state = S_DONE;
+        continue;
+      }
+      case S_DATA: {
+        size_t n = len - i;
+        if ((int64_t)n > _left) n = (size_t)_left;
+        if (!emit(data + i, n)) return false;
+        i += n;
+        if ((_left -= n) == 0) _state = S_DATA_CR;
+        continue;
+      }
+      case S_SIZE: {
+        const int d = hexDigit(c);
+        if (d >= 0) {
+          if (++_digits > CHUNK_SIZE_DIGITS) return fail("chunk_size");
+          _left = _left * 16 + d;
+        } else if (!_digits) {
+          return fail("chunk_size");
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          _state = S_EXT;
+        } else if (c == '\r') {
+          _state = S_SIZE_LF;
+        } else {
+          return fail("chunk_size");
+        }
+        break;
+      }
+      case S_EXT:
+        if (c == '\r') _state = S_SIZE_LF;
+        break;
+      case S_SIZE_LF:
+        if (c != '\n') return fail("chunk_framing");
+        _state = _left ? S_DATA : S_TRAILER;
+        break;
+      case S_DATA_CR:
+        if (c != '\r') return fail("chunk_framing");
+        _state = S_DATA_LF;
+        break;
+      case S_DATA_LF:
+        if (c != '\n') return fail("chunk_framing");
+        _state = S_SIZE;
+        _left = 0;
+        _digits = 0;
+        break;
+      case S_TRAILER:
+        _state = c == '\r' ? S_END_LF : S_TRAILER_LINE;
+        break;
+      case S_TRAILER_LINE:
+        if (c == '\r') _state = S_TRAILER_LF;
+        break;
+      case S_TRAILER_LF:
+        if (c != '\n') return fail("chunk_framing");
+        _state = S_TRAILER;
+        break;
+      case S_END_LF:
+        if (c != '\n') return fail("chunk_framing");
+        _state = S_DONE;
+        break;
+      case S_DONE:
+      case S_FAILED:
+        break;
+    }
+    i++;
+  }
+  return true;
+}
+
+void HttpBodyDecoder::closed() {
+  if (_state == S_IDENTITY && _left < 0) _state = S_DONE;
+  else if (_state != S_DONE && _state != S_FAILED) fail("truncated");
+}
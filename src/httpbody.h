@@ -0,0 +1,63 @@
+/**************************************************************
+ * HTTP/1.x response body decoder (OTA pull)
+ *
+ *  - HTTPClient::getStreamPtr() hands out the raw socket, so whatever
+ *    framing the server chose reaches us as-is. This strips it:
+ *      identity  Content-Length bytes, or everything up to the close
+ *                when no length was sent
+ *      chunked   hex size lines (extensions ignored), the CRLF after
+ *                each chunk, the last-chunk and any trailers
+ *  - Fed in arbitrary slices straight off the socket; only the body
+ *    bytes reach the sink, no buffering. Bytes after the end of the
+ *    body are ignored.
+ *  Portable: no Arduino dependencies.
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Receives body bytes. Returns false to abort.
+typedef bool (*HttpBodySink)(const uint8_t* data, size_t len, void* ctx);
+
+class HttpBodyDecoder {
+public:
+  // length: Content-Length, or -1 if the server sent none (ignored when chunked).
+  void begin(bool chunked, int64_t length, HttpBodySink sink, void* ctx);
+  // False on malformed chunk framing or a sink error ("sink").
+  bool write(const uint8_t* data, size_t len);
+  // The peer closed the connection: a body without a length ends here.
+  void closed();
+  // True once the whole body was delivered.
+  bool finished() const { return _state == S_DONE; }
+  uint64_t produced() const { return _produced; }
+  const char* error() const { return _error; }
+
+private:
+  enum State : uint8_t {
+    S_IDENTITY,
+    S_SIZE,        // chunk size hex digits
+    S_EXT,         // ";ext" up to the CR
+    S_SIZE_LF,
+    S_DATA,
+    S_DATA_CR,
+    S_DATA_LF,
+    S_TRAILER,     // start of a trailer line (or the final CRLF)
+    S_TRAILER_LINE,
+    S_TRAILER_LF,
+    S_END_LF,
+    S_DONE,
+    S_FAILED,
+  };
+
+  bool emit(const uint8_t* p, size_t n);
+  bool fail(const char* why) { _error = why; _state = S_FAILED; return false; }
+
+  HttpBodySink _sink = nullptr;
+  void* _ctx = nullptr;
+  const char* _error = nullptr;
+  State _state = S_FAILED;
+  int64_t _left = 0;         // identity: bytes to go (-1 = until close); chunked: of this chunk
+  uint8_t _digits = 0;
+  uint64_t _produced = 0;
+};
@@ -0,0 +1,113 @@
+#include "inputtrace.h"
+#include "control.h"
+#include "log.h"
+
+#include <atomic>
+#include "soc/gpio_reg.h"
+
+static_assert(INPUT_PIN < 32, "the sampler reads GPIO_IN_REG (pins 0-31)");
+
+// -------------------- State --------------------
+// Written by the timer ISR while `running`; read by other tasks only
+// after it has cleared `running`.
+static uint32_t* edges = nullptr;
+static volatile uint32_t n_edges = 0;
+static volatile uint32_t n_samples = 0;
+static uint32_t target = 0;
+static uint16_t period_us = 0;
+static uint8_t level0 = 1;
+static uint8_t last_level = 1;
+static volatile bool overflow = false;
+static std::atomic<bool> running{false};
+
+// Published by traceStart() (async_tcp) once the alarm runs; released
+// only by tracePoll() on the net task, so the timer is never ended twice.
+static std::atomic<hw_timer_t*> timer{nullptr};
+
+static inline uint8_t readPin() {
+  return (REG_READ(GPIO_IN_REG) >> INPUT_PIN) & 1;
+}
+
+// -------------------- Sampler (ISR) --------------------
+static void IRAM_ATTR onSample() {
+  if (!running.load(std::memory_order_relaxed)) return;
+  const uint32_t i = ++n_samples;
+  const uint8_t level = readPin();
+  if (level != last_level) {
+    last_level = level;
+    if (n_edges == TRACE_MAX_EDGES) {
+      overflow = true;
+      running.store(false, std::memory_order_release);
+      return;
+    }
+    edges[n_edges++] = i;
+  }
+  if (i >= target) running.store(false, std::memory_order_release);
+}
+
+// -------------------- Control --------------------
+static void releaseTimer() {
+  hw_timer_t* t = timer.load();
+  if (!t) return;
+  timerAlarmDisable(t);
+  timerDetachInterrupt(t);
+  timerEnd(t);
+  timer.store(nullptr);
+  LOGI("TRACE", "done: %lu samples, %lu edges%s", (unsigned long)n_samples, (unsigned long)n_edges,
+       overflow ? " (buffer full)" : "");
+}
+
+bool traceStart(uint16_t periodUs, uint32_t seconds) {
+  if (running.load() || timer.load()) return false;   // also while the last one is being released
+  if (periodUs < TRACE_PERIOD_MIN_US || periodUs > TRACE_PERIOD_MAX_US) return false;
+  if (!seconds || seconds > TRACE_MAX_SECONDS) return false;
+  if (!edges) edges = (uint32_t*)malloc(TRACE_MAX_EDGES * sizeof(uint32_t));
+  if (!edges) return false;
+
+  period_us = periodUs;
+  target = seconds * 1000000UL / periodUs;
+  n_samples = 0;
+  n_edges = 0;
+  overflow = false;
+  level0 = last_level = readPin();
+
+  // Arduino-ESP32 2.x timer API: timer 0 at 1 MHz, auto-reload alarm.
+  hw_timer_t* t = timerBegin(0, 80, true);
+  if (!t) return false;
+  timerAttachInterrupt(t, onSample, true);
+  timerAlarmWrite(t, periodUs, true);
+  running.store(true, std::memory_order_release);
+  timerAlarmEnable(t);
+  timer.store(t);   // from here on tracePoll() may release it
+  LOGI("TRACE", "capture: %u us period, %lu s", periodUs, (unsigned long)seconds);
+  return true;
+}
+
+// The ISR ignores ticks once `running` is clear; the net task releases
+// the timer on its next pass.
+void traceStop() {
+  running.store(false, std::memory_order_release);
+}
+
+void tracePoll() {
+  if (timer.load() && !running.load(std::memory_order_acquire)) releaseTimer();
+}
+
+TraceInfo traceInfo() {
+  TraceInfo t;
+  t.running = running.load(std::memory_order_acquire);
+  t.overflow = overflow;
+  t.level = level0;
+  t.periodUs = period_us;
+  t.samples = n_samples;
+  t.target = target;
+  t.edges = n_edges;
+  return t;
+}
+
+size_t traceEdges(uint32_t from, uint32_t* out, size_t n) {
+  if (running.load(std::memory_order_acquire) || !edges) return 0;
+  size_t i = 0;
+  for (; i < n && from + i < n_edges; i++) out[i] = edges[from + i] * period_us;
+  return i;
+}
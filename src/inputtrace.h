@@ -0,0 +1,62 @@
+/**************************************************************
+ * Raw input trace recorder (debounce benchmarking)
+ *
+ *  - A hardware timer samples the input pin every `periodUs` (default
+ *    50 us = 20 kHz) and stores the sample index of each level change,
+ *    so a capture is the undebounced contact waveform, bounce included.
+ *  - The timer interrupt is allocated on the core that starts the
+ *    capture (the HTTP handler, core 0), away from the control task.
+ *    The control task keeps debouncing and switching as usual.
+ *  - Edges go into a RAM buffer (TRACE_MAX_EDGES x 4 bytes, allocated on
+ *    the first capture). A full buffer ends the capture and sets
+ *    `overflow`.
+ *  - /api/trace starts/stops a capture and reports progress; the result
+ *    is dumped by GET /api/trace?format=text (format below) and replayed
+ *    through the debouncers by the native bench (src/bench/).
+ *
+ *    # switchnode input trace
+ *    pin=25
+ *    period_us=50
+ *    level=1          (level at t=0; 1 = open)
+ *    samples=200000
+ *    edges=2
+ *    overflow=0
+ *    debounce=stable/50
+ *    1234550          (one edge per line: us since the start)
+ *    1300100
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef TRACE_MAX_EDGES
+#define TRACE_MAX_EDGES 4096
+#endif
+
+static const uint16_t TRACE_PERIOD_MIN_US = 10;
+static const uint16_t TRACE_PERIOD_MAX_US = 1000;
+static const uint32_t TRACE_MAX_SECONDS   = 300;
+
+struct TraceInfo {
+  bool     running;
+  bool     overflow;
+  uint8_t  level;      // level at sample 0
+  uint16_t periodUs;
+  uint32_t samples;    // taken so far
+  uint32_t target;     // samples requested
+  uint32_t edges;
+};
+
+// False if a capture is running, the arguments are out of range or the
+// buffer cannot be allocated.
+bool traceStart(uint16_t periodUs, uint32_t seconds);
+// Ends the capture at once; the timer is released by the next tracePoll().
+void traceStop();
+// Net task: releases the timer once a capture has finished. The only
+// place that does.
+void tracePoll();
+
+TraceInfo traceInfo();
+// Copies up to `n` edges from index `from`, as us since the start.
+// Returns 0 while a capture is running.
+size_t traceEdges(uint32_t from, uint32_t* out, size_t n);
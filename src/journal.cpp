@@ -0,0 +1,174 @@
+#include "journal.h"
+
+#include <string.h>
+
+static const uint32_t SLOTS = JOURNAL_SECTOR / JOURNAL_RECORD;
+static const uint32_t SEQ_ERASED = 0xFFFFFFFF;
+
+static_assert(JOURNAL_SECTOR % JOURNAL_RECORD == 0, "records must tile a sector");
+
+uint16_t StateJournal::checkOf(const Record &r) {
+  uint32_t h = 2166136261u;
+  const uint8_t b[5] = { (uint8_t)r.seq, (uint8_t)(r.seq >> 8), (uint8_t)(r.seq >> 16), (uint8_t)(r.seq >> 24), r.state };
+  for (uint8_t x : b) h = (h ^ x) * 16777619u;
+  return (uint16_t)(h ^ (h >> 16));
+}
+
+bool StateJournal::valid(const Record &r) {
+  return r.seq != SEQ_ERASED && r.seq != 0 && (uint8_t)~r.state == r.inv && r.check == checkOf(r);
+}
+
+bool StateJournal::readRecord(uint32_t off, Record &r) {
+  uint8_t b[JOURNAL_RECORD];
+  if (!f_.read(f_.ctx, off, b, sizeof(b))) return false;
+  r.seq = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+  r.state = b[4];
+  r.inv = b[5];
+  r.check = (uint16_t)(b[6] | (b[7] << 8));
+  return true;
+}
+
+bool StateJournal::erased(uint32_t off) {
+  uint8_t b[JOURNAL_RECORD];
+  if (!f_.read(f_.ctx, off, b, sizeof(b))) return false;
+  for (uint8_t x : b) {
+    if (x != 0xFF) return false;
+  }
+  return true;
+}
+
+bool StateJournal::begin(const JournalFlash &flash) {
+  f_ = flash;
+  ok_ = false;
+  have_ = false;
+  next_clean_ = false;
+  st_ = {};
+  if (!f_.read || !f_.write || !f_.erase) return false;
+  if (f_.size % JOURNAL_SECTOR || f_.size < 2 * JOURNAL_SECTOR) return false;
+  sectors_ = f_.size / JOURNAL_SECTOR;
+
+  // Newest sector = the one whose first record has the highest sequence.
+  int32_t best = -1;
+  uint32_t bestSeq = 0;
+  for (uint32_t s = 0; s < sectors_; s++) {
+    Record r;
+    st_.bootReads++;
+    if (!readRecord(s * JOURNAL_SECTOR, r)) return false;
+    if (!valid(r)) continue;
+    if (best < 0 || (int32_t)(r.seq - bestSeq) > 0) {
+      best = (int32_t)s;
+      bestSeq = r.seq;
+    }
+  }
+
+  if (best < 0) {
+    // Empty: pretend the last sector is full so the first append
+    // starts on (and makes sure of) a clean sector 0.
+    cur_ = sectors_ - 1;
+    slot_ = SLOTS;
+    seq_ = 0;
+    ok_ = true;
+    return true;
+  }
+
+  // Written records form a prefix of the sector: find its end.
+  cur_ = (uint32_t)best;
+  const uint32_t base = cur_ * JOURNAL_SECTOR;
+  uint32_t lo = 1, hi = SLOTS;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    st_.bootReads++;
+    if (erased(base + mid * JOURNAL_RECORD)) hi = mid;
+    else lo = mid + 1;
+  }
+  slot_ = lo;
+
+  // The last record may be torn by a power cut; fall back to the one before.
+  for (uint32_t i = lo; i-- > 0;) {
+    Record r;
+    st_.bootReads++;
+    if (!readRecord(base + i * JOURNAL_RECORD, r)) return false;
+    if (valid(r)) {
+      seq_ = r.seq;
+      state_ = r.state;
+      have_ = true;
+      break;
+    }
+    st_.torn++;
+  }
+  st_.seq = seq_;
+  ok_ = true;
+  return true;
+}
+
+bool StateJournal::last(uint8_t &state) const {
+  if (!have_) return false;
+  state = state_;
+  return true;
+}
+
+bool StateJournal::eraseSector(uint32_t sector) {
+  // Skip the erase (and its wear) if the sector is already blank.
+  uint8_t b[256];
+  bool blank = true;
+  for (uint32_t off = 0; off < JOURNAL_SECTOR && blank; off += sizeof(b)) {
+    if (!f_.read(f_.ctx, sector * JOURNAL_SECTOR + off, b, sizeof(b))) return false;
+    for (uint8_t x : b) {
+      if (x != 0xFF) { blank = false; break; }
+    }
+  }
+  if (blank) return true;
+  if (!f_.erase(f_.ctx, sector * JOURNAL_SECTOR)) return false;
+  st_.erases++;
+  return true;
+}
+
+bool StateJournal::needsErase() const {
+  return ok_ && !next_clean_ && slot_ >= SLOTS / 2;
+}
+
+bool StateJournal::prepare() {
+  if (!ok_) return false;
+  if (next_clean_) return true;
+  next_clean_ = eraseSector((cur_ + 1) % sectors_);
+  return next_clean_;
+}
+
+bool StateJournal::append(uint8_t state) {
+  if (!ok_) return false;
+  if (slot_ >= SLOTS) {
+    if (!prepare()) return false;
+    cur_ = (cur_ + 1) % sectors_;
+    slot_ = 0;
+    next_clean_ = false;
+  }
+
+  Record r;
+  r.seq = seq_ + 1;
+  if (r.seq == SEQ_ERASED || r.seq == 0) r.seq = 1;
+  r.state = state;
+  r.inv = (uint8_t)~state;
+  r.check = checkOf(r);
+
+  const uint8_t b[JOURNAL_RECORD] = {
+    (uint8_t)r.seq, (uint8_t)(r.seq >> 8), (uint8_t)(r.seq >> 16), (uint8_t)(r.seq >> 24),
+    r.state, r.inv, (uint8_t)r.check, (uint8_t)(r.check >> 8),
+  };
+  const uint32_t off = cur_ * JOURNAL_SECTOR + slot_ * JOURNAL_RECORD;
+  slot_++;
+  if (!f_.write(f_.ctx, off, b, sizeof(b))) {
+    // Reuse the slot only if nothing was programmed; a hole would end
+    // the binary search in begin() early. A damaged first record would
+    // hide the whole sector from begin(), so move on to the next one.
+    if (erased(off)) slot_--;
+    else if (slot_ == 1) slot_ = SLOTS;
+    return false;
+  }
+
+  seq_ = r.seq;
+  state_ = state;
+  have_ = true;
+  st_.seq = seq_;
+  st_.appends++;
+  return true;
+}
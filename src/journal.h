@@ -0,0 +1,84 @@
+/**************************************************************
+ * Append-only state journal for raw flash (wear-leveled)
+ *
+ *  - The region is split into JOURNAL_SECTOR sectors used round-robin.
+ *    Each state change appends one 8-byte record (sequence number,
+ *    state, inverted state, check), so a 4 KB sector takes 512 changes
+ *    before it is erased. Every sector wears at the same rate.
+ *  - Records are never rewritten. A torn write fails its check and is
+ *    skipped, and the previous record stays valid.
+ *  - begin() reads the first record of every sector to find the newest
+ *    one, then binary-searches that sector for its last record: about
+ *    a dozen 8-byte reads, independent of how full the journal is.
+ *  - The next sector is erased ahead of time (prepare(), when
+ *    needsErase()) so the append at a sector boundary does not wait
+ *    for an erase.
+ *  - Flash access goes through JournalFlash, so this file stays portable
+ *    (the device uses a partition, host tools use a file or RAM).
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const uint32_t JOURNAL_SECTOR = 4096;
+static const uint32_t JOURNAL_RECORD = 8;
+
+struct JournalFlash {
+  void*    ctx;
+  uint32_t size;   // multiple of JOURNAL_SECTOR, at least 2 sectors
+  bool (*read)(void* ctx, uint32_t off, void* buf, size_t len);
+  bool (*write)(void* ctx, uint32_t off, const void* buf, size_t len);
+  bool (*erase)(void* ctx, uint32_t off);   // one sector
+};
+
+struct JournalStats {
+  uint32_t seq;        // of the last record, 0 = empty
+  uint32_t appends;    // since begin()
+  uint32_t erases;
+  uint32_t bootReads;  // flash reads done by begin()
+  uint32_t torn;       // invalid records skipped by begin()
+};
+
+class StateJournal {
+public:
+  // Scans the region. False if it is too small or unreadable.
+  bool begin(const JournalFlash &flash);
+  bool ready() const { return ok_; }
+
+  // Last recorded state; false if nothing was recorded yet.
+  bool last(uint8_t &state) const;
+  // Appends `state` (erasing inline only if prepare() did not run).
+  bool append(uint8_t state);
+
+  // True when the next sector should be erased ahead of use.
+  bool needsErase() const;
+  bool prepare();
+
+  JournalStats stats() const { return st_; }
+
+private:
+  struct Record {
+    uint32_t seq;
+    uint8_t  state;
+    uint8_t  inv;
+    uint16_t check;
+  };
+
+  bool readRecord(uint32_t off, Record &r);
+  bool erased(uint32_t off);
+  bool eraseSector(uint32_t sector);
+  static bool valid(const Record &r);
+  static uint16_t checkOf(const Record &r);
+
+  JournalFlash f_ = {};
+  bool     ok_ = false;
+  uint32_t sectors_ = 0;
+  uint32_t cur_ = 0;          // sector being written
+  uint32_t slot_ = 0;         // next free record in cur_
+  uint32_t seq_ = 0;
+  uint8_t  state_ = 0;
+  bool     have_ = false;
+  bool     next_clean_ = false;
+  JournalStats st_ = {};
+};
@@ -0,0 +1,210 @@
+#include "log.h"
+#include "taskcfg.h"
+
+#include <atomic>
+#include <stdarg.h>
+
+// -------------------- Ring --------------------
+// Bounded MPMC ring (per-slot sequence numbers). Producers reserve a slot
+// with a CAS on head, format in place, then publish by bumping the slot seq.
+// The drain task is the only consumer.
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+
+struct LogSlot {
+  std::atomic<uint32_t> seq;
+  LogRecord rec;
+};
+
+static LogSlot log_slots[LOG_RING_SLOTS];
+static std::atomic<uint32_t> log_head{0};
+static std::atomic<uint32_t> log_tail{0};     // written by the consumer only
+static std::atomic<uint32_t> log_dropped{0};
+// 0 = untouched, 1 = being initialized, 2 = ready. The control task can
+// log before setup() reaches logBegin(), so the first writer initializes.
+static std::atomic<uint8_t> log_state{0};
+
+static TaskHandle_t log_task = nullptr;
+
+// History (written by the drain task only)
+struct LogHistSlot {
+  uint32_t seq;
+  LogRecord rec;
+};
+static LogHistSlot log_hist[LOG_HISTORY_SLOTS];
+static uint32_t log_hist_seq = 0;
+static portMUX_TYPE log_hist_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint8_t LOG_MAX_SINKS = 4;
+static LogSinkFn log_sinks[LOG_MAX_SINKS];
+static std::atomic<uint8_t> log_sink_count{0};
+
+static const uint32_t LOG_DRAIN_IDLE_MS = 10;
+
+char logLevelChar(uint8_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR: return 'E';
+    case LOG_LEVEL_WARN:  return 'W';
+    case LOG_LEVEL_INFO:  return 'I';
+    case LOG_LEVEL_DEBUG: return 'D';
+    default: return '?';
+  }
+}
+
+// Runs the slot init exactly once. A writer that races the initializer
+// gets false (it must not spin: the initializer may be a lower-priority
+// task on the same core).
+static bool logRingReady() {
+  uint8_t st = log_state.load(std::memory_order_acquire);
+  if (st == 2) return true;
+  if (st == 0 && log_state.compare_exchange_strong(st, 1, std::memory_order_acq_rel)) {
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) {
+      log_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    log_state.store(2, std::memory_order_release);
+    return true;
+  }
+  return log_state.load(std::memory_order_acquire) == 2;
+}
+
+void logWrite(uint8_t level, const char* tag, const char* fmt, ...) {
+  if (!logRingReady()) {
+    log_dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  uint32_t pos = log_head.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  for (;;) {
+    slot = &log_slots[pos & (LOG_RING_SLOTS - 1)];
+    const uint32_t seq = slot->seq.load(std::memory_order_acquire);
+    const int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (log_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      // Full: never block the producer
+      log_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = log_head.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord &r = slot->rec;
+  r.ms = millis();
+  r.level = level;
+  r.tag = tag;
+
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(r.msg, sizeof(r.msg), fmt, ap);
+  va_end(ap);
+
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+// -------------------- Drain --------------------
+static void logEmit(const LogRecord &r) {
+  Serial.printf("%c [%s] %s\n", logLevelChar(r.level), r.tag, r.msg);
+
+  portENTER_CRITICAL(&log_hist_mux);
+  const uint32_t seq = ++log_hist_seq;
+  LogHistSlot &h = log_hist[seq % LOG_HISTORY_SLOTS];
+  h.seq = seq;
+  h.rec = r;
+  portEXIT_CRITICAL(&log_hist_mux);
+
+  const uint8_t n = log_sink_count.load(std::memory_order_acquire);
+  for (uint8_t i = 0; i < n; i++) log_sinks[i](seq, &r);
+}
+
+static void logIdleSinks() {
+  const uint8_t n = log_sink_count.load(std::memory_order_acquire);
+  for (uint8_t i = 0; i < n; i++) log_sinks[i](0, nullptr);
+}
+
+// Pops one record; returns false when the ring is empty.
+static bool logDrainOne() {
+  const uint32_t tail = log_tail.load(std::memory_order_relaxed);
+  LogSlot &slot = log_slots[tail & (LOG_RING_SLOTS - 1)];
+  if (slot.seq.load(std::memory_order_acquire) != tail + 1) return false;
+
+  logEmit(slot.rec);
+
+  slot.seq.store(tail + LOG_RING_SLOTS, std::memory_order_release);
+  log_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+static void logTask(void*) {
+  uint32_t lastDropped = 0;
+  for (;;) {
+    while (logDrainOne()) {}
+
+    const uint32_t dropped = log_dropped.load(std::memory_order_relaxed);
+    if (dropped != lastDropped) {
+      Serial.printf("W [LOG] %u message(s) dropped\n", (unsigned)(dropped - lastDropped));
+      lastDropped = dropped;
+    }
+    logIdleSinks();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+  }
+}
+
+void logBegin() {
+  logRingReady();
+  if (log_task) return;
+  xTaskCreatePinnedToCore(logTask, "log", 3072, nullptr, PRIO_LOG, &log_task, CORE_NET);
+}
+
+void logFlush(uint32_t timeoutMs) {
+  if (!log_task) {
+    while (logDrainOne()) {}
+    Serial.flush();
+    return;
+  }
+  const uint32_t t0 = millis();
+  while (log_tail.load(std::memory_order_acquire) != log_head.load(std::memory_order_acquire) && millis() - t0 < timeoutMs) {
+    delay(5);
+  }
+  Serial.flush();
+}
+
+uint32_t logDroppedCount() {
+  return log_dropped.load(std::memory_order_relaxed);
+}
+
+// -------------------- History / sinks --------------------
+uint32_t logHistoryLatest() {
+  portENTER_CRITICAL(&log_hist_mux);
+  const uint32_t seq = log_hist_seq;
+  portEXIT_CRITICAL(&log_hist_mux);
+  return seq;
+}
+
+uint32_t logHistoryOldest() {
+  const uint32_t latest = logHistoryLatest();
+  if (!latest) return 0;
+  return latest > LOG_HISTORY_SLOTS ? latest - LOG_HISTORY_SLOTS + 1 : 1;
+}
+
+bool logHistoryGet(uint32_t seq, LogRecord &out) {
+  if (!seq) return false;
+  bool ok = false;
+  portENTER_CRITICAL(&log_hist_mux);
+  const LogHistSlot &h = log_hist[seq % LOG_HISTORY_SLOTS];
+  if (h.seq == seq) {
+    out = h.rec;
+    ok = true;
+  }
+  portEXIT_CRITICAL(&log_hist_mux);
+  return ok;
+}
+
+// Sinks are registered once at startup; the list is append-only.
+bool logAddSink(LogSinkFn fn) {
+  const uint8_t n = log_sink_count.load(std::memory_order_relaxed);
+  if (n >= LOG_MAX_SINKS) return false;
+  log_sinks[n] = fn;
+  log_sink_count.store(n + 1, std::memory_order_release);
+  return true;
+}
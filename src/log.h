@@ -0,0 +1,91 @@
+/**************************************************************
+ * Leveled logging with an asynchronous ring-buffer sink
+ *
+ *  - LOGE/LOGW/LOGI/LOGD(tag, fmt, ...) are filtered at compile time
+ *    against LOG_LEVEL; disabled levels expand to nothing.
+ *  - Enabled messages are formatted into a fixed-slot lock-free ring
+ *    (multi-producer) and drained to Serial by a low-priority task,
+ *    so callers never block on the UART.
+ *  - When the ring is full the message is dropped and counted.
+ *  - The drain task also keeps a short history of recent records
+ *    (sequence-numbered) and fans out to extra sinks, used for remote
+ *    streaming (logremote.h).
+ *
+ * Build flag: -DLOG_LEVEL=<0..4> (see platformio.ini)
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Ring geometry (slots must be a power of two)
+#ifndef LOG_RING_SLOTS
+#define LOG_RING_SLOTS 32
+#endif
+#ifndef LOG_MSG_MAX
+#define LOG_MSG_MAX 120
+#endif
+#ifndef LOG_HISTORY_SLOTS
+#define LOG_HISTORY_SLOTS 64
+#endif
+
+struct LogRecord {
+  uint32_t    ms;
+  uint8_t     level;
+  const char* tag;            // string literal, never copied
+  char        msg[LOG_MSG_MAX];
+};
+
+void logBegin();
+void logWrite(uint8_t level, const char* tag, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// Blocks the caller until the ring is drained (or timeout). Use before restart.
+void logFlush(uint32_t timeoutMs = 500);
+
+uint32_t logDroppedCount();
+char logLevelChar(uint8_t level);
+
+// -------------------- History / sinks --------------------
+// Sequence numbers start at 1 and increase by one per drained record.
+uint32_t logHistoryLatest();
+// Copies record `seq` if it is still held in history.
+bool logHistoryGet(uint32_t seq, LogRecord &out);
+uint32_t logHistoryOldest();
+
+// Called from the drain task after Serial output. rec == nullptr is an
+// idle tick (ring empty) so sinks can flush on time.
+typedef void (*LogSinkFn)(uint32_t seq, const LogRecord* rec);
+bool logAddSink(LogSinkFn fn);
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOGE(tag, fmt, ...) logWrite(LOG_LEVEL_ERROR, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGE(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOGW(tag, fmt, ...) logWrite(LOG_LEVEL_WARN, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGW(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOGI(tag, fmt, ...) logWrite(LOG_LEVEL_INFO, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGI(tag, fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOGD(tag, fmt, ...) logWrite(LOG_LEVEL_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define LOGD(tag, fmt, ...) do {} while (0)
+#endif
@@ -0,0 +1,239 @@
+#include "logremote.h"
+#include "log.h"
+
+#include <atomic>
+#include <sys/time.h>
+#include <time.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+// -------------------- Tuning --------------------
+static const uint32_t SYSLOG_FLUSH_MS        = 250;    // max time a line waits in a batch
+static const uint32_t SYSLOG_RESOLVE_RETRY_MS = 30000;
+static const uint8_t  LOG_SSE_REPLAY_MAX     = 32;     // history records sent on connect
+static const uint8_t  LOG_SSE_BATCH          = 8;      // live records per logStreamLoop() pass
+static const size_t   LOG_SSE_MAX_WAITING    = 16;     // per-client queue depth before skipping
+static const time_t   SYSLOG_EPOCH_MIN       = 1700000000;   // anything earlier = clock not set
+
+static std::atomic<uint32_t> st_sse_sent{0};
+static std::atomic<uint32_t> st_sse_dropped{0};
+static std::atomic<uint32_t> st_sys_lines{0};
+static std::atomic<uint32_t> st_sys_dgrams{0};
+static std::atomic<uint32_t> st_sys_dropped{0};
+
+// -------------------- Syslog (drain task) --------------------
+struct SyslogCfg {
+  bool enabled;
+  char host[64];
+  uint16_t port;
+  uint32_t version;
+};
+
+static SyslogCfg sys_cfg_shared = {false, "", 514, 0};
+static portMUX_TYPE sys_cfg_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Owned by the drain task
+static SyslogCfg sys_cfg = {false, "", 514, 0};
+static char sys_hostname[40] = "switchnode";
+static WiFiUDP sys_udp;
+static IPAddress sys_ip;
+static bool sys_resolved = false;
+static uint32_t sys_last_resolve_ms = 0;
+
+static char sys_buf[SYSLOG_DGRAM_MAX];
+static size_t sys_len = 0;
+static uint32_t sys_batch_lines = 0;
+static uint32_t sys_batch_ms = 0;
+
+static uint8_t syslogSeverity(uint8_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR: return 3;
+    case LOG_LEVEL_WARN:  return 4;
+    case LOG_LEVEL_INFO:  return 6;
+    default:              return 7;
+  }
+}
+
+static void syslogRefreshCfg() {
+  portENTER_CRITICAL(&sys_cfg_mux);
+  const bool changed = (sys_cfg_shared.version != sys_cfg.version);
+  if (changed) sys_cfg = sys_cfg_shared;
+  portEXIT_CRITICAL(&sys_cfg_mux);
+
+  if (changed) {
+    sys_resolved = false;
+    sys_last_resolve_ms = 0;
+  }
+}
+
+static bool syslogResolve() {
+  if (sys_resolved) return true;
+  if (!sys_cfg.host[0] || !WiFi.isConnected()) return false;
+
+  const uint32_t now = millis();
+  if (sys_last_resolve_ms && now - sys_last_resolve_ms < SYSLOG_RESOLVE_RETRY_MS) return false;
+  sys_last_resolve_ms = now;
+
+  if (sys_ip.fromString(sys_cfg.host) || WiFi.hostByName(sys_cfg.host, sys_ip)) {
+    sys_resolved = true;
+  }
+  return sys_resolved;
+}
+
+static void syslogFlush() {
+  if (!sys_len) return;
+
+  bool sent = false;
+  if (WiFi.isConnected() && syslogResolve()) {
+    if (sys_udp.beginPacket(sys_ip, sys_cfg.port)) {
+      sys_udp.write((const uint8_t*)sys_buf, sys_len);
+      sent = sys_udp.endPacket();
+    }
+  }
+
+  if (sent) {
+    st_sys_dgrams.fetch_add(1, std::memory_order_relaxed);
+    st_sys_lines.fetch_add(sys_batch_lines, std::memory_order_relaxed);
+  } else {
+    st_sys_dropped.fetch_add(sys_batch_lines, std::memory_order_relaxed);
+  }
+  sys_len = 0;
+  sys_batch_lines = 0;
+}
+
+// RFC 3339 UTC time of a record logged at `ms` (uptime), or the nil
+// value "-" until SNTP has set the clock.
+static void syslogStamp(uint32_t ms, char* out, size_t n) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < SYSLOG_EPOCH_MIN) {
+    snprintf(out, n, "-");
+    return;
+  }
+  const int64_t at = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - (uint32_t)(millis() - ms);
+  const time_t sec = (time_t)(at / 1000);
+  struct tm tm;
+  gmtime_r(&sec, &tm);
+  snprintf(out, n, "%04d-%02d-%02dT%02d:%02d:%02d.%03uZ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+           tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned)(at % 1000));
+}
+
+// Never logs: it runs inside the log drain task.
+static void syslogSink(uint32_t, const LogRecord* rec) {
+  syslogRefreshCfg();
+
+  if (!sys_cfg.enabled) {
+    sys_len = 0;
+    sys_batch_lines = 0;
+    return;
+  }
+
+  if (!rec) {
+    if (sys_len && millis() - sys_batch_ms >= SYSLOG_FLUSH_MS) syslogFlush();
+    return;
+  }
+
+  // RFC 5424, facility user(1); the timestamp is nil until SNTP has synced
+  char stamp[32];
+  syslogStamp(rec->ms, stamp, sizeof(stamp));
+  char line[LOG_MSG_MAX + 128];
+  int n = snprintf(line, sizeof(line), "<%u>1 %s %s switchnode - %s - %s\n",
+                   (unsigned)(8 + syslogSeverity(rec->level)), stamp, sys_hostname, rec->tag, rec->msg);
+  if (n <= 0) return;
+  if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+
+  if (sys_len + (size_t)n > sizeof(sys_buf)) syslogFlush();
+  if (!sys_len) sys_batch_ms = millis();
+
+  memcpy(sys_buf + sys_len, line, n);
+  sys_len += n;
+  sys_batch_lines++;
+}
+
+void logRemoteBegin(const char* hostname) {
+  if (hostname && hostname[0]) {
+    strncpy(sys_hostname, hostname, sizeof(sys_hostname) - 1);
+    sys_hostname[sizeof(sys_hostname) - 1] = 0;
+  }
+  logAddSink(syslogSink);
+}
+
+void syslogConfigure(bool enabled, const char* host, uint16_t port) {
+  portENTER_CRITICAL(&sys_cfg_mux);
+  sys_cfg_shared.enabled = enabled;
+  strncpy(sys_cfg_shared.host, host ? host : "", sizeof(sys_cfg_shared.host) - 1);
+  sys_cfg_shared.host[sizeof(sys_cfg_shared.host) - 1] = 0;
+  sys_cfg_shared.port = port ? port : 514;
+  sys_cfg_shared.version++;
+  portEXIT_CRITICAL(&sys_cfg_mux);
+}
+
+// -------------------- SSE --------------------
+static AsyncEventSource log_events("/api/logs");
+static std::atomic<uint32_t> sse_cursor{0};
+
+static void sseSendRecord(AsyncEventSourceClient* c, uint32_t seq, const LogRecord &r) {
+  char line[LOG_MSG_MAX + 48];
+  snprintf(line, sizeof(line), "%lu %c [%s] %s",
+           (unsigned long)r.ms, logLevelChar(r.level), r.tag, r.msg);
+  if (c) c->send(line, "log", seq);
+  else   log_events.send(line, "log", seq);
+  st_sse_sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+void logStreamAttach(AsyncWebServer &server, const char* user, const char* pass) {
+  if (user) log_events.setAuthentication(user, pass);
+
+  log_events.onConnect([](AsyncEventSourceClient* c){
+    // Replay up to what the live path has already fanned out
+    const uint32_t upto = sse_cursor.load(std::memory_order_acquire);
+    uint32_t from = c->lastId() ? c->lastId() + 1 : 1;
+    const uint32_t oldest = logHistoryOldest();
+    if (from < oldest) from = oldest;
+    if (upto >= LOG_SSE_REPLAY_MAX && from < upto - LOG_SSE_REPLAY_MAX + 1) {
+      from = upto - LOG_SSE_REPLAY_MAX + 1;
+    }
+
+    LogRecord rec;
+    for (uint32_t seq = from; seq && seq <= upto; seq++) {
+      if (logHistoryGet(seq, rec)) sseSendRecord(c, seq, rec);
+    }
+  });
+
+  server.addHandler(&log_events);
+}
+
+void logStreamLoop() {
+  const uint32_t latest = logHistoryLatest();
+  uint32_t cursor = sse_cursor.load(std::memory_order_relaxed);
+
+  if (log_events.count() == 0) {
+    sse_cursor.store(latest, std::memory_order_release);
+    return;
+  }
+
+  LogRecord rec;
+  for (uint8_t budget = LOG_SSE_BATCH; cursor < latest && budget; budget--) {
+    // Backpressure: skip ahead rather than queue unbounded data
+    if (log_events.avgPacketsWaiting() > LOG_SSE_MAX_WAITING) {
+      st_sse_dropped.fetch_add(latest - cursor, std::memory_order_relaxed);
+      cursor = latest;
+      break;
+    }
+    cursor++;
+    if (logHistoryGet(cursor, rec)) sseSendRecord(nullptr, cursor, rec);
+    else st_sse_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  sse_cursor.store(cursor, std::memory_order_release);
+}
+
+LogRemoteStats logRemoteStats() {
+  LogRemoteStats s;
+  s.sseSent         = st_sse_sent.load(std::memory_order_relaxed);
+  s.sseDropped      = st_sse_dropped.load(std::memory_order_relaxed);
+  s.syslogLines     = st_sys_lines.load(std::memory_order_relaxed);
+  s.syslogDatagrams = st_sys_dgrams.load(std::memory_order_relaxed);
+  s.syslogDropped   = st_sys_dropped.load(std::memory_order_relaxed);
+  return s;
+}
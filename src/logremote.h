@@ -0,0 +1,48 @@
+/**************************************************************
+ * Remote log streaming
+ *
+ *  - SSE stream at /api/logs (Basic Auth), event "log", id = log seq.
+ *    On connect the recent history is replayed (from Last-Event-ID
+ *    when the browser reconnects).
+ *  - Optional UDP syslog (RFC 5424 lines, UTC timestamps once SNTP has
+ *    set the clock, nil before). Records are batched into
+ *    datagrams from the log drain task, so producers never wait on
+ *    the network; when Wi-Fi is down the batch is dropped and counted.
+ *
+ * Quick check against a local listener:
+ *   nc -klu 5514      (then POST /api/log syslog=1&host=<pc>&port=5514)
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#ifndef SYSLOG_DGRAM_MAX
+#define SYSLOG_DGRAM_MAX 1200   // stays under a typical path MTU
+#endif
+
+struct LogRemoteStats {
+  uint32_t sseSent;
+  uint32_t sseDropped;
+  uint32_t syslogLines;
+  uint32_t syslogDatagrams;
+  uint32_t syslogDropped;
+};
+
+// Registers the syslog sink with the log drain task.
+void logRemoteBegin(const char* hostname);
+
+// Thread-safe; takes effect on the next drain pass.
+void syslogConfigure(bool enabled, const char* host, uint16_t port);
+
+// Adds the SSE handler to the server (auth when user != nullptr).
+void logStreamAttach(AsyncWebServer &server, const char* user, const char* pass);
+
+// Net task: forwards new history records to SSE clients. The sends run
+// outside async_tcp. That is safe with this ESPAsyncWebServer: it guards
+// AsyncEventSource's client list and each client's queue with locks, and
+// AsyncTCP hands writes to the lwIP thread. Connect-time replay runs in
+// the onConnect handler on async_tcp.
+void logStreamLoop();
+
+LogRemoteStats logRemoteStats();
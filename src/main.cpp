@@ -14,14 +14,58 @@
  *  - Input GPIO: 25 (INPUT_PULLUP, dry contact to GND)
  *
  * DEBUG:
+ *  - Leveled logging (log.h), compile-time filtered via -DLOG_LEVEL,
+ *    drained to Serial by a low-priority task (never blocks callers)
+ *  - Prometheus text metrics at /metrics (auth) + Server-Timing on API replies
+ *  - Local control fast path (control.h): input -> relay runs in its own
+ *    high-priority task; MQTT notifications are published afterwards
+ *  - Dual core (taskcfg.h): control pinned to core 1, networking (net task,
+ *    async_tcp, log drain) on core 0; per-task CPU load in /metrics
+ *  - Latency probes (probe.h) at /api/latency, compiled out with -DPROBES_ENABLED=0
+ *  - Remote logs: SSE at /api/logs (auth) + optional UDP syslog (/api/log)
+ *  - Content negotiation (cbor.h): Accept/Content-Type application/cbor
+ *    for the JSON APIs
+ *  - /api/batch: ordered relay/status/config ops in one request, relay ops
+ *    run atomically in the control task
+ *  - /api/status: ETag/If-None-Match (304) and ?since=<version>&wait=<ms>
+ *    long-poll
+ *  - OTA (ota.h): /api/ota upload + MQTT-triggered pull, app or LittleFS,
+ *    SHA-256 verified, A/B rollback until the new image proves healthy;
+ *    LZSS-compressed and delta images (otaimage.h) decoded while streaming
+ *  - HTTP connection guard (connguard.h): connection cap, idle timeout,
+ *    early 503 on low heap; limits at /api/http
  *  - Verbose WiFi connect status prints + event-based disconnect reasons
  *  - Prints stored SSID + password length at boot
- *  - AP captive portal probe endpoints handled to reduce VFS "open()" spam
+ *  - mDNS: _switchnode._tcp with id / fw / ch and live relay, input and
+ *    MQTT state in TXT records (changes re-announced at most once a second)
+ *  - Fast boot (boottime.h): relay state first, Wi-Fi joins while the FS
+ *    mounts and config loads; per-phase timings at /api/boot and /metrics;
+ *    LittleFS listing only with -DBOOT_DIAG=1
+ *  - AP mode: one route table (router.h); OS probe URLs get a precomputed
+ *    redirect and the portal page is served from RAM
+ *  - Captive DNS (captivedns.h) answered from the AsyncUDP callback, with a
+ *    response cache and NODATA+SOA for AAAA/HTTPS
+ *  - Multicast group commands (groupcmd.h): signed all on/off/toggle and
+ *    scenes for many nodes in one datagram; config at /api/group
+ *  - Peer bindings (peerbind.h): input/relay of this node drives relays on
+ *    other nodes over ESP-NOW or UDP, acked + retried, no broker; /api/peer
+ *  - Local rules (rules.h): "on input long 2000 do pulse 500"-style text
+ *    compiled to bytecode and run in the control task; /api/rules and
+ *    MQTT <cmdTopic>/event
+ *  - Power-on policy off/on/last (powerstate.h): relay changes journaled
+ *    to a dedicated flash partition, restored before Wi-Fi starts; /api/power
+ *  - Event history (history.h): relay/input changes with time, source and
+ *    old/new state, flushed to flash in batches; /api/history (JSON or
+ *    compact binary, time-range and incremental queries)
+ *  - CoAP (coapserver.h): /relay and /input on udp/5683 with GET/PUT and
+ *    Observe (NON or CON notifications); off by default, /api/coap
+ *  - Input debounce (debounce.h): stable-window, lockout or integrating
+ *    algorithm set at /api/debounce; raw input traces (inputtrace.h) at
+ *    /api/trace for the native replay bench (src/bench/)
  **************************************************************/
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <DNSServer.h>
 #include <LittleFS.h>
 #include <Preferences.h>
 #include <dirent.h>
@@ -34,21 +78,48 @@
 #include <ESPmDNS.h>
 #include "esp_wifi.h"
 
-// -------------------- GPIO --------------------
-#define RELAY_PIN 16
-#define INPUT_PIN 25
-#define RELAY_ACTIVE_LOW 0   // 0 = ACTIVE HIGH, 1 = ACTIVE LOW
+#include "log.h"
+#include "logremote.h"
+#include "connguard.h"
+#include "cbor.h"
+#include "coapserver.h"
+#include "boottime.h"
+#include "captivedns.h"
+#include "groupcmd.h"
+#include "history.h"
+#include "inputtrace.h"
+#include "peerbind.h"
+#include "powerstate.h"
+#include "router.h"
+#include "ota.h"
+#include "metrics.h"
+#include "probe.h"
+#include "control.h"
+#include "rules.h"
+#include "taskcfg.h"
+#include "taskload.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// -------------------- Firmware ----------------
+#ifndef FW_VERSION
+#define FW_VERSION "dev"
+#endif
 
 // -------------------- FS/DNS ------------------
+// 1 = list LittleFS at boot (costs tens of ms; diagnostics only)
+#ifndef BOOT_DIAG
+#define BOOT_DIAG 0
+#endif
+
 static const char* FS_ROOT = "/www";
 static const byte DNS_PORT = 53;
 
-// -------------------- Debounce ----------------
-static const uint32_t INPUT_DEBOUNCE_MS = 50;
-
 // -------------------- Web/MQTT ----------------
+static const uint16_t MQTT_BUFFER_SIZE = 512;
 AsyncWebServer server(80);
-DNSServer dns;
 
 WiFiClient wifiClient;
 PubSubClient mqtt(wifiClient);
@@ -59,14 +130,6 @@ static const bool  BASIC_AUTH_ON = true;
 static const char* BASIC_USER   = "admin";
 static const char* BASIC_PASS   = "switchnode";
 
-// -------------------- State -------------------
-bool relayState = false;
-
-// Debounced input state (INPUT_PULLUP)
-static int in_last_read = HIGH;
-static int in_stable = HIGH;
-static uint32_t in_last_change_ms = 0;
-
 // IDs
 String deviceId;
 String shortId;
@@ -88,9 +151,34 @@ struct MqttCfg {
   String pass;
   String cmdTopic;
   String stateTopic;
-} mqttCfg;
+};
+
+MqttCfg mqttCfg;    // edited by /api/mqtt (under cfgLock)
+MqttCfg mqttLive;   // copy owned by the net task (PubSubClient keeps pointers into it)
+
+String topicCmd, topicState, topicDin, topicOta, topicOtaStatus, topicEvent;
+
+// mqttCfg and the topic strings are shared between async_tcp (HTTP) and
+// the net task; hold cfgLock while touching them outside the net task.
+static SemaphoreHandle_t cfgLock = nullptr;
+static std::atomic<bool> mqttCfgDirty{false};
+static std::atomic<bool> mqttUp{false};
+static std::atomic<uint32_t> statusMetaGen{0};   // bumps when non-control status fields change
+
+struct CfgLock {
+  CfgLock()  { xSemaphoreTake(cfgLock, portMAX_DELAY); }
+  ~CfgLock() { xSemaphoreGive(cfgLock); }
+};
 
-String topicCmd, topicState, topicDin;
+// Remote log config
+struct LogCfg {
+  bool syslogEnabled = false;
+  String syslogHost;
+  uint16_t syslogPort = 514;
+} logCfg;
+
+// HTTP connection limits (STA server)
+static ConnGuard connGuard;
 
 // -------------------- Helpers -----------------
 static String macToDeviceId() {
@@ -110,9 +198,12 @@ static String macSuffix6() {
 }
 
 static void applyTopics() {
-  topicCmd   = mqttCfg.cmdTopic;
-  topicState = mqttCfg.stateTopic.length() ? mqttCfg.stateTopic : (mqttCfg.cmdTopic + "/state");
-  topicDin   = mqttCfg.cmdTopic + "/din";
+  topicCmd   = mqttLive.cmdTopic;
+  topicState = mqttLive.stateTopic.length() ? mqttLive.stateTopic : (mqttLive.cmdTopic + "/state");
+  topicDin   = mqttLive.cmdTopic + "/din";
+  topicOta   = mqttLive.cmdTopic + "/ota";
+  topicOtaStatus = topicOta + "/status";
+  topicEvent = mqttLive.cmdTopic + "/event";
 }
 
 // -------------------- Debug WiFi --------------------
@@ -162,15 +253,16 @@ static const char* wifiDiscReasonStr(int reason) {
 static void onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
   switch (event) {
     case ARDUINO_EVENT_WIFI_STA_CONNECTED:
-      Serial.println("[WiFiEvent] STA_CONNECTED");
+      LOGI("WiFiEvent", "STA_CONNECTED");
       break;
     case ARDUINO_EVENT_WIFI_STA_GOT_IP:
-      Serial.printf("[WiFiEvent] GOT_IP: %s\n", WiFi.localIP().toString().c_str());
+      LOGI("WiFiEvent", "GOT_IP: %s", WiFi.localIP().toString().c_str());
       break;
     case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
-      Serial.printf("[WiFiEvent] STA_DISCONNECTED reason=%d (%s)\n",
-                    (int)info.wifi_sta_disconnected.reason,
-                    wifiDiscReasonStr((int)info.wifi_sta_disconnected.reason));
+      metricsRecordWifiDisconnect((int)info.wifi_sta_disconnected.reason);
+      LOGW("WiFiEvent", "STA_DISCONNECTED reason=%d (%s)",
+           (int)info.wifi_sta_disconnected.reason,
+           wifiDiscReasonStr((int)info.wifi_sta_disconnected.reason));
       break;
     default:
       break;
@@ -185,21 +277,181 @@ static inline bool authOK(AsyncWebServerRequest *r) {
 
 static inline bool requireAuthOr401(AsyncWebServerRequest *r) {
   if (authOK(r)) return true;
+  metricsInc(CNT_HTTP_UNAUTHORIZED);
   r->requestAuthentication();
   return false;
 }
 
-// -------------------- Relay --------------------
-static void setRelay(bool on) {
-  relayState = on;
-  const int level = RELAY_ACTIVE_LOW ? (on ? LOW : HIGH) : (on ? HIGH : LOW);
-  digitalWrite(RELAY_PIN, level);
+// -------------------- Request timing (metrics + Server-Timing) --------------------
+// Handlers run to completion on the async_tcp task, one at a time,
+// so a single start timestamp is enough.
+static uint32_t req_t0 = 0;
+static TaskLoadMeter http_load("http", CORE_NET);
+
+static ArRequestHandlerFunction timed(const char* route, ArRequestHandlerFunction fn) {
+  const uint8_t id = metricsRoute(route);
+  return [id, fn](AsyncWebServerRequest *r){
+    http_load.enter();
+    req_t0 = micros();
+    fn(r);
+    metricsRecordRequest(id, micros() - req_t0);
+    http_load.leave();
+  };
+}
+
+// serUs > 0 adds a "ser" metric (document serialization time).
+static void sendTimed(AsyncWebServerRequest *r, AsyncWebServerResponse *resp, uint32_t serUs = 0) {
+  char st[64];
+  int n = snprintf(st, sizeof(st), "app;dur=%.3f", (micros() - req_t0) / 1000.0f);
+  if (serUs) snprintf(st + n, sizeof(st) - n, ", ser;dur=%.3f", serUs / 1000.0f);
+  resp->addHeader("Server-Timing", st);
+  r->send(resp);
+}
+
+static void sendTimed(AsyncWebServerRequest *r, int code, const char* type, const String &body) {
+  sendTimed(r, r->beginResponse(code, type, body));
+}
 
-  Serial.printf("[RELAY] setRelay(%s) -> GPIO=%d\n", on ? "ON" : "OFF", level);
+// LittleFS is unmounted while an FS image is being written.
+static bool fsReadyOr503(AsyncWebServerRequest *r) {
+  if (!otaFsOffline()) return true;
+  AsyncWebServerResponse *resp = r->beginResponse(503, "text/plain", "Filesystem update in progress");
+  resp->addHeader("Retry-After", "5");
+  sendTimed(r, resp);
+  return false;
+}
 
+// -------------------- Content negotiation --------------------
+static const char* CT_CBOR = "application/cbor";
+// ApiArgs decodes into a 512-byte document; a larger body cannot fit.
+static const size_t API_BODY_MAX = 1024;
+static const size_t BATCH_BODY_MAX = 2048;   // /api/batch only
+
+static bool acceptsCbor(AsyncWebServerRequest *r) {
+  return r->hasHeader("Accept") && r->header("Accept").indexOf(CT_CBOR) >= 0;
+}
+
+static bool isCborBody(AsyncWebServerRequest *r) {
+  return r->contentType().startsWith(CT_CBOR);
+}
+
+static bool isJsonBody(AsyncWebServerRequest *r) {
+  return r->contentType().startsWith("application/json");
+}
+
+// Replies with `d` as CBOR if the client asked for it, JSON otherwise.
+static void sendDoc(AsyncWebServerRequest *r, int code, const JsonDocument &d) {
+  const uint32_t t0 = micros();
+  if (acceptsCbor(r)) {
+    AsyncResponseStream *s = r->beginResponseStream(CT_CBOR);
+    s->setCode(code);
+    serializeCbor(d, *s);
+    sendTimed(r, s, micros() - t0 + 1);
+    return;
+  }
+  String out;
+  serializeJson(d, out);
+  const uint32_t serUs = micros() - t0 + 1;
+  sendTimed(r, r->beginResponse(code, "application/json", out), serUs);
+}
+
+// 200 with an ETag header and no-cache (clients must revalidate).
+static void sendDocTagged(AsyncWebServerRequest *r, const JsonDocument &d, const String &etag) {
+  const uint32_t t0 = micros();
+  AsyncWebServerResponse *resp;
+  if (acceptsCbor(r)) {
+    AsyncResponseStream *s = r->beginResponseStream(CT_CBOR);
+    serializeCbor(d, *s);
+    resp = s;
+  } else {
+    String out;
+    serializeJson(d, out);
+    resp = r->beginResponse(200, "application/json", out);
+  }
+  const uint32_t serUs = micros() - t0 + 1;
+  resp->addHeader("ETag", etag);
+  resp->addHeader("Cache-Control", "no-cache");
+  sendTimed(r, resp, serUs);
+}
+
+static void sendResult(AsyncWebServerRequest *r, int code, const char* err = nullptr) {
+  StaticJsonDocument<64> d;
+  d["ok"] = (err == nullptr);
+  if (err) d["err"] = err;
+  sendDoc(r, code, d);
+}
+
+// Body handler for POST routes: buffers CBOR/JSON bodies up to `max` on
+// the request (_tempObject is freed by the server with the request).
+static void collectBodyMax(AsyncWebServerRequest *r, uint8_t *data, size_t len, size_t index, size_t total, size_t max) {
+  connGuard.touch(r->client());
+  if (!(isCborBody(r) || isJsonBody(r)) || total > max) return;
+  if (index == 0) {
+    r->_tempObject = malloc(total);
+  }
+  if (r->_tempObject && index + len <= total) memcpy((uint8_t*)r->_tempObject + index, data, len);
+}
+
+static void collectBody(AsyncWebServerRequest *r, uint8_t *data, size_t len, size_t index, size_t total) {
+  collectBodyMax(r, data, len, index, total, API_BODY_MAX);
+}
+
+static void collectBatchBody(AsyncWebServerRequest *r, uint8_t *data, size_t len, size_t index, size_t total) {
+  collectBodyMax(r, data, len, index, total, BATCH_BODY_MAX);
+}
+
+// Decodes a buffered CBOR or JSON body into `doc`; false if absent or malformed.
+static bool parseBody(AsyncWebServerRequest *r, JsonDocument &doc) {
+  if (!r->_tempObject) return false;
+  const uint8_t* body = (const uint8_t*)r->_tempObject;
+  const size_t len = r->contentLength();
+  const DeserializationError err = isCborBody(r) ? deserializeCbor(doc, body, len)
+                                                 : deserializeJson(doc, body, len);
+  return !err && doc.is<JsonObject>();
+}
+
+// POST fields from a form body or a CBOR/JSON map, read the same way.
+struct ApiArgs {
+  AsyncWebServerRequest *r;
+  StaticJsonDocument<512> doc;
+  bool structured = false;
+  bool valid = true;   // false: body missing, too large or malformed
+
+  explicit ApiArgs(AsyncWebServerRequest *req) : r(req) {
+    if (!isCborBody(r) && !isJsonBody(r)) return;
+    structured = true;
+    valid = parseBody(r, doc);
+  }
+
+  bool has(const char* k) const {
+    return structured ? doc.containsKey(k) : r->hasParam(k, true);
+  }
+
+  // Values come back as text so handlers parse every encoding identically.
+  String get(const char* k) const {
+    if (!structured) return r->hasParam(k, true) ? r->getParam(k, true)->value() : String();
+    JsonVariantConst v = doc[k];
+    if (v.is<bool>()) return v.as<bool>() ? "1" : "0";
+    if (v.is<long>()) return String(v.as<long>());
+    return v.as<const char*>() ? String(v.as<const char*>()) : String();
+  }
+};
+
+// -------------------- MQTT publish --------------------
+static bool mqttPublish(const char* topic, const char* payload, bool retained) {
+  const bool ok = mqtt.publish(topic, payload, retained);
+  metricsInc(ok ? CNT_MQTT_PUBLISH : CNT_MQTT_PUBLISH_FAILS);
+  return ok;
+}
+
+// -------------------- Relay state publishing --------------------
+static void publishRelayState(bool on) {
   if (mqtt.connected() && topicState.length()) {
-    mqtt.publish(topicState.c_str(), relayState ? "ON" : "OFF", true);
-    Serial.printf("[MQTT] publish state %s => %s\n", topicState.c_str(), relayState ? "ON" : "OFF");
+    mqttPublish(topicState.c_str(), on ? "ON" : "OFF", true);
+    PROBE_END(PROBE_GPIO_TO_PUBLISH);
+    LOGD("MQTT", "publish state %s => %s", topicState.c_str(), on ? "ON" : "OFF");
+  } else {
+    PROBE_CANCEL(PROBE_GPIO_TO_PUBLISH);
   }
 }
 
@@ -207,8 +459,8 @@ static void setRelay(bool on) {
 static void publishInputOpenBool(bool open) {
   if (!mqtt.connected() || !topicDin.length()) return;
   const char* payload = open ? "OFF" : "ON";
-  mqtt.publish(topicDin.c_str(), payload, true);
-  Serial.printf("[MQTT] publish din %s => %s (open=%d)\n", topicDin.c_str(), payload, open ? 1 : 0);
+  mqttPublish(topicDin.c_str(), payload, true);
+  LOGD("MQTT", "publish din %s => %s (open=%d)", topicDin.c_str(), payload, open ? 1 : 0);
 }
 
 // -------------------- Preferences --------------------
@@ -236,6 +488,7 @@ static void loadMqttCfg() {
   mqttCfg.cmdTopic   = prefs.getString("cmd", "");
   mqttCfg.stateTopic = prefs.getString("st", "");
   prefs.end();
+  mqttLive = mqttCfg;
   applyTopics();
 }
 
@@ -251,49 +504,292 @@ static void saveMqttCfg() {
   prefs.end();
 }
 
+static void loadLogCfg() {
+  prefs.begin("log", true);
+  logCfg.syslogEnabled = prefs.getBool("sys_en", false);
+  logCfg.syslogHost    = prefs.getString("sys_host", "");
+  logCfg.syslogPort    = prefs.getUShort("sys_port", 514);
+  prefs.end();
+  syslogConfigure(logCfg.syslogEnabled, logCfg.syslogHost.c_str(), logCfg.syslogPort);
+}
+
+static void saveLogCfg() {
+  prefs.begin("log", false);
+  prefs.putBool("sys_en", logCfg.syslogEnabled);
+  prefs.putString("sys_host", logCfg.syslogHost);
+  prefs.putUShort("sys_port", logCfg.syslogPort);
+  prefs.end();
+}
+
+static void loadHttpCfg() {
+  ConnGuardCfg c;
+  prefs.begin("http", true);
+  c.maxConnections = prefs.getUChar("max_conn", c.maxConnections);
+  c.idleTimeoutS   = prefs.getUShort("idle_s", c.idleTimeoutS);
+  c.minFreeHeap    = prefs.getUInt("min_heap", c.minFreeHeap);
+  prefs.end();
+  connGuard.configure(c);
+}
+
+static void saveHttpCfg() {
+  const ConnGuardCfg &c = connGuard.config();
+  prefs.begin("http", false);
+  prefs.putUChar("max_conn", c.maxConnections);
+  prefs.putUShort("idle_s", c.idleTimeoutS);
+  prefs.putUInt("min_heap", c.minFreeHeap);
+  prefs.end();
+}
+
+// -------------------- Group commands --------------------
+static void loadGroupCfg() {
+  GroupCfg c;
+  prefs.begin("group", true);
+  c.enabled = prefs.getBool("en", c.enabled);
+  c.port    = prefs.getUShort("port", c.port);
+  c.repeat  = prefs.getUChar("repeat", c.repeat);
+  strlcpy(c.addr, prefs.getString("addr", c.addr).c_str(), sizeof(c.addr));
+  strlcpy(c.scenes, prefs.getString("scenes", c.scenes).c_str(), sizeof(c.scenes));
+  strlcpy(c.key, prefs.getString("key", "").c_str(), sizeof(c.key));
+  groupParseList(prefs.getString("groups", "").c_str(), c.groups);
+  prefs.end();
+  groupConfigure(c);
+}
+
+static void saveGroupCfg() {
+  const GroupCfg c = groupConfig();
+  prefs.begin("group", false);
+  prefs.putBool("en", c.enabled);
+  prefs.putUShort("port", c.port);
+  prefs.putUChar("repeat", c.repeat);
+  prefs.putString("addr", c.addr);
+  prefs.putString("scenes", c.scenes);
+  prefs.putString("key", c.key);
+  prefs.putString("groups", groupListStr(c.groups));
+  prefs.end();
+}
+
+static bool validScenes(const String &s) {
+  if (s.length() != GROUP_SCENES) return false;
+  for (size_t i = 0; i < s.length(); i++) {
+    if (!strchr("01t-", s[i])) return false;
+  }
+  return true;
+}
+
+// -------------------- Peer bindings --------------------
+static void loadPeerCfg() {
+  PeerCfg c;
+  prefs.begin("peer", true);
+  c.enabled = prefs.getBool("en", c.enabled);
+  strlcpy(c.key, prefs.getString("key", "").c_str(), sizeof(c.key));
+  peerParseBindings(prefs.getString("binds", "").c_str(), c);
+  prefs.end();
+  peerConfigure(c);
+}
+
+static void savePeerCfg() {
+  const PeerCfg c = peerConfig();
+  prefs.begin("peer", false);
+  prefs.putBool("en", c.enabled);
+  prefs.putString("key", c.key);
+  prefs.putString("binds", peerBindingsStr(c));
+  prefs.end();
+}
+
+// -------------------- CoAP --------------------
+static void loadCoapCfg() {
+  CoapCfg c;
+  prefs.begin("coap", true);
+  c.enabled     = prefs.getBool("en", c.enabled);
+  c.confirmable = prefs.getBool("con", c.confirmable);
+  prefs.end();
+  coapConfigure(c);
+}
+
+static void saveCoapCfg() {
+  const CoapCfg c = coapConfig();
+  prefs.begin("coap", false);
+  prefs.putBool("en", c.enabled);
+  prefs.putBool("con", c.confirmable);
+  prefs.end();
+}
+
+// -------------------- Input debounce --------------------
+static DebounceCfg loadDebounceCfg() {
+  DebounceCfg c;
+  prefs.begin("input", true);
+  c.algo = prefs.getUChar("alg", c.algo);
+  c.ms   = prefs.getUShort("ms", c.ms);
+  prefs.end();
+  return (c.algo < DEB__COUNT && c.ms <= DEBOUNCE_MAX_MS) ? c : DebounceCfg();
+}
+
+static void saveDebounceCfg() {
+  const DebounceCfg c = controlDebounce();
+  prefs.begin("input", false);
+  prefs.putUChar("alg", c.algo);
+  prefs.putUShort("ms", c.ms);
+  prefs.end();
+}
+
+// -------------------- Power-on policy --------------------
+static uint8_t loadPowerPolicy() {
+  prefs.begin("power", true);
+  const uint8_t p = prefs.getUChar("policy", POWER_OFF);
+  prefs.end();
+  return p <= POWER_LAST ? p : POWER_OFF;
+}
+
+static void savePowerPolicy(uint8_t p) {
+  prefs.begin("power", false);
+  prefs.putUChar("policy", p);
+  prefs.end();
+}
+
+// -------------------- Rules --------------------
+static const size_t RULES_TEXT_MAX = 1024;
+
+static RuleProgram rulesScratch;   // compiled here, copied by controlLoadRules()
+
+// Falls back to the default rule if the stored text no longer compiles.
+// NVS only, so it also runs before the FS mount.
+static const RuleProgram& compileStoredRules() {
+  prefs.begin("rules", true);
+  String text = prefs.getString("text", RULES_DEFAULT);
+  prefs.end();
+
+  RuleError err;
+  if (!rulesCompile(text.c_str(), rulesScratch, err)) {
+    LOGW("RULES", "stored rules: line %u: %s; using default", err.line, err.msg);
+    rulesCompile(RULES_DEFAULT, rulesScratch, err);
+  }
+  return rulesScratch;
+}
+
+// Installs the stored program and fires its "boot" rules.
+static void loadRules() {
+  controlLoadRules(compileStoredRules());
+}
+
+static void saveRules(const String &text) {
+  prefs.begin("rules", false);
+  prefs.putString("text", text);
+  prefs.end();
+}
+
+// -------------------- Batch --------------------
+static const size_t   BATCH_DOC_SIZE   = 2048;
+static const uint32_t BATCH_TIMEOUT_MS = 200;
+
+enum BatchKind : uint8_t {
+  BK_CONTROL,   // runs in the control task
+  BK_CONFIG,
+};
+
+// Sets (apply=true) or validates one "mqtt.<field>" config value.
+// Caller holds cfgLock when applying.
+static bool mqttCfgField(const char* key, JsonVariantConst v, bool apply) {
+  if (strncmp(key, "mqtt.", 5) != 0) return false;
+  const char* f = key + 5;
+
+  if (!strcmp(f, "enabled")) {
+    if (!v.is<bool>()) return false;
+    if (apply) mqttCfg.enabled = v.as<bool>();
+    return true;
+  }
+  if (!strcmp(f, "port")) {
+    const long p = v.as<long>();
+    if (!v.is<long>() || p <= 0 || p > 65535) return false;
+    if (apply) mqttCfg.port = (uint16_t)p;
+    return true;
+  }
+
+  if (!v.is<const char*>()) return false;
+  String *dst = nullptr;
+  if      (!strcmp(f, "host"))       dst = &mqttCfg.host;
+  else if (!strcmp(f, "user"))       dst = &mqttCfg.user;
+  else if (!strcmp(f, "pass"))       dst = &mqttCfg.pass;
+  else if (!strcmp(f, "cmdTopic"))   dst = &mqttCfg.cmdTopic;
+  else if (!strcmp(f, "stateTopic")) dst = &mqttCfg.stateTopic;
+  if (!dst) return false;
+  if (apply) *dst = v.as<const char*>();
+  return true;
+}
+
+// Parses op `o`; on success fills `kind` and (for control ops) `cop`.
+static const char* parseBatchOp(JsonObjectConst o, BatchKind &kind, ControlBatchOp &cop) {
+  const char* name = o["op"] | "";
+  kind = BK_CONTROL;
+  cop = { BATCH_STATUS, false, 0 };
+
+  if (!strcmp(name, "status")) return nullptr;
+  if (!strcmp(name, "toggle")) { cop.type = BATCH_TOGGLE; return nullptr; }
+  if (!strcmp(name, "set") || !strcmp(name, "pulse")) {
+    if (!o["state"].is<bool>()) return "bad_state";
+    cop.type = (name[0] == 's') ? BATCH_SET : BATCH_PULSE;
+    cop.value = o["state"].as<bool>();
+    if (cop.type == BATCH_PULSE) {
+      const long ms = o["ms"] | 0L;
+      if (ms < CONTROL_PULSE_MIN_MS || ms > CONTROL_PULSE_MAX_MS) return "bad_ms";
+      cop.ms = (uint16_t)ms;
+    }
+    return nullptr;
+  }
+  if (!strcmp(name, "config")) {
+    kind = BK_CONFIG;
+    return mqttCfgField(o["key"] | "", o["value"], false) ? nullptr : "bad_config";
+  }
+  return "bad_op";
+}
+
 // -------------------- WiFi --------------------
-static bool connectSTA(uint32_t timeoutMs = 20000) {
+static const uint32_t STA_JOIN_TIMEOUT_MS = 20000;
+static const uint32_t STA_POLL_MS = 20;
+static uint32_t staStartMs = 0;
+
+// Starts the join without waiting; waitSTA() collects the result, so
+// setup() can mount the FS and load config while the radio associates.
+static bool beginSTA() {
   if (!wifiCfg.ssid.length()) {
-    Serial.println("[WiFi] No SSID saved.");
+    LOGW("WiFi", "No SSID saved.");
     return false;
   }
 
-  Serial.println("[WiFi] connectSTA()");
-  Serial.println("[WiFi] Saved SSID = [" + wifiCfg.ssid + "]");
-  Serial.println("[WiFi] Saved PASS length = " + String(wifiCfg.pass.length()));
+  LOGI("WiFi", "Saved SSID = [%s]", wifiCfg.ssid.c_str());
+  LOGD("WiFi", "Saved PASS length = %u", (unsigned)wifiCfg.pass.length());
 
   WiFi.mode(WIFI_STA);
   WiFi.setHostname(mdnsHost.c_str());
   WiFi.setAutoReconnect(true);
 
-  // Reset previous state
-  WiFi.disconnect(true, true);
-  delay(200);
-
-  Serial.println("[WiFi] Connecting...");
+  LOGI("WiFi", "Connecting...");
   WiFi.begin(wifiCfg.ssid.c_str(), wifiCfg.pass.c_str());
+  staStartMs = millis();
+  return true;
+}
 
+static bool waitSTA(uint32_t timeoutMs) {
   wl_status_t last = WL_IDLE_STATUS;
-  uint32_t t0 = millis();
 
-  while (millis() - t0 < timeoutMs) {
+  while (millis() - staStartMs < timeoutMs) {
     wl_status_t st = WiFi.status();
     if (st != last) {
       last = st;
-      Serial.printf("[WiFi] status=%d (%s)\n", (int)st, wlStatusStr(st));
+      LOGD("WiFi", "status=%d (%s)", (int)st, wlStatusStr(st));
     }
     if (st == WL_CONNECTED) {
-      Serial.printf("[WiFi] Connected! IP=%s RSSI=%d\n",
+      LOGI("WiFi", "Connected in %lu ms, IP=%s RSSI=%d",
+                    (unsigned long)(millis() - staStartMs),
                     WiFi.localIP().toString().c_str(),
                     WiFi.RSSI());
       return true;
     }
-    delay(250);
+    delay(STA_POLL_MS);
   }
 
-  Serial.printf("[WiFi] Timeout. Final status=%d (%s)\n",
-                (int)WiFi.status(), wlStatusStr(WiFi.status()));
-  Serial.printf("[WiFi] RSSI (if any)=%d\n", WiFi.RSSI());
+  LOGW("WiFi", "Timeout. Final status=%d (%s)",
+       (int)WiFi.status(), wlStatusStr(WiFi.status()));
+  LOGW("WiFi", "RSSI (if any)=%d", WiFi.RSSI());
   return false;
 }
 
@@ -308,41 +804,137 @@ static void startAPPortal() {
   delay(200);
 
   const IPAddress ip = WiFi.softAPIP();
-  dns.start(DNS_PORT, "*", ip);
+  captiveDnsBegin(ip, DNS_PORT);
 
-  Serial.println("[AP] Mode SSID: " + apSsid);
-  Serial.println("[AP] IP: " + ip.toString());
+  LOGI("AP", "Mode SSID: %s", apSsid.c_str());
+  LOGI("AP", "IP: %s", ip.toString().c_str());
 }
 
 // -------------------- mDNS --------------------
+// _switchnode._tcp carries the node's identity and live state in TXT
+// records, so one browse shows the whole fleet without HTTP requests.
+static const uint32_t MDNS_TXT_MIN_INTERVAL_MS = 1000;   // each change is re-announced
+
+static bool mdnsUp = false;
+
+// Last advertised values (net task after setup)
+static struct {
+  int8_t relay = -1;
+  int8_t input = -1;
+  const char* mqtt = nullptr;
+} mdnsTxt;
+
+static const char* mqttStatusStr() {
+  if (!mqttLive.enabled) return "off";
+  return mqttUp.load() ? "up" : "down";
+}
+
+// Sets only the TXT keys whose value changed; at most once per
+// MDNS_TXT_MIN_INTERVAL_MS unless forced.
+static void mdnsUpdateTxt(bool force) {
+  static uint32_t lastMs = 0;
+  if (!mdnsUp) return;
+
+  const ControlSnapshot st = controlSnapshot();
+  const int8_t relay = st.relay;
+  const int8_t input = !st.inputOpen;
+  const char* mqttSt = mqttStatusStr();
+  if (relay == mdnsTxt.relay && input == mdnsTxt.input && mqttSt == mdnsTxt.mqtt) return;
+  if (!force && millis() - lastMs < MDNS_TXT_MIN_INTERVAL_MS) return;
+  lastMs = millis();
+
+  if (relay != mdnsTxt.relay) MDNS.addServiceTxt("switchnode", "tcp", "relay", relay ? "1" : "0");
+  if (input != mdnsTxt.input) MDNS.addServiceTxt("switchnode", "tcp", "input", input ? "1" : "0");
+  if (mqttSt != mdnsTxt.mqtt) MDNS.addServiceTxt("switchnode", "tcp", "mqtt", mqttSt);
+  mdnsTxt.relay = relay;
+  mdnsTxt.input = input;
+  mdnsTxt.mqtt = mqttSt;
+}
+
 static void startMDNS() {
   if (MDNS.begin(mdnsHost.c_str())) {
     MDNS.addService("http", "tcp", 80);
-    Serial.println("[mDNS] http://" + mdnsFqdn + "/");
+    MDNS.addService("switchnode", "tcp", 80);
+    MDNS.addServiceTxt("switchnode", "tcp", "id", deviceId.c_str());
+    MDNS.addServiceTxt("switchnode", "tcp", "fw", FW_VERSION);
+    MDNS.addServiceTxt("switchnode", "tcp", "ch", "1");
+    mdnsUp = true;
+    mdnsUpdateTxt(true);
+    LOGI("mDNS", "http://%s/ (+ _switchnode._tcp)", mdnsFqdn.c_str());
   } else {
-    Serial.println("[mDNS] start failed");
+    LOGE("mDNS", "start failed");
   }
 }
 
 // -------------------- MQTT --------------------
+// {"url":"http://host/firmware.bin","sha256":"<hex>","target":"app|fs"}
+// sha256 is mandatory. A retained request would re-run on every
+// reconnect, so only live ones are taken, and an image that is already
+// installed is not fetched again.
+static void mqttOtaRequest(const String &msg, bool retained) {
+  if (retained) {
+    LOGW("OTA", "retained MQTT request ignored");
+    return;
+  }
+  StaticJsonDocument<384> d;
+  if (deserializeJson(d, msg)) {
+    LOGW("OTA", "bad MQTT request");
+    return;
+  }
+  OtaTarget target;
+  if (!otaParseTarget(d["target"] | "app", target)) {
+    LOGW("OTA", "bad target");
+    return;
+  }
+  const char* sha = d["sha256"] | "";
+  if (strlen(sha) != 64) {
+    LOGW("OTA", "MQTT request without sha256 ignored");
+    return;
+  }
+  if (otaIsInstalled(target, sha)) {
+    LOGI("OTA", "image %.12s... already installed", sha);
+    return;
+  }
+  const char* err = nullptr;
+  if (!otaStartPull(target, d["url"] | "", sha, &err)) {
+    LOGW("OTA", "pull not started: %s", err ? err : "?");
+  }
+}
+
 static void mqttCallback(char* topic, byte* payload, unsigned int len) {
+  metricsInc(CNT_MQTT_RX);
+
   String msg;
   msg.reserve(len);
   for (unsigned int i = 0; i < len; i++) msg += (char)payload[i];
   msg.trim();
 
-  Serial.printf("[MQTT] RX topic=%s payload=%s\n", topic, msg.c_str());
+  LOGD("MQTT", "RX topic=%s payload=%s", topic, msg.c_str());
 
   if (String(topic) == topicCmd) {
-    if (msg.equalsIgnoreCase("ON") || msg == "1" || msg.equalsIgnoreCase("true")) setRelay(true);
-    if (msg.equalsIgnoreCase("OFF") || msg == "0" || msg.equalsIgnoreCase("false")) setRelay(false);
+    int on = -1;
+    if (msg.equalsIgnoreCase("ON") || msg == "1" || msg.equalsIgnoreCase("true")) on = 1;
+    if (msg.equalsIgnoreCase("OFF") || msg == "0" || msg.equalsIgnoreCase("false")) on = 0;
+    if (on >= 0) {
+      // The control task closes the span on the relay write; cancel only
+      // if the command never reached it (cancelling after a successful
+      // enqueue would race the control task).
+      PROBE_MARK(PROBE_MQTT_TO_GPIO);
+      if (!controlSetRelay(on == 1, SRC_MQTT)) PROBE_CANCEL(PROBE_MQTT_TO_GPIO);
+    }
+  } else if (String(topic) == topicOta) {
+    // PubSubClient drops the retain flag; it is bit 0 of the fixed header
+    // still at the start of its buffer.
+    mqttOtaRequest(msg, (mqtt.getBuffer()[0] & 0x01) != 0);
+  } else if (String(topic) == topicEvent) {
+    controlRuleMessage(msg.c_str(), msg.length());
   }
 }
 
 static bool mqttReady() {
-  if (!mqttCfg.enabled) return false;
-  if (!mqttCfg.host.length()) return false;
-  if (!mqttCfg.cmdTopic.length()) return false;
+  if (!mqttLive.enabled) return false;
+  if (!mqttLive.host.length()) return false;
+  if (!mqttLive.cmdTopic.length()) return false;
   return true;
 }
 
@@ -350,9 +942,9 @@ static void mqttEnsureConnected() {
   if (WiFi.status() != WL_CONNECTED) return;
 
   // Hard OFF when disabled
-  if (!mqttCfg.enabled) {
+  if (!mqttLive.enabled) {
     if (mqtt.connected()) {
-      Serial.println("[MQTT] Disabled -> disconnect");
+      LOGI("MQTT", "Disabled -> disconnect");
       mqtt.disconnect();
     }
     return;
@@ -361,61 +953,437 @@ static void mqttEnsureConnected() {
   if (!mqttReady()) return;
   if (mqtt.connected()) return;
 
-  mqtt.setServer(mqttCfg.host.c_str(), mqttCfg.port);
+  mqtt.setServer(mqttLive.host.c_str(), mqttLive.port);
   mqtt.setCallback(mqttCallback);
+  mqtt.setBufferSize(MQTT_BUFFER_SIZE);   // OTA requests carry a URL + SHA-256
 
   const String clientId = mdnsHost + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
 
-  Serial.printf("[MQTT] Connecting to %s:%u user=%s\n",
-                mqttCfg.host.c_str(),
-                mqttCfg.port,
-                mqttCfg.user.length() ? mqttCfg.user.c_str() : "(none)");
+  LOGI("MQTT", "Connecting to %s:%u user=%s",
+       mqttLive.host.c_str(),
+       mqttLive.port,
+       mqttLive.user.length() ? mqttLive.user.c_str() : "(none)");
+
+  metricsInc(CNT_MQTT_CONNECT_ATTEMPTS);
 
   bool ok;
-  if (mqttCfg.user.length()) ok = mqtt.connect(clientId.c_str(), mqttCfg.user.c_str(), mqttCfg.pass.c_str());
+  if (mqttLive.user.length()) ok = mqtt.connect(clientId.c_str(), mqttLive.user.c_str(), mqttLive.pass.c_str());
   else                       ok = mqtt.connect(clientId.c_str());
 
+  metricsInc(ok ? CNT_MQTT_CONNECTS : CNT_MQTT_CONNECT_FAILS);
+
   if (ok) {
-    Serial.println("[MQTT] Connected.");
+    LOGI("MQTT", "Connected.");
     mqtt.subscribe(topicCmd.c_str());
-    Serial.printf("[MQTT] Subscribed: %s\n", topicCmd.c_str());
+    mqtt.subscribe(topicOta.c_str());
+    mqtt.subscribe(topicEvent.c_str());
+    LOGI("MQTT", "Subscribed: %s, %s, %s", topicCmd.c_str(), topicOta.c_str(), topicEvent.c_str());
 
-    mqtt.publish(topicState.c_str(), relayState ? "ON" : "OFF", true);
-    Serial.printf("[MQTT] Published retained state: %s=%s\n", topicState.c_str(), relayState ? "ON" : "OFF");
+    const bool on = controlRelayState();
+    mqttPublish(topicState.c_str(), on ? "ON" : "OFF", true);
+    LOGD("MQTT", "Published retained state: %s=%s", topicState.c_str(), on ? "ON" : "OFF");
 
-    publishInputOpenBool(in_stable == HIGH);
+    publishInputOpenBool(controlInputOpen());
   } else {
-    Serial.printf("[MQTT] Connect failed, rc=%d\n", mqtt.state());
+    LOGW("MQTT", "Connect failed, rc=%d", mqtt.state());
+  }
+}
+
+// Net task: picks up config saved by /api/mqtt and forces a reconnect.
+static void mqttApplyPendingCfg() {
+  if (!mqttCfgDirty.exchange(false)) return;
+  {
+    CfgLock lock;
+    mqttLive = mqttCfg;
+    applyTopics();
+  }
+  statusMetaGen.fetch_add(1);
+  if (mqtt.connected()) mqtt.disconnect(); // force reconnect with new params
+}
+
+// -------------------- Status --------------------
+static const uint32_t STATUS_WAIT_MAX_MS = 25000;
+
+static void buildStatus(JsonDocument &d, const ControlSnapshot &st) {
+  d["ok"] = true;
+  d["ip"] = WiFi.localIP().toString();
+  d["mdns"] = mdnsFqdn;
+  d["fw"] = FW_VERSION;
+  d["rssi"] = WiFi.RSSI();
+  d["relay"] = st.relay;
+  d["input_pressed"] = !st.inputOpen;
+  d["version"] = st.version;
+  d["mqtt_connected"] = mqttUp.load();
+  {
+    CfgLock lock;
+    d["mqtt_enabled"] = mqttCfg.enabled;
+    d["cmd_topic"] = mqttCfg.cmdTopic;
+    d["state_topic"] = topicState;
+    d["din_topic"] = topicDin;
+  }
+}
+
+// Weak: RSSI and IP may differ between two replies with the same tag.
+static String statusEtag(const ControlSnapshot &st) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "W/\"%lu.%lu\"", (unsigned long)st.version, (unsigned long)statusMetaGen.load());
+  return String(buf);
+}
+
+struct BytePrint : Print {
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t b) override { bytes.push_back(b); return 1; }
+  size_t write(const uint8_t *b, size_t n) override { bytes.insert(bytes.end(), b, b + n); return n; }
+};
+
+// -------------------- Status long-poll --------------------
+// A parked long-poll keeps its request open with a response that sends
+// nothing until the net task completes it: right after it drains a
+// control event, or at the deadline. The reply is written straight to
+// the socket (the net task already feeds SSE clients the same way);
+// acks and the close are handled on the async_tcp task as usual.
+// Parked polls have their own cap and leave the connection guard.
+static const uint8_t STATUS_POLL_MAX = 4;
+
+class StatusPollResponse;
+static StatusPollResponse* statusPolls[STATUS_POLL_MAX];
+static SemaphoreHandle_t statusPollLock = nullptr;   // statusPolls and completion
+
+class StatusPollResponse : public AsyncWebServerResponse {
+public:
+  StatusPollResponse(AsyncClient* c, uint32_t since, uint32_t deadlineMs, bool cbor)
+      : _client(c), _since(since), _deadlineMs(deadlineMs), _cbor(cbor) {
+    _code = 200;
+  }
+
+  ~StatusPollResponse() override {
+    xSemaphoreTake(statusPollLock, portMAX_DELAY);
+    for (StatusPollResponse* &p : statusPolls) {
+      if (p == this) p = nullptr;
+    }
+    xSemaphoreGive(statusPollLock);
+  }
+
+  bool _sourceValid() const override { return true; }
+  void _respond(AsyncWebServerRequest*) override { _state = RESPONSE_WAIT_ACK; }
+
+  // async_tcp task: acks (and polls, len 0) of what complete() wrote.
+  size_t _ack(AsyncWebServerRequest *r, size_t len, uint32_t) override {
+    _ackedLength += len;
+    const size_t sent = _sent.load(std::memory_order_acquire);
+    if (sent && _ackedLength >= sent) {
+      _state = RESPONSE_END;
+      r->client()->close(true);
+    }
+    return 0;
+  }
+
+  uint32_t since() const { return _since; }
+  uint32_t deadlineMs() const { return _deadlineMs; }
+
+  // Net task, statusPollLock held. False if the socket cannot take the
+  // reply yet (retried on the next tick).
+  bool complete(const ControlSnapshot &st, bool changed) {
+    StaticJsonDocument<704> d;
+    buildStatus(d, st);
+    d["changed"] = changed;
+    d["etag"] = statusEtag(st);
+    BytePrint body;
+    if (_cbor) serializeCbor(d, body);
+    else serializeJson(d, body);
+
+    char head[160];
+    const int n = snprintf(head, sizeof(head),
+        "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+        "Cache-Control: no-cache\r\nConnection: close\r\n\r\n",
+        _cbor ? CT_CBOR : "application/json", (unsigned)body.bytes.size());
+    BytePrint out;
+    out.bytes.reserve(n + body.bytes.size());
+    out.write((const uint8_t*)head, n);
+    out.write(body.bytes.data(), body.bytes.size());
+
+    if (_client->space() < out.bytes.size()) return false;
+    if (_client->write((const char*)out.bytes.data(), out.bytes.size()) != out.bytes.size()) return false;
+    _sent.store(out.bytes.size(), std::memory_order_release);
+    return true;
+  }
+
+private:
+  AsyncClient* _client;
+  uint32_t _since;
+  uint32_t _deadlineMs;
+  bool _cbor;
+  std::atomic<size_t> _sent{0};
+};
+
+// async_tcp task. False when STATUS_POLL_MAX polls are already parked.
+static bool statusPollPark(AsyncWebServerRequest *r, uint32_t since, uint32_t wait) {
+  xSemaphoreTake(statusPollLock, portMAX_DELAY);
+  StatusPollResponse** slot = nullptr;
+  for (StatusPollResponse* &p : statusPolls) {
+    if (!p) { slot = &p; break; }
+  }
+  if (slot) *slot = new StatusPollResponse(r->client(), since, millis() + wait, acceptsCbor(r));
+  StatusPollResponse* resp = slot ? *slot : nullptr;
+  xSemaphoreGive(statusPollLock);
+  if (!resp) return false;
+
+  connGuard.release(r->client());   // bounded by STATUS_POLL_MAX instead
+  r->client()->setRxTimeout(wait / 1000 + 5);
+  r->send(resp);
+  return true;
+}
+
+// Net task: completes polls whose version moved or whose wait expired.
+// Runs right after drainControlEvents(), so a change is answered within
+// one wake-up of the net task.
+static void statusPollStep() {
+  const ControlSnapshot st = controlSnapshot();
+  const uint32_t now = millis();
+  xSemaphoreTake(statusPollLock, portMAX_DELAY);
+  for (StatusPollResponse* &p : statusPolls) {
+    if (!p) continue;
+    const bool changed = (st.version != p->since());
+    if (!changed && (int32_t)(now - p->deadlineMs()) < 0) continue;
+    if (p->complete(st, changed)) p = nullptr;
+  }
+  xSemaphoreGive(statusPollLock);
+}
+
+// -------------------- History export --------------------
+static const size_t HISTORY_READ_BATCH = 16;
+
+// Cursor of one /api/history response, filled chunk by chunk.
+struct HistoryExport {
+  uint32_t after;          // last seq consumed
+  uint32_t from, to;       // sec range [from, to)
+  uint32_t left;           // events still allowed by ?limit
+  bool     bin;
+  uint8_t  phase = 0;      // 0 header, 1 events, 2 trailer, 3 done
+  bool     first = true;
+  HistEncoder enc = {};
+};
+
+static size_t historyJsonEntry(const HistEntry &e, bool first, char *out, size_t cap) {
+  const int n = snprintf(out, cap,
+      "%s{\"seq\":%lu,\"t\":%lu,\"ms\":%u,\"boot\":%u,\"type\":\"%s\",\"src\":\"%s\",\"old\":%s,\"new\":%s%s}",
+      first ? "" : ",", (unsigned long)e.seq, (unsigned long)e.sec, e.ms, e.boot,
+      e.type == EV_INPUT ? "input" : "relay", relaySourceStr(e.source),
+      (e.flags & HIST_OLD) ? "true" : "false", (e.flags & HIST_NEW) ? "true" : "false",
+      (e.flags & HIST_UPTIME) ? ",\"uptime\":true" : "");
+  return (n > 0 && (size_t)n < cap) ? (size_t)n : 0;
+}
+
+static size_t fillHistory(HistoryExport &x, uint8_t *buf, size_t maxLen) {
+  size_t n = 0;
+  char tmp[192];
+
+  if (x.phase == 0) {
+    size_t len;
+    if (x.bin) {
+      memcpy(tmp, HISTORY_BIN_MAGIC, sizeof(HISTORY_BIN_MAGIC));
+      len = sizeof(HISTORY_BIN_MAGIC);
+    } else {
+      const HistStats s = historyStats();
+      len = snprintf(tmp, sizeof(tmp),
+                     "{\"ok\":true,\"boot\":%u,\"clock\":%s,\"oldest\":%lu,\"flushed\":%lu,\"events\":[",
+                     s.boot, s.clockSet ? "true" : "false", (unsigned long)s.oldest, (unsigned long)s.flushed);
+    }
+    if (len > maxLen) return 0;
+    memcpy(buf, tmp, len);
+    n = len;
+    x.phase = 1;
+  }
+
+  while (x.phase == 1) {
+    HistEntry batch[HISTORY_READ_BATCH];
+    const size_t got = historyRead(x.after, batch, HISTORY_READ_BATCH);
+    if (!got || !x.left) { x.phase = 2; break; }
+
+    size_t i = 0;
+    for (; i < got && x.left; i++) {
+      const HistEntry &e = batch[i];
+      if (e.sec >= x.from && e.sec < x.to) {
+        size_t len;
+        if (x.bin) {
+          HistEncoder enc = x.enc;
+          len = historyEncode(enc, e, (uint8_t*)tmp);
+          if (n + len > maxLen) break;
+          x.enc = enc;
+        } else {
+          len = historyJsonEntry(e, x.first, tmp, sizeof(tmp));
+          if (n + len > maxLen) break;
+          x.first = false;
+        }
+        memcpy(buf + n, tmp, len);
+        n += len;
+        x.left--;
+      }
+      x.after = e.seq;
+    }
+    if (i < got && x.left) return n;   // buffer full; resume at x.after
   }
+
+  if (x.phase == 2) {
+    if (!x.bin) {
+      const size_t len = snprintf(tmp, sizeof(tmp), "],\"next\":%lu}", (unsigned long)x.after);
+      if (n + len > maxLen) return n;
+      memcpy(buf + n, tmp, len);
+      n += len;
+    }
+    x.phase = 3;
+  }
+  return n;
+}
+
+// -------------------- Input trace --------------------
+// Text dump of a finished capture (format in inputtrace.h).
+struct TraceExport {
+  uint32_t next = 0;   // next edge index
+  bool     header = true;
+};
+
+static size_t fillTrace(TraceExport &x, uint8_t *buf, size_t maxLen) {
+  size_t n = 0;
+  char tmp[192];
+
+  if (x.header) {
+    const TraceInfo t = traceInfo();
+    const DebounceCfg c = controlDebounce();
+    const int len = snprintf(tmp, sizeof(tmp),
+        "# switchnode input trace\npin=%d\nperiod_us=%u\nlevel=%u\nsamples=%lu\nedges=%lu\noverflow=%d\n"
+        "debounce=%s/%u\n",
+        INPUT_PIN, t.periodUs, t.level, (unsigned long)t.samples, (unsigned long)t.edges, t.overflow ? 1 : 0,
+        debounceAlgoName(c.algo), c.ms);
+    if (len <= 0 || (size_t)len > maxLen) return 0;
+    memcpy(buf, tmp, len);
+    n = len;
+    x.header = false;
+  }
+
+  uint32_t batch[32];
+  for (;;) {
+    const size_t got = traceEdges(x.next, batch, 32);
+    size_t i = 0;
+    for (; i < got; i++) {
+      const int len = snprintf(tmp, sizeof(tmp), "%lu\n", (unsigned long)batch[i]);
+      if (n + len > maxLen) break;
+      memcpy(buf + n, tmp, len);
+      n += len;
+    }
+    x.next += i;
+    if (!got || i < got) return n;
+  }
+}
+
+// -------------------- OTA upload --------------------
+// Per-request upload state (freed by the server with the request).
+struct OtaUpload {
+  bool owner;   // this request holds the OTA session
+  bool busy;    // another session was running
+};
+
+static void otaStatusDoc(JsonDocument &d) {
+  const OtaStatus st = otaStatus();
+  d["ok"] = true;
+  d["state"] = otaStateStr(st.state);
+  d["target"] = otaTargetStr(st.target);
+  d["source"] = st.source;
+  if (st.encoding[0]) d["encoding"] = st.encoding;
+  d["written"] = st.written;
+  d["received"] = st.received;
+  d["total"] = st.total;
+  d["elapsed_ms"] = st.elapsedMs;
+  d["bytes_per_sec"] = st.bytesPerSec;
+  if (st.error[0]) d["error"] = st.error;
+  if (st.sha256[0]) d["sha256"] = st.sha256;
+}
+
+static OtaUpload* otaUploadStart(AsyncWebServerRequest *r, size_t total) {
+  connGuard.hold(r->client());   // a slow upload is still progress
+  OtaUpload *u = (OtaUpload*)calloc(1, sizeof(OtaUpload));
+  r->_tempObject = u;
+  if (!u || !authOK(r)) return u;
+
+  OtaTarget target;
+  const String t = r->hasParam("target") ? r->getParam("target")->value() : String("app");
+  if (!otaParseTarget(t.c_str(), target)) return u;
+  const String sha = r->hasParam("sha256") ? r->getParam("sha256")->value() : String();
+
+  u->busy = (otaStatus().state == OTA_RUNNING);
+  u->owner = !u->busy && otaBegin(target, total, sha.c_str(), "upload");
+  return u;
+}
+
+// Raw body (curl --data-binary @firmware.bin)
+static void otaBodyChunk(AsyncWebServerRequest *r, uint8_t *data, size_t len, size_t index, size_t total) {
+  OtaUpload *u = index == 0 ? otaUploadStart(r, total) : (OtaUpload*)r->_tempObject;
+  if (!u || !u->owner) return;
+  if (!otaWrite(data, len)) { u->owner = false; return; }
+  if (index + len == total) u->owner = otaEnd();
+}
+
+// Multipart form (browser file input); size is unknown up front
+static void otaUploadChunk(AsyncWebServerRequest *r, const String &filename, size_t index,
+                           uint8_t *data, size_t len, bool final) {
+  OtaUpload *u = index == 0 ? otaUploadStart(r, 0) : (OtaUpload*)r->_tempObject;
+  if (!u || !u->owner) return;
+  if (!otaWrite(data, len)) { u->owner = false; return; }
+  if (final) u->owner = otaEnd();
 }
 
 // -------------------- Web routes --------------------
+// Captive-portal probe URLs (Android, Apple, Windows, Firefox, ChromeOS).
+// All get the same redirect to the portal.
+static const char* const AP_PROBE_PATHS[] = {
+  "/generate_204", "/gen_204", "/hotspot-detect.html", "/library/test/success.html",
+  "/connecttest.txt", "/ncsi.txt", "/redirect", "/fwlink", "/canonical.html",
+  "/success.txt", "/ncc.txt", "/chromehotstart.crx",
+};
+
+static RouteTable apRoutes;
+static String apPortalUrl;          // "http://<ap ip>/", built once
+static uint8_t* apPage = nullptr;   // ap.html cached in RAM
+static size_t apPageLen = 0;
+
+static void loadPortalPage() {
+  File f = LittleFS.open("/www/ap.html", "r");
+  if (!f) {
+    LOGE("AP", "ap.html missing");
+    return;
+  }
+  const size_t len = f.size();
+  apPage = (uint8_t*)malloc(len);
+  if (apPage && f.read(apPage, len) == len) {
+    apPageLen = len;
+    LOGI("AP", "portal page cached (%u bytes)", (unsigned)len);
+  } else {
+    free(apPage);
+    apPage = nullptr;
+    LOGW("AP", "portal page not cached, serving from LittleFS");
+  }
+  f.close();
+}
+
+static void sendPortalPage(AsyncWebServerRequest *r) {
+  if (apPage) r->send_P(200, "text/html", apPage, apPageLen);
+  else r->send(LittleFS, "/www/ap.html", "text/html");
+}
+
 static void setupRoutes_AP() {
-  // Captive portal probe endpoints (avoid LittleFS "open()" errors)
-  server.on("/connecttest.txt", HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/ncc.txt",         HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/generate_204",    HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/hotspot-detect.html", HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/fwlink",          HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/canonical.html",  HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/success.txt",     HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/library/test/success.html", HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/redirect",        HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/ncsi.txt",        HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  server.on("/chromehotstart.crx", HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect("/"); });
-  
-  // Handle any .txt or .crx files
-  server.onNotFound([](AsyncWebServerRequest *r){
-    r->redirect("/");
-  });
+  apPortalUrl = "http://" + WiFi.softAPIP().toString() + "/";
+  loadPortalPage();
 
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *r){
-    r->send(LittleFS, "/www/ap.html", "text/html");
-  });
+  // Probes: precomputed redirect, no filesystem access
+  for (const char* path : AP_PROBE_PATHS) {
+    apRoutes.add(path, HTTP_ANY, [](AsyncWebServerRequest *r){ r->redirect(apPortalUrl); });
+  }
+
+  apRoutes.add("/", HTTP_GET, sendPortalPage);
 
   // WiFi scan endpoint
-  server.on("/api/scan", HTTP_GET, [](AsyncWebServerRequest *r){
-    Serial.println("[AP] Scanning WiFi networks...");
+  apRoutes.add("/api/scan", HTTP_GET, [](AsyncWebServerRequest *r){
+    LOGI("AP", "Scanning WiFi networks...");
     int n = WiFi.scanNetworks();
     String json = "{\"networks\":[";
     
@@ -431,45 +1399,43 @@ static void setupRoutes_AP() {
     WiFi.scanDelete();
   });
 
-  // Add this after the /api/scan endpoint, before /api/wifi
-  server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *r){
-    // In AP mode, just return the device ID and mDNS info
+  // In AP mode, just return the device ID and mDNS info
+  apRoutes.add("/api/status", HTTP_GET, [](AsyncWebServerRequest *r){
     String json = "{\"ok\":true,\"mdns\":\"" + mdnsFqdn + "\"}";
     r->send(200, "application/json", json);
   });
 
-  server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *r){
-    Serial.println("[AP] /api/wifi POST received");
-    
-    // Log all parameters received
+  apRoutes.add("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *r){
+    LOGI("AP", "/api/wifi POST received");
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+    // Log all parameters received (values of secrets are never printed)
     int params = r->params();
-    Serial.printf("[AP] Number of params: %d\n", params);
+    LOGD("AP", "Number of params: %d", params);
     for (int i = 0; i < params; i++) {
         AsyncWebParameter* p = r->getParam(i);
         if (p->isPost()) {
-            Serial.printf("[AP] POST param: %s = %s\n", 
-                p->name().c_str(), 
-                p->value().c_str());
+            const bool secret = (p->name() == "pass");
+            LOGD("AP", "POST param: %s = %s",
+                 p->name().c_str(),
+                 secret ? "***" : p->value().c_str());
         }
     }
-    
+#endif
+
     auto v = [&](const char* k)->String{
-        if (r->hasParam(k, true)) {
-            String val = r->getParam(k, true)->value();
-            Serial.printf("[AP] Found param %s = %s\n", k, val.c_str());
-            return val;
-        }
-        Serial.printf("[AP] Param %s not found!\n", k);
+        if (r->hasParam(k, true)) return r->getParam(k, true)->value();
+        LOGW("AP", "Param %s not found!", k);
         return "";
     };
 
     const String ssid = v("ssid");
     const String pass = v("pass");
 
-    Serial.println("[AP] /api/wifi POST ssid=[" + ssid + "] passLen=" + String(pass.length()));
+    LOGI("AP", "/api/wifi POST ssid=[%s] passLen=%u", ssid.c_str(), (unsigned)pass.length());
 
     if (!ssid.length()) {
-        Serial.println("[AP] ERROR: ssid required but not provided");
+        LOGE("AP", "ssid required but not provided");
         r->send(400, "application/json", "{\"ok\":false,\"err\":\"ssid_required\"}");
         return;
     }
@@ -478,89 +1444,200 @@ static void setupRoutes_AP() {
     wifiCfg.pass = pass;
     saveWifiCfg();
     
-    Serial.println("[AP] WiFi credentials saved, sending response and rebooting...");
+    LOGI("AP", "WiFi credentials saved, sending response and rebooting...");
     r->send(200, "application/json", "{\"ok\":true,\"reboot\":true}");
     
     // Flush the response before rebooting
     delay(500);
-    Serial.println("[AP] Rebooting now...");
+    LOGI("AP", "Rebooting now...");
+    logFlush();
     ESP.restart();
   });
 
-  server.onNotFound([](AsyncWebServerRequest *r){
-    r->send(LittleFS, "/www/ap.html", "text/html");
-  });
+  // Anything else is the portal page (served from RAM)
+  apRoutes.setFallback(sendPortalPage);
 
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *r){
-    r->send(LittleFS, "/www/ap.html", "text/html");
-  });
-
-  server.serveStatic("/", LittleFS, FS_ROOT); // AP is open
+  server.addHandler(&apRoutes);
   server.begin();
 
-  Serial.println("[AP] Web server started (open).");
+  LOGI("AP", "Web server started (open, %u routes).", apRoutes.size());
 }
 
 static void setupRoutes_STA() {
-  server.on("/", HTTP_GET, [](AsyncWebServerRequest *r){
-    if (!requireAuthOr401(r)) return;
-    r->send(LittleFS, "/www/index.html", "text/html");
-  });
-
-  server.on("/settings", HTTP_GET, [](AsyncWebServerRequest *r){
-    if (!requireAuthOr401(r)) return;
-    r->send(LittleFS, "/www/settings.html", "text/html");
-  });
-
-  // Static under auth
+  // Must be the first handler: it vets every request before routing.
+  connGuard.addStreamingPrefix("/api/logs");
+  server.addHandler(&connGuard);
+  metricsSetHttpActive([]() -> uint8_t { return connGuard.active(); });
+
+  server.on("/", HTTP_GET, timed("GET /", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r) || !fsReadyOr503(r)) return;
+    sendTimed(r, r->beginResponse(LittleFS, "/www/index.html", "text/html"));
+  }));
+
+  server.on("/settings", HTTP_GET, timed("GET /settings", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r) || !fsReadyOr503(r)) return;
+    sendTimed(r, r->beginResponse(LittleFS, "/www/settings.html", "text/html"));
+  }));
+
+  // Static under auth; while the FS is offline the not-found handler answers
   {
     auto &h = server.serveStatic("/", LittleFS, FS_ROOT);
     h.setFilter([](AsyncWebServerRequest *r){
-      return authOK(r);
+      return authOK(r) && !otaFsOffline();
     });
   }
+  server.onNotFound([](AsyncWebServerRequest *r){
+    if (!fsReadyOr503(r)) return;
+    sendTimed(r, 404, "text/plain", "Not found");
+  });
 
-  // Status
-  server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *r){
+  // Status: conditional GET (ETag) + long-poll (?since=<version>&wait=<ms>)
+  server.on("/api/status", HTTP_GET, timed("GET /api/status", [](AsyncWebServerRequest *r){
     if (!requireAuthOr401(r)) return;
 
-    StaticJsonDocument<640> d;
-    d["ok"] = true;
-    d["ip"] = WiFi.localIP().toString();
-    d["mdns"] = mdnsFqdn;
-    d["rssi"] = WiFi.RSSI();
-    d["relay"] = relayState;
-    d["input_pressed"] = (in_stable == LOW);
-    d["mqtt_enabled"] = mqttCfg.enabled;
-    d["mqtt_connected"] = mqtt.connected();
-    d["cmd_topic"] = mqttCfg.cmdTopic;
-    d["state_topic"] = topicState;
-    d["din_topic"] = topicDin;
+    const ControlSnapshot st = controlSnapshot();
 
-    String out;
-    serializeJson(d, out);
-    r->send(200, "application/json", out);
-  });
+    if (r->hasParam("since") && r->hasParam("wait")) {
+      const uint32_t since = (uint32_t)strtoul(r->getParam("since")->value().c_str(), nullptr, 10);
+      uint32_t wait = (uint32_t)r->getParam("wait")->value().toInt();
+      if (wait > STATUS_WAIT_MAX_MS) wait = STATUS_WAIT_MAX_MS;
+
+      if (since == st.version && wait > 0) {
+        if (!statusPollPark(r, since, wait)) {
+          AsyncWebServerResponse *resp = r->beginResponse(503, "application/json", "{\"ok\":false,\"err\":\"busy\"}");
+          resp->addHeader("Retry-After", "2");
+          sendTimed(r, resp);
+        }
+        return;
+      }
+    }
+
+    const String etag = statusEtag(st);
+    if (r->hasHeader("If-None-Match") && r->header("If-None-Match") == etag) {
+      AsyncWebServerResponse *resp = r->beginResponse(304);
+      resp->addHeader("ETag", etag);
+      sendTimed(r, resp);
+      return;
+    }
+
+    StaticJsonDocument<640> d;
+    buildStatus(d, st);
+    sendDocTagged(r, d, etag);
+  }));
 
   // Relay set
-  server.on("/api/relay", HTTP_POST, [](AsyncWebServerRequest *r){
+  server.on("/api/relay", HTTP_POST, timed("POST /api/relay", [](AsyncWebServerRequest *r){
     if (!requireAuthOr401(r)) return;
 
-    if (!r->hasParam("state", true)) {
-      r->send(400, "application/json", "{\"ok\":false,\"err\":\"missing_state\"}");
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+    if (!a.has("state")) { sendResult(r, 400, "missing_state"); return; }
+
+    const String s = a.get("state");
+    const bool on = (s == "1" || s.equalsIgnoreCase("on") || s.equalsIgnoreCase("true"));
+    if (!controlSetRelay(on, SRC_WEB)) {
+      sendResult(r, 503, "busy");
       return;
     }
-    const String s = r->getParam("state", true)->value();
-    const bool on = (s == "1" || s.equalsIgnoreCase("on") || s.equalsIgnoreCase("true"));
-    setRelay(on);
-    r->send(200, "application/json", "{\"ok\":true}");
-  });
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Batch: {"ops":[{"op":"set","state":true},{"op":"pulse","state":true,"ms":500},
+  //   {"op":"toggle"},{"op":"status"},{"op":"config","key":"mqtt.host","value":"..."}]}
+  // Every op is validated before any runs, then ops run in the order given:
+  // each run of consecutive relay/status ops is one control-task batch,
+  // config ops are applied between them. Stops at the first op that fails;
+  // results report what actually ran.
+  server.on("/api/batch", HTTP_POST, timed("POST /api/batch", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    DynamicJsonDocument req(BATCH_DOC_SIZE);
+    if (!parseBody(r, req)) { sendResult(r, 400, "bad_body"); return; }
+    JsonArrayConst ops = req["ops"];
+    if (ops.isNull() || ops.size() == 0 || ops.size() > CONTROL_BATCH_MAX) {
+      sendResult(r, 400, "bad_ops");
+      return;
+    }
+
+    const uint8_t n = (uint8_t)ops.size();
+    BatchKind kinds[CONTROL_BATCH_MAX];
+    ControlBatchOp cops[CONTROL_BATCH_MAX];
+
+    for (uint8_t i = 0; i < n; i++) {
+      const char* err = parseBatchOp(ops[i], kinds[i], cops[i]);
+      if (err) {
+        StaticJsonDocument<96> d;
+        d["ok"] = false;
+        d["err"] = err;
+        d["index"] = i;
+        sendDoc(r, 400, d);
+        return;
+      }
+    }
+
+    ControlSnapshot snaps[CONTROL_BATCH_MAX];
+    const char* errs[CONTROL_BATCH_MAX] = {};
+    uint8_t done = 0;   // ops that ran (successfully), in order
+    bool cfgChanged = false;
+    const char* failed = nullptr;
+
+    while (done < n && !failed) {
+      if (kinds[done] == BK_CONFIG) {
+        CfgLock lock;
+        if (mqttCfgField(ops[done]["key"], ops[done]["value"], true)) {
+          cfgChanged = true;
+          done++;
+        } else {
+          failed = errs[done] = "bad_config";
+        }
+        continue;
+      }
+      uint8_t end = done;
+      while (end < n && kinds[end] == BK_CONTROL) end++;
+      if (controlRunBatch(cops + done, end - done, SRC_WEB, snaps + done, BATCH_TIMEOUT_MS)) {
+        done = end;
+      } else {
+        failed = errs[done] = "busy";   // none of this run executed
+      }
+    }
+
+    if (cfgChanged) {
+      CfgLock lock;
+      saveMqttCfg();
+      mqttCfgDirty.store(true);
+    }
+
+    DynamicJsonDocument d(BATCH_DOC_SIZE);
+    d["ok"] = !failed;
+    if (failed) d["err"] = failed;
+    d["done"] = done;
+    JsonArray res = d.createNestedArray("results");
+    for (uint8_t i = 0; i < n; i++) {
+      JsonObject o = res.createNestedObject();
+      o["op"] = ops[i]["op"];
+      o["ok"] = (i < done);
+      if (i >= done) {
+        o["err"] = errs[i] ? errs[i] : "not_run";
+        continue;
+      }
+      if (kinds[i] == BK_CONFIG) {
+        o["key"] = ops[i]["key"];
+        continue;
+      }
+      const ControlSnapshot &st = snaps[i];
+      o["relay"] = st.relay;
+      o["input_pressed"] = !st.inputOpen;
+      o["version"] = st.version;
+    }
+    sendDoc(r, !failed ? 200 : (strcmp(failed, "busy") ? 400 : 503), d);
+  }), nullptr, collectBatchBody);
 
   // MQTT GET (masked)
-  server.on("/api/mqtt", HTTP_GET, [](AsyncWebServerRequest *r){
+  server.on("/api/mqtt", HTTP_GET, timed("GET /api/mqtt", [](AsyncWebServerRequest *r){
     if (!requireAuthOr401(r)) return;
 
     StaticJsonDocument<520> d;
+    CfgLock lock;
     d["ok"] = true;
     d["enabled"] = mqttCfg.enabled;
     d["host"] = mqttCfg.host;
@@ -570,51 +1647,601 @@ static void setupRoutes_STA() {
     d["cmdTopic"] = mqttCfg.cmdTopic;
     d["stateTopic"] = mqttCfg.stateTopic;
 
-    String out;
-    serializeJson(d, out);
-    r->send(200, "application/json", out);
-  });
+    sendDoc(r, 200, d);
+  }));
 
   // MQTT POST
-  server.on("/api/mqtt", HTTP_POST, [](AsyncWebServerRequest *r){
+  server.on("/api/mqtt", HTTP_POST, timed("POST /api/mqtt", [](AsyncWebServerRequest *r){
     if (!requireAuthOr401(r)) return;
 
-    auto v = [&](const char* k)->String{
-      if (r->hasParam(k, true)) return r->getParam(k, true)->value();
-      return "";
-    };
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+    auto v = [&](const char* k)->String{ return a.get(k); };
 
     const String enS = v("enabled");
-    mqttCfg.enabled = (enS == "1" || enS.equalsIgnoreCase("true") || enS.equalsIgnoreCase("on"));
+    long p = v("port").toInt();
+    if (p <= 0 || p > 65535) p = 1883;
+    const String pass = v("pass");
+
+    {
+      CfgLock lock;
+      mqttCfg.enabled = (enS == "1" || enS.equalsIgnoreCase("true") || enS.equalsIgnoreCase("on"));
+      mqttCfg.host = v("host");
+      mqttCfg.port = (uint16_t)p;
+      mqttCfg.user = v("user");
+      if (pass.length()) mqttCfg.pass = pass;
+      mqttCfg.cmdTopic = v("cmdTopic");
+      mqttCfg.stateTopic = v("stateTopic");
+      saveMqttCfg();
+    }
+
+    // The net task owns PubSubClient: it applies topics and reconnects
+    mqttCfgDirty.store(true);
+
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Metrics (Prometheus text exposition)
+  server.on("/metrics", HTTP_GET, timed("GET /metrics", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    String out;
+    metricsRender(out, wifiDiscReasonStr);
+    sendTimed(r, 200, "text/plain; version=0.0.4", out);
+  }));
 
-    mqttCfg.host = v("host");
+  // Latency probes
+  server.on("/api/latency", HTTP_GET, timed("GET /api/latency", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    DynamicJsonDocument d(3072);
+    d["ok"] = true;
+    d["enabled"] = (bool)PROBES_ENABLED;
+    JsonArray probes = d.createNestedArray("probes");
+    for (uint8_t i = 0; i < PROBE__COUNT; i++) {
+      const LatencyHistogram &h = probeHistogram(i);
+      JsonObject p = probes.createNestedObject();
+      p["name"] = probeName(i);
+      p["count"] = h.count();
+      p["mean_us"] = h.count() ? (uint32_t)(h.sumUs() / h.count()) : 0;
+      p["p50_us"] = h.percentileUs(0.50f);
+      p["p90_us"] = h.percentileUs(0.90f);
+      p["p99_us"] = h.percentileUs(0.99f);
+      p["max_us"] = h.maxUs();
+      // [upper bound us, count] for non-empty buckets (upper 0 = overflow)
+      JsonArray b = p.createNestedArray("buckets");
+      for (uint8_t k = 0; k < LatencyHistogram::SLOTS; k++) {
+        const uint32_t c = h.bucket(k);
+        if (!c) continue;
+        JsonArray e = b.createNestedArray();
+        e.add(k < LatencyHistogram::BUCKETS ? LatencyHistogram::bucketUpper(k) : 0);
+        e.add(c);
+      }
+    }
+
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/latency/reset", HTTP_POST, timed("POST /api/latency/reset", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+    probeResetAll();
+    sendTimed(r, 200, "application/json", "{\"ok\":true}");
+  }));
+
+  // Remote log config + stats
+  server.on("/api/log", HTTP_GET, timed("GET /api/log", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const LogRemoteStats st = logRemoteStats();
+    StaticJsonDocument<384> d;
+    d["ok"] = true;
+    d["level"] = LOG_LEVEL;
+    d["syslog"] = logCfg.syslogEnabled;
+    d["host"] = logCfg.syslogHost;
+    d["port"] = logCfg.syslogPort;
+    d["dropped"] = logDroppedCount();
+    d["sse_sent"] = st.sseSent;
+    d["sse_dropped"] = st.sseDropped;
+    d["syslog_lines"] = st.syslogLines;
+    d["syslog_datagrams"] = st.syslogDatagrams;
+    d["syslog_dropped"] = st.syslogDropped;
+
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/log", HTTP_POST, timed("POST /api/log", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+    auto v = [&](const char* k)->String{ return a.get(k); };
+
+    const String enS = v("syslog");
+    logCfg.syslogEnabled = (enS == "1" || enS.equalsIgnoreCase("true") || enS.equalsIgnoreCase("on"));
+    logCfg.syslogHost = v("host");
 
     long p = v("port").toInt();
-    if (p <= 0 || p > 65535) p = 1883;
-    mqttCfg.port = (uint16_t)p;
+    if (p <= 0 || p > 65535) p = 514;
+    logCfg.syslogPort = (uint16_t)p;
 
-    mqttCfg.user = v("user");
-    const String pass = v("pass");
-    if (pass.length()) mqttCfg.pass = pass;
+    saveLogCfg();
+    syslogConfigure(logCfg.syslogEnabled, logCfg.syslogHost.c_str(), logCfg.syslogPort);
 
-    mqttCfg.cmdTopic = v("cmdTopic");
-    mqttCfg.stateTopic = v("stateTopic");
+    sendResult(r, 200);
+  }), nullptr, collectBody);
 
-    saveMqttCfg();
-    applyTopics();
+  // HTTP connection limits
+  server.on("/api/http", HTTP_GET, timed("GET /api/http", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ConnGuardCfg &c = connGuard.config();
+    StaticJsonDocument<256> d;
+    d["ok"] = true;
+    d["max_conn"] = c.maxConnections;
+    d["idle_s"] = c.idleTimeoutS;
+    d["min_heap"] = c.minFreeHeap;
+    d["active"] = connGuard.active();
+    d["heap"] = ESP.getFreeHeap();
+    d["max_alloc"] = ESP.getMaxAllocHeap();
 
-    if (!mqttCfg.enabled && mqtt.connected()) mqtt.disconnect();
-    if (mqtt.connected()) mqtt.disconnect(); // force reconnect with new params
+    sendDoc(r, 200, d);
+  }));
 
-    r->send(200, "application/json", "{\"ok\":true}");
-  });
+  server.on("/api/http", HTTP_POST, timed("POST /api/http", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    ConnGuardCfg c = connGuard.config();
+    auto num = [&](const char* k, long lo, long hi, long def)->long{
+      if (!a.has(k)) return def;
+      long n = a.get(k).toInt();
+      return (n < lo || n > hi) ? def : n;
+    };
+    c.maxConnections = (uint8_t)num("max_conn", 1, HTTP_GUARD_SLOTS, c.maxConnections);
+    c.idleTimeoutS   = (uint16_t)num("idle_s", 1, 3600, c.idleTimeoutS);
+    c.minFreeHeap    = (uint32_t)num("min_heap", 0, 128 * 1024, c.minFreeHeap);
+
+    connGuard.configure(c);
+    saveHttpCfg();
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Group commands: config (key write-only) + stats, and sending one
+  server.on("/api/group", HTTP_GET, timed("GET /api/group", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const GroupCfg c = groupConfig();
+    const GroupStats s = groupStats();
+    StaticJsonDocument<512> d;
+    d["ok"] = true;
+    d["enabled"] = c.enabled;
+    d["addr"] = c.addr;
+    d["port"] = c.port;
+    d["groups"] = groupListStr(c.groups);
+    d["scenes"] = c.scenes;
+    d["repeat"] = c.repeat;
+    d["key_set"] = c.key[0] != 0;
+    JsonObject st = d.createNestedObject("stats");
+    st["received"] = s.received;
+    st["applied"] = s.applied;
+    st["ignored"] = s.ignored;
+    st["bad_mac"] = s.badMac;
+    st["duplicate"] = s.duplicate;
+    st["stale"] = s.stale;
+    st["challenged"] = s.challenged;
+    st["sent"] = s.sent;
+
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/group", HTTP_POST, timed("POST /api/group", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    GroupCfg c = groupConfig();
+    if (a.has("enabled")) c.enabled = (a.get("enabled") == "1" || a.get("enabled") == "true");
+    if (a.has("addr")) {
+      IPAddress ip;
+      const String v = a.get("addr");
+      if (!ip.fromString(v.c_str()) || ip[0] < 224 || ip[0] > 239) { sendResult(r, 400, "bad_addr"); return; }
+      strlcpy(c.addr, v.c_str(), sizeof(c.addr));
+    }
+    if (a.has("port")) {
+      const long p = a.get("port").toInt();
+      if (p < 1 || p > 65535) { sendResult(r, 400, "bad_port"); return; }
+      c.port = (uint16_t)p;
+    }
+    if (a.has("groups") && !groupParseList(a.get("groups").c_str(), c.groups)) {
+      sendResult(r, 400, "bad_groups");
+      return;
+    }
+    if (a.has("scenes")) {
+      const String v = a.get("scenes");
+      if (!validScenes(v)) { sendResult(r, 400, "bad_scenes"); return; }
+      strlcpy(c.scenes, v.c_str(), sizeof(c.scenes));
+    }
+    if (a.has("repeat")) {
+      const long n = a.get("repeat").toInt();
+      if (n < 1 || n > GROUP_REPEAT_MAX) { sendResult(r, 400, "bad_repeat"); return; }
+      c.repeat = (uint8_t)n;
+    }
+    if (a.has("key")) {
+      const String v = a.get("key");
+      if (v.length() < 16 || v.length() > 64) { sendResult(r, 400, "bad_key"); return; }
+      strlcpy(c.key, v.c_str(), sizeof(c.key));
+    }
+
+    groupConfigure(c);
+    saveGroupCfg();
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // POST /api/group/send  group=<n>&cmd=on|off|toggle|scene[&scene=<0-7>]
+  server.on("/api/group/send", HTTP_POST, timed("POST /api/group/send", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    const long group = a.has("group") ? a.get("group").toInt() : 0;
+    uint8_t cmd;
+    if (group < 0 || group > 65535) { sendResult(r, 400, "bad_group"); return; }
+    if (!groupParseCmd(a.get("cmd").c_str(), cmd)) { sendResult(r, 400, "bad_cmd"); return; }
+    const long scene = a.has("scene") ? a.get("scene").toInt() : 0;
+    if (cmd == GROUP_SCENE && (scene < 0 || scene >= GROUP_SCENES)) { sendResult(r, 400, "bad_scene"); return; }
+
+    if (!groupReady()) { sendResult(r, 409, "group_disabled"); return; }
+    if (!groupSend((uint16_t)group, cmd, (uint8_t)scene)) { sendResult(r, 503, "busy"); return; }
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Peer bindings: config (key write-only), this node's address, stats
+  server.on("/api/peer", HTTP_GET, timed("GET /api/peer", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const PeerCfg c = peerConfig();
+    const PeerStats s = peerStats();
+    StaticJsonDocument<768> d;
+    d["ok"] = true;
+    d["enabled"] = c.enabled;
+    d["key_set"] = c.key[0] != 0;
+    String mac = WiFi.macAddress();
+    mac.toLowerCase();
+    d["espnow"] = mac;
+    d["udp"] = "udp:" + WiFi.localIP().toString() + ":" + String(PEER_UDP_PORT);
+    d["bindings"] = peerBindingsStr(c);
+    JsonObject st = d.createNestedObject("stats");
+    st["sent"] = s.sent;
+    st["acked"] = s.acked;
+    st["retries"] = s.retries;
+    st["failed"] = s.failed;
+    st["received"] = s.received;
+    st["applied"] = s.applied;
+    st["duplicate"] = s.duplicate;
+    st["bad_mac"] = s.badMac;
+    st["challenged"] = s.challenged;
+    st["rtt_last_us"] = s.rttLastUs;
+    st["rtt_max_us"] = s.rttMaxUs;
+
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/peer", HTTP_POST, timed("POST /api/peer", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    PeerCfg c = peerConfig();
+    if (a.has("enabled")) c.enabled = (a.get("enabled") == "1" || a.get("enabled") == "true");
+    if (a.has("bindings") && !peerParseBindings(a.get("bindings").c_str(), c)) {
+      sendResult(r, 400, "bad_bindings");
+      return;
+    }
+    if (a.has("key")) {
+      const String v = a.get("key");
+      if (v.length() < 16 || v.length() > 64) { sendResult(r, 400, "bad_key"); return; }
+      strlcpy(c.key, v.c_str(), sizeof(c.key));
+    }
+
+    peerConfigure(c);
+    savePeerCfg();
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // CoAP endpoint: config + stats
+  server.on("/api/coap", HTTP_GET, timed("GET /api/coap", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const CoapCfg c = coapConfig();
+    const CoapStats s = coapStats();
+    StaticJsonDocument<384> d;
+    d["ok"] = true;
+    d["enabled"] = c.enabled;
+    d["confirmable"] = c.confirmable;
+    d["port"] = COAP_DEFAULT_PORT;
+    JsonObject st = d.createNestedObject("stats");
+    st["requests"] = s.requests;
+    st["malformed"] = s.malformed;
+    st["duplicates"] = s.duplicates;
+    st["notifications"] = s.notifications;
+    st["retransmits"] = s.retransmits;
+    st["dropped"] = s.dropped;
+    st["observers"] = s.observers;
+
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/coap", HTTP_POST, timed("POST /api/coap", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    CoapCfg c = coapConfig();
+    if (a.has("enabled")) c.enabled = (a.get("enabled") == "1" || a.get("enabled") == "true");
+    if (a.has("confirmable")) c.confirmable = (a.get("confirmable") == "1" || a.get("confirmable") == "true");
+
+    coapConfigure(c);
+    saveCoapCfg();
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Input debouncer (debounce.h): algo=stable|lockout|integrate, ms=
+  server.on("/api/debounce", HTTP_GET, timed("GET /api/debounce", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const DebounceCfg c = controlDebounce();
+    StaticJsonDocument<192> d;
+    d["ok"] = true;
+    d["algo"] = debounceAlgoName(c.algo);
+    d["ms"] = c.ms;
+    JsonArray a = d.createNestedArray("algos");
+    for (uint8_t i = 0; i < DEB__COUNT; i++) a.add(debounceAlgoName(i));
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/debounce", HTTP_POST, timed("POST /api/debounce", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    DebounceCfg c = controlDebounce();
+    if (a.has("algo")) {
+      c.algo = debounceParseAlgo(a.get("algo").c_str());
+      if (c.algo >= DEB__COUNT) { sendResult(r, 400, "bad_algo"); return; }
+    }
+    if (a.has("ms")) {
+      const long ms = a.get("ms").toInt();
+      if (ms < 0 || ms > DEBOUNCE_MAX_MS) { sendResult(r, 400, "bad_ms"); return; }
+      c.ms = (uint16_t)ms;
+    }
+
+    if (!controlSetDebounce(c)) { sendResult(r, 503, "busy"); return; }
+    saveDebounceCfg();
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Raw input trace (inputtrace.h): GET = progress, ?format=text = the
+  // finished capture; POST period_us=&seconds= starts, stop=1 aborts.
+  server.on("/api/trace", HTTP_GET, timed("GET /api/trace", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const TraceInfo t = traceInfo();
+    if (r->hasParam("format") && r->getParam("format")->value() == "text") {
+      if (t.running) { sendResult(r, 409, "running"); return; }
+      if (!t.periodUs) { sendResult(r, 404, "no_trace"); return; }
+      auto x = std::make_shared<TraceExport>();
+      AsyncWebServerResponse *resp = r->beginChunkedResponse(
+          "text/plain",
+          [x](uint8_t *buf, size_t maxLen, size_t) -> size_t {
+            return fillTrace(*x, buf, maxLen);
+          });
+      resp->addHeader("Cache-Control", "no-cache");
+      sendTimed(r, resp);
+      return;
+    }
+
+    StaticJsonDocument<256> d;
+    d["ok"] = true;
+    d["running"] = t.running;
+    d["period_us"] = t.periodUs;
+    d["samples"] = t.samples;
+    d["target"] = t.target;
+    d["edges"] = t.edges;
+    d["max_edges"] = TRACE_MAX_EDGES;
+    d["overflow"] = t.overflow;
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/trace", HTTP_POST, timed("POST /api/trace", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid) { sendResult(r, 400, "bad_body"); return; }
+
+    if (a.has("stop") && (a.get("stop") == "1" || a.get("stop") == "true")) {
+      traceStop();
+      sendResult(r, 200);
+      return;
+    }
+    const long period = a.has("period_us") ? a.get("period_us").toInt() : 50;
+    const long seconds = a.has("seconds") ? a.get("seconds").toInt() : 10;
+    if (period < TRACE_PERIOD_MIN_US || period > TRACE_PERIOD_MAX_US ||
+        seconds < 1 || seconds > (long)TRACE_MAX_SECONDS) {
+      sendResult(r, 400, "bad_args");
+      return;
+    }
+    if (!traceStart((uint16_t)period, (uint32_t)seconds)) { sendResult(r, 409, "busy"); return; }
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Boot phase timings (see boottime.h)
+  server.on("/api/boot", HTTP_GET, timed("GET /api/boot", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    BootPhase phases[BOOT_PHASES_MAX];
+    const uint8_t n = bootPhases(phases);
+    StaticJsonDocument<1024> d;
+    d["ok"] = true;
+    d["ready_ms"] = bootReadyUs() / 1000.0f;
+    JsonArray a = d.createNestedArray("phases");
+    for (uint8_t i = 0; i < n; i++) {
+      JsonObject o = a.createNestedObject();
+      o["name"] = phases[i].name;
+      o["start_ms"] = phases[i].startUs / 1000.0f;
+      o["ms"] = phases[i].durUs / 1000.0f;
+    }
+    sendDoc(r, 200, d);
+  }));
+
+  // Power-on policy + state journal
+  server.on("/api/power", HTTP_GET, timed("GET /api/power", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const PowerStats s = powerStats();
+    StaticJsonDocument<384> d;
+    d["ok"] = true;
+    d["policy"] = powerPolicyStr(s.policy);
+    d["boot_state"] = s.bootState;
+    d["restored"] = s.restored;
+    JsonObject j = d.createNestedObject("journal");
+    j["ok"] = s.journal;
+    j["seq"] = s.j.seq;
+    j["appends"] = s.j.appends;
+    j["erases"] = s.j.erases;
+    j["write_fails"] = s.writeFails;
+    j["boot_us"] = s.bootUs;
+    j["boot_reads"] = s.j.bootReads;
+    j["torn"] = s.j.torn;
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/power", HTTP_POST, timed("POST /api/power", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    uint8_t p;
+    if (!a.valid || !a.has("policy")) { sendResult(r, 400, "bad_body"); return; }
+    if (!powerParsePolicy(a.get("policy").c_str(), p)) { sendResult(r, 400, "bad_policy"); return; }
+    savePowerPolicy(p);
+    powerSetPolicy(p);
+    sendResult(r, 200);
+  }), nullptr, collectBody);
+
+  // Local rules: source text + stats; POST compiles (check=1: compile only)
+  server.on("/api/rules", HTTP_GET, timed("GET /api/rules", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    prefs.begin("rules", true);
+    const String text = prefs.getString("text", RULES_DEFAULT);
+    prefs.end();
+    const ControlRuleStats s = controlRuleStats();
+
+    DynamicJsonDocument d(RULES_TEXT_MAX + 384);
+    d["ok"] = true;
+    d["text"] = text;
+    JsonObject st = d.createNestedObject("stats");
+    st["events"] = s.events;
+    st["actions"] = s.actions;
+    st["last_us"] = s.lastUs;
+    st["max_us"] = s.maxUs;
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/rules", HTTP_POST, timed("POST /api/rules", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const ApiArgs a(r);
+    if (!a.valid || !a.has("text")) { sendResult(r, 400, "bad_body"); return; }
+    const String text = a.get("text");
+    if (text.length() > RULES_TEXT_MAX) { sendResult(r, 400, "too_long"); return; }
+
+    RuleError err;
+    if (!rulesCompile(text.c_str(), rulesScratch, err)) {
+      StaticJsonDocument<160> d;
+      d["ok"] = false;
+      d["err"] = "compile";
+      d["line"] = err.line;
+      d["msg"] = (const char*)err.msg;
+      sendDoc(r, 400, d);
+      return;
+    }
+
+    StaticJsonDocument<96> d;
+    d["ok"] = true;
+    d["rules"] = rulesScratch.rules;
+    d["bytes"] = rulesScratch.len;
+    if (a.get("check") != "1") {
+      if (!controlLoadRules(rulesScratch)) { sendResult(r, 409, "busy"); return; }
+      saveRules(text);
+    }
+    sendDoc(r, 200, d);
+  }), nullptr, collectBody);
+
+  // Event history: ?from=&to= (sec), ?after=<seq> for incremental pulls,
+  // ?limit=, ?format=bin for the delta-encoded export (tools/history.py)
+  server.on("/api/history", HTTP_GET, timed("GET /api/history", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    auto x = std::make_shared<HistoryExport>();
+    auto num = [r](const char *k, uint32_t def) -> uint32_t {
+      return r->hasParam(k) ? (uint32_t)strtoul(r->getParam(k)->value().c_str(), nullptr, 10) : def;
+    };
+    x->after = r->hasParam("after") ? num("after", 0) : historyStats().oldest - 1;
+    x->from = num("from", 0);
+    x->to = num("to", UINT32_MAX);
+    x->left = num("limit", UINT32_MAX);
+    x->bin = r->hasParam("format") && r->getParam("format")->value() == "bin";
+
+    AsyncWebServerResponse *resp = r->beginChunkedResponse(
+        x->bin ? "application/octet-stream" : "application/json",
+        [x](uint8_t *buf, size_t maxLen, size_t) -> size_t {
+          return fillHistory(*x, buf, maxLen);
+        });
+    resp->addHeader("Cache-Control", "no-cache");
+    sendTimed(r, resp);
+  }));
+
+  // OTA: POST /api/ota?target=app|fs[&sha256=<hex>] with the image as a raw
+  // body (application/octet-stream) or a multipart file field. The image
+  // may be a plain .bin or a compressed/delta container (tools/otapack.py).
+  server.on("/api/ota", HTTP_GET, timed("GET /api/ota", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+    StaticJsonDocument<384> d;
+    otaStatusDoc(d);
+    sendDoc(r, 200, d);
+  }));
+
+  server.on("/api/ota", HTTP_POST, timed("POST /api/ota", [](AsyncWebServerRequest *r){
+    if (!requireAuthOr401(r)) return;
+
+    const OtaUpload *u = (const OtaUpload*)r->_tempObject;
+    StaticJsonDocument<384> d;
+    otaStatusDoc(d);
+    const bool ok = u && u->owner && otaStatus().state == OTA_DONE;
+    d["ok"] = ok;
+    if (ok) d["reboot"] = true;
+    else if (!u) d["err"] = "no_image";
+    else if (!u->owner) d["err"] = u->busy ? "busy" : "begin_failed";
+    sendDoc(r, ok ? 200 : (u && u->busy ? 409 : 400), d);
+  }), otaUploadChunk, otaBodyChunk);
+
+  // Live log stream (SSE)
+  logStreamAttach(server, BASIC_AUTH_ON ? BASIC_USER : nullptr, BASIC_PASS);
 
   server.begin();
-  Serial.println("[STA] Web server started (Basic Auth ON).");
+  metricsRegisterTask("async_tcp", xTaskGetHandle("async_tcp"));
+  LOGI("STA", "Web server started (Basic Auth ON).");
 }
 
 void listFiles(const char* dirname, uint8_t levels) {
-  Serial.printf("Listing directory: %s\r\n", dirname);
+  LOGD("FS", "Listing directory: %s", dirname);
   
   // Ensure the path starts with /
   String path = dirname;
@@ -624,27 +2251,23 @@ void listFiles(const char* dirname, uint8_t levels) {
   
   File root = LittleFS.open(path);
   if (!root) {
-    Serial.printf("- failed to open directory: %s\r\n", path.c_str());
+    LOGW("FS", "failed to open directory: %s", path.c_str());
     return;
   }
   if (!root.isDirectory()) {
-    Serial.println(" - not a directory");
+    LOGW("FS", "%s: not a directory", path.c_str());
     return;
   }
   
   File file = root.openNextFile();
   while (file) {
     if (file.isDirectory()) {
-      Serial.print("  DIR : ");
-      Serial.println(file.name());
+      LOGD("FS", "  DIR : %s", file.name());
       if (levels) {
         listFiles(file.name(), levels - 1);
       }
     } else {
-      Serial.print("  FILE: ");
-      Serial.print(file.name());
-      Serial.print("\tSIZE: ");
-      Serial.println(file.size());
+      LOGD("FS", "  FILE: %s\tSIZE: %u", file.name(), (unsigned)file.size());
     }
     file = root.openNextFile();
   }
@@ -654,48 +2277,193 @@ void listFiles(const char* dirname, uint8_t levels) {
 enum Mode { MODE_AP, MODE_STA };
 Mode modeNow = MODE_AP;
 
-void setup() {
-  Serial.begin(115200);
-  delay(200);
-  Serial.println();
-  Serial.println("=== SwitchNode boot ===");
+// Hands relay/input changes from the control task to MQTT.
+static void drainControlEvents() {
+  ControlEvent ev;
+  while (controlPollEvent(ev)) {
+    historyRecord(ev);
+    if (modeNow != MODE_STA) continue;
+    coapNotify(ev);
+    if (ev.type == EV_RELAY) publishRelayState(ev.value);
+    else if (ev.type == EV_INPUT) publishInputOpenBool(ev.value);
+  }
+}
 
-  WiFi.onEvent(onWiFiEvent);
+// -------------------- Net task (core 0) --------------------
+static const uint32_t NET_LOOP_MS = 10;
+static const uint32_t NET_STACK   = 8192;
+static TaskLoadMeter net_load("net", CORE_NET);
+
+static void otaHousekeeping() {
+  static uint8_t lastState = OTA_IDLE;
+  static uint32_t rebootAt = 0;
+
+  otaPoll();
+  if (millis() > OTA_HEALTHY_AFTER_MS) otaMarkHealthy();
+
+  const OtaStatus st = otaStatus();
+  if (st.state != lastState) {
+    lastState = st.state;
+    if (modeNow == MODE_STA && mqtt.connected() && topicOtaStatus.length()) {
+      char buf[192];
+      snprintf(buf, sizeof(buf), "{\"state\":\"%s\",\"target\":\"%s\",\"bytes\":%lu,\"bps\":%lu,\"err\":\"%s\"}",
+               otaStateStr(st.state), otaTargetStr(st.target), (unsigned long)st.written,
+               (unsigned long)st.bytesPerSec, st.error);
+      mqttPublish(topicOtaStatus.c_str(), buf, false);
+    }
+  }
 
-  pinMode(RELAY_PIN, OUTPUT);
-  pinMode(INPUT_PIN, INPUT_PULLUP);
+  // Give the HTTP reply / MQTT status a moment to leave before restarting
+  if (otaRebootPending()) {
+    if (!rebootAt) rebootAt = millis() + 1000;
+    else if ((int32_t)(millis() - rebootAt) >= 0) {
+      LOGI("OTA", "Rebooting into the new image...");
+      historyFlush();
+      logFlush();
+      ESP.restart();
+    }
+  }
+}
 
-  setRelay(false);
+// (Re)starts the UDP / ESP-NOW listeners whenever the station comes back up.
+static void listenerHousekeeping() {
+  static bool wasUp = false;
+  const bool up = WiFi.isConnected();
+  if (up && !wasUp) {
+    groupStart();
+    peerStart();
+    coapStart();
+  }
+  wasUp = up;
+}
 
-  // Safer: do NOT format on fail in production.
-  if (!LittleFS.begin(true)) {
-    Serial.println("[FS] LittleFS mount failed (formatted if needed).");
-  } else {
-    Serial.println("[FS] LittleFS mounted.");
-    listFiles("/", 2);
-    listFiles("/www", 1);  // Explicitly list www directory
-  // Add debug file system check
+static void netLoopOnce() {
+  otaHousekeeping();
+  historyPoll();
+  tracePoll();
+
+  if (modeNow == MODE_AP) {
+    drainControlEvents();   // DNS is answered from the AsyncUDP callback
+    statusPollStep();
+    return;
   }
 
+  const uint32_t loopT0 = micros();
+  PROBE_LAP(PROBE_LOOP_PERIOD);
+
+  listenerHousekeeping();
+  groupPoll();
+  mqttApplyPendingCfg();
+  mqttEnsureConnected();
+  mqtt.loop();
+  const bool up = mqtt.connected();
+  if (mqttUp.exchange(up) != up) statusMetaGen.fetch_add(1);
+  drainControlEvents();
+  statusPollStep();
+  coapPoll();
+  mdnsUpdateTxt(false);
+  logStreamLoop();
+
+  metricsRecordLoop(micros() - loopT0);
+}
+
+static void netTask(void*) {
+  for (;;) {
+    // Woken early by control events so publishes are not held for a full tick
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NET_LOOP_MS));
+    net_load.enter();
+    netLoopOnce();
+    net_load.leave();
+    taskLoadSampleAll();
+  }
+}
+
+static void startNetTask() {
+  TaskHandle_t h = nullptr;
+  taskLoadRegister(&net_load);
+  taskLoadRegister(&http_load);
+  xTaskCreatePinnedToCore(netTask, "net", NET_STACK, nullptr, PRIO_NET, &h, CORE_NET);
+  controlSetEventListener(h);
+  metricsRegisterTask("net", h);
+}
+
+void setup() {
+  // Relay first: the power-on state is on the pin before anything else
+  // runs (logs are queued and printed once Serial is up).
+  uint8_t ph = bootPhaseBegin("relay");
+  controlSetDebounce(loadDebounceCfg());
+  controlLoadRules(compileStoredRules());   // a press right after power-on already counts
+  controlBegin(powerStateBegin(loadPowerPolicy()));
+  bootPhaseEnd(ph);
+
+  ph = bootPhaseBegin("core");
+  Serial.begin(115200);
+  logBegin();
+  LOGI("BOOT", "=== SwitchNode boot ===");
+  otaBootCheck();
+
+  cfgLock = xSemaphoreCreateMutex();
+  statusPollLock = xSemaphoreCreateMutex();
+
+  metricsRegisterTask("log", xTaskGetHandle("log"));
+  metricsRegisterTask("control", xTaskGetHandle("control"));
+  peerBegin();
+  metricsRegisterTask("peer", xTaskGetHandle("peer"));
+
+  WiFi.onEvent(onWiFiEvent);
+
   deviceId = macToDeviceId();
   shortId  = macSuffix6();
   mdnsHost = "switchnode-" + shortId;
   mdnsFqdn = mdnsHost + ".local";
+  bootPhaseEnd(ph);
 
+  // The join runs in the Wi-Fi task while we mount the FS and load config.
+  ph = bootPhaseBegin("wifi_cfg");
   loadWifiCfg();
-  loadMqttCfg();
+  bootPhaseEnd(ph);
+  const uint8_t joinPh = bootPhaseBegin("wifi_join");
+  const bool joining = beginSTA();
 
-  in_last_read = digitalRead(INPUT_PIN);
-  in_stable = in_last_read;
-  in_last_change_ms = millis();
-
-  Serial.println("[ID] Device ID: " + deviceId);
-  Serial.println("[ID] mDNS host:  " + mdnsHost);
-  Serial.println(String("[AUTH] ") + (BASIC_AUTH_ON ? "ENABLED" : "disabled") + " user=" + BASIC_USER);
+  ph = bootPhaseBegin("fs");
+  // Safer: do NOT format on fail in production.
+  if (!LittleFS.begin(true)) {
+    LOGE("FS", "LittleFS mount failed (formatted if needed).");
+  } else {
+    LOGI("FS", "LittleFS mounted.");
+#if BOOT_DIAG
+    listFiles("/", 2);
+#endif
+  }
+  bootPhaseEnd(ph);
 
-  if (connectSTA(20000)) {
+  ph = bootPhaseBegin("config");
+  loadMqttCfg();
+  logRemoteBegin(mdnsHost.c_str());
+  loadLogCfg();
+  loadHttpCfg();
+  loadGroupCfg();
+  loadPeerCfg();
+  loadCoapCfg();
+  bootPhaseEnd(ph);
+
+  ph = bootPhaseBegin("services");
+  historyBegin(controlSnapshot());
+  loadRules();
+  bootPhaseEnd(ph);
+
+  LOGI("ID", "Device ID: %s", deviceId.c_str());
+  LOGI("ID", "mDNS host:  %s", mdnsHost.c_str());
+  LOGI("AUTH", "%s user=%s", BASIC_AUTH_ON ? "ENABLED" : "disabled", BASIC_USER);
+
+  const bool sta = joining && waitSTA(STA_JOIN_TIMEOUT_MS);
+  bootPhaseEnd(joinPh);
+
+  ph = bootPhaseBegin("net");
+  if (sta) {
     modeNow = MODE_STA;
-    Serial.println("[WiFi] STA connected, IP: " + WiFi.localIP().toString());
+    LOGI("WiFi", "STA connected, IP: %s", WiFi.localIP().toString().c_str());
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");   // UTC, for history timestamps
     startMDNS();
     setupRoutes_STA();
   } else {
@@ -703,40 +2471,13 @@ void setup() {
     startAPPortal();
     setupRoutes_AP();
   }
+
+  startNetTask();
+  bootPhaseEnd(ph);
+  bootDone();
 }
 
 void loop() {
-  if (modeNow == MODE_AP) {
-    dns.processNextRequest();
-    delay(10);
-    return;
-  }
-
-  mqttEnsureConnected();
-  mqtt.loop();
-
-  // Dry contact debounce (INPUT_PULLUP)
-  int level = digitalRead(INPUT_PIN);
-  uint32_t now = millis();
-
-  if (level != in_last_read) {
-    in_last_read = level;
-    in_last_change_ms = now;
-  }
-
-  if ((now - in_last_change_ms) > INPUT_DEBOUNCE_MS && in_stable != in_last_read) {
-    in_stable = in_last_read;
-
-    const bool isOpen = (in_stable == HIGH);
-    Serial.printf("[DIN] stable change -> %s\n", isOpen ? "OPEN(HIGH)" : "CLOSED(LOW)");
-
-    publishInputOpenBool(isOpen);
-
-    // IMPORTANT: toggle only on press/close (LOW) to avoid double-toggle on release
-    if (!isOpen) {
-      setRelay(!relayState);
-    }
-  }
-
-  delay(10);
+  // All work runs in the control and net tasks.
+  vTaskDelete(nullptr);
 }
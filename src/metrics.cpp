@@ -0,0 +1,231 @@
+#include "metrics.h"
+#include "boottime.h"
+#include "log.h"
+#include "control.h"
+#include "taskload.h"
+
+std::atomic<uint32_t> metricCounters[CNT__COUNT];
+
+// -------------------- HTTP routes --------------------
+struct RouteMetrics {
+  const char* name;
+  LatencyHistogram hist;
+};
+
+static RouteMetrics routes[METRICS_MAX_ROUTES];
+static std::atomic<uint8_t> route_count{0};
+
+uint8_t metricsRoute(const char* name) {
+  const uint8_t n = route_count.load(std::memory_order_acquire);
+  for (uint8_t i = 0; i < n; i++) {
+    if (strcmp(routes[i].name, name) == 0) return i;
+  }
+  // Registration happens during setup() only, from a single task
+  if (n >= METRICS_MAX_ROUTES) {
+    LOGE("METRICS", "route table full (METRICS_MAX_ROUTES=%u), \"%s\" not recorded", METRICS_MAX_ROUTES, name);
+    return METRICS_ROUTE_NONE;
+  }
+  routes[n].name = name;
+  route_count.store(n + 1, std::memory_order_release);
+  return n;
+}
+
+void metricsRecordRequest(uint8_t route, uint32_t us) {
+  if (route >= route_count.load(std::memory_order_acquire)) return;
+  routes[route].hist.record(us);
+}
+
+// -------------------- Loop --------------------
+static LatencyHistogram loop_hist;
+
+void metricsRecordLoop(uint32_t us) {
+  loop_hist.record(us);
+}
+
+// -------------------- WiFi disconnect reasons --------------------
+// 802.11 reason codes 0..47 and ESP-specific 200..215 share one table.
+static const uint8_t WIFI_REASON_SLOTS = 64;
+static std::atomic<uint32_t> wifi_reasons[WIFI_REASON_SLOTS];
+
+static int wifiReasonSlot(int reason) {
+  if (reason >= 0 && reason < 48) return reason;
+  if (reason >= 200 && reason < 216) return 48 + (reason - 200);
+  return 0;   // "unknown"
+}
+
+static int wifiSlotReason(int slot) {
+  return slot < 48 ? slot : 200 + (slot - 48);
+}
+
+void metricsRecordWifiDisconnect(int reason) {
+  metricsInc(CNT_WIFI_DISCONNECTS);
+  wifi_reasons[wifiReasonSlot(reason)].fetch_add(1, std::memory_order_relaxed);
+}
+
+// -------------------- Tasks --------------------
+static const uint8_t METRICS_MAX_TASKS = 8;
+static const char*  task_names[METRICS_MAX_TASKS];
+static TaskHandle_t task_handles[METRICS_MAX_TASKS];
+static uint8_t task_count = 0;
+
+void metricsRegisterTask(const char* name, TaskHandle_t h) {
+  if (!h || task_count >= METRICS_MAX_TASKS) return;
+  task_names[task_count] = name;
+  task_handles[task_count] = h;
+  task_count++;
+}
+
+// -------------------- HTTP connections --------------------
+static uint8_t (*http_active_fn)() = nullptr;
+
+void metricsSetHttpActive(uint8_t (*fn)()) {
+  http_active_fn = fn;
+}
+
+// -------------------- Render --------------------
+static void emitHeader(String &out, const char* name, const char* type, const char* help) {
+  out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+  out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+}
+
+static void emitValue(String &out, const char* name, const char* labels, uint64_t v) {
+  char buf[160];
+  snprintf(buf, sizeof(buf), "%s%s%s%s %llu\n",
+           name, labels ? "{" : "", labels ? labels : "", labels ? "}" : "",
+           (unsigned long long)v);
+  out += buf;
+}
+
+static void emitSimple(String &out, const char* name, const char* type, const char* help, uint64_t v) {
+  emitHeader(out, name, type, help);
+  emitValue(out, name, nullptr, v);
+}
+
+// Histogram in seconds. Exposed bounds are every other log2 bucket
+// (16 us, 64 us, ... 4.2 s) to keep the page small; counts stay cumulative.
+static const uint8_t EXPO_FIRST_BUCKET = 4;
+static const uint8_t EXPO_STEP = 2;
+
+static void emitHistogram(String &out, const char* name, const char* extraLabel,
+                          const LatencyHistogram &h) {
+  char labels[96];
+  char line[200];
+  uint32_t acc = 0;
+  for (uint8_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+    acc += h.bucket(i);
+    if (i < EXPO_FIRST_BUCKET || (i - EXPO_FIRST_BUCKET) % EXPO_STEP) continue;
+    snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%.6f\"} %u\n",
+             name, extraLabel ? extraLabel : "", extraLabel ? "," : "",
+             LatencyHistogram::bucketUpper(i) / 1e6, (unsigned)acc);
+    out += line;
+  }
+  snprintf(labels, sizeof(labels), "%s%sle=\"+Inf\"", extraLabel ? extraLabel : "", extraLabel ? "," : "");
+  snprintf(line, sizeof(line), "%s_bucket{%s} %u\n", name, labels, (unsigned)h.count());
+  out += line;
+
+  snprintf(line, sizeof(line), "%s_sum%s%s%s %.6f\n", name,
+           extraLabel ? "{" : "", extraLabel ? extraLabel : "", extraLabel ? "}" : "",
+           h.sumUs() / 1e6);
+  out += line;
+  snprintf(line, sizeof(line), "%s_count%s%s%s %u\n", name,
+           extraLabel ? "{" : "", extraLabel ? extraLabel : "", extraLabel ? "}" : "",
+           (unsigned)h.count());
+  out += line;
+}
+
+void metricsRender(String &out, const char* (*reasonStr)(int)) {
+  out.reserve(4096);
+  char labels[96];
+
+  emitSimple(out, "switchnode_uptime_seconds", "gauge", "Seconds since boot", millis() / 1000);
+
+  char bline[128];
+  BootPhase phases[BOOT_PHASES_MAX];
+  const uint8_t np = bootPhases(phases);
+  emitHeader(out, "switchnode_boot_phase_seconds", "gauge", "Duration of each setup() phase at the last boot");
+  for (uint8_t i = 0; i < np; i++) {
+    snprintf(bline, sizeof(bline), "switchnode_boot_phase_seconds{phase=\"%s\"} %.6f\n", phases[i].name, phases[i].durUs / 1e6f);
+    out += bline;
+  }
+  emitHeader(out, "switchnode_boot_ready_seconds", "gauge", "Time from app start to serving");
+  snprintf(bline, sizeof(bline), "switchnode_boot_ready_seconds %.6f\n", bootReadyUs() / 1e6f);
+  out += bline;
+
+  emitSimple(out, "switchnode_heap_free_bytes", "gauge", "Current free heap", ESP.getFreeHeap());
+  emitSimple(out, "switchnode_heap_min_free_bytes", "gauge", "Lowest free heap since boot", ESP.getMinFreeHeap());
+  emitSimple(out, "switchnode_heap_largest_block_bytes", "gauge", "Largest allocatable block", ESP.getMaxAllocHeap());
+
+  emitHeader(out, "switchnode_task_stack_free_bytes", "gauge", "Stack high-water mark per task");
+  for (uint8_t i = 0; i < task_count; i++) {
+    snprintf(labels, sizeof(labels), "task=\"%s\"", task_names[i]);
+    emitValue(out, "switchnode_task_stack_free_bytes", labels, uxTaskGetStackHighWaterMark(task_handles[i]));
+  }
+
+  emitHeader(out, "switchnode_task_cpu_ratio", "gauge", "Share of one core used by the task over the last second");
+  for (uint8_t i = 0; i < taskLoadCount(); i++) {
+    const TaskLoadMeter* m = taskLoadAt(i);
+    char line[128];
+    snprintf(line, sizeof(line), "switchnode_task_cpu_ratio{task=\"%s\",core=\"%d\"} %.3f\n",
+             m->name(), (int)m->core(), m->permille() / 1000.0f);
+    out += line;
+  }
+
+  emitHeader(out, "switchnode_loop_duration_seconds", "histogram", "Net task iteration time (excluding idle wait)");
+  emitHistogram(out, "switchnode_loop_duration_seconds", nullptr, loop_hist);
+
+  const uint8_t nr = route_count.load(std::memory_order_acquire);
+  emitHeader(out, "switchnode_http_requests_total", "counter", "HTTP requests handled per route");
+  for (uint8_t i = 0; i < nr; i++) {
+    snprintf(labels, sizeof(labels), "route=\"%s\"", routes[i].name);
+    emitValue(out, "switchnode_http_requests_total", labels, routes[i].hist.count());
+  }
+  emitSimple(out, "switchnode_http_unauthorized_total", "counter", "Requests rejected by Basic Auth",
+             metricCounters[CNT_HTTP_UNAUTHORIZED].load(std::memory_order_relaxed));
+
+  emitSimple(out, "switchnode_http_connections", "gauge", "Connections with a request in flight",
+             http_active_fn ? http_active_fn() : 0);
+  emitSimple(out, "switchnode_http_rejected_busy_total", "counter", "Requests rejected: connection limit",
+             metricCounters[CNT_HTTP_REJECT_BUSY].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_http_rejected_low_heap_total", "counter", "Requests rejected: heap below floor",
+             metricCounters[CNT_HTTP_REJECT_HEAP].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_http_evicted_total", "counter", "Idle connections closed to admit new ones",
+             metricCounters[CNT_HTTP_EVICTED].load(std::memory_order_relaxed));
+
+  emitHeader(out, "switchnode_http_request_duration_seconds", "histogram", "Handler time per route");
+  for (uint8_t i = 0; i < nr; i++) {
+    snprintf(labels, sizeof(labels), "route=\"%s\"", routes[i].name);
+    emitHistogram(out, "switchnode_http_request_duration_seconds", labels, routes[i].hist);
+  }
+
+  const uint32_t connects = metricCounters[CNT_MQTT_CONNECTS].load(std::memory_order_relaxed);
+  emitSimple(out, "switchnode_mqtt_connect_attempts_total", "counter", "MQTT connect attempts",
+             metricCounters[CNT_MQTT_CONNECT_ATTEMPTS].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_mqtt_connects_total", "counter", "Successful MQTT connects", connects);
+  emitSimple(out, "switchnode_mqtt_reconnects_total", "counter", "MQTT connects after the first",
+             connects ? connects - 1 : 0);
+  emitSimple(out, "switchnode_mqtt_connect_failures_total", "counter", "Failed MQTT connects",
+             metricCounters[CNT_MQTT_CONNECT_FAILS].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_mqtt_publish_total", "counter", "MQTT publishes",
+             metricCounters[CNT_MQTT_PUBLISH].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_mqtt_publish_failures_total", "counter", "MQTT publishes rejected by the client",
+             metricCounters[CNT_MQTT_PUBLISH_FAILS].load(std::memory_order_relaxed));
+  emitSimple(out, "switchnode_mqtt_received_total", "counter", "MQTT messages received",
+             metricCounters[CNT_MQTT_RX].load(std::memory_order_relaxed));
+
+  emitSimple(out, "switchnode_wifi_disconnects_total", "counter", "Wi-Fi STA disconnect events",
+             metricCounters[CNT_WIFI_DISCONNECTS].load(std::memory_order_relaxed));
+  emitHeader(out, "switchnode_wifi_disconnect_reason_total", "counter", "Wi-Fi STA disconnects by reason");
+  for (int slot = 0; slot < WIFI_REASON_SLOTS; slot++) {
+    const uint32_t c = wifi_reasons[slot].load(std::memory_order_relaxed);
+    if (!c) continue;
+    const int reason = wifiSlotReason(slot);
+    snprintf(labels, sizeof(labels), "code=\"%d\",reason=\"%s\"", reason, reasonStr ? reasonStr(reason) : "");
+    emitValue(out, "switchnode_wifi_disconnect_reason_total", labels, c);
+  }
+
+  emitSimple(out, "switchnode_control_events_dropped_total", "counter", "Relay/input events not delivered to the network side",
+             controlEventsDropped());
+  emitSimple(out, "switchnode_control_commands_dropped_total", "counter", "Relay commands rejected (queue full)",
+             controlCommandsDropped());
+  emitSimple(out, "switchnode_log_dropped_total", "counter", "Log messages dropped (ring full)", logDroppedCount());
+}
@@ -0,0 +1,59 @@
+/**************************************************************
+ * Runtime metrics (Prometheus text exposition at /metrics)
+ *
+ *  - Counters are relaxed atomics: metricsInc() is safe on any hot path.
+ *  - HTTP routes are registered by name once at setup; each gets a
+ *    request counter and a latency histogram (histogram.h).
+ *  - Gauges (heap, stack high-water marks, uptime) are sampled when
+ *    /metrics is rendered.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "histogram.h"
+
+enum MetricCounter : uint8_t {
+  CNT_MQTT_CONNECT_ATTEMPTS,
+  CNT_MQTT_CONNECTS,
+  CNT_MQTT_CONNECT_FAILS,
+  CNT_MQTT_PUBLISH,
+  CNT_MQTT_PUBLISH_FAILS,
+  CNT_MQTT_RX,
+  CNT_WIFI_DISCONNECTS,
+  CNT_HTTP_UNAUTHORIZED,
+  CNT_HTTP_REJECT_BUSY,
+  CNT_HTTP_REJECT_HEAP,
+  CNT_HTTP_EVICTED,
+  CNT__COUNT
+};
+
+extern std::atomic<uint32_t> metricCounters[CNT__COUNT];
+
+static inline void metricsInc(MetricCounter c) {
+  metricCounters[c].fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifndef METRICS_MAX_ROUTES
+#define METRICS_MAX_ROUTES 48
+#endif
+static_assert(METRICS_MAX_ROUTES < 255, "route ids are uint8_t; 255 is METRICS_ROUTE_NONE");
+
+static const uint8_t METRICS_ROUTE_NONE = 255;   // table full: requests are not recorded
+
+// Returns a route id for `name` (string literal), registering it on first
+// use. A route past METRICS_MAX_ROUTES is logged and gets METRICS_ROUTE_NONE.
+uint8_t metricsRoute(const char* name);
+void metricsRecordRequest(uint8_t route, uint32_t us);
+
+void metricsRecordLoop(uint32_t us);
+void metricsRecordWifiDisconnect(int reason);
+
+// Gauge callback for in-flight HTTP connections.
+void metricsSetHttpActive(uint8_t (*fn)());
+
+// Tasks whose stack high-water mark is reported.
+void metricsRegisterTask(const char* name, TaskHandle_t h);
+
+// Renders the exposition text. reasonStr maps Wi-Fi disconnect codes to labels.
+void metricsRender(String &out, const char* (*reasonStr)(int));
@@ -0,0 +1,60 @@
+/**************************************************************
+ * Bounded multi-producer / single-consumer lock-free queue
+ *
+ *  - Any number of tasks may push; exactly one task may pop.
+ *  - Per-slot sequence numbers (Vyukov); push() reserves a slot with
+ *    a CAS and fails instead of blocking when the queue is full.
+ *  - Header-only and Arduino-free.
+ **************************************************************/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, size_t N>
+class MpscQueue {
+  static_assert((N & (N - 1)) == 0, "MpscQueue size must be a power of two");
+
+public:
+  MpscQueue() {
+    for (size_t i = 0; i < N; i++) _slots[i].seq.store((uint32_t)i, std::memory_order_relaxed);
+  }
+
+  bool push(const T &v) {
+    uint32_t pos = _head.load(std::memory_order_relaxed);
+    Slot* s;
+    for (;;) {
+      s = &_slots[pos & (N - 1)];
+      const int32_t diff = (int32_t)(s->seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;   // full
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    s->value = v;
+    s->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &v) {
+    Slot &s = _slots[_tail & (N - 1)];
+    if (s.seq.load(std::memory_order_acquire) != _tail + 1) return false;
+    v = s.value;
+    s.seq.store(_tail + N, std::memory_order_release);
+    _tail++;
+    return true;
+  }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    T value;
+  };
+  Slot _slots[N];
+  std::atomic<uint32_t> _head{0};
+  uint32_t _tail = 0;   // consumer only
+};
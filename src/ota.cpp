@@ -0,0 +1,549 @@
+#include "ota.h"
+#include "httpbody.h"
+#include "log.h"
+#include "otaimage.h"
+#include "taskcfg.h"
+
+#include <HTTPClient.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <Update.h>
+#include <atomic>
+#include <new>
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define sha256Starts mbedtls_sha256_starts
+#define sha256Update mbedtls_sha256_update
+#define sha256Finish mbedtls_sha256_finish
+#else
+#define sha256Starts mbedtls_sha256_starts_ret
+#define sha256Update mbedtls_sha256_update_ret
+#define sha256Finish mbedtls_sha256_finish_ret
+#endif
+
+// -------------------- Tuning --------------------
+static const uint32_t OTA_PULL_STACK      = 6144;
+static const size_t   OTA_PULL_CHUNK      = 1024;
+static const uint32_t OTA_PULL_TIMEOUT_MS = 15000;   // no data for this long = fail
+static const uint32_t OTA_LOG_EVERY       = 128 * 1024;
+static const size_t   OTA_BASE_HASH_CHUNK = 512;
+
+// -------------------- State --------------------
+// The session is owned by whoever won otaBegin() (async_tcp for uploads,
+// the pull task otherwise). Other tasks read `status` under status_mux.
+static std::atomic<bool> session_busy{false};
+static std::atomic<bool> reboot_pending{false};
+static std::atomic<bool> fs_offline{false};   // LittleFS unmounted for an FS image
+static bool healthy_marked = false;
+
+static OtaStatus status = {};
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static mbedtls_sha256_context sha;
+static uint8_t expected_sha[32];
+static bool has_expected = false;
+static uint32_t start_ms = 0;
+static std::atomic<uint32_t> last_data_ms{0};
+static uint32_t next_log = 0;
+
+// Image decoding. Update.begin() waits until the first bytes tell a raw
+// image from a container (otaimage.h); containers are decoded through
+// `decoder` (4.5 KB, allocated only for them).
+enum OtaPhase : uint8_t {
+  PHASE_SNIFF,   // collecting the first bytes
+  PHASE_RAW,     // plain image, straight to flash
+  PHASE_IMAGE,   // container payload through the decoder
+};
+
+static OtaPhase phase = PHASE_SNIFF;
+static OtaTarget session_target = OTA_TARGET_APP;
+static size_t session_total = 0;
+static uint8_t hdr_buf[OTA_IMG_HEADER];
+static size_t hdr_len = 0;
+static bool flash_open = false;
+static OtaImageDecoder* decoder = nullptr;
+static const esp_partition_t* base_part = nullptr;
+
+struct PullJob {
+  OtaTarget target;
+  String url;
+  String sha;
+};
+
+const char* otaTargetStr(uint8_t t) {
+  return t == OTA_TARGET_FS ? "fs" : "app";
+}
+
+const char* otaStateStr(uint8_t s) {
+  switch (s) {
+    case OTA_IDLE:    return "idle";
+    case OTA_RUNNING: return "running";
+    case OTA_DONE:    return "done";
+    case OTA_FAILED:  return "failed";
+    default: return "unknown";
+  }
+}
+
+bool otaParseTarget(const char* s, OtaTarget &out) {
+  if (!s || !*s || !strcmp(s, "app") || !strcmp(s, "firmware")) { out = OTA_TARGET_APP; return true; }
+  if (!strcmp(s, "fs") || !strcmp(s, "littlefs"))                { out = OTA_TARGET_FS;  return true; }
+  return false;
+}
+
+static bool parseHex32(const char* hex, uint8_t out[32]) {
+  if (!hex || strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    uint8_t b = 0;
+    for (int k = 0; k < 2; k++) {
+      const char c = hex[2 * i + k];
+      b <<= 4;
+      if (c >= '0' && c <= '9')      b |= c - '0';
+      else if (c >= 'a' && c <= 'f') b |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F') b |= c - 'A' + 10;
+      else return false;
+    }
+    out[i] = b;
+  }
+  return true;
+}
+
+static void setError(const char* why) {
+  portENTER_CRITICAL(&status_mux);
+  strlcpy(status.error, why, sizeof(status.error));
+  status.state = OTA_FAILED;
+  portEXIT_CRITICAL(&status_mux);
+}
+
+static void setEncoding(const char* enc) {
+  portENTER_CRITICAL(&status_mux);
+  strlcpy(status.encoding, enc, sizeof(status.encoding));
+  portEXIT_CRITICAL(&status_mux);
+}
+
+static void updateProgress(size_t received, size_t written) {
+  const uint32_t el = millis() - start_ms;
+  portENTER_CRITICAL(&status_mux);
+  status.received += received;
+  status.written += written;
+  status.elapsedMs = el;
+  status.bytesPerSec = el ? (uint32_t)((uint64_t)status.written * 1000 / el) : 0;
+  portEXIT_CRITICAL(&status_mux);
+}
+
+// -------------------- Session --------------------
+bool otaBegin(OtaTarget target, size_t total, const char* sha256Hex, const char* source) {
+  bool expected = false;
+  if (!session_busy.compare_exchange_strong(expected, true)) return false;
+
+  has_expected = sha256Hex && *sha256Hex;
+  if (has_expected && !parseHex32(sha256Hex, expected_sha)) {
+    session_busy.store(false);
+    setError("bad_sha256");
+    return false;
+  }
+
+  portENTER_CRITICAL(&status_mux);
+  status = {};
+  status.state = OTA_RUNNING;
+  status.target = target;
+  status.total = (uint32_t)total;
+  strlcpy(status.source, source, sizeof(status.source));
+  portEXIT_CRITICAL(&status_mux);
+
+  if (target == OTA_TARGET_FS) {   // the image replaces the mounted FS
+    fs_offline.store(true);
+    LittleFS.end();
+  }
+
+  phase = PHASE_SNIFF;
+  session_target = target;
+  session_total = total;
+  hdr_len = 0;
+  flash_open = false;
+  delete decoder;
+  decoder = nullptr;
+
+  mbedtls_sha256_init(&sha);
+  sha256Starts(&sha, 0);
+  start_ms = millis();
+  last_data_ms.store(start_ms);
+  next_log = OTA_LOG_EVERY;
+  LOGI("OTA", "%s update from %s, %u bytes%s", otaTargetStr(target), source, (unsigned)total,
+       has_expected ? ", sha256 given" : "");
+  return true;
+}
+
+// -------------------- Flash sink --------------------
+static bool openFlash(size_t size) {
+  const int cmd = (session_target == OTA_TARGET_FS) ? U_SPIFFS : U_FLASH;
+  if (!Update.begin(size ? size : UPDATE_SIZE_UNKNOWN, cmd)) {
+    LOGE("OTA", "begin failed: %s", Update.errorString());
+    return false;
+  }
+  flash_open = true;
+  return true;
+}
+
+// Reconstructed image bytes: flash + digest.
+static bool flashWrite(const uint8_t* data, size_t len) {
+  if (Update.write(const_cast<uint8_t*>(data), len) != len) {
+    LOGE("OTA", "write failed: %s", Update.errorString());
+    return false;
+  }
+  sha256Update(&sha, data, len);
+  updateProgress(0, len);
+
+  if (status.written >= next_log) {
+    next_log += OTA_LOG_EVERY;
+    LOGI("OTA", "%lu bytes, %lu B/s", (unsigned long)status.written, (unsigned long)status.bytesPerSec);
+  }
+  return true;
+}
+
+static bool decoderSink(const uint8_t* data, size_t len, void*) {
+  return flashWrite(data, len);
+}
+
+static bool baseRead(uint32_t off, uint8_t* buf, size_t len, void*) {
+  return base_part && esp_partition_read(base_part, off, buf, len) == ESP_OK;
+}
+
+// The delta was made against a specific firmware.bin; the running slot
+// must start with exactly those bytes.
+static bool baseMatches(const OtaImageHeader &h) {
+  base_part = esp_ota_get_running_partition();
+  if (!base_part || h.baseSize > base_part->size) return false;
+
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  sha256Starts(&ctx, 0);
+  uint8_t buf[OTA_BASE_HASH_CHUNK];
+  bool ok = true;
+  for (uint32_t off = 0; ok && off < h.baseSize; off += sizeof(buf)) {
+    const size_t n = (h.baseSize - off) < sizeof(buf) ? (h.baseSize - off) : sizeof(buf);
+    ok = esp_partition_read(base_part, off, buf, n) == ESP_OK;
+    if (ok) sha256Update(&ctx, buf, n);
+  }
+  uint8_t digest[32];
+  sha256Finish(&ctx, digest);
+  mbedtls_sha256_free(&ctx);
+  return ok && memcmp(digest, h.baseSha, sizeof(digest)) == 0;
+}
+
+// Returns an error string, or nullptr once the decoder is ready.
+static const char* openContainer() {
+  OtaImageHeader h;
+  if (!otaImageParseHeader(hdr_buf, h)) return "bad_header";
+  if (h.target != session_target) return "target_mismatch";
+  if (has_expected && memcmp(expected_sha, h.outSha, sizeof(expected_sha)) != 0) return "sha256_mismatch";
+  memcpy(expected_sha, h.outSha, sizeof(expected_sha));
+  has_expected = true;
+
+  const bool delta = h.flags & OTA_IMG_DELTA;
+  if (delta && (session_target != OTA_TARGET_APP || !baseMatches(h))) return "base_mismatch";
+
+  decoder = new (std::nothrow) OtaImageDecoder();
+  if (!decoder) return "no_memory";
+  if (!openFlash(h.outSize)) return Update.errorString();
+  decoder->begin(h, decoderSink, baseRead, nullptr);
+
+  const bool lzss = h.flags & OTA_IMG_LZSS;
+  setEncoding(delta ? (lzss ? "delta+lzss" : "delta") : (lzss ? "lzss" : "raw"));
+  LOGI("OTA", "container: %s, %lu -> %lu bytes", status.encoding,
+       (unsigned long)session_total, (unsigned long)h.outSize);
+  return nullptr;
+}
+
+// Collects the first bytes until the format is known. Consumes from
+// data/len; returns an error string or nullptr.
+static const char* sniff(const uint8_t* &data, size_t &len) {
+  while (phase == PHASE_SNIFF && len) {
+    const size_t want = (hdr_len < 4) ? 4 : OTA_IMG_HEADER;
+    const size_t k = (want - hdr_len) < len ? (want - hdr_len) : len;
+    memcpy(hdr_buf + hdr_len, data, k);
+    hdr_len += k;
+    data += k;
+    len -= k;
+    if (hdr_len < 4) break;
+
+    if (!otaImageIsContainer(hdr_buf, hdr_len)) {
+      if (!openFlash(session_total)) return Update.errorString();
+      setEncoding("raw");
+      phase = PHASE_RAW;
+      if (!flashWrite(hdr_buf, hdr_len)) return Update.errorString();
+    } else if (hdr_len == OTA_IMG_HEADER) {
+      const char* err = openContainer();
+      if (err) return err;
+      phase = PHASE_IMAGE;
+    }
+  }
+  return nullptr;
+}
+
+bool otaWrite(const uint8_t* data, size_t len) {
+  if (!session_busy.load() || status.state != OTA_RUNNING) return false;
+  if (!len) return true;
+
+  updateProgress(len, 0);
+  last_data_ms.store(millis());
+
+  const char* err = sniff(data, len);
+  if (!err && len) {
+    if (phase == PHASE_RAW && !flashWrite(data, len)) err = Update.errorString();
+    if (phase == PHASE_IMAGE && !decoder->write(data, len)) {
+      err = strcmp(decoder->error(), "sink") == 0 ? Update.errorString() : decoder->error();
+    }
+  }
+  if (err) {
+    otaAbort(err);
+    return false;
+  }
+  return true;
+}
+
+// Every way out of a session ends here: an FS session remounts LittleFS
+// (the new image on success, whatever is left on failure).
+static void releaseSession() {
+  delete decoder;
+  decoder = nullptr;
+  base_part = nullptr;
+  flash_open = false;
+  if (fs_offline.load()) {
+    if (LittleFS.begin(false)) LOGI("OTA", "LittleFS remounted");
+    else LOGE("OTA", "LittleFS remount failed: upload a complete FS image");
+    fs_offline.store(false);
+  }
+  session_busy.store(false);
+}
+
+// Digest of the last image committed per target; for the app also the
+// slot it went to, so it is known to be the running one after the reboot.
+static void rememberImage(const char* hex) {
+  Preferences p;
+  p.begin("ota", false);
+  if (session_target == OTA_TARGET_FS) {
+    p.putString("fs_sha", hex);
+  } else {
+    const esp_partition_t* boot = esp_ota_get_boot_partition();
+    p.putString("app_sha", hex);
+    p.putString("app_part", boot ? boot->label : "");
+  }
+  p.end();
+}
+
+void otaAbort(const char* why) {
+  if (!session_busy.load()) return;
+  if (flash_open) Update.abort();
+  mbedtls_sha256_free(&sha);
+  setError(why);
+  LOGW("OTA", "aborted: %s", why);
+  releaseSession();
+}
+
+bool otaEnd() {
+  if (!session_busy.load() || status.state != OTA_RUNNING) return false;
+
+  if (phase == PHASE_SNIFF) {
+    otaAbort("too_short");
+    return false;
+  }
+  if (phase == PHASE_IMAGE && !decoder->finished()) {
+    otaAbort(decoder->error() ? decoder->error() : "truncated");
+    return false;
+  }
+
+  uint8_t digest[32];
+  sha256Finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+
+  if (has_expected && memcmp(digest, expected_sha, sizeof(digest)) != 0) {
+    LOGE("OTA", "sha256 mismatch: got %s", hex);
+    Update.abort();
+    setError("sha256_mismatch");
+    releaseSession();
+    return false;
+  }
+
+  if (!Update.end(true)) {   // marks the new app partition bootable
+    LOGE("OTA", "end failed: %s", Update.errorString());
+    setError(Update.errorString());
+    releaseSession();
+    return false;
+  }
+
+  portENTER_CRITICAL(&status_mux);
+  status.state = OTA_DONE;
+  memcpy(status.sha256, hex, sizeof(hex));
+  portEXIT_CRITICAL(&status_mux);
+  rememberImage(hex);
+
+  const OtaStatus st = otaStatus();
+  LOGI("OTA", "%s done (%s): %lu bytes from %lu received in %lu ms (%lu B/s), sha256 %s",
+       otaTargetStr(st.target), st.encoding, (unsigned long)st.written, (unsigned long)st.received,
+       (unsigned long)st.elapsedMs, (unsigned long)st.bytesPerSec, hex);
+  reboot_pending.store(true);
+  releaseSession();
+  return true;
+}
+
+OtaStatus otaStatus() {
+  portENTER_CRITICAL(&status_mux);
+  const OtaStatus st = status;
+  portEXIT_CRITICAL(&status_mux);
+  return st;
+}
+
+void otaPoll() {
+  if (!session_busy.load() || status.state != OTA_RUNNING) return;
+  if (millis() - last_data_ms.load() > OTA_STALL_MS) otaAbort("stalled");
+}
+
+// -------------------- Pull --------------------
+static bool pullSink(const uint8_t* data, size_t len, void*) {
+  return otaWrite(data, len);   // aborts the session itself on failure
+}
+
+static void pullTask(void* arg) {
+  PullJob* job = static_cast<PullJob*>(arg);
+
+  HTTPClient http;
+  http.setTimeout(OTA_PULL_TIMEOUT_MS);
+  // HTTP/1.0: no keep-alive, so a body without a length ends at the
+  // close; servers should not chunk it either, but if one does anyway
+  // the decoder strips the framing (the stream is the raw socket).
+  http.useHTTP10(true);
+  const char* keys[] = { "Transfer-Encoding" };
+  http.collectHeaders(keys, 1);
+  if (!http.begin(job->url)) {
+    otaAbort("bad_url");
+  } else {
+    const int code = http.GET();
+    if (code != HTTP_CODE_OK) {
+      LOGE("OTA", "GET %s -> %d", job->url.c_str(), code);
+      otaAbort(code < 0 ? "http_error" : "http_status");
+    } else {
+      const bool chunked = http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+      const int size = chunked ? -1 : http.getSize();   // -1: no Content-Length
+      WiFiClient* s = http.getStreamPtr();
+      uint8_t buf[OTA_PULL_CHUNK];
+      uint32_t lastData = millis();
+      bool ok = true;
+      HttpBodyDecoder body;
+      body.begin(chunked, size, pullSink, nullptr);
+
+      portENTER_CRITICAL(&status_mux);
+      if (size > 0) status.total = (uint32_t)size;
+      portEXIT_CRITICAL(&status_mux);
+
+      while (ok && !body.finished()) {
+        const int avail = s->available();
+        if (avail <= 0) {
+          if (!http.connected()) {
+            body.closed();
+            if (!body.finished()) { otaAbort(body.error()); ok = false; }
+            break;
+          }
+          if (millis() - lastData > OTA_PULL_TIMEOUT_MS) { otaAbort("timeout"); ok = false; break; }
+          vTaskDelay(pdMS_TO_TICKS(2));
+          continue;
+        }
+        const int n = s->read(buf, avail < (int)sizeof(buf) ? avail : sizeof(buf));
+        if (n <= 0) continue;
+        lastData = millis();
+        if (!body.write(buf, n)) {
+          // A sink failure already ended the session inside otaWrite().
+          if (strcmp(body.error(), "sink") != 0) otaAbort(body.error());
+          ok = false;
+        }
+      }
+      if (ok) otaEnd();
+    }
+    http.end();
+  }
+
+  delete job;
+  vTaskDelete(nullptr);
+}
+
+bool otaStartPull(OtaTarget target, const char* url, const char* sha256Hex, const char** err) {
+  const char* why = nullptr;
+  uint8_t digest[32];
+  // A running session's status stays untouched by a rejected request.
+  if (session_busy.load())                                    why = "busy";
+  else if (!url || strncmp(url, "http://", 7) != 0)          why = "url_must_be_http";
+  else if (sha256Hex && *sha256Hex && !parseHex32(sha256Hex, digest)) why = "bad_sha256";
+  if (why) {
+    if (err) *err = why;
+    return false;
+  }
+  if (!otaBegin(target, 0, sha256Hex, "pull")) {
+    if (err) *err = "busy";
+    return false;
+  }
+
+  PullJob* job = new PullJob{ target, url, sha256Hex ? sha256Hex : "" };
+  if (xTaskCreatePinnedToCore(pullTask, "ota", OTA_PULL_STACK, job, PRIO_LOG, nullptr, CORE_NET) != pdPASS) {
+    delete job;
+    otaAbort("no_task");
+    return false;
+  }
+  return true;
+}
+
+// -------------------- Rollback --------------------
+// The core marks the running app valid at startup unless this returns
+// true; we defer that to otaMarkHealthy().
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+void otaBootCheck() {
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  esp_ota_img_states_t st;
+  if (running && esp_ota_get_state_partition(running, &st) == ESP_OK && st == ESP_OTA_IMG_PENDING_VERIFY) {
+    LOGW("OTA", "running %s pending verification (rollback armed)", running->label);
+  }
+  const esp_partition_t* invalid = esp_ota_get_last_invalid_partition();
+  if (invalid) LOGW("OTA", "previous image in %s was rolled back", invalid->label);
+}
+
+void otaMarkHealthy() {
+  if (healthy_marked) return;
+  healthy_marked = true;
+  if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) LOGI("OTA", "running image marked valid");
+}
+
+bool otaRebootPending() {
+  return reboot_pending.load();
+}
+
+bool otaFsOffline() {
+  return fs_offline.load();
+}
+
+bool otaIsInstalled(OtaTarget target, const char* sha256Hex) {
+  uint8_t digest[32];
+  if (!parseHex32(sha256Hex, digest)) return false;
+
+  const OtaStatus st = otaStatus();
+  if (st.state == OTA_DONE && st.target == target && !strcasecmp(st.sha256, sha256Hex)) return true;   // awaiting reboot
+
+  Preferences p;
+  p.begin("ota", true);
+  bool same;
+  if (target == OTA_TARGET_FS) {
+    same = !strcasecmp(p.getString("fs_sha", "").c_str(), sha256Hex);
+  } else {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    same = running && p.getString("app_part", "") == running->label &&
+           !strcasecmp(p.getString("app_sha", "").c_str(), sha256Hex);
+  }
+  p.end();
+  return same;
+}
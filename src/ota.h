@@ -0,0 +1,85 @@
+/**************************************************************
+ * Over-the-air updates (app partition + LittleFS image)
+ *
+ *  - One streaming session at a time: otaBegin / otaWrite... / otaEnd.
+ *    Chunks go straight to the inactive partition through Update (one
+ *    flash sector of buffering); a SHA-256 runs over the same bytes.
+ *  - otaEnd() checks the digest against the expected one *before*
+ *    Update marks the new partition bootable; a mismatch aborts.
+ *  - Compressed / delta images (otaimage.h) are recognised by their
+ *    header and decoded on the fly; the digest covers the reconstructed
+ *    image, and a delta must match the running app byte for byte.
+ *  - Sources: HTTP upload (/api/ota, raw or multipart body) and a pull
+ *    task (otaStartPull, triggered over MQTT) fetching a plain http:// URL.
+ *  - An FS image unmounts LittleFS for the session (otaFsOffline());
+ *    every way out of the session mounts it again.
+ *  - A/B rollback: a freshly flashed app boots in PENDING_VERIFY. It is
+ *    marked valid once otaMarkHealthy() runs; a crash before that makes
+ *    the bootloader fall back to the previous slot.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+enum OtaTarget : uint8_t {
+  OTA_TARGET_APP,
+  OTA_TARGET_FS,
+};
+
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_RUNNING,
+  OTA_DONE,     // verified and committed; reboot pending
+  OTA_FAILED,
+};
+
+struct OtaStatus {
+  uint8_t  state;
+  uint8_t  target;
+  uint32_t written;        // image bytes written to flash
+  uint32_t received;       // bytes received from the source (compressed size)
+  uint32_t total;          // expected received bytes, 0 = unknown
+  uint32_t elapsedMs;
+  uint32_t bytesPerSec;
+  char     source[8];      // "upload" / "pull"
+  char     encoding[12];   // "raw", "lzss", "delta", "delta+lzss"
+  char     error[48];
+  char     sha256[65];     // hex digest of the written image (when done)
+};
+
+static const uint32_t OTA_HEALTHY_AFTER_MS = 60000;
+static const uint32_t OTA_STALL_MS         = 30000;
+
+// Starts a session. total = 0 if unknown. sha256Hex (64 hex chars) is optional.
+bool otaBegin(OtaTarget target, size_t total, const char* sha256Hex, const char* source);
+bool otaWrite(const uint8_t* data, size_t len);
+// Verifies and commits. On success a reboot is pending.
+bool otaEnd();
+void otaAbort(const char* why);
+
+OtaStatus otaStatus();
+const char* otaTargetStr(uint8_t t);
+const char* otaStateStr(uint8_t s);
+bool otaParseTarget(const char* s, OtaTarget &out);
+
+// Spawns the pull task (http:// only). False if a session is running or
+// an argument is bad; *err (optional) says which. A rejected request does
+// not touch otaStatus().
+bool otaStartPull(OtaTarget target, const char* url, const char* sha256Hex, const char** err = nullptr);
+
+// Net task housekeeping: aborts a session that stopped receiving data
+// (e.g. the uploading client went away mid-transfer).
+void otaPoll();
+
+// True while an FS image is being written: LittleFS is unmounted, so
+// file access (static pages, history flush) must wait.
+bool otaFsOffline();
+
+// True if sha256Hex is the image already in place for `target`: the app
+// running now, the last FS image written, or the one awaiting a reboot.
+bool otaIsInstalled(OtaTarget target, const char* sha256Hex);
+
+// Boot/rollback bookkeeping.
+void otaBootCheck();
+void otaMarkHealthy();
+bool otaRebootPending();
@@ -0,0 +1,199 @@
+#include "otaimage.h"
+
+#include <string.h>
+
+static uint32_t rd32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool otaImageIsContainer(const uint8_t* p, size_t len) {
+  return len >= 4 && memcmp(p, "SNU1", 4) == 0;
+}
+
+bool otaImageParseHeader(const uint8_t* p, OtaImageHeader &h) {
+  if (!otaImageIsContainer(p, OTA_IMG_HEADER)) return false;
+  h.flags = p[4];
+  h.target = p[5];
+  h.outSize = rd32(p + 8);
+  h.baseSize = rd32(p + 12);
+  memcpy(h.outSha, p + 16, 32);
+  memcpy(h.baseSha, p + 48, 32);
+  if (h.flags & ~(OTA_IMG_LZSS | OTA_IMG_DELTA)) return false;
+  return h.outSize > 0;
+}
+
+void OtaImageDecoder::begin(const OtaImageHeader &h, OtaImageSink sink, OtaImageBaseRead base, void* ctx) {
+  _h = h;
+  _sink = sink;
+  _base = base;
+  _ctx = ctx;
+  _error = nullptr;
+  _produced = 0;
+  memset(_window, 0, sizeof(_window));
+  _wpos = 0;
+  _bits = 0;
+  _haveLo = false;
+  _ds = D_OP;
+  _fieldBytes = 0;
+  _stageLen = 0;
+}
+
+bool OtaImageDecoder::finished() const {
+  const bool streamDone = (_h.flags & OTA_IMG_DELTA) ? (_ds == D_END) : true;
+  return !_error && streamDone && _produced == _h.outSize && _stageLen == 0;
+}
+
+// -------------------- Sink staging --------------------
+bool OtaImageDecoder::flushStage() {
+  if (!_stageLen) return true;
+  const size_t n = _stageLen;
+  _stageLen = 0;
+  return _sink(_stage, n, _ctx) || fail("sink");
+}
+
+bool OtaImageDecoder::emit(const uint8_t* p, size_t n) {
+  if (_produced + n > _h.outSize) return fail("too_long");
+  _produced += n;
+  while (n) {
+    size_t k = STAGE - _stageLen;
+    if (k > n) k = n;
+    memcpy(_stage + _stageLen, p, k);
+    _stageLen += k;
+    p += k;
+    n -= k;
+    if (_stageLen == STAGE && !flushStage()) return false;
+  }
+  if (_produced == _h.outSize) return flushStage();
+  return true;
+}
+
+// -------------------- Delta --------------------
+bool OtaImageDecoder::addByte(uint8_t b) {
+  if (_basePos == _baseLen) {
+    const uint32_t n = _remaining < sizeof(_baseBuf) ? _remaining : sizeof(_baseBuf);
+    if (!_base || !_base(_baseOff, _baseBuf, n, _ctx)) return fail("base_read");
+    _baseOff += n;
+    _baseLen = (uint8_t)n;
+    _basePos = 0;
+  }
+  const uint8_t c = (uint8_t)(_baseBuf[_basePos++] + b);
+  if (!emit(&c, 1)) return false;
+  if (--_remaining == 0) _ds = D_OP;
+  return true;
+}
+
+bool OtaImageDecoder::deltaByte(uint8_t b) {
+  switch (_ds) {
+    case D_OP:
+      _op = b;
+      _fieldBytes = 0;
+      _field = 0;
+      if (b == 'C' || b == 'A') _ds = D_OFF;
+      else if (b == 'I')        _ds = D_LEN;
+      else if (b == 'E')        { _ds = D_END; return flushStage(); }
+      else return fail("bad_op");
+      return true;
+
+    case D_OFF:
+    case D_LEN:
+      _field |= (uint32_t)b << (8 * _fieldBytes);
+      if (++_fieldBytes < 4) return true;
+      _fieldBytes = 0;
+      if (_ds == D_OFF) {
+        _baseOff = _field;
+        _field = 0;
+        _ds = D_LEN;
+        return true;
+      }
+      _remaining = _field;
+      if (_op != 'I' && (_baseOff + _remaining < _baseOff || _baseOff + _remaining > _h.baseSize)) {
+        return fail("base_range");
+      }
+      if (_op == 'A') {
+        _basePos = _baseLen = 0;
+        _ds = _remaining ? D_ADD_DATA : D_OP;
+        return true;
+      }
+      if (_op == 'I') {
+        _ds = _remaining ? D_INS_DATA : D_OP;
+        return true;
+      }
+      // 'C': copy from the base in small blocks
+      while (_remaining) {
+        uint8_t buf[128];
+        const uint32_t n = _remaining < sizeof(buf) ? _remaining : sizeof(buf);
+        if (!_base || !_base(_baseOff, buf, n, _ctx)) return fail("base_read");
+        if (!emit(buf, n)) return false;
+        _baseOff += n;
+        _remaining -= n;
+      }
+      _ds = D_OP;
+      return true;
+
+    case D_ADD_DATA:
+      return addByte(b);
+
+    case D_INS_DATA:
+      if (!emit(&b, 1)) return false;
+      if (--_remaining == 0) _ds = D_OP;
+      return true;
+
+    case D_END:
+    default:
+      return fail("trailing_data");
+  }
+}
+
+// -------------------- LZSS --------------------
+bool OtaImageDecoder::lzssByte(uint8_t b) {
+  auto out = [this](uint8_t c) -> bool {
+    _window[_wpos] = c;
+    _wpos = (_wpos + 1) & (WINDOW - 1);
+    return (_h.flags & OTA_IMG_DELTA) ? deltaByte(c) : emit(&c, 1);
+  };
+
+  if (_bits == 0) {
+    _flags = b;
+    _bits = 8;
+    return true;
+  }
+
+  if (_flags & 1) {
+    _flags >>= 1;
+    _bits--;
+    return out(b);
+  }
+
+  if (!_haveLo) {
+    _haveLo = true;
+    _lo = b;
+    return true;
+  }
+  _haveLo = false;
+  _flags >>= 1;
+  _bits--;
+
+  const uint16_t dist = (uint16_t)(((b >> 4) << 8) | _lo) + 1;
+  const uint8_t len = (b & 0x0F) + 3;
+  uint16_t src = (uint16_t)((_wpos - dist) & (WINDOW - 1));
+  for (uint8_t i = 0; i < len; i++) {
+    const uint8_t c = _window[src];
+    src = (src + 1) & (WINDOW - 1);
+    if (!out(c)) return false;
+  }
+  return true;
+}
+
+bool OtaImageDecoder::write(const uint8_t* data, size_t len) {
+  if (_error) return false;
+  const bool lzss = _h.flags & OTA_IMG_LZSS;
+  const bool delta = _h.flags & OTA_IMG_DELTA;
+
+  if (!lzss && !delta) return emit(data, len);
+
+  for (size_t i = 0; i < len; i++) {
+    const bool ok = lzss ? lzssByte(data[i]) : deltaByte(data[i]);
+    if (!ok) return false;
+  }
+  return true;
+}
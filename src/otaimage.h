@@ -0,0 +1,103 @@
+/**************************************************************
+ * OTA image container: compressed and delta updates
+ *
+ *  Layout (little-endian), produced by tools/otapack.py:
+ *    0  "SNU1"
+ *    4  u8  flags      OTA_IMG_LZSS | OTA_IMG_DELTA
+ *    5  u8  target     0 = app, 1 = LittleFS
+ *    6  u16 reserved
+ *    8  u32 outSize    size of the reconstructed image
+ *   12  u32 baseSize   delta: bytes of the running app it was made against
+ *   16  u8[32]         SHA-256 of the reconstructed image
+ *   48  u8[32]         delta: SHA-256 of those baseSize bytes
+ *   80  payload
+ *
+ *  Payload pipeline: [LZSS decode] -> [delta apply] -> sink.
+ *  - LZSS: flag byte per 8 items (bit set = literal byte, clear = match
+ *    of 2 bytes: 12-bit distance-1, 4-bit length-3), 4 KB window.
+ *  - Delta ops (bsdiff-like): 'C' u32 off u32 len copies from the base,
+ *    'A' u32 off u32 len + len bytes adds them (mod 256) to the base bytes
+ *    at off, 'I' u32 len + bytes inserts new data, 'E' ends the stream.
+ *  Everything is streamed: input arrives in arbitrary chunks, RAM is the
+ *  4 KB window plus small staging buffers. Portable (no Arduino deps).
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const uint8_t OTA_IMG_LZSS  = 0x01;
+static const uint8_t OTA_IMG_DELTA = 0x02;
+
+static const size_t OTA_IMG_HEADER = 80;
+
+struct OtaImageHeader {
+  uint8_t  flags;
+  uint8_t  target;
+  uint32_t outSize;
+  uint32_t baseSize;
+  uint8_t  outSha[32];
+  uint8_t  baseSha[32];
+};
+
+// True if `p` (at least 4 bytes) starts a container.
+bool otaImageIsContainer(const uint8_t* p, size_t len);
+bool otaImageParseHeader(const uint8_t* p, OtaImageHeader &h);
+
+// Receives reconstructed image bytes. Returns false to abort.
+typedef bool (*OtaImageSink)(const uint8_t* data, size_t len, void* ctx);
+// Reads `len` bytes of the base image at `off`. Returns false on error.
+typedef bool (*OtaImageBaseRead)(uint32_t off, uint8_t* buf, size_t len, void* ctx);
+
+class OtaImageDecoder {
+public:
+  void begin(const OtaImageHeader &h, OtaImageSink sink, OtaImageBaseRead base, void* ctx);
+  // Feeds payload bytes (after the header). False on a corrupt stream or sink error.
+  bool write(const uint8_t* data, size_t len);
+  // True once the stream ended cleanly and produced exactly outSize bytes.
+  bool finished() const;
+  uint32_t produced() const { return _produced; }
+  const char* error() const { return _error; }
+
+private:
+  static const size_t WINDOW = 4096;
+  static const size_t STAGE  = 256;
+
+  bool lzssByte(uint8_t b);
+  bool deltaByte(uint8_t b);
+  bool addByte(uint8_t b);
+  bool emit(const uint8_t* p, size_t n);
+  bool flushStage();
+  bool fail(const char* why) { _error = why; return false; }
+
+  OtaImageHeader _h;
+  OtaImageSink _sink = nullptr;
+  OtaImageBaseRead _base = nullptr;
+  void* _ctx = nullptr;
+  const char* _error = nullptr;
+  uint32_t _produced = 0;
+
+  // LZSS
+  uint8_t  _window[WINDOW];
+  uint16_t _wpos = 0;
+  uint8_t  _flags = 0;
+  uint8_t  _bits = 0;
+  bool     _haveLo = false;
+  uint8_t  _lo = 0;
+
+  // Delta
+  enum DeltaState : uint8_t { D_OP, D_OFF, D_LEN, D_ADD_DATA, D_INS_DATA, D_END };
+  DeltaState _ds = D_OP;
+  uint8_t  _op = 0;
+  uint8_t  _fieldBytes = 0;
+  uint32_t _field = 0;
+  uint32_t _baseOff = 0;
+  uint32_t _remaining = 0;
+  uint8_t  _baseBuf[64];   // base bytes for the running 'A' op
+  uint8_t  _basePos = 0;
+  uint8_t  _baseLen = 0;
+
+  // Staging for the sink
+  uint8_t _stage[STAGE];
+  size_t  _stageLen = 0;
+};
@@ -0,0 +1,369 @@
+#include "peerbind.h"
+#include "control.h"
+#include "groupmsg.h"
+#include "log.h"
+#include "mpsc.h"
+#include "peertransport.h"
+#include "spsc.h"
+#include "taskcfg.h"
+
+#include <WiFi.h>
+#include <atomic>
+#include "esp_system.h"
+
+// -------------------- Tuning --------------------
+static const uint32_t PEER_STACK = 3072;
+
+// -------------------- State --------------------
+// `cfg` is shared under cfg_mux; the task keeps its own copy, refreshed
+// when cfg_version moves.
+static PeerCfg cfg;
+static portMUX_TYPE cfg_mux = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<uint32_t> cfg_version{0};
+
+static EspNowTransport espnow;
+static UdpPeerTransport udp(PEER_UDP_PORT);
+static PeerTransport* const transports[] = { &espnow, &udp };
+
+// A raw datagram, as the receive callback saw it; decoded by the peer task.
+struct RxFrame {
+  PeerTransport* t;
+  PeerAddr from;
+  uint32_t us;
+  uint8_t  data[PEER_MSG_LEN];
+};
+
+static SpscQueue<ControlEvent, 16> events_q;   // control task -> peer task
+static MpscQueue<RxFrame, 16>      rx_q;       // receive callbacks -> peer task
+static TaskHandle_t peer_task = nullptr;
+
+static GroupReplayWindow replay;   // peer task only
+
+static uint32_t own_sender = 0;
+
+static std::atomic<uint32_t> st_sent{0}, st_acked{0}, st_retries{0}, st_failed{0};
+static std::atomic<uint32_t> st_rx{0}, st_applied{0}, st_dup{0}, st_bad{0}, st_challenged{0};
+static std::atomic<uint32_t> st_rtt_last{0}, st_rtt_max{0};
+
+static inline void bump(std::atomic<uint32_t> &c) {
+  c.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* peerModeStr(uint8_t mode) {
+  return mode == BIND_FOLLOW ? "follow" : "toggle";
+}
+
+static PeerCfg cfgCopy() {
+  portENTER_CRITICAL(&cfg_mux);
+  const PeerCfg c = cfg;
+  portEXIT_CRITICAL(&cfg_mux);
+  return c;
+}
+
+static PeerTransport* transportFor(const PeerAddr &a) {
+  for (PeerTransport* t : transports) {
+    if (t->kind() == a.kind) return t;
+  }
+  return nullptr;
+}
+
+// -------------------- Receive (Wi-Fi / AsyncUDP tasks) --------------------
+// Copy and hand over only: the HMAC, the replay check and every reply
+// run in the peer task, not in the radio's callback.
+static void onReceive(PeerTransport* t, const PeerAddr &from, const uint8_t* data, size_t len) {
+  if (len != PEER_MSG_LEN) {
+    bump(st_bad);
+    return;
+  }
+  RxFrame f;
+  f.t = t;
+  f.from = from;
+  f.us = micros();
+  memcpy(f.data, data, PEER_MSG_LEN);
+  if (rx_q.push(f) && peer_task) xTaskNotifyGive(peer_task);
+}
+
+// -------------------- Send (peer task) --------------------
+struct Pending {
+  bool     active;
+  uint8_t  action;
+  uint8_t  attempts;
+  uint32_t seq;
+  uint32_t firstUs;
+  uint32_t firstMs;   // kept after the ACK: vouched for in a challenge
+  uint32_t dueMs;
+};
+
+static Pending pending[PEER_BINDINGS_MAX];
+static uint32_t next_seq = 0;
+
+static void sendMsg(PeerTransport* t, const PeerAddr &to, const PeerMsg &m, const PeerCfg &c) {
+  uint8_t buf[PEER_MSG_LEN];
+  peerMsgEncode(m, (const uint8_t*)c.key, strlen(c.key), buf);
+  if (t) t->send(to, buf, sizeof(buf));
+}
+
+static void transmit(const PeerCfg &c, uint8_t i) {
+  Pending &p = pending[i];
+  const PeerBinding &b = c.bindings[i];
+  PeerTransport* t = transportFor(b.addr);
+
+  sendMsg(t, b.addr, { PEER_CMD, p.action, own_sender, p.seq, 0 }, c);
+
+  p.dueMs = millis() + (PEER_ACK_TIMEOUT_MS << (p.attempts - 1));
+}
+
+static void dispatch(const PeerCfg &c, const ControlEvent &ev) {
+  for (uint8_t i = 0; i < c.count; i++) {
+    uint8_t action;
+    const uint8_t mode = c.bindings[i].mode;
+    if (mode == BIND_TOGGLE && ev.type == EV_INPUT && !ev.value) action = PEER_TOGGLE;   // press
+    else if (mode == BIND_FOLLOW && ev.type == EV_RELAY && ev.source != SRC_PEER) action = ev.value ? PEER_ON : PEER_OFF;
+    else continue;
+
+    Pending &p = pending[i];
+    p = { true, action, 1, ++next_seq, micros(), millis(), 0 };
+    bump(st_sent);
+    transmit(c, i);
+  }
+}
+
+static void noteAck(uint32_t seq, uint32_t us, bool accepted) {
+  for (Pending &p : pending) {
+    if (!p.active || p.seq != seq) continue;
+    p.active = false;
+    if (!accepted) {
+      bump(st_failed);
+      return;
+    }
+    const uint32_t rtt = us - p.firstUs;
+    bump(st_acked);
+    st_rtt_last.store(rtt, std::memory_order_relaxed);
+    if (rtt > st_rtt_max.load(std::memory_order_relaxed)) st_rtt_max.store(rtt, std::memory_order_relaxed);
+    return;
+  }
+}
+
+// Returns ms until the next retry is due (0 = none pending).
+static uint32_t retryStep(const PeerCfg &c) {
+  const uint32_t now = millis();
+  uint32_t wait = 0;
+  for (uint8_t i = 0; i < c.count; i++) {
+    Pending &p = pending[i];
+    if (!p.active) continue;
+    int32_t left = (int32_t)(p.dueMs - now);
+    if (left <= 0) {
+      if (p.attempts > PEER_RETRIES) {
+        p.active = false;
+        bump(st_failed);
+        char a[24];
+        peerFormatAddr(c.bindings[i].addr, a, sizeof(a));
+        LOGW("PEER", "no ACK from %s (seq %lu)", a, (unsigned long)p.seq);
+        continue;
+      }
+      p.attempts++;
+      bump(st_retries);
+      transmit(c, i);
+      left = (int32_t)(p.dueMs - now);
+    }
+    if (!wait || (uint32_t)left < wait) wait = (uint32_t)left;
+  }
+  return wait;
+}
+
+// -------------------- Receive (peer task) --------------------
+static void apply(const RxFrame &f, const PeerMsg &cmd, const PeerCfg &c) {
+  bool ok;
+  if (cmd.action == PEER_TOGGLE) ok = controlToggleRelay(SRC_PEER);
+  else                           ok = controlSetRelay(cmd.action == PEER_ON, SRC_PEER);
+  if (ok) bump(st_applied);
+  sendMsg(f.t, f.from, { PEER_ACK, (uint8_t)(ok ? 1 : 0), cmd.sender, cmd.seq, 0 }, c);
+}
+
+static void onCommand(const RxFrame &f, const PeerMsg &m, const PeerCfg &c) {
+  bump(st_rx);
+  const uint32_t now = millis();
+  switch (replay.check(m.sender, m.seq, now)) {
+    case GROUP_STALE:
+      return;
+    case GROUP_DUPLICATE:   // our ACK was lost: confirm again, do not re-apply
+      bump(st_dup);
+      sendMsg(f.t, f.from, { PEER_ACK, 1, m.sender, m.seq, 0 }, c);
+      return;
+    case GROUP_UNKNOWN: {   // could be a capture: hold it and ask the sender
+      const GroupMsg held = { m.sender, m.seq, 0, m.action, 0 };
+      const uint32_t nonce = replay.challenge(held, esp_random(), now);
+      bump(st_challenged);
+      sendMsg(f.t, f.from, { PEER_CHALLENGE, 0, m.sender, 0, nonce }, c);
+      return;
+    }
+    case GROUP_FRESH:
+      apply(f, m, c);
+      return;
+  }
+}
+
+// We are the sender: vouch for the latest command sent to that peer.
+static void onChallenge(const RxFrame &f, const PeerMsg &m, const PeerCfg &c) {
+  for (uint8_t i = 0; i < c.count; i++) {
+    const Pending &p = pending[i];
+    if (!p.seq || !peerAddrEqual(c.bindings[i].addr, f.from)) continue;
+    GroupResponse r;
+    if (!groupVouch({ 0, m.sender, m.nonce }, own_sender, p.seq, p.firstMs, millis(), r)) return;
+    sendMsg(f.t, f.from, { PEER_RESPONSE, 0, own_sender, r.seq, r.nonce }, c);
+    return;
+  }
+}
+
+static void onResponse(const RxFrame &f, const PeerMsg &m, const PeerCfg &c) {
+  GroupMsg held;
+  if (!replay.answer({ m.sender, m.nonce, m.seq }, millis(), held)) return;
+  apply(f, { PEER_CMD, held.cmd, held.sender, held.seq, 0 }, c);
+}
+
+static void handleFrame(const RxFrame &f, const PeerCfg &c) {
+  if (!c.enabled || !c.key[0]) return;
+  PeerMsg m;
+  if (!peerMsgDecode(f.data, PEER_MSG_LEN, (const uint8_t*)c.key, strlen(c.key), m)) {
+    bump(st_bad);
+    return;
+  }
+  switch (m.type) {
+    case PEER_CMD:
+      onCommand(f, m, c);
+      break;
+    case PEER_ACK:
+      if (m.sender == own_sender) noteAck(m.seq, f.us, m.action == 1);
+      break;
+    case PEER_CHALLENGE:
+      if (m.sender == own_sender) onChallenge(f, m, c);
+      break;
+    case PEER_RESPONSE:
+      onResponse(f, m, c);
+      break;
+  }
+}
+
+static void peerTask(void*) {
+  PeerCfg c = cfgCopy();
+  uint32_t seenVersion = cfg_version.load();
+  uint32_t waitMs = 1000;
+
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+
+    const uint32_t v = cfg_version.load();
+    if (v != seenVersion) {
+      seenVersion = v;
+      c = cfgCopy();
+      memset(pending, 0, sizeof(pending));   // bindings may have moved
+    }
+
+    ControlEvent ev;
+    while (events_q.pop(ev)) {
+      if (c.enabled && c.key[0]) dispatch(c, ev);
+    }
+    RxFrame f;
+    while (rx_q.pop(f)) handleFrame(f, c);
+
+    const uint32_t retry = retryStep(c);
+    waitMs = retry ? retry : 1000;
+  }
+}
+
+// Control task: hand the event over; the peer task does the rest.
+static void onControlEvent(const ControlEvent &ev) {
+  if (ev.source == SRC_PEER && ev.type == EV_RELAY) return;
+  if (events_q.push(ev) && peer_task) xTaskNotifyGive(peer_task);
+}
+
+// -------------------- Lifecycle --------------------
+void peerBegin() {
+  while (!own_sender) own_sender = esp_random();
+  xTaskCreatePinnedToCore(peerTask, "peer", PEER_STACK, nullptr, PRIO_PEER, &peer_task, CORE_NET);
+  controlSetEventHook(onControlEvent);
+}
+
+void peerStart() {
+  const PeerCfg c = cfgCopy();
+  const bool up = c.enabled && c.key[0] && WiFi.isConnected();
+  for (PeerTransport* t : transports) {
+    if (!up) t->end();
+    else if (!t->begin(onReceive)) LOGW("PEER", "%s transport failed to start", t->name());
+  }
+  if (up) LOGI("PEER", "%u binding(s), listening on espnow + udp:%u", c.count, PEER_UDP_PORT);
+}
+
+void peerConfigure(const PeerCfg &c) {
+  portENTER_CRITICAL(&cfg_mux);
+  cfg = c;
+  portEXIT_CRITICAL(&cfg_mux);
+  cfg_version.fetch_add(1);
+  if (peer_task) xTaskNotifyGive(peer_task);
+  peerStart();
+}
+
+PeerCfg peerConfig() {
+  return cfgCopy();
+}
+
+// -------------------- Helpers --------------------
+bool peerParseBindings(const char* s, PeerCfg &c) {
+  PeerBinding tmp[PEER_BINDINGS_MAX] = {};
+  uint8_t n = 0;
+  char item[48];
+
+  while (s && *s) {
+    while (*s == ' ' || *s == ',') s++;
+    if (!*s) break;
+    size_t len = strcspn(s, ",");
+    if (len >= sizeof(item) || n == PEER_BINDINGS_MAX) return false;
+    memcpy(item, s, len);
+    item[len] = 0;
+    s += len;
+
+    char* eq = strrchr(item, '=');
+    uint8_t mode = BIND_TOGGLE;
+    if (eq) {
+      *eq = 0;
+      if (!strcmp(eq + 1, "follow"))      mode = BIND_FOLLOW;
+      else if (strcmp(eq + 1, "toggle")) return false;
+    }
+    if (!peerParseAddr(item, tmp[n].addr, PEER_UDP_PORT)) return false;
+    tmp[n].mode = mode;
+    n++;
+  }
+
+  memcpy(c.bindings, tmp, sizeof(tmp));
+  c.count = n;
+  return true;
+}
+
+String peerBindingsStr(const PeerCfg &c) {
+  String s;
+  char a[24];
+  for (uint8_t i = 0; i < c.count; i++) {
+    peerFormatAddr(c.bindings[i].addr, a, sizeof(a));
+    if (s.length()) s += ',';
+    s += a;
+    s += '=';
+    s += peerModeStr(c.bindings[i].mode);
+  }
+  return s;
+}
+
+PeerStats peerStats() {
+  return {
+    st_sent.load(std::memory_order_relaxed),
+    st_acked.load(std::memory_order_relaxed),
+    st_retries.load(std::memory_order_relaxed),
+    st_failed.load(std::memory_order_relaxed),
+    st_rx.load(std::memory_order_relaxed),
+    st_applied.load(std::memory_order_relaxed),
+    st_dup.load(std::memory_order_relaxed),
+    st_bad.load(std::memory_order_relaxed),
+    st_challenged.load(std::memory_order_relaxed),
+    st_rtt_last.load(std::memory_order_relaxed),
+    st_rtt_max.load(std::memory_order_relaxed),
+  };
+}
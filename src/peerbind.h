@@ -0,0 +1,75 @@
+/**************************************************************
+ * Peer bindings: a local input or relay drives relays on other nodes
+ *
+ *  - Modes per binding:
+ *      toggle  a press on this node's input toggles the peer's relay
+ *      follow  the peer's relay mirrors this node's relay
+ *  - No broker involved: events come from the control-task hook, a
+ *    dedicated task sends one signed datagram per bound peer (ESP-NOW
+ *    or UDP, peerlink.h) and retries until the peer acknowledges.
+ *    A newer command to the same peer replaces a pending one.
+ *  - Receive callbacks only queue the raw datagram; the same task
+ *    verifies it, de-duplicates per sender (a lost ACK makes the
+ *    sender retry) and acknowledges. A sender without a replay window
+ *    (first contact, after a reboot) is challenged first and has to
+ *    vouch for the command (groupmsg.h handshake) before it runs.
+ *    Changes caused by a peer are never forwarded (no loops).
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "peerlink.h"
+
+#ifndef PEER_BINDINGS_MAX
+#define PEER_BINDINGS_MAX 6
+#endif
+
+static const uint16_t PEER_UDP_PORT     = 4211;
+static const uint8_t  PEER_RETRIES      = 4;
+static const uint32_t PEER_ACK_TIMEOUT_MS = 15;   // doubles per retry
+
+enum PeerBindMode : uint8_t {
+  BIND_TOGGLE,
+  BIND_FOLLOW,
+};
+
+struct PeerBinding {
+  PeerAddr addr;
+  uint8_t  mode;
+};
+
+struct PeerCfg {
+  bool        enabled = false;
+  char        key[65] = "";
+  uint8_t     count = 0;
+  PeerBinding bindings[PEER_BINDINGS_MAX] = {};
+};
+
+struct PeerStats {
+  uint32_t sent;        // commands (not counting retries)
+  uint32_t acked;
+  uint32_t retries;
+  uint32_t failed;      // no ACK after all retries
+  uint32_t received;
+  uint32_t applied;
+  uint32_t duplicate;
+  uint32_t badMac;
+  uint32_t challenged;  // commands held until the sender answered a challenge
+  uint32_t rttLastUs;   // send -> ACK of the last acknowledged command
+  uint32_t rttMaxUs;
+};
+
+// Starts the binding task and hooks control events. Call once after controlBegin().
+void peerBegin();
+// Safe from any task; (re)starts the transports.
+void peerConfigure(const PeerCfg &cfg);
+PeerCfg peerConfig();
+// Transports up/down (call when the station (re)connects).
+void peerStart();
+
+// "aa:bb:cc:dd:ee:ff=toggle,udp:192.168.1.40=follow"
+bool peerParseBindings(const char* s, PeerCfg &cfg);
+String peerBindingsStr(const PeerCfg &cfg);
+const char* peerModeStr(uint8_t mode);
+
+PeerStats peerStats();
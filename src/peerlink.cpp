@@ -0,0 +1,93 @@
+#include "peerlink.h"
+#include "hmac.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline void put32(uint8_t* p, uint32_t v) {
+  p[0] = v >> 24; p[1] = (uint8_t)(v >> 16); p[2] = (uint8_t)(v >> 8); p[3] = (uint8_t)v;
+}
+static inline uint32_t get32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// -------------------- Addresses --------------------
+bool peerParseAddr(const char* s, PeerAddr &out, uint16_t defaultPort) {
+  PeerAddr a = {};
+  if (!s) return false;
+
+  if (!strncmp(s, "udp:", 4)) {
+    unsigned ip[4], port = defaultPort;
+    char tail = 0;
+    const int n = sscanf(s + 4, "%u.%u.%u.%u:%u%c", &ip[0], &ip[1], &ip[2], &ip[3], &port, &tail);
+    if (n != 4 && n != 5) return false;
+    for (unsigned v : ip) if (v > 255) return false;
+    if (port < 1 || port > 65535) return false;
+    a.kind = PEER_ADDR_UDP;
+    for (int i = 0; i < 4; i++) a.b[i] = (uint8_t)ip[i];
+    a.b[4] = (uint8_t)(port >> 8);
+    a.b[5] = (uint8_t)port;
+    out = a;
+    return true;
+  }
+
+  unsigned m[6];
+  char tail = 0;
+  if (sscanf(s, "%2x:%2x:%2x:%2x:%2x:%2x%c", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], &tail) != 6) return false;
+  a.kind = PEER_ADDR_ESPNOW;
+  for (int i = 0; i < 6; i++) a.b[i] = (uint8_t)m[i];
+  if (a.b[0] & 0x01) return false;   // no multicast/broadcast peers
+  out = a;
+  return true;
+}
+
+void peerFormatAddr(const PeerAddr &a, char* out, size_t n) {
+  if (a.kind == PEER_ADDR_UDP) {
+    snprintf(out, n, "udp:%u.%u.%u.%u:%u", a.b[0], a.b[1], a.b[2], a.b[3], (unsigned)((a.b[4] << 8) | a.b[5]));
+  } else if (a.kind == PEER_ADDR_ESPNOW) {
+    snprintf(out, n, "%02x:%02x:%02x:%02x:%02x:%02x", a.b[0], a.b[1], a.b[2], a.b[3], a.b[4], a.b[5]);
+  } else if (n) {
+    out[0] = 0;
+  }
+}
+
+bool peerAddrEqual(const PeerAddr &a, const PeerAddr &b) {
+  return a.kind == b.kind && memcmp(a.b, b.b, sizeof(a.b)) == 0;
+}
+
+// -------------------- Messages --------------------
+static const size_t PEER_BODY_LEN = PEER_MSG_LEN - PEER_MAC_LEN;
+
+static bool mac(const uint8_t* key, size_t keyLen, const uint8_t* msg, uint8_t out[PEER_MAC_LEN]) {
+  uint8_t full[HMAC_SHA256_LEN];
+  if (!hmacSha256(key, keyLen, msg, PEER_BODY_LEN, full)) return false;
+  memcpy(out, full, PEER_MAC_LEN);
+  return true;
+}
+
+void peerMsgEncode(const PeerMsg &m, const uint8_t* key, size_t keyLen, uint8_t out[PEER_MSG_LEN]) {
+  out[0] = 'S';
+  out[1] = 'B';
+  out[2] = m.type;
+  out[3] = m.action;
+  put32(out + 4, m.sender);
+  put32(out + 8, m.seq);
+  put32(out + 12, m.nonce);
+  if (!mac(key, keyLen, out, out + PEER_BODY_LEN)) memset(out + PEER_BODY_LEN, 0, PEER_MAC_LEN);
+}
+
+bool peerMsgDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, PeerMsg &m) {
+  if (len != PEER_MSG_LEN || in[0] != 'S' || in[1] != 'B') return false;
+
+  uint8_t want[PEER_MAC_LEN];
+  if (!mac(key, keyLen, in, want) || !hmacEqual(want, in + PEER_BODY_LEN, PEER_MAC_LEN)) return false;
+
+  m.type = in[2];
+  m.action = in[3];
+  m.sender = get32(in + 4);
+  m.seq = get32(in + 8);
+  m.nonce = get32(in + 12);
+  if (m.type == PEER_CMD) return m.action <= PEER_TOGGLE;
+  return m.type == PEER_ACK || m.type == PEER_CHALLENGE || m.type == PEER_RESPONSE;
+}
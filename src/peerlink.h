@@ -0,0 +1,77 @@
+/**************************************************************
+ * Node-to-node links: transport interface + message format
+ *
+ *  - A PeerTransport moves small datagrams to a PeerAddr. ESP-NOW is
+ *    the default on hardware; UDP unicast implements the same interface
+ *    (peers on another channel/AP; peerposix.h in a native build).
+ *  - Messages are 24 bytes: "SB", type, action, u32 sender, u32 seq,
+ *    u32 nonce, 8-byte truncated HMAC-SHA256. An ACK echoes the
+ *    command's sender and seq, so the sender can match it without
+ *    extra state.
+ *  - CHALLENGE / RESPONSE carry the handshake for senders a receiver
+ *    has no replay window for (groupmsg.h): the challenge names the
+ *    sender and a nonce, the response returns the nonce with the seq
+ *    the sender vouches for.
+ *  Portable: no Arduino dependencies (hmac.h).
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum PeerAddrKind : uint8_t {
+  PEER_ADDR_NONE,
+  PEER_ADDR_ESPNOW,   // b = station MAC
+  PEER_ADDR_UDP,      // b = IPv4 (4) + port (2, big-endian)
+};
+
+struct PeerAddr {
+  uint8_t kind;
+  uint8_t b[6];
+};
+
+// "aa:bb:cc:dd:ee:ff" (ESP-NOW) or "udp:192.168.1.40[:4211]".
+bool peerParseAddr(const char* s, PeerAddr &out, uint16_t defaultPort);
+void peerFormatAddr(const PeerAddr &a, char* out, size_t n);
+bool peerAddrEqual(const PeerAddr &a, const PeerAddr &b);
+
+class PeerTransport {
+public:
+  typedef void (*RxFn)(PeerTransport* t, const PeerAddr &from, const uint8_t* data, size_t len);
+
+  virtual ~PeerTransport() {}
+  virtual bool begin(RxFn rx) = 0;
+  virtual void end() = 0;
+  // Non-blocking best effort; false if it could not be queued.
+  virtual bool send(const PeerAddr &to, const uint8_t* data, size_t len) = 0;
+  virtual uint8_t kind() const = 0;
+  virtual const char* name() const = 0;
+};
+
+// -------------------- Messages --------------------
+static const size_t PEER_MSG_LEN = 24;
+static const size_t PEER_MAC_LEN = 8;
+
+enum PeerMsgType : uint8_t {
+  PEER_CMD = 1,
+  PEER_ACK = 2,
+  PEER_CHALLENGE = 3,   // sender = the sender being asked
+  PEER_RESPONSE = 4,
+};
+
+enum PeerAction : uint8_t {
+  PEER_OFF,
+  PEER_ON,
+  PEER_TOGGLE,
+};
+
+struct PeerMsg {
+  uint8_t  type;
+  uint8_t  action;   // CMD: PeerAction; ACK: resulting relay state (0/1)
+  uint32_t sender;
+  uint32_t seq;
+  uint32_t nonce;    // CHALLENGE / RESPONSE only, 0 otherwise
+};
+
+void peerMsgEncode(const PeerMsg &m, const uint8_t* key, size_t keyLen, uint8_t out[PEER_MSG_LEN]);
+bool peerMsgDecode(const uint8_t* in, size_t len, const uint8_t* key, size_t keyLen, PeerMsg &m);
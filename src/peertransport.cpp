@@ -0,0 +1,90 @@
+#include "peertransport.h"
+#include "log.h"
+
+#include <WiFi.h>
+#include <esp_now.h>
+
+// -------------------- ESP-NOW --------------------
+// The IDF callbacks carry no context; there is one ESP-NOW instance.
+static EspNowTransport* espnow_self = nullptr;
+static PeerTransport::RxFn espnow_rx = nullptr;
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+static void onEspNowRecv(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+  const uint8_t* mac = info->src_addr;
+#else
+static void onEspNowRecv(const uint8_t* mac, const uint8_t* data, int len) {
+#endif
+  if (!espnow_self || !espnow_rx || len <= 0) return;
+  PeerAddr from = {};
+  from.kind = PEER_ADDR_ESPNOW;
+  memcpy(from.b, mac, 6);
+  espnow_rx(espnow_self, from, data, (size_t)len);
+}
+
+bool EspNowTransport::begin(RxFn rx) {
+  if (_started) return true;
+  if (esp_now_init() != ESP_OK) {
+    LOGE("PEER", "esp_now_init failed");
+    return false;
+  }
+  espnow_self = this;
+  espnow_rx = rx;
+  esp_now_register_recv_cb(onEspNowRecv);
+  _started = true;
+  return true;
+}
+
+void EspNowTransport::end() {
+  if (!_started) return;
+  esp_now_unregister_recv_cb();
+  esp_now_deinit();
+  espnow_self = nullptr;
+  _started = false;
+}
+
+bool EspNowTransport::send(const PeerAddr &to, const uint8_t* data, size_t len) {
+  if (!_started || to.kind != PEER_ADDR_ESPNOW) return false;
+  if (!esp_now_is_peer_exist(to.b)) {
+    esp_now_peer_info_t p = {};
+    memcpy(p.peer_addr, to.b, 6);
+    p.channel = 0;   // current channel
+    p.ifidx = WIFI_IF_STA;
+    p.encrypt = false;   // messages carry their own HMAC
+    if (esp_now_add_peer(&p) != ESP_OK) return false;
+  }
+  return esp_now_send(to.b, data, len) == ESP_OK;
+}
+
+// -------------------- UDP --------------------
+bool UdpPeerTransport::begin(RxFn rx) {
+  if (_started) return true;
+  if (!_udp.listen(_port)) {
+    LOGE("PEER", "udp listen %u failed", _port);
+    return false;
+  }
+  _udp.onPacket([this, rx](AsyncUDPPacket &pkt) {
+    const IPAddress ip = pkt.remoteIP();
+    const uint16_t port = pkt.remotePort();
+    PeerAddr from = {};
+    from.kind = PEER_ADDR_UDP;
+    for (int i = 0; i < 4; i++) from.b[i] = ip[i];
+    from.b[4] = (uint8_t)(port >> 8);
+    from.b[5] = (uint8_t)port;
+    rx(this, from, pkt.data(), pkt.length());
+  });
+  _started = true;
+  return true;
+}
+
+void UdpPeerTransport::end() {
+  if (!_started) return;
+  _udp.close();
+  _started = false;
+}
+
+bool UdpPeerTransport::send(const PeerAddr &to, const uint8_t* data, size_t len) {
+  if (!_started || to.kind != PEER_ADDR_UDP) return false;
+  const IPAddress ip(to.b[0], to.b[1], to.b[2], to.b[3]);
+  return _udp.writeTo(data, len, ip, (uint16_t)((to.b[4] << 8) | to.b[5])) == len;
+}
@@ -0,0 +1,42 @@
+/**************************************************************
+ * Peer transports for the ESP32 (peerlink.h interface)
+ *
+ *  - EspNowTransport: connectionless 802.11 action frames on the
+ *    channel of the current AP; one frame each way, no IP stack.
+ *    Peers are registered on first send.
+ *  - UdpPeerTransport: plain unicast UDP (AsyncUDP); for peers that are
+ *    not on the same channel. Host builds use sim/peerudp.h instead.
+ *  Receive callbacks run in the Wi-Fi / AsyncUDP task: keep them short.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include "peerlink.h"
+
+class EspNowTransport : public PeerTransport {
+public:
+  bool begin(RxFn rx) override;
+  void end() override;
+  bool send(const PeerAddr &to, const uint8_t* data, size_t len) override;
+  uint8_t kind() const override { return PEER_ADDR_ESPNOW; }
+  const char* name() const override { return "espnow"; }
+
+private:
+  bool _started = false;
+};
+
+class UdpPeerTransport : public PeerTransport {
+public:
+  explicit UdpPeerTransport(uint16_t port) : _port(port) {}
+  bool begin(RxFn rx) override;
+  void end() override;
+  bool send(const PeerAddr &to, const uint8_t* data, size_t len) override;
+  uint8_t kind() const override { return PEER_ADDR_UDP; }
+  const char* name() const override { return "udp"; }
+
+private:
+  AsyncUDP _udp;
+  uint16_t _port;
+  bool _started = false;
+};
@@ -0,0 +1,118 @@
+#include "powerstate.h"
+#include "log.h"
+
+#include "esp_partition.h"
+
+// -------------------- State --------------------
+// The journal is used by setup() and then only by the control task;
+// other tasks read the copy in `stats` under stats_mux.
+static const char*    JOURNAL_LABEL  = "journal";
+static const uint32_t ERASE_RETRY_MS = 60000;
+
+static const esp_partition_t* part = nullptr;
+static StateJournal journal;
+static bool recorded = false;   // last journaled relay state (valid if journal has one)
+static bool have_record = false;
+
+static PowerStats stats = {};
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// -------------------- Flash --------------------
+static bool flashRead(void*, uint32_t off, void* buf, size_t len) {
+  return esp_partition_read(part, off, buf, len) == ESP_OK;
+}
+
+static bool flashWrite(void*, uint32_t off, const void* buf, size_t len) {
+  return esp_partition_write(part, off, buf, len) == ESP_OK;
+}
+
+static bool flashErase(void*, uint32_t off) {
+  return esp_partition_erase_range(part, off, JOURNAL_SECTOR) == ESP_OK;
+}
+
+static void publishStats(bool failed) {
+  const JournalStats j = journal.stats();
+  portENTER_CRITICAL(&stats_mux);
+  stats.j = j;
+  if (failed) stats.writeFails++;
+  portEXIT_CRITICAL(&stats_mux);
+}
+
+// -------------------- API --------------------
+const char* powerPolicyStr(uint8_t p) {
+  switch (p) {
+    case POWER_ON:   return "on";
+    case POWER_LAST: return "last";
+    default:         return "off";
+  }
+}
+
+bool powerParsePolicy(const char* s, uint8_t &out) {
+  if (!strcmp(s, "off"))  { out = POWER_OFF;  return true; }
+  if (!strcmp(s, "on"))   { out = POWER_ON;   return true; }
+  if (!strcmp(s, "last")) { out = POWER_LAST; return true; }
+  return false;
+}
+
+bool powerStateBegin(uint8_t policy) {
+  const uint32_t t0 = micros();
+  part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_LABEL);
+  if (part) {
+    const JournalFlash f = { nullptr, part->size - part->size % JOURNAL_SECTOR, flashRead, flashWrite, flashErase };
+    uint8_t last = 0;
+    if (journal.begin(f) && journal.last(last)) {
+      recorded = (last != 0);
+      have_record = true;
+    }
+  }
+  const uint32_t us = micros() - t0;
+
+  bool on = (policy == POWER_ON);
+  if (policy == POWER_LAST && have_record) on = recorded;
+
+  stats.policy = policy;
+  stats.journal = journal.ready();
+  stats.restored = (policy == POWER_LAST && have_record);
+  stats.bootState = on;
+  stats.bootUs = us;
+  stats.j = journal.stats();
+
+  if (!part) LOGW("POWER", "no '%s' partition: relay state is not journaled", JOURNAL_LABEL);
+  LOGI("POWER", "policy=%s last=%s -> %s (%lu us, %lu reads)", powerPolicyStr(policy),
+       have_record ? (recorded ? "on" : "off") : "none", on ? "ON" : "OFF",
+       (unsigned long)us, (unsigned long)stats.j.bootReads);
+  return on;
+}
+
+void powerSetPolicy(uint8_t policy) {
+  portENTER_CRITICAL(&stats_mux);
+  stats.policy = policy;
+  portEXIT_CRITICAL(&stats_mux);
+}
+
+void powerStateRecord(bool relay) {
+  if (!journal.ready()) return;
+  if (have_record && recorded == relay) return;
+  const bool ok = journal.append(relay ? 1 : 0);
+  if (ok) {
+    recorded = relay;
+    have_record = true;
+  }
+  publishStats(!ok);
+}
+
+void powerStateIdle() {
+  static uint32_t retry_at = 0;
+  if (!journal.needsErase()) return;
+  if (retry_at && (int32_t)(millis() - retry_at) < 0) return;
+  const bool ok = journal.prepare();
+  retry_at = ok ? 0 : (millis() + ERASE_RETRY_MS) | 1;
+  publishStats(!ok);
+}
+
+PowerStats powerStats() {
+  portENTER_CRITICAL(&stats_mux);
+  const PowerStats s = stats;
+  portEXIT_CRITICAL(&stats_mux);
+  return s;
+}
@@ -0,0 +1,51 @@
+/**************************************************************
+ * Relay state across power loss
+ *
+ *  - Relay changes are appended to a StateJournal (journal.h) in the
+ *    "journal" data partition (partitions.csv), never to NVS, so a busy
+ *    relay does not wear the config pages.
+ *  - The power-on policy picks the boot state: always off, always on,
+ *    or the last journaled state. setup() applies it in controlBegin(),
+ *    before Wi-Fi and the file system start.
+ *  - Records are written by the control task only when the state
+ *    differs from the last record. The next sector is erased while the
+ *    control task is idle.
+ *  - Without the partition (older partition table) the policy still
+ *    applies, and "last" falls back to off.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include "journal.h"
+
+enum PowerPolicy : uint8_t {
+  POWER_OFF,
+  POWER_ON,
+  POWER_LAST,
+};
+
+struct PowerStats {
+  uint8_t  policy;
+  bool     journal;     // partition found and scanned
+  bool     restored;    // boot state came from the journal
+  bool     bootState;
+  uint32_t bootUs;      // journal scan at boot
+  uint32_t writeFails;
+  JournalStats j;
+};
+
+const char* powerPolicyStr(uint8_t p);
+bool powerParsePolicy(const char* s, uint8_t &out);
+
+// setup(), before controlBegin(): opens the journal and returns the relay
+// state to apply at power-on under `policy`.
+bool powerStateBegin(uint8_t policy);
+// Takes effect at the next boot.
+void powerSetPolicy(uint8_t policy);
+
+// Control task: journals `relay` if it differs from the last record.
+void powerStateRecord(bool relay);
+// Control task, when idle: erases the next sector ahead of use.
+void powerStateIdle();
+
+PowerStats powerStats();
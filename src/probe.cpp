@@ -0,0 +1,38 @@
+#include "probe.h"
+
+static LatencyHistogram probe_hist[PROBE__COUNT];
+
+#if PROBES_ENABLED
+std::atomic<uint32_t> probeMarks[PROBE__COUNT];
+
+#if defined(ARDUINO) && PROBE_CLOCK_CCOUNT
+uint32_t probeTicksPerUs() {
+  static uint32_t mhz = 0;
+  if (!mhz) mhz = ESP.getCpuFreqMHz();
+  return mhz ? mhz : 240;
+}
+#endif
+#endif
+
+const char* probeName(uint8_t id) {
+  switch (id) {
+    case PROBE_INPUT_TO_GPIO:   return "input_to_gpio";
+    case PROBE_MQTT_TO_GPIO:    return "mqtt_to_gpio";
+    case PROBE_GPIO_TO_PUBLISH: return "gpio_to_publish";
+    case PROBE_LOOP_PERIOD:     return "loop_period";
+    default: return "unknown";
+  }
+}
+
+LatencyHistogram &probeHistogram(uint8_t id) {
+  return probe_hist[id < PROBE__COUNT ? id : 0];
+}
+
+void probeResetAll() {
+  for (uint8_t i = 0; i < PROBE__COUNT; i++) {
+    probe_hist[i].reset();
+#if PROBES_ENABLED
+    probeMarks[i].store(0, std::memory_order_relaxed);
+#endif
+  }
+}
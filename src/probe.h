@@ -0,0 +1,103 @@
+/**************************************************************
+ * Hot-path latency probes
+ *
+ *  - PROBE_MARK(id) stamps the start of a span, PROBE_END(id) records
+ *    the elapsed time into that probe's log2 histogram (histogram.h)
+ *    and clears the mark. An END without a pending MARK is ignored.
+ *  - PROBE_LAP(id) records the time since the previous LAP (period).
+ *  - Stamps come from esp_timer on the ESP32 (spans may start and end
+ *    in different tasks/cores) and from steady_clock on a host build,
+ *    so both produce identical histograms. -DPROBE_CLOCK_CCOUNT=1
+ *    selects the CPU cycle counter instead (finer, but a MARK/END pair
+ *    must then run on the same core).
+ *  - -DPROBES_ENABLED=0 compiles every probe out.
+ **************************************************************/
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include "histogram.h"
+
+#ifndef PROBES_ENABLED
+#define PROBES_ENABLED 1
+#endif
+
+enum ProbeId : uint8_t {
+  PROBE_INPUT_TO_GPIO,     // first raw input edge -> relay GPIO write (includes debounce)
+  PROBE_MQTT_TO_GPIO,      // MQTT command received -> relay GPIO write
+  PROBE_GPIO_TO_PUBLISH,   // relay GPIO write -> state publish handed to the MQTT client
+  PROBE_LOOP_PERIOD,       // loop() start -> next loop() start (jitter = spread)
+  PROBE__COUNT
+};
+
+const char* probeName(uint8_t id);
+LatencyHistogram &probeHistogram(uint8_t id);
+void probeResetAll();
+
+#if PROBES_ENABLED
+
+#ifndef PROBE_CLOCK_CCOUNT
+#define PROBE_CLOCK_CCOUNT 0
+#endif
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#if PROBE_CLOCK_CCOUNT
+static inline uint32_t probeTicks() { return ESP.getCycleCount(); }
+uint32_t probeTicksPerUs();
+#else
+#include "esp_timer.h"
+static inline uint32_t probeTicks() { return (uint32_t)esp_timer_get_time(); }
+static inline uint32_t probeTicksPerUs() { return 1; }
+#endif
+#else
+#include <chrono>
+static inline uint32_t probeTicks() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+static inline uint32_t probeTicksPerUs() { return 1; }
+#endif
+
+// 0 = no pending mark
+extern std::atomic<uint32_t> probeMarks[PROBE__COUNT];
+
+static inline void probeMark(uint8_t id) {
+  uint32_t t = probeTicks();
+  probeMarks[id].store(t ? t : 1, std::memory_order_relaxed);
+}
+
+// Marks only if no span is already open (keeps the first edge of a burst).
+static inline void probeMarkFirst(uint8_t id) {
+  uint32_t expected = 0;
+  uint32_t t = probeTicks();
+  probeMarks[id].compare_exchange_strong(expected, t ? t : 1, std::memory_order_relaxed);
+}
+
+static inline void probeEnd(uint8_t id) {
+  const uint32_t t0 = probeMarks[id].exchange(0, std::memory_order_relaxed);
+  if (!t0) return;
+  probeHistogram(id).record((probeTicks() - t0) / probeTicksPerUs());
+}
+
+static inline void probeLap(uint8_t id) {
+  const uint32_t now = probeTicks();
+  const uint32_t t0 = probeMarks[id].exchange(now ? now : 1, std::memory_order_relaxed);
+  if (t0) probeHistogram(id).record((now - t0) / probeTicksPerUs());
+}
+
+#define PROBE_MARK(id)       probeMark(id)
+#define PROBE_MARK_FIRST(id) probeMarkFirst(id)
+#define PROBE_END(id)        probeEnd(id)
+#define PROBE_LAP(id)        probeLap(id)
+#define PROBE_CANCEL(id)     probeMarks[id].store(0, std::memory_order_relaxed)
+
+#else
+
+#define PROBE_MARK(id)       do {} while (0)
+#define PROBE_MARK_FIRST(id) do {} while (0)
+#define PROBE_END(id)        do {} while (0)
+#define PROBE_LAP(id)        do {} while (0)
+#define PROBE_CANCEL(id)     do {} while (0)
+
+#endif
@@ -0,0 +1,51 @@
+#include "router.h"
+
+#include <string.h>
+
+uint32_t RouteTable::hashPath(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+bool RouteTable::add(const char* path, WebRequestMethodComposite methods, ArRequestHandlerFunction fn) {
+  if (_count >= ROUTER_SLOTS - 1) return false;   // keep one slot empty to end probes
+
+  const size_t len = strlen(path);
+  const uint32_t h = hashPath(path, len);
+  for (uint32_t i = h & (ROUTER_SLOTS - 1);; i = (i + 1) & (ROUTER_SLOTS - 1)) {
+    Route &s = _slots[i];
+    if (s.path && s.hash == h && strcmp(s.path, path) == 0) return false;   // duplicate
+    if (!s.path) {
+      s.path = path;
+      s.hash = h;
+      s.methods = methods;
+      s.fn = fn;
+      _count++;
+      return true;
+    }
+  }
+}
+
+void RouteTable::handleRequest(AsyncWebServerRequest *r) {
+  const String &url = r->url();
+  const uint32_t h = hashPath(url.c_str(), url.length());
+
+  for (uint32_t i = h & (ROUTER_SLOTS - 1);; i = (i + 1) & (ROUTER_SLOTS - 1)) {
+    const Route &s = _slots[i];
+    if (!s.path) break;
+    if (s.hash == h && strcmp(s.path, url.c_str()) == 0) {
+      if (s.methods & r->method()) {
+        s.fn(r);
+        return;
+      }
+      break;
+    }
+  }
+
+  if (_fallback) _fallback(r);
+  else r->send(404);
+}
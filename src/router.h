@@ -0,0 +1,45 @@
+/**************************************************************
+ * Single-table request router
+ *
+ *  - One AsyncWebHandler that claims every request and dispatches it
+ *    with a single hash lookup on the path (open addressing, FNV-1a),
+ *    instead of the server walking a handler list per request.
+ *  - Unmatched paths (or methods) go to the fallback.
+ *  - Routes are added once at setup; the table is not resized.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#ifndef ROUTER_SLOTS
+#define ROUTER_SLOTS 32   // power of two, > number of routes
+#endif
+
+class RouteTable : public AsyncWebHandler {
+public:
+  // `path` must outlive the table (string literal).
+  bool add(const char* path, WebRequestMethodComposite methods, ArRequestHandlerFunction fn);
+  void setFallback(ArRequestHandlerFunction fn) { _fallback = fn; }
+
+  bool canHandle(AsyncWebServerRequest *r) override { return true; }
+  void handleRequest(AsyncWebServerRequest *r) override;
+  // Not trivial: lets the server parse form bodies before dispatch.
+  bool isRequestHandlerTrivial() override { return false; }
+
+  uint8_t size() const { return _count; }
+
+private:
+  struct Route {
+    const char* path;
+    uint32_t hash;
+    WebRequestMethodComposite methods;
+    ArRequestHandlerFunction fn;
+  };
+
+  static uint32_t hashPath(const char* s, size_t len);
+
+  Route _slots[ROUTER_SLOTS] = {};
+  uint8_t _count = 0;
+  ArRequestHandlerFunction _fallback;
+};
@@ -0,0 +1,361 @@
+#include "rules.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t RULES_PULSE_MAX_MS = 60000;
+static const uint32_t RULES_LONG_MAX_MS  = 60000;
+static const uint32_t RULES_TIMER_MAX_MS = 86400000UL;   // 24 h
+static const size_t   RULES_BODY_MAX     = 64;
+
+uint32_t rulesHash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;   // FNV-1a
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// -------------------- LEB128 --------------------
+static size_t putVar(uint8_t* out, uint32_t v) {
+  size_t n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    out[n++] = b | (v ? 0x80 : 0);
+  } while (v);
+  return n;
+}
+
+static bool getVar(const uint8_t* p, size_t end, size_t &pos, uint32_t &v) {
+  v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (pos >= end) return false;
+    const uint8_t b = p[pos++];
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+// -------------------- Lexer --------------------
+struct Token {
+  const char* s;
+  size_t n;
+  bool quoted;
+};
+
+struct Lexer {
+  const char* p;
+  const char* end;
+
+  bool next(Token &t) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p >= end || *p == '#') return false;
+    t.quoted = false;
+    if (*p == ';' || *p == ',') {
+      t.s = p++;
+      t.n = 1;
+      return true;
+    }
+    if (*p == '"') {
+      const char* q = ++p;
+      while (p < end && *p != '"') p++;
+      if (p >= end) return false;
+      t.s = q;
+      t.n = (size_t)(p - q);
+      t.quoted = true;
+      p++;
+      return true;
+    }
+    t.s = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != ';' && *p != ',' && *p != '#') p++;
+    t.n = (size_t)(p - t.s);
+    return true;
+  }
+};
+
+static bool is(const Token &t, const char* word) {
+  return !t.quoted && strlen(word) == t.n && strncmp(t.s, word, t.n) == 0;
+}
+
+static bool number(const Token &t, uint32_t lo, uint32_t hi, uint32_t &out) {
+  if (t.quoted || !t.n || t.n > 9) return false;
+  uint32_t v = 0;
+  for (size_t i = 0; i < t.n; i++) {
+    if (t.s[i] < '0' || t.s[i] > '9') return false;
+    v = v * 10 + (uint32_t)(t.s[i] - '0');
+  }
+  if (v < lo || v > hi) return false;
+  out = v;
+  return true;
+}
+
+// -------------------- Compiler --------------------
+struct LineCompiler {
+  Lexer lx;
+  uint8_t trig = 0;
+  uint32_t arg = 0;
+  uint8_t body[RULES_BODY_MAX];
+  size_t blen = 0;
+  const char* error = nullptr;
+
+  bool fail(const char* why) { error = why; return false; }
+
+  bool emit(uint8_t b) {
+    if (blen >= sizeof(body)) return fail("rule too long");
+    body[blen++] = b;
+    return true;
+  }
+
+  bool emitVar(uint32_t v) {
+    uint8_t tmp[5];
+    const size_t n = putVar(tmp, v);
+    for (size_t i = 0; i < n; i++) if (!emit(tmp[i])) return false;
+    return true;
+  }
+
+  bool want(Token &t, const char* what) {
+    if (!lx.next(t)) return fail(what);
+    return true;
+  }
+
+  bool trigger() {
+    Token t, u;
+    if (!want(t, "missing trigger")) return false;
+    if (is(t, "boot")) { trig = TRIG_BOOT; return true; }
+    if (is(t, "input")) {
+      if (!want(u, "input: press/release/short/long")) return false;
+      if (is(u, "press"))   { trig = TRIG_PRESS; return true; }
+      if (is(u, "release")) { trig = TRIG_RELEASE; return true; }
+      if (is(u, "short"))   { trig = TRIG_SHORT; return true; }
+      if (is(u, "long")) {
+        trig = TRIG_LONG;
+        if (!lx.next(u) || !number(u, 1, RULES_LONG_MAX_MS, arg)) return fail("input long: ms 1-60000");
+        return true;
+      }
+      return fail("input: press/release/short/long");
+    }
+    if (is(t, "relay")) {
+      if (!want(u, "relay: on/off")) return false;
+      if (is(u, "on"))  { trig = TRIG_RELAY_ON; return true; }
+      if (is(u, "off")) { trig = TRIG_RELAY_OFF; return true; }
+      return fail("relay: on/off");
+    }
+    if (is(t, "timer")) {
+      trig = TRIG_TIMER;
+      if (!lx.next(u) || !number(u, 1, RULES_TIMERS, arg)) return fail("timer: 1-4");
+      arg -= 1;
+      return true;
+    }
+    if (is(t, "mqtt")) {
+      if (!lx.next(u) || !u.quoted) return fail("mqtt: quoted payload");
+      trig = TRIG_MQTT;
+      arg = rulesHash(u.s, u.n);
+      return true;
+    }
+    return fail("unknown trigger");
+  }
+
+  bool condition() {
+    Token t, u;
+    if (!want(t, "missing condition") || !want(u, "incomplete condition")) return false;
+    if (is(t, "relay") && is(u, "on"))      return emit(OP_IF_RELAY_ON);
+    if (is(t, "relay") && is(u, "off"))     return emit(OP_IF_RELAY_OFF);
+    if (is(t, "input") && is(u, "open"))    return emit(OP_IF_INPUT_OPEN);
+    if (is(t, "input") && is(u, "closed"))  return emit(OP_IF_INPUT_CLOSED);
+    return fail("unknown condition");
+  }
+
+  bool action(const Token &t) {
+    Token u, v;
+    uint32_t n;
+    if (is(t, "relay")) {
+      if (!want(u, "relay: on/off/toggle")) return false;
+      if (is(u, "on"))     return emit(OP_RELAY_ON);
+      if (is(u, "off"))    return emit(OP_RELAY_OFF);
+      if (is(u, "toggle")) return emit(OP_RELAY_TOGGLE);
+      return fail("relay: on/off/toggle");
+    }
+    if (is(t, "pulse")) {
+      if (!lx.next(u) || !number(u, 10, RULES_PULSE_MAX_MS, n)) return fail("pulse: ms 10-60000");
+      return emit(OP_PULSE) && emitVar(n);
+    }
+    if (is(t, "timer")) {
+      if (!lx.next(u) || !number(u, 1, RULES_TIMERS, n)) return fail("timer: 1-4");
+      if (!want(v, "timer: start/cancel")) return false;
+      if (is(v, "cancel")) return emit(OP_TIMER_CANCEL) && emit((uint8_t)(n - 1));
+      if (!is(v, "start")) return fail("timer: start/cancel");
+      uint32_t ms;
+      if (!lx.next(u) || !number(u, 1, RULES_TIMER_MAX_MS, ms)) return fail("timer start: ms");
+      return emit(OP_TIMER_START) && emit((uint8_t)(n - 1)) && emitVar(ms);
+    }
+    return fail("unknown action");
+  }
+
+  // Returns false on error; `empty` for blank/comment lines.
+  bool line(bool &empty) {
+    Token t;
+    empty = !lx.next(t);
+    if (empty) return true;
+    if (!is(t, "on")) return fail("expected 'on'");
+    if (!trigger()) return false;
+
+    if (!want(t, "expected 'if' or 'do'")) return false;
+    if (is(t, "if")) {
+      for (;;) {
+        if (!condition()) return false;
+        if (!want(t, "expected 'and' or 'do'")) return false;
+        if (is(t, "do")) break;
+        if (!is(t, "and")) return fail("expected 'and' or 'do'");
+      }
+    } else if (!is(t, "do")) {
+      return fail("expected 'if' or 'do'");
+    }
+
+    bool any = false;
+    while (lx.next(t)) {
+      if (is(t, ";") || is(t, ",")) continue;
+      if (!action(t)) return false;
+      any = true;
+    }
+    return any || fail("no action");
+  }
+};
+
+bool rulesCompile(const char* text, RuleProgram &out, RuleError &err) {
+  static RuleProgram tmp;   // keeps large buffers off small task stacks; not reentrant
+  tmp.len = 0;
+  tmp.rules = 0;
+  err.line = 0;
+  err.msg[0] = 0;
+
+  uint16_t lineNo = 0;
+  const char* p = text ? text : "";
+  while (*p) {
+    const char* eol = strchr(p, '\n');
+    if (!eol) eol = p + strlen(p);
+    lineNo++;
+
+    LineCompiler lc;
+    lc.lx = { p, eol };
+    bool empty = false;
+    if (!lc.line(empty)) {
+      err.line = lineNo;
+      snprintf(err.msg, sizeof(err.msg), "%s", lc.error);
+      return false;
+    }
+    if (!empty) {
+      uint8_t head[7];
+      size_t hn = 0;
+      head[hn++] = lc.trig;
+      hn += putVar(head + hn, lc.arg);
+      head[hn++] = (uint8_t)lc.blen;
+      if (tmp.len + hn + lc.blen > sizeof(tmp.code) || tmp.rules == 255) {
+        err.line = lineNo;
+        snprintf(err.msg, sizeof(err.msg), "program too large");
+        return false;
+      }
+      memcpy(tmp.code + tmp.len, head, hn);
+      memcpy(tmp.code + tmp.len + hn, lc.body, lc.blen);
+      tmp.len += (uint16_t)(hn + lc.blen);
+      tmp.rules++;
+    }
+    p = *eol ? eol + 1 : eol;
+  }
+
+  // The control task tracks a fixed number of long-press thresholds.
+  uint32_t seen[RULES_LONG_MAX + 1];
+  uint8_t distinct = 0;
+  for (size_t pos = 0; pos < tmp.len && distinct <= RULES_LONG_MAX;) {
+    const uint8_t trig = tmp.code[pos++];
+    uint32_t arg;
+    getVar(tmp.code, tmp.len, pos, arg);
+    pos += 1 + tmp.code[pos];
+    if (trig != TRIG_LONG) continue;
+    bool dup = false;
+    for (uint8_t i = 0; i < distinct; i++) dup |= (seen[i] == arg);
+    if (!dup) seen[distinct++] = arg;
+  }
+  if (distinct > RULES_LONG_MAX) {
+    snprintf(err.msg, sizeof(err.msg), "at most %u long-press thresholds", RULES_LONG_MAX);
+    return false;
+  }
+
+  out = tmp;
+  return true;
+}
+
+// -------------------- VM --------------------
+uint16_t rulesRun(const RuleProgram &p, uint8_t trigger, uint32_t arg, const RuleHost &h) {
+  uint16_t actions = 0;
+  size_t pos = 0;
+  while (pos < p.len) {
+    const uint8_t trig = p.code[pos++];
+    uint32_t targ;
+    if (!getVar(p.code, p.len, pos, targ) || pos >= p.len) return actions;
+    const size_t end = pos + 1 + p.code[pos];
+    size_t i = pos + 1;
+    pos = end;
+    if (end > p.len) return actions;
+    if (trig != trigger || targ != arg) continue;
+
+    bool pass = true;
+    while (pass && i < end) {
+      const uint8_t op = p.code[i++];
+      uint32_t v;
+      switch (op) {
+        case OP_IF_RELAY_ON:     pass = h.relay(h.ctx); break;
+        case OP_IF_RELAY_OFF:    pass = !h.relay(h.ctx); break;
+        case OP_IF_INPUT_OPEN:   pass = !h.inputClosed(h.ctx); break;
+        case OP_IF_INPUT_CLOSED: pass = h.inputClosed(h.ctx); break;
+        case OP_RELAY_ON:     h.setRelay(h.ctx, true); actions++; break;
+        case OP_RELAY_OFF:    h.setRelay(h.ctx, false); actions++; break;
+        case OP_RELAY_TOGGLE: h.toggle(h.ctx); actions++; break;
+        case OP_PULSE:
+          if (!getVar(p.code, end, i, v)) return actions;
+          h.pulse(h.ctx, v);
+          actions++;
+          break;
+        case OP_TIMER_START: {
+          if (i >= end) return actions;
+          const uint8_t t = p.code[i++];
+          if (!getVar(p.code, end, i, v)) return actions;
+          if (t < RULES_TIMERS) h.timerStart(h.ctx, t, v);
+          actions++;
+          break;
+        }
+        case OP_TIMER_CANCEL:
+          if (i >= end) return actions;
+          if (p.code[i] < RULES_TIMERS) h.timerCancel(h.ctx, p.code[i]);
+          i++;
+          actions++;
+          break;
+        default:
+          return actions;   // corrupt program
+      }
+    }
+  }
+  return actions;
+}
+
+uint8_t rulesLongThresholds(const RuleProgram &p, uint32_t out[RULES_LONG_MAX]) {
+  uint8_t n = 0;
+  size_t pos = 0;
+  while (pos < p.len) {
+    const uint8_t trig = p.code[pos++];
+    uint32_t arg;
+    if (!getVar(p.code, p.len, pos, arg) || pos >= p.len) break;
+    pos += 1 + p.code[pos];
+    if (trig != TRIG_LONG) continue;
+
+    bool dup = false;
+    for (uint8_t i = 0; i < n; i++) dup |= (out[i] == arg);
+    if (dup || n == RULES_LONG_MAX) continue;
+    uint8_t k = n++;
+    while (k && out[k - 1] > arg) { out[k] = out[k - 1]; k--; }   // insertion sort
+    out[k] = arg;
+  }
+  return n;
+}
@@ -0,0 +1,94 @@
+/**************************************************************
+ * Local automation rules: text -> bytecode compiler + VM
+ *
+ *  One rule per line ('#' starts a comment):
+ *    on <trigger> [if <cond> [and <cond>...]] do <action>[; <action>...]
+ *
+ *  Triggers   input press | input release | input short
+ *             input long <ms> | relay on | relay off | timer <n>
+ *             mqtt "<payload>" | boot
+ *  Conditions relay on|off, input open|closed
+ *  Actions    relay on|off|toggle, pulse <ms>,
+ *             timer <n> start <ms>, timer <n> cancel
+ *
+ *  "short" fires on release before the shortest "long" threshold.
+ *  MQTT payloads are compiled to a 32-bit FNV-1a hash.
+ *
+ *  Bytecode per rule: trigger (u8), arg (LEB128), body length (u8),
+ *  body ops. The VM scans the program once per event. It does no
+ *  allocation and its cost is bounded by RULES_MAX_BYTES. Side effects
+ *  go through RuleHost, so the compiler and VM stay portable.
+ **************************************************************/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef RULES_MAX_BYTES
+#define RULES_MAX_BYTES 512
+#endif
+
+static const uint8_t RULES_TIMERS   = 4;
+static const uint8_t RULES_LONG_MAX = 4;   // distinct long-press thresholds
+
+static const char* const RULES_DEFAULT = "on input press do relay toggle\n";
+
+enum RuleTrigger : uint8_t {
+  TRIG_BOOT = 1,
+  TRIG_PRESS,
+  TRIG_RELEASE,
+  TRIG_SHORT,
+  TRIG_LONG,        // arg = ms
+  TRIG_RELAY_ON,
+  TRIG_RELAY_OFF,
+  TRIG_TIMER,       // arg = timer
+  TRIG_MQTT,        // arg = payload hash
+};
+
+enum RuleOp : uint8_t {
+  // Conditions: a false one ends the rule
+  OP_IF_RELAY_ON = 0x01,
+  OP_IF_RELAY_OFF,
+  OP_IF_INPUT_OPEN,
+  OP_IF_INPUT_CLOSED,
+  // Actions
+  OP_RELAY_ON = 0x10,
+  OP_RELAY_OFF,
+  OP_RELAY_TOGGLE,
+  OP_PULSE,         // LEB128 ms
+  OP_TIMER_START,   // u8 timer, LEB128 ms
+  OP_TIMER_CANCEL,  // u8 timer
+};
+
+struct RuleProgram {
+  uint8_t  code[RULES_MAX_BYTES];
+  uint16_t len;
+  uint8_t  rules;
+};
+
+struct RuleError {
+  uint16_t line;    // 1-based, 0 = whole program
+  char     msg[48];
+};
+
+// Compiles `text`. On failure `err` says where and why and `out` is untouched.
+bool rulesCompile(const char* text, RuleProgram &out, RuleError &err);
+
+uint32_t rulesHash(const char* s, size_t len);
+
+struct RuleHost {
+  void* ctx;
+  bool (*relay)(void* ctx);
+  bool (*inputClosed)(void* ctx);
+  void (*setRelay)(void* ctx, bool on);
+  void (*toggle)(void* ctx);
+  void (*pulse)(void* ctx, uint32_t ms);
+  void (*timerStart)(void* ctx, uint8_t timer, uint32_t ms);
+  void (*timerCancel)(void* ctx, uint8_t timer);
+};
+
+// Runs every rule matching (trigger, arg). Returns the number of actions run.
+uint16_t rulesRun(const RuleProgram &p, uint8_t trigger, uint32_t arg, const RuleHost &host);
+
+// Distinct long-press thresholds used by `p`, ascending. Returns the count.
+uint8_t rulesLongThresholds(const RuleProgram &p, uint32_t out[RULES_LONG_MAX]);
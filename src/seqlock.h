@@ -0,0 +1,52 @@
+/**************************************************************
+ * Single-writer versioned snapshot (seqlock)
+ *
+ *  - One writer publishes a trivially-copyable T; any number of readers
+ *    take consistent copies without locks (they retry if a write raced).
+ *  - The payload is stored as relaxed atomic words, so there is no data
+ *    race even while a reader retries.
+ *  - version() is the number of completed writes.
+ **************************************************************/
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+  static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+public:
+  void write(const T &v) {
+    uint32_t w[WORDS] = {};
+    memcpy(w, &v, sizeof(T));
+    const uint32_t s = _seq.load(std::memory_order_relaxed);
+    _seq.store(s + 1, std::memory_order_relaxed);           // odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) _data[i].store(w[i], std::memory_order_relaxed);
+    _seq.store(s + 2, std::memory_order_release);
+  }
+
+  T read() const {
+    uint32_t w[WORDS];
+    uint32_t s0, s1;
+    do {
+      s0 = _seq.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++) w[i] = _data[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s1 = _seq.load(std::memory_order_relaxed);
+    } while ((s0 & 1) || s0 != s1);
+    T v;
+    memcpy(&v, w, sizeof(T));
+    return v;
+  }
+
+  uint32_t version() const { return _seq.load(std::memory_order_acquire) >> 1; }
+
+private:
+  std::atomic<uint32_t> _seq{0};
+  std::atomic<uint32_t> _data[WORDS] = {};
+};
@@ -0,0 +1,715 @@
+/**************************************************************
+ * SwitchNode fleet simulator (Linux)
+ *
+ *  Runs N SwitchNode instances (simnode.h) in one process against an
+ *  MQTT broker, plus one controller connection that drives the fleet
+ *  and measures it:
+ *    - cmd:   controller publishes ON/OFF to <cmd> -> node switches ->
+ *             retained state published -> controller receives it
+ *    - input: scripted press (first raw edge) -> debounce ->
+ *             <cmd>/din "ON" received by the controller
+ *  Both latencies include two broker hops. Rates are PUBLISH packets
+ *  per second, per instance and for the fleet.
+ *
+ *  Activity: random presses (--press-rate per node per minute, with
+ *  optional contact bounce), random commands (--cmd-rate per second
+ *  across the fleet) and/or a script (--script), one action per line:
+ *    <sec> <all|N|N-M> press [hold_ms] | on | off | event <payload> | drop
+ *
+ *  Several processes can share a broker: give each a distinct
+ *  --first so instance numbers (and so IDs and topics) do not overlap.
+ *
+ *  pio run -e native && .pio/build/native/program --instances 200
+ **************************************************************/
+#include "simnode.h"
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// -------------------- Options --------------------
+struct Options {
+  const char* broker = "127.0.0.1:1883";
+  const char* user = "";
+  const char* pass = "";
+  uint32_t instances = 10;
+  uint32_t first = 0;
+  double   durationS = 60;
+  double   rampPerS = 50;        // node power-ons per second, 0 = all at once
+  const char* prefix = "switchnode-sim";
+  const char* rulesFile = nullptr;
+  const char* power = "off";
+  uint16_t keepAliveS = 15;
+  uint32_t retryMs = 1000;
+  const char* stateDir = nullptr;
+  double   pressPerMin = 1;      // per node
+  uint32_t holdMs = 150;
+  uint32_t bounce = 0;           // extra edges at press and release
+  DebounceCfg debounce;
+  double   cmdPerS = 1;          // fleet-wide
+  const char* script = nullptr;
+  uint32_t seed = 1;
+  double   reportS = 5;
+  const char* csv = nullptr;
+  bool     perInstance = false;
+};
+
+static volatile sig_atomic_t stop_flag = 0;
+static void onSignal(int) { stop_flag = 1; }
+
+static uint64_t t0_us = 0;
+static uint64_t nowUs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000u + t.tv_nsec / 1000 - t0_us;
+}
+
+// -------------------- Latency samples --------------------
+struct Samples {
+  std::vector<uint32_t> us;
+  void add(uint64_t v) { us.push_back(v > UINT32_MAX ? UINT32_MAX : (uint32_t)v); }
+  // Nearest-rank percentile in ms (0 if empty). Sorts in place.
+  double pct(double p) {
+    if (us.empty()) return 0;
+    std::sort(us.begin(), us.end());
+    size_t i = (size_t)(p * us.size() + 0.5);
+    if (i < 1) i = 1;
+    if (i > us.size()) i = us.size();
+    return us[i - 1] / 1000.0;
+  }
+  double max() { return us.empty() ? 0 : *std::max_element(us.begin(), us.end()) / 1000.0; }
+};
+
+// Harness-side view of one instance.
+struct Track {
+  std::unique_ptr<SimNode> node;
+  uint64_t startUs = 0;
+  bool     lastState = false;   // as seen by the controller
+  uint64_t cmdUs = 0;           // pending command (0 = none)
+  bool     cmdValue = false;
+  uint64_t pressUs = 0;         // pending press (0 = none)
+  uint32_t cmdsSent = 0, cmdsLost = 0, cmdsSkipped = 0;
+  uint32_t ctlRx = 0;
+  Samples  cmd, input;
+};
+
+// -------------------- Actions --------------------
+enum ActionKind : uint8_t { A_PIN, A_PRESS, A_CMD, A_EVENT, A_DROP, A_RANDOM_PRESS, A_RANDOM_CMD };
+
+struct Action {
+  uint64_t    atUs;
+  uint32_t    node;
+  uint8_t     kind;
+  uint32_t    arg;
+  std::string payload;
+  bool operator>(const Action &o) const { return atUs > o.atUs; }
+};
+
+typedef std::priority_queue<Action, std::vector<Action>, std::greater<Action>> ActionQueue;
+
+static bool parseRange(const char* s, uint32_t n, uint32_t &lo, uint32_t &hi) {
+  if (!strcmp(s, "all")) { lo = 0; hi = n - 1; return n > 0; }
+  char* end;
+  lo = hi = strtoul(s, &end, 10);
+  if (end == s) return false;
+  if (*end == '-') {
+    const char* p = end + 1;
+    hi = strtoul(p, &end, 10);
+    if (end == p) return false;
+  }
+  return !*end && lo <= hi && hi < n;
+}
+
+static bool loadScript(const char* path, uint32_t n, ActionQueue &q) {
+  FILE* f = fopen(path, "r");
+  if (!f) { perror(path); return false; }
+  char line[512];
+  unsigned lineNo = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    lineNo++;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = 0;
+    if (strspn(line, " \t\r\n") == strlen(line)) continue;
+
+    char nodes[32], act[16];
+    double sec;
+    int used = 0;
+    uint32_t lo = 0, hi = 0;
+    if (sscanf(line, " %lf %31s %15s %n", &sec, nodes, act, &used) < 3 || sec < 0 || !parseRange(nodes, n, lo, hi)) {
+      ok = false;
+      break;
+    }
+    std::string rest = line + used;
+    while (!rest.empty() && strchr(" \t\r\n", rest.back())) rest.pop_back();
+
+    Action a = { (uint64_t)(sec * 1e6), 0, A_PRESS, 0, "" };
+    if (!strcmp(act, "press")) {
+      a.arg = rest.empty() ? 0 : (uint32_t)atoi(rest.c_str());
+    } else if (!strcmp(act, "on") || !strcmp(act, "off")) {
+      a.kind = A_CMD;
+      a.arg = !strcmp(act, "on");
+    } else if (!strcmp(act, "event") && !rest.empty()) {
+      a.kind = A_EVENT;
+      a.payload = rest;
+    } else if (!strcmp(act, "drop")) {
+      a.kind = A_DROP;
+    } else {
+      ok = false;
+      break;
+    }
+    for (uint32_t i = lo; i <= hi; i++) {
+      a.node = i;
+      q.push(a);
+    }
+  }
+  fclose(f);
+  if (!ok) fprintf(stderr, "%s:%u: expected <sec> <all|N|N-M> press [ms] | on | off | event <payload> | drop\n", path, lineNo);
+  return ok;
+}
+
+static std::string readFile(const char* path) {
+  std::string s;
+  FILE* f = fopen(path, "r");
+  if (!f) return s;
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  fclose(f);
+  return s;
+}
+
+static bool resolveBroker(const char* spec, sockaddr_in &out) {
+  std::string host = spec;
+  uint16_t port = 1883;
+  const size_t colon = host.rfind(':');
+  if (colon != std::string::npos) {
+    port = (uint16_t)atoi(host.c_str() + colon + 1);
+    host.resize(colon);
+  }
+  addrinfo hints = {}, *res = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), nullptr, &hints, &res) || !res) return false;
+  out = *(const sockaddr_in*)res->ai_addr;
+  out.sin_port = htons(port);
+  freeaddrinfo(res);
+  return true;
+}
+
+// -------------------- Simulator --------------------
+class Fleet {
+public:
+  explicit Fleet(const Options &o) : _o(o), _rng(o.seed) {}
+
+  bool begin();
+  void run();
+  void report(bool final);
+
+private:
+  static void ctlMessage(void* ctx, const char* topic, const uint8_t* payload, size_t len);
+  static void ctlConnected(void* ctx);
+  static void ctlLost(void* ctx, const char* why);
+
+  void fire(const Action &a, uint64_t now);
+  void press(uint32_t i, uint64_t now, uint32_t holdMs);
+  void sendCmd(uint32_t i, bool on, uint64_t now);
+  uint64_t expDelayUs(double perSecond);
+
+  Options  _o;
+  std::mt19937 _rng;
+  sockaddr_in _broker = {};
+  std::string _rules;
+  std::vector<Track> _t;
+  std::unordered_map<std::string, std::pair<uint32_t, bool>> _topics;   // topic -> (node, is din)
+  ActionQueue _q;
+  MqttLite _ctl;
+  uint32_t _started = 0;
+  uint32_t _upAtEnd = 0;
+  uint64_t _runStartUs = 0;
+  uint64_t _runEndUs = 0;
+
+  // Report window
+  uint64_t _winStartUs = 0;
+  uint64_t _winTx = 0, _winRx = 0, _winCtlRx = 0;
+  Samples  _winCmd, _winInput;
+};
+
+uint64_t Fleet::expDelayUs(double perSecond) {
+  std::exponential_distribution<double> d(perSecond);
+  return (uint64_t)(d(_rng) * 1e6) + 1;
+}
+
+bool Fleet::begin() {
+  if (!resolveBroker(_o.broker, _broker)) {
+    fprintf(stderr, "cannot resolve broker %s\n", _o.broker);
+    return false;
+  }
+  _rules = _o.rulesFile ? readFile(_o.rulesFile) : RULES_DEFAULT;
+  if (_o.rulesFile && _rules.empty()) {
+    fprintf(stderr, "cannot read %s\n", _o.rulesFile);
+    return false;
+  }
+
+  const SimNodeCfg cfg = {
+    _broker, _o.user, _o.pass, _o.keepAliveS, _o.prefix, _rules.c_str(), _o.power, _o.retryMs, _o.stateDir,
+    _o.debounce,
+  };
+  _t.resize(_o.instances);
+  for (uint32_t i = 0; i < _o.instances; i++) {
+    Track &t = _t[i];
+    t.node.reset(new SimNode());
+    std::string err;
+    if (!t.node->begin(_o.first + i, cfg, err)) {
+      fprintf(stderr, "%s\n", err.c_str());
+      return false;
+    }
+    _topics[t.node->cmdTopic() + "/state"] = { i, false };
+    _topics[t.node->cmdTopic() + "/din"] = { i, true };
+  }
+
+  if (_o.script && !loadScript(_o.script, _o.instances, _q)) return false;
+  return true;
+}
+
+// -------------------- Controller --------------------
+void Fleet::ctlConnected(void* ctx) {
+  Fleet* f = (Fleet*)ctx;
+  const std::string prefix = f->_o.prefix;
+  f->_ctl.subscribe((prefix + "/+/state").c_str());
+  f->_ctl.subscribe((prefix + "/+/din").c_str());
+}
+
+void Fleet::ctlLost(void*, const char* why) {
+  fprintf(stderr, "controller connection lost: %s\n", why);
+}
+
+void Fleet::ctlMessage(void* ctx, const char* topic, const uint8_t* payload, size_t len) {
+  Fleet* f = (Fleet*)ctx;
+  const auto it = f->_topics.find(topic);
+  if (it == f->_topics.end()) return;   // another process's instance
+  Track &t = f->_t[it->second.first];
+  const uint64_t now = nowUs();
+  const bool on = (len == 2 && !memcmp(payload, "ON", 2));
+  t.ctlRx++;
+  f->_winCtlRx++;
+
+  if (!it->second.second) {
+    t.lastState = on;
+    if (t.cmdUs && on == t.cmdValue) {
+      t.cmd.add(now - t.cmdUs);
+      f->_winCmd.add(now - t.cmdUs);
+      t.cmdUs = 0;
+    }
+  } else if (on && t.pressUs) {
+    t.input.add(now - t.pressUs);
+    f->_winInput.add(now - t.pressUs);
+    t.pressUs = 0;
+  }
+}
+
+// -------------------- Activity --------------------
+void Fleet::press(uint32_t i, uint64_t now, uint32_t holdMs) {
+  Track &t = _t[i];
+  if (!holdMs) holdMs = _o.holdMs;
+  t.pressUs = now;
+  // Closed at `now`; each bounce edge 0.3-2 ms after the previous one,
+  // ending in the pressed/released level.
+  std::uniform_int_distribution<uint32_t> gap(300, 2000);
+  for (int phase = 0; phase < 2; phase++) {
+    const bool level = (phase == 0);
+    uint64_t at = now + (phase ? (uint64_t)holdMs * 1000 : 0);
+    for (uint32_t b = 0; b < _o.bounce * 2; b++) {
+      _q.push({ at, i, A_PIN, (uint32_t)((b & 1) ? !level : level), "" });
+      at += gap(_rng);
+    }
+    _q.push({ at, i, A_PIN, level, "" });
+  }
+}
+
+void Fleet::sendCmd(uint32_t i, bool on, uint64_t now) {
+  Track &t = _t[i];
+  if (!_ctl.up() || !t.node->mqtt().up()) {
+    t.cmdsSkipped++;
+    return;
+  }
+  if (t.cmdUs) t.cmdsLost++;   // previous one never echoed
+  t.cmdUs = now;
+  t.cmdValue = on;
+  t.cmdsSent++;
+  _ctl.publish(t.node->cmdTopic().c_str(), on ? "ON" : "OFF", on ? 2 : 3, false);
+}
+
+void Fleet::fire(const Action &a, uint64_t now) {
+  const uint32_t nowMs = (uint32_t)(now / 1000);
+  switch (a.kind) {
+    case A_PIN:
+      _t[a.node].node->setInput(a.arg != 0, nowMs);
+      break;
+    case A_PRESS:
+      press(a.node, now, a.arg);
+      break;
+    case A_CMD:
+      sendCmd(a.node, a.arg != 0, now);
+      break;
+    case A_EVENT:
+      if (_ctl.up()) {
+        const std::string topic = _t[a.node].node->cmdTopic() + "/event";
+        _ctl.publish(topic.c_str(), a.payload.data(), a.payload.size(), false);
+      }
+      break;
+    case A_DROP:
+      _t[a.node].node->dropConnection(nowMs);
+      break;
+    case A_RANDOM_PRESS:
+      press(a.node, now, 0);
+      _q.push({ now + expDelayUs(_o.pressPerMin / 60.0), a.node, A_RANDOM_PRESS, 0, "" });
+      break;
+    case A_RANDOM_CMD: {
+      std::uniform_int_distribution<uint32_t> pick(0, _o.instances - 1);
+      const uint32_t i = pick(_rng);
+      sendCmd(i, !_t[i].lastState, now);
+      _q.push({ now + expDelayUs(_o.cmdPerS), 0, A_RANDOM_CMD, 0, "" });
+      break;
+    }
+  }
+}
+
+// -------------------- Main loop --------------------
+void Fleet::run() {
+  char ctlId[40];
+  snprintf(ctlId, sizeof(ctlId), "fleetsim-ctl-%d", (int)getpid());
+  _ctl.setHandler({ this, ctlMessage, ctlConnected, ctlLost });
+  _ctl.connect(_broker, ctlId, _o.user, _o.pass, 60, (uint32_t)(nowUs() / 1000));
+
+  // Let the controller subscribe first so no node's first publish is missed.
+  const uint64_t waitUntil = nowUs() + 3000000;
+  std::vector<pollfd> pfds;
+  while (!stop_flag && !_ctl.up() && _ctl.state() != MqttLite::IDLE && nowUs() < waitUntil) {
+    pollfd p = { _ctl.fd(), (short)(POLLIN | (_ctl.wantWrite() ? POLLOUT : 0)), 0 };
+    poll(&p, 1, 50);
+    if (p.revents & POLLOUT) _ctl.onWritable((uint32_t)(nowUs() / 1000));
+    if (_ctl.fd() >= 0 && (p.revents & (POLLIN | POLLHUP | POLLERR))) _ctl.onReadable((uint32_t)(nowUs() / 1000));
+  }
+  if (!_ctl.up()) fprintf(stderr, "controller not connected to %s: no latencies will be measured\n", _o.broker);
+
+  _runStartUs = nowUs();
+  _winStartUs = _runStartUs;
+  const uint64_t endUs = _runStartUs + (uint64_t)(_o.durationS * 1e6);
+  uint64_t nextReportUs = _runStartUs + (uint64_t)(_o.reportS * 1e6);
+
+  // Script times are relative to the run start; random activity begins
+  // once a node is powered on.
+  ActionQueue shifted;
+  while (!_q.empty()) {
+    Action a = _q.top();
+    _q.pop();
+    a.atUs += _runStartUs;
+    shifted.push(a);
+  }
+  _q.swap(shifted);
+  if (_o.cmdPerS > 0) _q.push({ _runStartUs + expDelayUs(_o.cmdPerS), 0, A_RANDOM_CMD, 0, "" });
+
+  std::vector<uint32_t> owner;   // pollfd index -> node (UINT32_MAX = controller)
+  while (!stop_flag) {
+    const uint64_t now = nowUs();
+    if (now >= endUs) break;
+    const uint32_t nowMs = (uint32_t)(now / 1000);
+    uint64_t wakeUs = now + 100000;
+
+    // Power-on ramp
+    while (_started < _o.instances) {
+      const uint64_t at = _runStartUs + (_o.rampPerS > 0 ? (uint64_t)(_started * 1e6 / _o.rampPerS) : 0);
+      if (at > now) { wakeUs = std::min(wakeUs, at); break; }
+      Track &t = _t[_started];
+      t.startUs = now;
+      t.node->start(nowMs);
+      if (_o.pressPerMin > 0) _q.push({ now + expDelayUs(_o.pressPerMin / 60.0), _started, A_RANDOM_PRESS, 0, "" });
+      _started++;
+    }
+
+    while (!_q.empty() && _q.top().atUs <= now) {
+      const Action a = _q.top();
+      _q.pop();
+      if (a.kind == A_RANDOM_CMD || _t[a.node].node->started()) fire(a, now);
+    }
+    if (!_q.empty()) wakeUs = std::min(wakeUs, _q.top().atUs);
+
+    pfds.clear();
+    owner.clear();
+    for (uint32_t i = 0; i < _started; i++) {
+      const uint32_t w = _t[i].node->step(nowMs);
+      if (w) wakeUs = std::min(wakeUs, now + (uint64_t)w * 1000);
+      MqttLite &m = _t[i].node->mqtt();
+      if (m.fd() < 0) continue;
+      pfds.push_back({ m.fd(), (short)(POLLIN | (m.wantWrite() ? POLLOUT : 0)), 0 });
+      owner.push_back(i);
+    }
+    const uint32_t cw = _ctl.tick(nowMs);
+    if (cw) wakeUs = std::min(wakeUs, now + (uint64_t)cw * 1000);
+    if (_ctl.fd() >= 0) {
+      pfds.push_back({ _ctl.fd(), (short)(POLLIN | (_ctl.wantWrite() ? POLLOUT : 0)), 0 });
+      owner.push_back(UINT32_MAX);
+    }
+
+    if (now >= nextReportUs) {
+      report(false);
+      nextReportUs += (uint64_t)(_o.reportS * 1e6);
+    }
+    wakeUs = std::min(wakeUs, std::min(nextReportUs, endUs));
+
+    const int timeoutMs = wakeUs > now ? (int)((wakeUs - now + 999) / 1000) : 0;
+    if (poll(pfds.data(), pfds.size(), timeoutMs) <= 0) continue;
+
+    const uint32_t ioMs = (uint32_t)(nowUs() / 1000);
+    for (size_t k = 0; k < pfds.size(); k++) {
+      if (!pfds[k].revents) continue;
+      MqttLite &m = owner[k] == UINT32_MAX ? _ctl : _t[owner[k]].node->mqtt();
+      if (m.fd() != pfds[k].fd) continue;
+      if (pfds[k].revents & POLLOUT) m.onWritable(ioMs);
+      if (m.fd() == pfds[k].fd && (pfds[k].revents & (POLLIN | POLLHUP | POLLERR))) m.onReadable(ioMs);
+    }
+  }
+
+  _runEndUs = nowUs();
+  for (const Track &t : _t) {
+    if (t.node->mqtt().up()) _upAtEnd++;
+  }
+
+  // Drain in-flight echoes briefly before the final report.
+  const uint64_t drainUntil = nowUs() + 500000;
+  while (_ctl.up() && nowUs() < drainUntil) {
+    pollfd p = { _ctl.fd(), POLLIN, 0 };
+    if (poll(&p, 1, 50) > 0) _ctl.onReadable((uint32_t)(nowUs() / 1000));
+  }
+  for (Track &t : _t) {
+    if (t.cmdUs) t.cmdsLost++;
+    if (t.node->started()) t.node->end();
+  }
+  _ctl.disconnect();
+}
+
+// -------------------- Report --------------------
+void Fleet::report(bool final) {
+  const uint64_t now = final ? _runEndUs : nowUs();
+  uint64_t tx = 0, rx = 0, bytes = 0;
+  uint32_t up = 0, connects = 0, failures = 0;
+  for (const Track &t : _t) {
+    const MqttLite::Stats &s = t.node->mqtt().stats();
+    tx += s.tx;
+    rx += s.rx;
+    bytes += s.bytesTx + s.bytesRx;
+    connects += s.connects;
+    failures += s.failures;
+    if (t.node->mqtt().up()) up++;
+  }
+
+  if (!final) {
+    const double win = (now - _winStartUs) / 1e6;
+    printf("[%6.1fs] up %u/%u | nodes tx %.1f/s rx %.1f/s | ctl rx %.1f/s | cmd n=%zu p50 %.1f p99 %.1f max %.1f ms"
+           " | input n=%zu p50 %.1f p99 %.1f max %.1f ms\n",
+           (now - _runStartUs) / 1e6, up, _started, (tx - _winTx) / win, (rx - _winRx) / win, _winCtlRx / win,
+           _winCmd.us.size(), _winCmd.pct(0.5), _winCmd.pct(0.99), _winCmd.max(),
+           _winInput.us.size(), _winInput.pct(0.5), _winInput.pct(0.99), _winInput.max());
+    fflush(stdout);
+    _winStartUs = now;
+    _winTx = tx;
+    _winRx = rx;
+    _winCtlRx = 0;
+    _winCmd.us.clear();
+    _winInput.us.clear();
+    return;
+  }
+
+  const double dur = (now - _runStartUs) / 1e6;
+  Samples cmd, input;
+  uint32_t sent = 0, lost = 0, skipped = 0, presses = 0, changes = 0;
+  for (Track &t : _t) {
+    cmd.us.insert(cmd.us.end(), t.cmd.us.begin(), t.cmd.us.end());
+    input.us.insert(input.us.end(), t.input.us.begin(), t.input.us.end());
+    sent += t.cmdsSent;
+    lost += t.cmdsLost;
+    skipped += t.cmdsSkipped;
+    presses += t.node->stats().presses;
+    changes += t.node->stats().relayChanges;
+  }
+
+  const bool table = _o.perInstance || _o.instances <= 20;
+  if (table) {
+    printf("\n%-13s %5s %8s %8s %7s %7s %9s %9s %9s %9s\n", "instance", "conn", "tx/s", "rx/s", "cmds", "lost",
+           "cmd p50", "cmd max", "in p50", "in max");
+    for (Track &t : _t) {
+      const MqttLite::Stats &s = t.node->mqtt().stats();
+      const double live = t.startUs ? (now - t.startUs) / 1e6 : 0;
+      printf("%-13s %5u %8.2f %8.2f %7u %7u %9.1f %9.1f %9.1f %9.1f\n", t.node->deviceId(), s.connects,
+             live > 0 ? s.tx / live : 0, live > 0 ? s.rx / live : 0, t.cmdsSent, t.cmdsLost,
+             t.cmd.pct(0.5), t.cmd.max(), t.input.pct(0.5), t.input.max());
+    }
+  }
+
+  printf("\n== %u instances, %.1f s ==\n", _o.instances, dur);
+  printf("connections   %u up at end, %u connects, %u failures\n", _upAtEnd, connects, failures);
+  printf("node publish  %llu (%.1f/s fleet, %.2f/s per instance)\n", (unsigned long long)tx, tx / dur,
+         _o.instances ? tx / dur / _o.instances : 0);
+  printf("node receive  %llu (%.1f/s fleet), %.1f KiB on the wire\n", (unsigned long long)rx, rx / dur, bytes / 1024.0);
+  printf("presses       %u debounced, %u relay changes\n", presses, changes);
+  printf("commands      %u sent, %u without echo, %u skipped (node or controller down)\n", sent, lost, skipped);
+  printf("cmd latency   n=%zu p50 %.1f p90 %.1f p99 %.1f max %.1f ms\n", cmd.us.size(), cmd.pct(0.5), cmd.pct(0.9),
+         cmd.pct(0.99), cmd.max());
+  printf("input latency n=%zu p50 %.1f p90 %.1f p99 %.1f max %.1f ms (includes %s/%u debounce)\n", input.us.size(),
+         input.pct(0.5), input.pct(0.9), input.pct(0.99), input.max(), debounceAlgoName(_o.debounce.algo),
+         _o.debounce.ms);
+
+  if (_o.csv) {
+    FILE* f = fopen(_o.csv, "w");
+    if (!f) { perror(_o.csv); return; }
+    fprintf(f, "instance,connects,failures,tx,rx,tx_per_s,rx_per_s,presses,relay_changes,cmds_sent,cmds_lost,"
+               "cmd_p50_ms,cmd_p99_ms,cmd_max_ms,input_p50_ms,input_p99_ms,input_max_ms\n");
+    for (Track &t : _t) {
+      const MqttLite::Stats &s = t.node->mqtt().stats();
+      const double live = t.startUs ? (now - t.startUs) / 1e6 : 0;
+      fprintf(f, "%s,%u,%u,%u,%u,%.3f,%.3f,%u,%u,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", t.node->deviceId(),
+              s.connects, s.failures, s.tx, s.rx, live > 0 ? s.tx / live : 0, live > 0 ? s.rx / live : 0,
+              t.node->stats().presses, t.node->stats().relayChanges, t.cmdsSent, t.cmdsLost,
+              t.cmd.pct(0.5), t.cmd.pct(0.99), t.cmd.max(), t.input.pct(0.5), t.input.pct(0.99), t.input.max());
+    }
+    fclose(f);
+    printf("per-instance CSV: %s\n", _o.csv);
+  }
+}
+
+// -------------------- CLI --------------------
+static void usage() {
+  fprintf(stderr,
+    "usage: fleetsim [options]\n"
+    "  --broker HOST[:PORT]  MQTT broker (127.0.0.1:1883)\n"
+    "  --user U --pass P     broker credentials\n"
+    "  --instances N         instances in this process (10)\n"
+    "  --first K             first instance number, for several processes (0)\n"
+    "  --duration S          run time in seconds (60)\n"
+    "  --ramp R              power-ons per second, 0 = all at once (50)\n"
+    "  --prefix P            command topic prefix: <P>/<id> (switchnode-sim)\n"
+    "  --rules FILE          rule text for every instance (default rule)\n"
+    "  --power off|on|last   power-on policy (off)\n"
+    "  --keepalive S         MQTT keep-alive (15, as PubSubClient)\n"
+    "  --retry-ms MS         reconnect back-off (1000)\n"
+    "  --state-dir DIR       per-instance config store files (in memory)\n"
+    "  --press-rate R        random presses per instance per minute (1)\n"
+    "  --hold-ms MS          press duration (150)\n"
+    "  --bounce N            contact bounce edges per press/release (0)\n"
+    "  --debounce ALGO/MS    stable|lockout|integrate (stable/50, as the firmware)\n"
+    "  --cmd-rate R          random MQTT commands per second, fleet-wide (1)\n"
+    "  --script FILE         scripted actions (see the header of fleetsim.cpp)\n"
+    "  --seed N              random seed (1)\n"
+    "  --report S            progress line interval (5)\n"
+    "  --csv FILE            per-instance results\n"
+    "  --per-instance        print the per-instance table (automatic up to 20)\n");
+}
+
+#ifndef PIO_UNIT_TESTING   // pio test -e native links src/ with each test's own main()
+int main(int argc, char** argv) {
+  static const option longOpts[] = {
+    { "broker", required_argument, nullptr, 'b' },
+    { "user", required_argument, nullptr, 'u' },
+    { "pass", required_argument, nullptr, 'p' },
+    { "instances", required_argument, nullptr, 'n' },
+    { "first", required_argument, nullptr, 'f' },
+    { "duration", required_argument, nullptr, 'd' },
+    { "ramp", required_argument, nullptr, 'r' },
+    { "prefix", required_argument, nullptr, 'P' },
+    { "rules", required_argument, nullptr, 'R' },
+    { "power", required_argument, nullptr, 'w' },
+    { "keepalive", required_argument, nullptr, 'k' },
+    { "retry-ms", required_argument, nullptr, 'y' },
+    { "state-dir", required_argument, nullptr, 's' },
+    { "press-rate", required_argument, nullptr, 'i' },
+    { "hold-ms", required_argument, nullptr, 'H' },
+    { "bounce", required_argument, nullptr, 'B' },
+    { "debounce", required_argument, nullptr, 'D' },
+    { "cmd-rate", required_argument, nullptr, 'c' },
+    { "script", required_argument, nullptr, 'S' },
+    { "seed", required_argument, nullptr, 'e' },
+    { "report", required_argument, nullptr, 'o' },
+    { "csv", required_argument, nullptr, 'C' },
+    { "per-instance", no_argument, nullptr, 'I' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
+  };
+
+  Options o;
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOpts, nullptr)) != -1) {
+    switch (c) {
+      case 'b': o.broker = optarg; break;
+      case 'u': o.user = optarg; break;
+      case 'p': o.pass = optarg; break;
+      case 'n': o.instances = (uint32_t)atol(optarg); break;
+      case 'f': o.first = (uint32_t)atol(optarg); break;
+      case 'd': o.durationS = atof(optarg); break;
+      case 'r': o.rampPerS = atof(optarg); break;
+      case 'P': o.prefix = optarg; break;
+      case 'R': o.rulesFile = optarg; break;
+      case 'w': o.power = optarg; break;
+      case 'k': o.keepAliveS = (uint16_t)atoi(optarg); break;
+      case 'y': o.retryMs = (uint32_t)atol(optarg); break;
+      case 's': o.stateDir = optarg; break;
+      case 'i': o.pressPerMin = atof(optarg); break;
+      case 'H': o.holdMs = (uint32_t)atol(optarg); break;
+      case 'B': o.bounce = (uint32_t)atol(optarg); break;
+      case 'D':
+        if (!debounceParse(optarg, o.debounce)) { usage(); return 2; }
+        break;
+      case 'c': o.cmdPerS = atof(optarg); break;
+      case 'S': o.script = optarg; break;
+      case 'e': o.seed = (uint32_t)atol(optarg); break;
+      case 'o': o.reportS = atof(optarg); break;
+      case 'C': o.csv = optarg; break;
+      case 'I': o.perInstance = true; break;
+      default: usage(); return c == 'h' ? 0 : 2;
+    }
+  }
+  if (!o.instances || o.first + o.instances > 0x1000000 || o.durationS <= 0 || o.reportS <= 0 ||
+      (strcmp(o.power, "off") && strcmp(o.power, "on") && strcmp(o.power, "last"))) {
+    usage();
+    return 2;
+  }
+
+  // One socket per instance: lift the soft descriptor limit.
+  rlimit rl;
+  if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+  if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < o.instances + 16) {
+    fprintf(stderr, "warning: %lu file descriptors for %u instances\n", (unsigned long)rl.rlim_cur, o.instances);
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  t0_us = 0;
+  t0_us = nowUs();
+
+  Fleet fleet(o);
+  if (!fleet.begin()) return 1;
+  printf("%u instances (%06X..%06X) -> %s, %.0f s\n", o.instances, o.first, o.first + o.instances - 1, o.broker,
+         o.durationS);
+  fleet.run();
+  fleet.report(true);
+  return 0;
+}
+#endif
@@ -0,0 +1,267 @@
+#include "mqttlite.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const uint32_t CONNECT_TIMEOUT_MS = 10000;
+
+enum : uint8_t {
+  PKT_CONNECT = 1, PKT_CONNACK, PKT_PUBLISH, PKT_PUBACK,
+  PKT_SUBSCRIBE = 8, PKT_SUBACK, PKT_PINGREQ = 12, PKT_PINGRESP, PKT_DISCONNECT,
+};
+
+static void putStr(std::vector<uint8_t> &b, const char* s, size_t n) {
+  b.push_back((uint8_t)(n >> 8));
+  b.push_back((uint8_t)n);
+  b.insert(b.end(), (const uint8_t*)s, (const uint8_t*)s + n);
+}
+
+static void putStr(std::vector<uint8_t> &b, const char* s) {
+  putStr(b, s, strlen(s));
+}
+
+// -------------------- Connection --------------------
+bool MqttLite::connect(const sockaddr_in &broker, const char* clientId, const char* user, const char* pass,
+                       uint16_t keepAliveS, uint32_t nowMs) {
+  close();
+  _fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (_fd < 0) {
+    _st.failures++;
+    return false;
+  }
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+  const int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));   // lwIP sends small segments at once too
+
+  if (::connect(_fd, (const sockaddr*)&broker, sizeof(broker)) < 0 && errno != EINPROGRESS) {
+    fail(strerror(errno));
+    return false;
+  }
+
+  _keepAliveS = keepAliveS;
+  _startMs = nowMs;
+  _lastTxMs = _lastRxMs = nowMs;
+  _pingOut = false;
+  _state = CONNECTING;
+
+  std::vector<uint8_t> b;
+  putStr(b, "MQTT");
+  b.push_back(4);   // protocol level 3.1.1
+  uint8_t flags = 0x02;   // clean session
+  if (user && *user) flags |= 0x80;
+  if (user && *user && pass && *pass) flags |= 0x40;
+  b.push_back(flags);
+  b.push_back((uint8_t)(keepAliveS >> 8));
+  b.push_back((uint8_t)keepAliveS);
+  putStr(b, clientId);
+  if (flags & 0x80) putStr(b, user);
+  if (flags & 0x40) putStr(b, pass);
+  queue(PKT_CONNECT << 4, b.data(), b.size());
+  return true;
+}
+
+void MqttLite::close() {
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+  _state = IDLE;
+  _out.clear();
+  _outPos = 0;
+  _in.clear();
+}
+
+void MqttLite::fail(const char* why) {
+  const bool wasUp = (_state == UP);
+  _st.failures++;
+  close();
+  if (_h.lost) _h.lost(_h.ctx, wasUp ? why : "connect failed");
+}
+
+void MqttLite::disconnect() {
+  if (_state == UP) {
+    const uint8_t pkt[2] = { PKT_DISCONNECT << 4, 0 };
+    (void)::send(_fd, pkt, sizeof(pkt), MSG_NOSIGNAL);
+  }
+  close();
+}
+
+// -------------------- Output --------------------
+void MqttLite::queue(uint8_t type, const uint8_t* body, size_t len) {
+  if (_outPos && _outPos == _out.size()) {
+    _out.clear();
+    _outPos = 0;
+  }
+  _out.push_back(type);
+  size_t rem = len;
+  do {
+    uint8_t d = rem % 128;
+    rem /= 128;
+    if (rem) d |= 0x80;
+    _out.push_back(d);
+  } while (rem);
+  _out.insert(_out.end(), body, body + len);
+  if (_state == WAIT_CONNACK || _state == UP) flush();
+}
+
+void MqttLite::flush() {
+  while (_outPos < _out.size()) {
+    const ssize_t n = ::send(_fd, _out.data() + _outPos, _out.size() - _outPos, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      fail(strerror(errno));
+      return;
+    }
+    _outPos += (size_t)n;
+    _st.bytesTx += (uint64_t)n;
+  }
+  _out.clear();
+  _outPos = 0;
+}
+
+bool MqttLite::subscribe(const char* topic) {
+  if (_state != UP) return false;
+  std::vector<uint8_t> b;
+  b.push_back((uint8_t)(_nextId >> 8));
+  b.push_back((uint8_t)_nextId);
+  if (!++_nextId) _nextId = 1;
+  putStr(b, topic);
+  b.push_back(0);   // QoS 0
+  queue(PKT_SUBSCRIBE << 4 | 0x02, b.data(), b.size());
+  return _fd >= 0;
+}
+
+bool MqttLite::publish(const char* topic, const void* payload, size_t len, bool retain) {
+  if (_state != UP) return false;
+  std::vector<uint8_t> b;
+  putStr(b, topic);
+  b.insert(b.end(), (const uint8_t*)payload, (const uint8_t*)payload + len);
+  queue(PKT_PUBLISH << 4 | (retain ? 1 : 0), b.data(), b.size());
+  if (_fd < 0) return false;
+  _st.tx++;
+  return true;
+}
+
+// -------------------- Input --------------------
+void MqttLite::onWritable(uint32_t nowMs) {
+  if (_state == CONNECTING) {
+    int err = 0;
+    socklen_t l = sizeof(err);
+    getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &l);
+    if (err) {
+      fail(strerror(err));
+      return;
+    }
+    _state = WAIT_CONNACK;
+    _lastTxMs = nowMs;
+  }
+  flush();
+}
+
+void MqttLite::onReadable(uint32_t nowMs) {
+  uint8_t buf[4096];
+  for (;;) {
+    const ssize_t n = ::recv(_fd, buf, sizeof(buf), 0);
+    if (n == 0) { fail("closed by broker"); return; }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      fail(strerror(errno));
+      return;
+    }
+    _st.bytesRx += (uint64_t)n;
+    _in.insert(_in.end(), buf, buf + n);
+  }
+  _lastRxMs = nowMs;
+
+  size_t pos = 0;
+  while (_fd >= 0 && _in.size() - pos >= 2) {
+    size_t rem = 0, hdr = 1;
+    uint32_t mul = 1;
+    bool complete = false;
+    while (hdr < 5 && pos + hdr < _in.size()) {
+      const uint8_t d = _in[pos + hdr++];
+      rem += (d & 0x7F) * mul;
+      mul *= 128;
+      if (!(d & 0x80)) { complete = true; break; }
+    }
+    if (!complete) {
+      if (hdr >= 5) { fail("bad remaining length"); return; }
+      break;
+    }
+    if (_in.size() - pos < hdr + rem) break;
+    if (!handlePacket(_in[pos], &_in[pos + hdr], rem)) return;
+    pos += hdr + rem;
+  }
+  if (_fd >= 0) _in.erase(_in.begin(), _in.begin() + pos);
+}
+
+bool MqttLite::handlePacket(uint8_t type, const uint8_t* p, size_t len) {
+  switch (type >> 4) {
+    case PKT_CONNACK:
+      if (len < 2 || p[1] != 0) {
+        fail("connection refused");
+        return false;
+      }
+      _state = UP;
+      _st.connects++;
+      if (_h.connected) _h.connected(_h.ctx);
+      return _fd >= 0;
+
+    case PKT_PUBLISH: {
+      if (len < 2) { fail("short publish"); return false; }
+      const size_t tl = (size_t)p[0] << 8 | p[1];
+      const uint8_t qos = (type >> 1) & 0x03;
+      size_t off = 2 + tl;
+      if (off + (qos ? 2 : 0) > len) { fail("short publish"); return false; }
+      char topic[256];
+      const size_t n = tl < sizeof(topic) - 1 ? tl : sizeof(topic) - 1;
+      memcpy(topic, p + 2, n);
+      topic[n] = 0;
+      if (qos == 1) {
+        const uint8_t ack[2] = { p[off], p[off + 1] };
+        queue(PKT_PUBACK << 4, ack, sizeof(ack));
+      }
+      if (qos) off += 2;
+      if (qos == 2) return _fd >= 0;
+      _st.rx++;
+      if (_h.message) _h.message(_h.ctx, topic, p + off, len - off);
+      return _fd >= 0;
+    }
+
+    case PKT_PINGRESP:
+      _pingOut = false;
+      return true;
+
+    default:   // SUBACK, PUBACK, ...
+      return true;
+  }
+}
+
+uint32_t MqttLite::tick(uint32_t nowMs) {
+  if (_state == IDLE) return 0;
+  if (_state != UP) {
+    const uint32_t age = nowMs - _startMs;
+    if (age >= CONNECT_TIMEOUT_MS) {
+      fail("connect timeout");
+      return 0;
+    }
+    return CONNECT_TIMEOUT_MS - age;
+  }
+
+  const uint32_t ka = _keepAliveS * 1000u;
+  if (!ka) return 0;
+  if (_pingOut && nowMs - _lastRxMs >= ka + ka / 2) {
+    fail("keep-alive timeout");
+    return 0;
+  }
+  if (!_pingOut && nowMs - _lastTxMs >= ka) {
+    const uint8_t none = 0;
+    queue(PKT_PINGREQ << 4, &none, 0);
+    _pingOut = true;
+    _lastTxMs = nowMs;
+  }
+  if (_pingOut) return ka + ka / 2 - (nowMs - _lastRxMs);
+  return ka - (nowMs - _lastTxMs);
+}
@@ -0,0 +1,85 @@
+/**************************************************************
+ * Minimal non-blocking MQTT 3.1.1 client (QoS 0) for the simulator
+ *
+ *  - One TCP socket per client, driven by the caller's poll() loop:
+ *    fd() / wantWrite() to build the poll set, then onReadable() /
+ *    onWritable(), and tick() for connect timeout and keep-alive.
+ *  - Publish, subscribe and receive at QoS 0 only, like the firmware's
+ *    PubSubClient usage. Incoming QoS 1 is acknowledged, QoS 2 dropped.
+ *  - POSIX only; no allocation on the steady-state receive path beyond
+ *    the input buffer growing to the largest packet seen.
+ **************************************************************/
+#pragma once
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MqttLite {
+public:
+  enum State : uint8_t { IDLE, CONNECTING, WAIT_CONNACK, UP };
+
+  struct Handler {
+    void* ctx;
+    void (*message)(void* ctx, const char* topic, const uint8_t* payload, size_t len);
+    void (*connected)(void* ctx);
+    void (*lost)(void* ctx, const char* why);
+  };
+
+  struct Stats {
+    uint32_t connects;
+    uint32_t failures;     // connect refused / timed out / dropped
+    uint32_t tx;           // PUBLISH sent
+    uint32_t rx;           // PUBLISH received
+    uint64_t bytesTx;
+    uint64_t bytesRx;
+  };
+
+  ~MqttLite() { close(); }
+
+  void setHandler(const Handler &h) { _h = h; }
+
+  // Starts a non-blocking connect; the CONNECT packet goes out as soon as
+  // the socket is writable. False if the socket could not be created.
+  bool connect(const sockaddr_in &broker, const char* clientId, const char* user, const char* pass,
+               uint16_t keepAliveS, uint32_t nowMs);
+  void disconnect();   // sends DISCONNECT when up, then closes
+
+  bool subscribe(const char* topic);
+  bool publish(const char* topic, const void* payload, size_t len, bool retain);
+
+  int   fd() const { return _fd; }
+  State state() const { return _state; }
+  bool  up() const { return _state == UP; }
+  bool  wantWrite() const { return _state == CONNECTING || _out.size() > _outPos; }
+
+  void onReadable(uint32_t nowMs);
+  void onWritable(uint32_t nowMs);
+  // Connect timeout + keep-alive. Returns ms until it needs to run again.
+  uint32_t tick(uint32_t nowMs);
+
+  const Stats &stats() const { return _st; }
+
+private:
+  void close();
+  void fail(const char* why);
+  void queue(uint8_t type, const uint8_t* body, size_t len);
+  void flush();
+  bool handlePacket(uint8_t type, const uint8_t* p, size_t len);
+
+  Handler  _h = {};
+  int      _fd = -1;
+  State    _state = IDLE;
+  uint16_t _keepAliveS = 15;
+  uint16_t _nextId = 1;
+  uint32_t _startMs = 0;
+  uint32_t _lastTxMs = 0;
+  uint32_t _lastRxMs = 0;
+  bool     _pingOut = false;
+  std::vector<uint8_t> _out;
+  size_t   _outPos = 0;
+  std::vector<uint8_t> _in;
+  Stats    _st = {};
+};
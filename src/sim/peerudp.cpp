@@ -0,0 +1,76 @@
+#include "peerudp.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int RX_POLL_MS = 50;   // how quickly end() is noticed
+
+bool PosixUdpPeerTransport::begin(RxFn rx) {
+  if (_fd >= 0) return true;
+
+  _fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (_fd < 0) {
+    fprintf(stderr, "peer: udp socket: %s\n", strerror(errno));
+    return false;
+  }
+  sockaddr_in sa = {};
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(_bindIp);
+  sa.sin_port = htons(_port);
+  socklen_t len = sizeof(sa);
+  if (bind(_fd, (const sockaddr*)&sa, sizeof(sa)) < 0 || getsockname(_fd, (sockaddr*)&sa, &len) < 0) {
+    fprintf(stderr, "peer: udp bind %u: %s\n", _port, strerror(errno));
+    close(_fd);
+    _fd = -1;
+    return false;
+  }
+  _port = ntohs(sa.sin_port);
+
+  _stop.store(false);
+  _rx = std::thread(&PosixUdpPeerTransport::rxLoop, this, rx);
+  return true;
+}
+
+void PosixUdpPeerTransport::end() {
+  if (_fd < 0) return;
+  _stop.store(true);
+  if (_rx.joinable()) _rx.join();
+  close(_fd);
+  _fd = -1;
+}
+
+bool PosixUdpPeerTransport::send(const PeerAddr &to, const uint8_t* data, size_t len) {
+  if (_fd < 0 || to.kind != PEER_ADDR_UDP) return false;
+  sockaddr_in sa = {};
+  sa.sin_family = AF_INET;
+  memcpy(&sa.sin_addr.s_addr, to.b, 4);   // already network order
+  sa.sin_port = htons((uint16_t)((to.b[4] << 8) | to.b[5]));
+  return sendto(_fd, data, len, MSG_DONTWAIT, (const sockaddr*)&sa, sizeof(sa)) == (ssize_t)len;
+}
+
+void PosixUdpPeerTransport::rxLoop(RxFn rx) {
+  uint8_t buf[64];
+  while (!_stop.load()) {
+    pollfd p = { _fd, POLLIN, 0 };
+    if (poll(&p, 1, RX_POLL_MS) <= 0) continue;
+
+    sockaddr_in sa = {};
+    socklen_t len = sizeof(sa);
+    const ssize_t n = recvfrom(_fd, buf, sizeof(buf), 0, (sockaddr*)&sa, &len);
+    if (n <= 0 || sa.sin_family != AF_INET) continue;
+
+    PeerAddr from = {};
+    from.kind = PEER_ADDR_UDP;
+    memcpy(from.b, &sa.sin_addr.s_addr, 4);
+    const uint16_t port = ntohs(sa.sin_port);
+    from.b[4] = (uint8_t)(port >> 8);
+    from.b[5] = (uint8_t)port;
+    rx(this, from, buf, (size_t)n);
+  }
+}
@@ -0,0 +1,41 @@
+/**************************************************************
+ * POSIX UDP peer transport (host builds)
+ *
+ *  - The PeerTransport (peerlink.h) a native build uses: same
+ *    addressing as the firmware's UdpPeerTransport ("udp:ip:port"),
+ *    on a plain BSD socket.
+ *  - A receive thread calls the RxFn, the way the AsyncUDP task does
+ *    on the device, so the consumer has to hand frames over to its own
+ *    task just the same.
+ *  - Port 0 binds an ephemeral port (tests); port() reports it.
+ **************************************************************/
+#pragma once
+
+#include "../peerlink.h"
+
+#include <atomic>
+#include <thread>
+
+class PosixUdpPeerTransport : public PeerTransport {
+public:
+  // bindIp: host order, 0 = any interface.
+  explicit PosixUdpPeerTransport(uint16_t port, uint32_t bindIp = 0) : _port(port), _bindIp(bindIp) {}
+  ~PosixUdpPeerTransport() override { end(); }
+
+  bool begin(RxFn rx) override;
+  void end() override;
+  bool send(const PeerAddr &to, const uint8_t* data, size_t len) override;
+  uint8_t kind() const override { return PEER_ADDR_UDP; }
+  const char* name() const override { return "udp"; }
+
+  uint16_t port() const { return _port; }
+
+private:
+  void rxLoop(RxFn rx);
+
+  uint16_t _port;
+  uint32_t _bindIp;
+  int _fd = -1;
+  std::atomic<bool> _stop{false};
+  std::thread _rx;
+};
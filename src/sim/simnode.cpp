@@ -0,0 +1,305 @@
+#include "simnode.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// -------------------- Config store --------------------
+bool SimPrefs::load(const std::string &path) {
+  _path = path;
+  _kv.clear();
+  _dirty = false;
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) return false;
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    char* eq = strchr(line, '=');
+    if (!eq) continue;
+    *eq = 0;
+    std::string v;
+    for (const char* p = eq + 1; *p && *p != '\n'; p++) {
+      if (*p == '\\' && p[1]) {
+        p++;
+        v += (*p == 'n') ? '\n' : *p;
+      } else {
+        v += *p;
+      }
+    }
+    _kv[line] = v;
+  }
+  fclose(f);
+  return true;
+}
+
+bool SimPrefs::save() {
+  if (!_dirty || _path.empty()) return true;
+  FILE* f = fopen(_path.c_str(), "w");
+  if (!f) return false;
+  for (const auto &kv : _kv) {
+    fprintf(f, "%s=", kv.first.c_str());
+    for (char c : kv.second) {
+      if (c == '\n') fputs("\\n", f);
+      else if (c == '\\') fputs("\\\\", f);
+      else fputc(c, f);
+    }
+    fputc('\n', f);
+  }
+  _dirty = false;
+  return fclose(f) == 0;
+}
+
+std::string SimPrefs::get(const char* key, const char* def) const {
+  const auto it = _kv.find(key);
+  return it == _kv.end() ? std::string(def) : it->second;
+}
+
+void SimPrefs::put(const char* key, const std::string &v) {
+  std::string &cur = _kv[key];
+  if (cur == v) return;
+  cur = v;
+  _dirty = true;
+}
+
+// -------------------- Lifecycle --------------------
+bool SimNode::begin(uint32_t index, const SimNodeCfg &cfg, std::string &err) {
+  _cfg = cfg;
+  _index = index;
+
+  // Locally administered MAC; the low 3 bytes are the instance number.
+  const uint8_t mac[6] = { 0x02, 0x53, 0x4E, (uint8_t)(index >> 16), (uint8_t)(index >> 8), (uint8_t)index };
+  snprintf(_shortId, sizeof(_shortId), "%02X%02X%02X", mac[3], mac[4], mac[5]);
+  snprintf(_deviceId, sizeof(_deviceId), "esp32-%s", _shortId);
+  const uint32_t efuse = mac[0] | mac[1] << 8 | mac[2] << 16 | (uint32_t)mac[3] << 24;
+  snprintf(_clientId, sizeof(_clientId), "switchnode-%s-%x", _shortId, efuse);
+
+  if (cfg.stateDir) _prefs.load(std::string(cfg.stateDir) + "/" + _deviceId + ".prefs");
+
+  const std::string defCmd = std::string(cfg.topicPrefix) + "/" + _shortId;
+  _topicCmd   = _prefs.get("mqtt.cmd", defCmd.c_str());
+  _topicState = _prefs.get("mqtt.state", "");
+  if (_topicState.empty()) _topicState = _topicCmd + "/state";
+  _topicDin   = _topicCmd + "/din";
+  _topicOta   = _topicCmd + "/ota";
+  _topicEvent = _topicCmd + "/event";
+  _prefs.put("mqtt.cmd", _topicCmd);
+
+  const std::string text = _prefs.get("rules.text", cfg.rules);
+  RuleError e;
+  if (!rulesCompile(text.c_str(), _prog, e)) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s: rules line %u: %s", _deviceId, e.line, e.msg);
+    err = buf;
+    return false;
+  }
+  _longN = rulesLongThresholds(_prog, _longTh);
+  _deb.begin(cfg.debounce, 1, 0);   // open
+
+  _host = { this, hostRelay, hostInputClosed, hostSetRelay, hostToggle, hostPulse, hostTimerStart, hostTimerCancel };
+  _mqtt.setHandler({ this, onMessage, onConnected, onLost });
+  return true;
+}
+
+void SimNode::start(uint32_t nowMs) {
+  _now = nowMs;
+  _started = true;
+  _deb.begin(_cfg.debounce, _deb.raw(), nowMs);
+
+  const std::string policy = _prefs.get("power.policy", _cfg.powerPolicy);
+  bool on = (policy == "on");
+  if (policy == "last") on = (_prefs.get("power.last", "0") == "1");
+  if (on) applyRelay(true, SIM_SRC_BOOT);   // before the rules are installed, as on the device
+  fireRules(TRIG_BOOT, 0, SIM_SRC_RULE);
+
+  connectNow();
+}
+
+void SimNode::end() {
+  _prefs.put("power.last", _relay ? "1" : "0");
+  _prefs.save();
+  _mqtt.disconnect();
+  _started = false;
+}
+
+void SimNode::dropConnection(uint32_t nowMs) {
+  _now = nowMs;
+  if (_mqtt.state() == MqttLite::IDLE) return;
+  _mqtt.disconnect();
+  _reconnectAt = nowMs + _cfg.retryMs;
+}
+
+void SimNode::connectNow() {
+  _st.connectAttempts++;
+  _reconnectAt = 0;
+  if (!_mqtt.connect(_cfg.broker, _clientId, _cfg.user, _cfg.pass, _cfg.keepAliveS, _now)) {
+    _reconnectAt = _now + _cfg.retryMs;
+  }
+}
+
+// -------------------- MQTT --------------------
+void SimNode::onConnected(void* ctx) {
+  SimNode* n = (SimNode*)ctx;
+  n->_mqtt.subscribe(n->_topicCmd.c_str());
+  n->_mqtt.subscribe(n->_topicOta.c_str());
+  n->_mqtt.subscribe(n->_topicEvent.c_str());
+  n->publishState();
+  n->publishInput();
+}
+
+void SimNode::onLost(void* ctx, const char*) {
+  SimNode* n = (SimNode*)ctx;
+  // Spread reconnects a little so a broker restart is not one burst.
+  n->_reconnectAt = n->_now + n->_cfg.retryMs + (n->_index * 37) % 250;
+}
+
+void SimNode::onMessage(void* ctx, const char* topic, const uint8_t* payload, size_t len) {
+  SimNode* n = (SimNode*)ctx;
+  while (len && isspace(payload[len - 1])) len--;
+  while (len && isspace(*payload)) { payload++; len--; }
+  char msg[64];
+  const size_t m = len < sizeof(msg) - 1 ? len : sizeof(msg) - 1;
+  memcpy(msg, payload, m);
+  msg[m] = 0;
+
+  // Same payloads as mqttCallback() in main.cpp
+  if (n->_topicCmd == topic) {
+    n->_st.commands++;
+    if (!strcasecmp(msg, "ON") || !strcmp(msg, "1") || !strcasecmp(msg, "true"))        n->applyRelay(true, SIM_SRC_MQTT);
+    else if (!strcasecmp(msg, "OFF") || !strcmp(msg, "0") || !strcasecmp(msg, "false")) n->applyRelay(false, SIM_SRC_MQTT);
+  } else if (n->_topicOta == topic) {
+    n->_st.otaRequests++;
+  } else if (n->_topicEvent == topic) {
+    n->fireRules(TRIG_MQTT, rulesHash(msg, m), SIM_SRC_RULE);
+  }
+}
+
+void SimNode::publishState() {
+  _mqtt.publish(_topicState.c_str(), _relay ? "ON" : "OFF", _relay ? 2 : 3, true);
+}
+
+void SimNode::publishInput() {
+  const bool open = (_deb.stable() == 1);
+  _mqtt.publish(_topicDin.c_str(), open ? "OFF" : "ON", open ? 3 : 2, true);
+}
+
+// -------------------- Relay + rules (control.cpp) --------------------
+void SimNode::applyRelay(bool on, uint8_t src) {
+  const bool changed = (on != _relay);
+  _pulseArmed = false;
+  _relay = on;
+  if (changed) _st.relayChanges++;
+  publishState();
+  if (changed && src != SIM_SRC_RULE) fireRules(on ? TRIG_RELAY_ON : TRIG_RELAY_OFF, 0, SIM_SRC_RULE);
+}
+
+void SimNode::armPulse(bool on, uint32_t ms, uint8_t src) {
+  const bool prev = _relay;
+  applyRelay(on, src);
+  _pulseRevertTo = prev;
+  _pulseSource = src;
+  _pulseDueMs = _now + ms;
+  _pulseArmed = true;
+}
+
+void SimNode::fireRules(uint8_t trigger, uint32_t arg, uint8_t src) {
+  const uint8_t outer = _ruleSrc;
+  _ruleSrc = src;
+  _st.ruleActions += rulesRun(_prog, trigger, arg, _host);
+  _ruleSrc = outer;
+}
+
+bool SimNode::hostRelay(void* ctx)       { return ((SimNode*)ctx)->_relay; }
+bool SimNode::hostInputClosed(void* ctx) { return ((SimNode*)ctx)->_deb.stable() == 0; }
+void SimNode::hostSetRelay(void* ctx, bool on) { SimNode* n = (SimNode*)ctx; n->applyRelay(on, n->_ruleSrc); }
+void SimNode::hostToggle(void* ctx)      { SimNode* n = (SimNode*)ctx; n->applyRelay(!n->_relay, n->_ruleSrc); }
+void SimNode::hostPulse(void* ctx, uint32_t ms) { SimNode* n = (SimNode*)ctx; n->armPulse(true, ms, n->_ruleSrc); }
+
+void SimNode::hostTimerStart(void* ctx, uint8_t t, uint32_t ms) {
+  SimNode* n = (SimNode*)ctx;
+  n->_timerDue[t] = n->_now + ms;
+  n->_timersArmed |= (1 << t);
+}
+
+void SimNode::hostTimerCancel(void* ctx, uint8_t t) {
+  ((SimNode*)ctx)->_timersArmed &= ~(1 << t);
+}
+
+// -------------------- Input --------------------
+void SimNode::setInput(bool closed, uint32_t nowMs) {
+  const int level = closed ? 0 : 1;
+  if (!_started) {
+    _deb.begin(_cfg.debounce, level, nowMs);
+    return;
+  }
+  _now = nowMs;
+  debounceStep(level);   // every edge, as the pin interrupt does
+}
+
+uint32_t SimNode::debounceStep(int level) {
+  if (!_deb.update(level, _now)) return _deb.wait();
+
+  const bool isOpen = (_deb.stable() == 1);
+  if (!isOpen) {
+    _st.presses++;
+    _pressMs = _now;
+    _longFired = 0;
+    fireRules(TRIG_PRESS, 0, SIM_SRC_INPUT);
+  } else {
+    fireRules(TRIG_RELEASE, 0, SIM_SRC_INPUT);
+    if (!_longFired) fireRules(TRIG_SHORT, 0, SIM_SRC_INPUT);
+  }
+  publishInput();
+  return _deb.wait();
+}
+
+uint32_t SimNode::pulseStep() {
+  if (!_pulseArmed) return 0;
+  const int32_t left = (int32_t)(_pulseDueMs - _now);
+  if (left > 0) return (uint32_t)left;
+  applyRelay(_pulseRevertTo, _pulseSource);
+  return 0;
+}
+
+uint32_t SimNode::rulesStep() {
+  uint32_t wait = 0;
+  auto consider = [&wait](uint32_t left) { if (!wait || left < wait) wait = left; };
+
+  for (uint8_t t = 0; t < RULES_TIMERS; t++) {
+    if (!(_timersArmed & (1 << t))) continue;
+    const int32_t left = (int32_t)(_timerDue[t] - _now);
+    if (left > 0) { consider((uint32_t)left); continue; }
+    _timersArmed &= ~(1 << t);
+    fireRules(TRIG_TIMER, t, SIM_SRC_RULE);
+  }
+
+  if (_deb.stable() == 0) {
+    const uint32_t held = _now - _pressMs;
+    for (uint8_t i = 0; i < _longN; i++) {
+      if (_longFired & (1 << i)) continue;
+      if (held < _longTh[i]) { consider(_longTh[i] - held); break; }
+      _longFired |= (1 << i);
+      fireRules(TRIG_LONG, _longTh[i], SIM_SRC_INPUT);
+    }
+  }
+  return wait;
+}
+
+uint32_t SimNode::step(uint32_t nowMs) {
+  _now = nowMs;
+  if (!_started) return 0;
+
+  uint32_t wait = 0;
+  auto consider = [&wait](uint32_t left) { if (left && (!wait || left < wait)) wait = left; };
+  consider(debounceStep(_deb.raw()));
+  consider(pulseStep());
+  consider(rulesStep());
+
+  if (_mqtt.state() == MqttLite::IDLE) {
+    const int32_t left = (int32_t)(_reconnectAt - nowMs);
+    if (left <= 0) connectNow();
+    else consider((uint32_t)left);
+  } else {
+    consider(_mqtt.tick(nowMs));
+  }
+  return wait;
+}
@@ -0,0 +1,152 @@
+/**************************************************************
+ * One simulated SwitchNode
+ *
+ *  - Identity from the instance number: MAC 02:53:4E:xx:xx:xx gives
+ *    the firmware's device ID (esp32-XXXXXX), mDNS host
+ *    (switchnode-XXXXXX) and MQTT client ID formats.
+ *  - Simulated GPIO: relay output and the input pin (pull-up, LOW =
+ *    pressed). Raw edges go through the firmware's debouncer
+ *    (debounce.h) and drive the same compiled rules (rules.h),
+ *    including long presses, pulses and timers.
+ *  - MQTT contract of main.cpp: subscribes <cmd>, <cmd>/ota and
+ *    <cmd>/event; publishes retained ON/OFF to the state topic on
+ *    connect and on every relay command, and to <cmd>/din on input
+ *    changes. OTA requests are counted, not executed.
+ *  - Config store: a key/value file per instance (<dir>/<id>.prefs),
+ *    standing in for the NVS namespaces; the relay state is kept there
+ *    for the "last" power-on policy.
+ *  - Single-threaded: the simulator's poll() loop calls everything.
+ **************************************************************/
+#pragma once
+
+#include "../debounce.h"
+#include "../rules.h"
+#include "mqttlite.h"
+
+#include <map>
+#include <string>
+
+enum SimSource : uint8_t { SIM_SRC_BOOT, SIM_SRC_MQTT, SIM_SRC_INPUT, SIM_SRC_RULE };
+
+class SimPrefs {
+public:
+  // Missing file = empty store. Values are stored one per line as
+  // key=value with \n and \\ escaped.
+  bool load(const std::string &path);
+  bool save();
+  std::string get(const char* key, const char* def) const;
+  void put(const char* key, const std::string &v);
+
+private:
+  std::string _path;
+  std::map<std::string, std::string> _kv;
+  bool _dirty = false;
+};
+
+struct SimNodeCfg {
+  sockaddr_in broker;
+  const char* user;
+  const char* pass;
+  uint16_t    keepAliveS;     // PubSubClient default: 15
+  const char* topicPrefix;    // cmd topic = <prefix>/<short id> unless stored
+  const char* rules;          // default rule text unless stored
+  const char* powerPolicy;    // off | on | last, unless stored
+  uint32_t    retryMs;        // reconnect back-off
+  const char* stateDir;       // nullptr = in-memory config only
+  DebounceCfg debounce;
+};
+
+struct SimNodeStats {
+  uint32_t presses;         // debounced presses
+  uint32_t relayChanges;
+  uint32_t commands;        // relay commands received on <cmd>
+  uint32_t ruleActions;
+  uint32_t otaRequests;
+  uint32_t connectAttempts;
+};
+
+class SimNode {
+public:
+  // Loads the config store and compiles the rules. False with `err` set
+  // if the stored or configured rules do not compile.
+  bool begin(uint32_t index, const SimNodeCfg &cfg, std::string &err);
+  // Power on: applies the power-on policy and starts connecting.
+  void start(uint32_t nowMs);
+  // Power off: saves the config store and disconnects.
+  void end();
+
+  // Drives the input pin (raw level; bounce is a series of calls).
+  void setInput(bool closed, uint32_t nowMs);
+  // Drops the TCP connection as if Wi-Fi went away; reconnects after
+  // the back-off.
+  void dropConnection(uint32_t nowMs);
+  // Debounce, pulse, rule timers, MQTT keep-alive and reconnects.
+  // Returns ms until it needs to run again (0 = nothing pending).
+  uint32_t step(uint32_t nowMs);
+
+  MqttLite &mqtt() { return _mqtt; }
+  const char* deviceId() const { return _deviceId; }
+  const char* shortId() const { return _shortId; }
+  const std::string &cmdTopic() const { return _topicCmd; }
+  bool relay() const { return _relay; }
+  bool started() const { return _started; }
+  const SimNodeStats &stats() const { return _st; }
+
+private:
+  static void onMessage(void* ctx, const char* topic, const uint8_t* payload, size_t len);
+  static void onConnected(void* ctx);
+  static void onLost(void* ctx, const char* why);
+
+  static bool hostRelay(void* ctx);
+  static bool hostInputClosed(void* ctx);
+  static void hostSetRelay(void* ctx, bool on);
+  static void hostToggle(void* ctx);
+  static void hostPulse(void* ctx, uint32_t ms);
+  static void hostTimerStart(void* ctx, uint8_t t, uint32_t ms);
+  static void hostTimerCancel(void* ctx, uint8_t t);
+
+  void applyRelay(bool on, uint8_t src);
+  void armPulse(bool on, uint32_t ms, uint8_t src);
+  void fireRules(uint8_t trigger, uint32_t arg, uint8_t src);
+  void publishState();
+  void publishInput();
+  void connectNow();
+  uint32_t debounceStep(int level);
+  uint32_t pulseStep();
+  uint32_t rulesStep();
+
+  SimNodeCfg _cfg = {};
+  uint32_t   _index = 0;
+  char       _deviceId[16] = "";
+  char       _shortId[8] = "";
+  char       _clientId[40] = "";
+  std::string _topicCmd, _topicState, _topicDin, _topicOta, _topicEvent;
+  SimPrefs   _prefs;
+  MqttLite   _mqtt;
+  bool       _started = false;
+  uint32_t   _now = 0;
+  uint32_t   _reconnectAt = 0;
+
+  // GPIO + debounce (control.cpp)
+  bool      _relay = false;
+  Debouncer _deb;
+
+  // Pulse
+  bool     _pulseArmed = false;
+  bool     _pulseRevertTo = false;
+  uint8_t  _pulseSource = SIM_SRC_RULE;
+  uint32_t _pulseDueMs = 0;
+
+  // Rules
+  RuleHost    _host = {};
+  RuleProgram _prog = {};
+  uint8_t  _ruleSrc = SIM_SRC_RULE;
+  uint32_t _longTh[RULES_LONG_MAX] = {};
+  uint8_t  _longN = 0;
+  uint8_t  _longFired = 0;
+  uint32_t _pressMs = 0;
+  uint8_t  _timersArmed = 0;
+  uint32_t _timerDue[RULES_TIMERS] = {};
+
+  SimNodeStats _st = {};
+};
@@ -0,0 +1,43 @@
+/**************************************************************
+ * Bounded single-producer / single-consumer lock-free queue
+ *
+ *  - Exactly one task may push and exactly one task may pop.
+ *  - push() fails (returns false) when full; it never blocks.
+ *  - Header-only and Arduino-free.
+ **************************************************************/
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  bool push(const T &v) {
+    const uint32_t h = _head.load(std::memory_order_relaxed);
+    if (h - _tail.load(std::memory_order_acquire) == N) return false;
+    _buf[h & (N - 1)] = v;
+    _head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &v) {
+    const uint32_t t = _tail.load(std::memory_order_relaxed);
+    if (t == _head.load(std::memory_order_acquire)) return false;
+    v = _buf[t & (N - 1)];
+    _tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T _buf[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+};
@@ -0,0 +1,23 @@
+/**************************************************************
+ * Task placement (ESP32 dual core)
+ *
+ *  - Core 1 (APP_CPU): control task (GPIO, debounce, relay commands).
+ *  - Core 0 (PRO_CPU): Wi-Fi/lwIP, async_tcp (see platformio.ini),
+ *    the peer-binding task, the net task (MQTT, captive DNS, log
+ *    streaming) and the log drain.
+ *  Cross-core traffic goes through lock-free structures: SPSC queues
+ *  (spsc.h) for one-to-one links, MPSC queues (mpsc.h) where several
+ *  tasks feed one consumer, and seqlock snapshots (seqlock.h) for state
+ *  read by many tasks.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+
+#define CORE_CONTROL 1
+#define CORE_NET     0
+
+static const UBaseType_t PRIO_CONTROL = configMAX_PRIORITIES - 3;   // nothing else runs on its core at this level
+static const UBaseType_t PRIO_PEER    = 3;   // above the net task: MQTT connects can block it
+static const UBaseType_t PRIO_NET     = 2;
+static const UBaseType_t PRIO_LOG     = 1;
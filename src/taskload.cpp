@@ -0,0 +1,31 @@
+#include "taskload.h"
+
+static const uint8_t TASKLOAD_MAX = 6;
+static TaskLoadMeter* meters[TASKLOAD_MAX];
+static uint8_t meter_count = 0;
+static uint32_t last_sample_us = 0;
+
+// Registration happens during setup() only.
+void taskLoadRegister(TaskLoadMeter* m) {
+  if (meter_count < TASKLOAD_MAX) meters[meter_count++] = m;
+}
+
+void taskLoadSampleAll(uint32_t periodMs) {
+  const uint32_t now = micros();
+  if (!last_sample_us) {
+    last_sample_us = now;
+    return;
+  }
+  const uint32_t window = now - last_sample_us;
+  if (window < periodMs * 1000UL) return;
+  last_sample_us = now;
+  for (uint8_t i = 0; i < meter_count; i++) meters[i]->sample(window);
+}
+
+uint8_t taskLoadCount() {
+  return meter_count;
+}
+
+const TaskLoadMeter* taskLoadAt(uint8_t i) {
+  return i < meter_count ? meters[i] : nullptr;
+}
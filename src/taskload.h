@@ -0,0 +1,45 @@
+/**************************************************************
+ * Per-task CPU utilization
+ *
+ *  - A task wraps each unit of work in enter()/leave(); busy time is
+ *    accumulated in microseconds (one writer per meter).
+ *  - taskLoadSampleAll() (called about once a second) turns the busy
+ *    delta into a utilization figure for the last window.
+ **************************************************************/
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+class TaskLoadMeter {
+public:
+  explicit TaskLoadMeter(const char* name, int8_t core) : _name(name), _core(core) {}
+
+  void enter() { _t0 = micros(); }
+  void leave() { _busy.fetch_add(micros() - _t0, std::memory_order_relaxed); }
+
+  void sample(uint32_t windowUs) {
+    const uint32_t busy = _busy.load(std::memory_order_relaxed);
+    const uint32_t delta = busy - _lastBusy;
+    _lastBusy = busy;
+    _permille.store(windowUs ? (uint16_t)((uint64_t)delta * 1000 / windowUs) : 0, std::memory_order_relaxed);
+  }
+
+  const char* name() const { return _name; }
+  int8_t core() const { return _core; }
+  uint16_t permille() const { return _permille.load(std::memory_order_relaxed); }
+
+private:
+  const char* _name;
+  int8_t _core;
+  uint32_t _t0 = 0;
+  uint32_t _lastBusy = 0;
+  std::atomic<uint32_t> _busy{0};
+  std::atomic<uint16_t> _permille{0};
+};
+
+void taskLoadRegister(TaskLoadMeter* m);
+// Samples every meter if at least `periodMs` passed since the last sample.
+void taskLoadSampleAll(uint32_t periodMs = 1000);
+uint8_t taskLoadCount();
+const TaskLoadMeter* taskLoadAt(uint8_t i);
@@ -0,0 +1,333 @@
+// CoAP core (coap.h) against a fake host: option encoding, Block2 on
+// /.well-known/core, Observe sequence numbers and retransmission.
+//   pio test -e native -f test_coap
+#include <unity.h>
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "coap.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// -------------------- Fake host --------------------
+struct Sent {
+  CoapAddr to;
+  Bytes data;
+};
+
+struct FakeHost {
+  std::vector<Sent> sent;
+  uint32_t now = 1000;
+  bool relay = false;
+  bool pressed = false;
+  uint32_t toggles = 0;
+};
+
+static FakeHost fake;
+static CoapServer server;
+static const CoapAddr CLIENT = { 0x0100007F, 40000 };
+static const CoapAddr OTHER  = { 0x0200007F, 40001 };
+
+static CoapHost makeHost() {
+  CoapHost h = {};
+  h.ctx = &fake;
+  h.send = [](void* c, const CoapAddr &to, const uint8_t* d, size_t n) {
+    static_cast<FakeHost*>(c)->sent.push_back({ to, Bytes(d, d + n) });
+  };
+  h.nowMs = [](void* c) { return static_cast<FakeHost*>(c)->now; };
+  h.random = [](void*) -> uint32_t { return 0; };   // ACK timeout exactly 2 s
+  h.relay = [](void* c) { return static_cast<FakeHost*>(c)->relay; };
+  h.inputPressed = [](void* c) { return static_cast<FakeHost*>(c)->pressed; };
+  h.setRelay = [](void* c, bool on) { static_cast<FakeHost*>(c)->relay = on; return true; };
+  h.toggle = [](void* c) {
+    FakeHost* f = static_cast<FakeHost*>(c);
+    f->relay = !f->relay;
+    f->toggles++;
+    return true;
+  };
+  return h;
+}
+
+void setUp() {
+  fake = FakeHost();
+  server.begin(makeHost(), false);
+}
+void tearDown() {}
+
+// Sends a request; Uri-Path segments are split on '/'. Returns the parsed reply.
+static CoapMsg request(uint8_t type, uint8_t code, uint16_t mid, const char* path,
+                       uint32_t observe = COAP_NONE, uint32_t block2 = COAP_NONE,
+                       const char* body = nullptr, const CoapAddr &from = CLIENT) {
+  uint8_t buf[COAP_MSG_MAX];
+  const uint8_t token[2] = { 0xAB, 0xCD };   // one token per client, as for a re-registration
+  CoapWriter w(buf, sizeof(buf));
+  w.header(type, code, mid, token, sizeof(token));
+  if (observe != COAP_NONE) w.optionUint(COAP_OPT_OBSERVE, observe);
+  for (const char* p = path + 1; *p;) {
+    const char* e = strchr(p, '/');
+    const size_t n = e ? (size_t)(e - p) : strlen(p);
+    w.option(COAP_OPT_URI_PATH, p, n);
+    p += n + (e ? 1 : 0);
+  }
+  if (block2 != COAP_NONE) w.optionUint(COAP_OPT_BLOCK2, block2);
+  if (body) w.payload(body, strlen(body));
+  TEST_ASSERT_GREATER_THAN(0, w.size());
+
+  fake.sent.clear();
+  server.onPacket(from, buf, w.size());
+  TEST_ASSERT_EQUAL_size_t(1, fake.sent.size());
+  static Bytes last;   // the parsed reply points into it
+  last = fake.sent[0].data;
+  CoapMsg r;
+  TEST_ASSERT_TRUE(coapParse(last.data(), last.size(), r));
+  return r;
+}
+
+static std::string payload(const CoapMsg &m) {
+  return std::string((const char*)m.payload, m.payloadLen);
+}
+
+// -------------------- Codec --------------------
+static void test_option_encoding() {
+  uint8_t buf[64];
+  CoapWriter w(buf, sizeof(buf));
+  w.header(COAP_CON, COAP_GET, 0x1234, nullptr, 0);
+  w.option(1, nullptr, 0);                  // delta 1, len 0
+  w.option(20, "abcdefghijklmno", 15);      // delta 19 and len 15: 1-byte extensions
+  w.option(300, nullptr, 0);                // delta 280: 2-byte extension
+  const uint8_t want[] = {
+    0x40, 0x01, 0x12, 0x34,
+    0x10,
+    0xDD, 19 - 13, 15 - 13, 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    0xE0, 0x00, 280 - 269,
+  };
+  TEST_ASSERT_EQUAL_size_t(sizeof(want), w.size());
+  TEST_ASSERT_EQUAL_MEMORY(want, buf, sizeof(want));
+
+  // Unsigned options use the fewest bytes; 0 is empty.
+  w.header(COAP_NON, COAP_CONTENT, 1, nullptr, 0);
+  w.optionUint(COAP_OPT_OBSERVE, 0);
+  w.optionUint(COAP_OPT_CONTENT_FORMAT, 0x1234);
+  w.optionUint(COAP_OPT_BLOCK2, 0x10000);
+  const uint8_t uints[] = { 0x50, 0x45, 0x00, 0x01, 0x60, 0x62, 0x12, 0x34, 0xB3, 0x01, 0x00, 0x00 };
+  TEST_ASSERT_EQUAL_size_t(sizeof(uints), w.size());
+  TEST_ASSERT_EQUAL_MEMORY(uints, buf, sizeof(uints));
+
+  // Out of order or past the buffer: no message at all.
+  w.header(COAP_CON, COAP_GET, 1, nullptr, 0);
+  w.option(12, nullptr, 0);
+  w.option(11, nullptr, 0);
+  TEST_ASSERT_EQUAL_size_t(0, w.size());
+  uint8_t tiny[8];
+  CoapWriter t(tiny, sizeof(tiny));
+  t.header(COAP_CON, COAP_GET, 1, nullptr, 0);
+  t.payload("hello", 5);
+  TEST_ASSERT_EQUAL_size_t(0, t.size());
+}
+
+static void test_parse() {
+  uint8_t buf[64];
+  CoapWriter w(buf, sizeof(buf));
+  const uint8_t token[3] = { 1, 2, 3 };
+  w.header(COAP_CON, COAP_GET, 7, token, 3);
+  w.optionUint(COAP_OPT_OBSERVE, 0);
+  w.option(COAP_OPT_URI_PATH, ".well-known", 11);
+  w.option(COAP_OPT_URI_PATH, "core", 4);
+  w.optionUint(COAP_OPT_ACCEPT, COAP_CF_LINK);
+  w.optionUint(COAP_OPT_BLOCK2, 0x12);
+  w.option(60, "x", 1);                     // elective, unknown: ignored
+  w.payload("hi", 2);
+
+  CoapMsg m;
+  TEST_ASSERT_TRUE(coapParse(buf, w.size(), m));
+  TEST_ASSERT_EQUAL_UINT8(COAP_CON, m.type);
+  TEST_ASSERT_EQUAL_UINT16(7, m.mid);
+  TEST_ASSERT_EQUAL_MEMORY(token, m.token, 3);
+  TEST_ASSERT_EQUAL_UINT32(0, m.observe);
+  TEST_ASSERT_EQUAL_STRING("/.well-known/core", m.path);
+  TEST_ASSERT_EQUAL_UINT32(COAP_CF_LINK, m.accept);
+  TEST_ASSERT_EQUAL_UINT32(0x12, m.block2);
+  TEST_ASSERT_FALSE(m.badOption);
+  TEST_ASSERT_EQUAL_size_t(2, m.payloadLen);
+
+  w.header(COAP_CON, COAP_GET, 8, nullptr, 0);
+  w.option(61, "x", 1);                     // critical, unknown
+  TEST_ASSERT_TRUE(coapParse(buf, w.size(), m));
+  TEST_ASSERT_TRUE(m.badOption);
+
+  const uint8_t reserved[] = { 0x40, 0x01, 0, 1, 0xF0 };          // delta nibble 15
+  const uint8_t marker[]   = { 0x40, 0x01, 0, 1, 0xFF };          // marker, no payload
+  const uint8_t longTkl[]  = { 0x49, 0x01, 0, 1, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  const uint8_t cutExt[]   = { 0x40, 0x01, 0, 1, 0xE0, 0x00 };    // 2-byte delta, 1 byte left
+  const uint8_t badVer[]   = { 0x80, 0x01, 0, 1 };
+  TEST_ASSERT_FALSE(coapParse(reserved, sizeof(reserved), m));
+  TEST_ASSERT_FALSE(coapParse(marker, sizeof(marker), m));
+  TEST_ASSERT_FALSE(coapParse(longTkl, sizeof(longTkl), m));
+  TEST_ASSERT_FALSE(coapParse(cutExt, sizeof(cutExt), m));
+  TEST_ASSERT_FALSE(coapParse(badVer, sizeof(badVer), m));
+}
+
+// -------------------- Block2 --------------------
+static void test_block2() {
+  const CoapMsg whole = request(COAP_CON, COAP_GET, 1, "/.well-known/core");
+  TEST_ASSERT_EQUAL_HEX8(COAP_CONTENT, whole.code);
+  TEST_ASSERT_EQUAL_UINT32(COAP_NONE, whole.block2);
+  const std::string links = payload(whole);
+  TEST_ASSERT_GREATER_THAN(64, links.size());
+
+  // 16-byte blocks (SZX 0) and 32-byte blocks (SZX 1) reassemble the same body.
+  for (uint8_t szx = 0; szx <= 1; szx++) {
+    const size_t size = (size_t)16 << szx;
+    std::string got;
+    for (uint32_t num = 0;; num++) {
+      const CoapMsg r = request(COAP_CON, COAP_GET, (uint16_t)(100 + num), "/.well-known/core",
+                                COAP_NONE, num << 4 | szx);
+      TEST_ASSERT_EQUAL_HEX8(COAP_CONTENT, r.code);
+      TEST_ASSERT_EQUAL_UINT32(num, r.block2 >> 4);
+      TEST_ASSERT_EQUAL_UINT32(szx, r.block2 & 0x07);
+      got += payload(r);
+      if (!(r.block2 & 0x08)) break;
+      TEST_ASSERT_EQUAL_size_t(size, r.payloadLen);   // every block but the last is full
+    }
+    TEST_ASSERT_TRUE(got == links);
+  }
+
+  // Past the end, or the TCP-only SZX 7.
+  const uint32_t past = (uint32_t)((links.size() + 15) / 16) << 4;
+  TEST_ASSERT_EQUAL_HEX8(COAP_BAD_OPTION, request(COAP_CON, COAP_GET, 200, "/.well-known/core", COAP_NONE, past).code);
+  TEST_ASSERT_EQUAL_HEX8(COAP_BAD_REQUEST, request(COAP_CON, COAP_GET, 201, "/.well-known/core", COAP_NONE, 0x07).code);
+
+  // Block 0 of a one-byte resource is the plain answer; block 1 does not exist.
+  const CoapMsg relay0 = request(COAP_CON, COAP_GET, 202, "/relay", COAP_NONE, 0x02);
+  TEST_ASSERT_EQUAL_HEX8(COAP_CONTENT, relay0.code);
+  TEST_ASSERT_TRUE(payload(relay0) == "0");
+  TEST_ASSERT_EQUAL_HEX8(COAP_BAD_OPTION, request(COAP_CON, COAP_GET, 203, "/relay", COAP_NONE, 0x12).code);
+}
+
+// -------------------- Observe --------------------
+static CoapMsg lastSent() {
+  static Bytes copy;
+  copy = fake.sent.back().data;
+  CoapMsg m;
+  TEST_ASSERT_TRUE(coapParse(copy.data(), copy.size(), m));
+  return m;
+}
+
+static void test_observe_sequence() {
+  const uint32_t before = request(COAP_NON, COAP_GET, 9, "/relay", 0, COAP_NONE, nullptr, OTHER).observe;
+  request(COAP_NON, COAP_GET, 10, "/relay", 1, COAP_NONE, nullptr, OTHER);
+  server.notify(COAP_RES_RELAY);   // seq moves while nobody observes
+  const CoapMsg reg = request(COAP_CON, COAP_GET, 1, "/relay", 0);
+  TEST_ASSERT_EQUAL_UINT8(COAP_ACK, reg.type);
+  TEST_ASSERT_EQUAL_UINT32(before + 1, reg.observe);
+  TEST_ASSERT_EQUAL_UINT8(1, server.stats().observers);
+
+  // Each change: one notification with the next sequence number and the state.
+  uint32_t last = reg.observe;
+  for (int i = 0; i < 2 * COAP_CON_EVERY; i++) {
+    fake.relay = !fake.relay;
+    fake.sent.clear();
+    server.notify(COAP_RES_RELAY);
+    TEST_ASSERT_EQUAL_size_t(1, fake.sent.size());
+    const CoapMsg n = lastSent();
+    TEST_ASSERT_EQUAL_UINT32(last + 1, n.observe);
+    TEST_ASSERT_TRUE(payload(n) == (fake.relay ? "1" : "0"));
+    // NON, except every COAP_CON_EVERY-th, which must be acknowledged.
+    const bool con = ((i + 1) % COAP_CON_EVERY) == 0;
+    TEST_ASSERT_EQUAL_UINT8(con ? COAP_CON : COAP_NON, n.type);
+    if (con) {
+      const uint8_t ack[4] = { 0x60, 0x00, (uint8_t)(n.mid >> 8), (uint8_t)n.mid };
+      server.onPacket(CLIENT, ack, sizeof(ack));
+    }
+    last = n.observe;
+  }
+
+  // Other resources keep their own sequence and do not reach this observer.
+  fake.sent.clear();
+  server.notify(COAP_RES_INPUT);
+  TEST_ASSERT_EQUAL_size_t(0, fake.sent.size());
+
+  // Observe=1 deregisters.
+  const CoapMsg dereg = request(COAP_CON, COAP_GET, 2, "/relay", 1);
+  TEST_ASSERT_EQUAL_UINT32(COAP_NONE, dereg.observe);
+  TEST_ASSERT_EQUAL_UINT8(0, server.stats().observers);
+}
+
+static void test_observe_sequence_wraps() {
+  const uint32_t start = request(COAP_NON, COAP_GET, 1, "/input", 0).observe;
+  for (uint32_t i = 0; i < 0x1000000; i++) server.notify(COAP_RES_INPUT);   // 24-bit wrap
+  fake.sent.clear();
+  server.notify(COAP_RES_INPUT);
+  TEST_ASSERT_EQUAL_UINT32((start + 1) & 0xFFFFFF, lastSent().observe);
+}
+
+static void test_con_retransmit_and_drop() {
+  server.setConfirmable(true);
+  request(COAP_CON, COAP_GET, 1, "/relay", 0);
+  fake.sent.clear();
+  server.notify(COAP_RES_RELAY);
+  const CoapMsg first = lastSent();
+  TEST_ASSERT_EQUAL_UINT8(COAP_CON, first.type);
+
+  // 2 s, 4 s, 8 s, 16 s: each retry is the same message, then the observer goes.
+  uint32_t timeout = COAP_ACK_TIMEOUT_MS;
+  for (uint8_t i = 0; i < COAP_MAX_RETRANSMIT; i++) {
+    fake.now += timeout - 1;
+    fake.sent.clear();
+    server.poll();
+    TEST_ASSERT_EQUAL_size_t(0, fake.sent.size());
+    fake.now += 1;
+    TEST_ASSERT_EQUAL_UINT32(timeout * 2, server.poll());
+    TEST_ASSERT_EQUAL_size_t(1, fake.sent.size());
+    TEST_ASSERT_EQUAL_UINT16(first.mid, lastSent().mid);
+    timeout *= 2;
+  }
+  fake.now += timeout;
+  server.poll();
+  TEST_ASSERT_EQUAL_UINT8(0, server.stats().observers);
+  TEST_ASSERT_EQUAL_UINT32(1, server.stats().dropped);
+  TEST_ASSERT_EQUAL_UINT32(COAP_MAX_RETRANSMIT, server.stats().retransmits);
+}
+
+static void test_rst_drops_observer() {
+  request(COAP_CON, COAP_GET, 1, "/relay", 0);
+  request(COAP_CON, COAP_GET, 2, "/relay", 0, COAP_NONE, nullptr, OTHER);
+  fake.sent.clear();
+  server.notify(COAP_RES_RELAY);
+  TEST_ASSERT_EQUAL_size_t(2, fake.sent.size());
+  CoapMsg n;
+  TEST_ASSERT_TRUE(coapParse(fake.sent[0].data.data(), fake.sent[0].data.size(), n));
+  const uint8_t rst[4] = { 0x70, 0x00, (uint8_t)(n.mid >> 8), (uint8_t)n.mid };
+  server.onPacket(fake.sent[0].to, rst, sizeof(rst));
+  TEST_ASSERT_EQUAL_UINT8(1, server.stats().observers);
+}
+
+// -------------------- Requests --------------------
+static void test_duplicate_con_applied_once() {
+  const CoapMsg r = request(COAP_CON, COAP_POST, 42, "/relay");
+  TEST_ASSERT_EQUAL_HEX8(COAP_CHANGED, r.code);
+  const CoapMsg again = request(COAP_CON, COAP_POST, 42, "/relay");   // retransmission
+  TEST_ASSERT_EQUAL_HEX8(COAP_CHANGED, again.code);
+  TEST_ASSERT_EQUAL_UINT32(1, fake.toggles);
+  TEST_ASSERT_EQUAL_UINT32(1, server.stats().duplicates);
+
+  TEST_ASSERT_EQUAL_HEX8(COAP_CHANGED, request(COAP_CON, COAP_PUT, 43, "/relay", COAP_NONE, COAP_NONE, "off").code);
+  TEST_ASSERT_FALSE(fake.relay);
+  TEST_ASSERT_EQUAL_HEX8(COAP_BAD_REQUEST, request(COAP_CON, COAP_PUT, 44, "/relay", COAP_NONE, COAP_NONE, "maybe").code);
+  TEST_ASSERT_EQUAL_HEX8(COAP_NOT_FOUND, request(COAP_CON, COAP_GET, 45, "/nope").code);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_option_encoding);
+  RUN_TEST(test_parse);
+  RUN_TEST(test_block2);
+  RUN_TEST(test_observe_sequence);
+  RUN_TEST(test_observe_sequence_wraps);
+  RUN_TEST(test_con_retransmit_and_drop);
+  RUN_TEST(test_rst_drops_observer);
+  RUN_TEST(test_duplicate_con_applied_once);
+  return UNITY_END();
+}
@@ -0,0 +1,299 @@
+// Group command datagrams (groupmsg.h): signing, the replay window and
+// the challenge for unknown senders, with several receivers.
+//   pio test -e native -f test_groupmsg
+#include <unity.h>
+
+#include <string.h>
+#include <vector>
+
+#include "groupmsg.h"
+#include "hmac.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint8_t* KEY = (const uint8_t*)"test-key-0123456789";
+static const size_t KEY_LEN = 19;
+
+static void fromHex(const char* hex, uint8_t* out) {
+  for (size_t i = 0; hex[2 * i]; i++) {
+    auto nib = [](char c) { return (uint8_t)(c <= '9' ? c - '0' : c - 'a' + 10); };
+    out[i] = (uint8_t)(nib(hex[2 * i]) << 4 | nib(hex[2 * i + 1]));
+  }
+}
+
+// -------------------- HMAC --------------------
+static void test_hmac_rfc4231() {
+  uint8_t out[HMAC_SHA256_LEN], want[HMAC_SHA256_LEN];
+
+  // Test case 1
+  uint8_t key1[20];
+  memset(key1, 0x0b, sizeof(key1));
+  TEST_ASSERT_TRUE(hmacSha256(key1, sizeof(key1), (const uint8_t*)"Hi There", 8, out));
+  fromHex("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", want);
+  TEST_ASSERT_EQUAL_MEMORY(want, out, sizeof(want));
+
+  // Test case 2
+  const char* data2 = "what do ya want for nothing?";
+  TEST_ASSERT_TRUE(hmacSha256((const uint8_t*)"Jefe", 4, (const uint8_t*)data2, strlen(data2), out));
+  fromHex("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", want);
+  TEST_ASSERT_EQUAL_MEMORY(want, out, sizeof(want));
+
+  // Test case 6: key longer than the block is hashed first
+  uint8_t key6[131];
+  memset(key6, 0xaa, sizeof(key6));
+  const char* data6 = "Test Using Larger Than Block-Size Key - Hash Key First";
+  TEST_ASSERT_TRUE(hmacSha256(key6, sizeof(key6), (const uint8_t*)data6, strlen(data6), out));
+  fromHex("60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54", want);
+  TEST_ASSERT_EQUAL_MEMORY(want, out, sizeof(want));
+
+  TEST_ASSERT_TRUE(hmacEqual(want, want, sizeof(want)));
+  out[31] ^= 1;
+  TEST_ASSERT_FALSE(hmacEqual(want, out, sizeof(want)));
+}
+
+// -------------------- Wire format --------------------
+static void test_signing() {
+  // Same bytes as tools/groupcmd.py encode(key, 0x11223344, 7, 3, 3, 2).
+  uint8_t want[GROUP_MSG_LEN];
+  fromHex("534e473111223344000000070003030236523b19aa0499006f5467d51dad6fb8", want);
+  const GroupMsg m = { 0x11223344, 7, 3, GROUP_SCENE, 2 };
+  uint8_t buf[GROUP_MSG_LEN];
+  groupMsgEncode(m, KEY, KEY_LEN, buf);
+  TEST_ASSERT_EQUAL_MEMORY(want, buf, sizeof(want));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_FRAME_CMD, groupFrameKind(buf, sizeof(buf)));
+
+  GroupMsg d;
+  TEST_ASSERT_TRUE(groupMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+  TEST_ASSERT_EQUAL_UINT32(m.sender, d.sender);
+  TEST_ASSERT_EQUAL_UINT32(m.seq, d.seq);
+  TEST_ASSERT_EQUAL_UINT16(m.group, d.group);
+  TEST_ASSERT_EQUAL_UINT8(m.cmd, d.cmd);
+  TEST_ASSERT_EQUAL_UINT8(m.arg, d.arg);
+
+  TEST_ASSERT_FALSE(groupMsgDecode(buf, sizeof(buf), (const uint8_t*)"other-key", 9, d));
+  TEST_ASSERT_FALSE(groupMsgDecode(buf, sizeof(buf) - 1, KEY, KEY_LEN, d));
+  for (size_t i = 0; i < sizeof(buf); i++) {   // any flipped bit breaks it
+    buf[i] ^= 0x01;
+    TEST_ASSERT_FALSE(groupMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+    buf[i] ^= 0x01;
+  }
+
+  // Signed but meaningless: scene out of range.
+  groupMsgEncode({ 1, 1, 0, GROUP_SCENE, GROUP_SCENES }, KEY, KEY_LEN, buf);
+  TEST_ASSERT_FALSE(groupMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+
+  // A challenge is not a command and vice versa.
+  groupChallengeEncode({ 5, 6, 7 }, KEY, KEY_LEN, buf);
+  TEST_ASSERT_EQUAL_UINT8(GROUP_FRAME_CHALLENGE, groupFrameKind(buf, sizeof(buf)));
+  TEST_ASSERT_FALSE(groupMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+  GroupChallenge ch;
+  TEST_ASSERT_TRUE(groupChallengeDecode(buf, sizeof(buf), KEY, KEY_LEN, ch));
+  TEST_ASSERT_EQUAL_UINT32(7, ch.nonce);
+  GroupResponse r;
+  TEST_ASSERT_FALSE(groupResponseDecode(buf, sizeof(buf), KEY, KEY_LEN, r));
+}
+
+// -------------------- Replay window --------------------
+struct Sender {
+  uint32_t id;
+  uint32_t lastSeq;
+  uint32_t lastMs;
+};
+
+struct Node {
+  GroupReplayWindow w;
+  uint32_t self;
+  uint32_t nextNonce;
+  std::vector<uint32_t> ran;   // seqs applied
+  uint32_t challenges = 0;
+};
+
+// Delivers a command the way groupcmd.cpp does; the sender (if online)
+// vouches via groupVouch over a lossless "unicast". True if it ran.
+static bool deliver(Node &n, const uint8_t* pkt, uint32_t nowMs, const Sender* online) {
+  GroupMsg m;
+  if (!groupMsgDecode(pkt, GROUP_MSG_LEN, KEY, KEY_LEN, m)) return false;
+  switch (n.w.check(m.sender, m.seq, nowMs)) {
+    case GROUP_FRESH:
+      n.ran.push_back(m.seq);
+      return true;
+    case GROUP_UNKNOWN: {
+      uint8_t buf[GROUP_MSG_LEN];
+      groupChallengeEncode({ n.self, m.sender, n.w.challenge(m, n.nextNonce++, nowMs) }, KEY, KEY_LEN, buf);
+      n.challenges++;
+      GroupChallenge ch;
+      GroupResponse r;
+      if (!online || !groupChallengeDecode(buf, sizeof(buf), KEY, KEY_LEN, ch)) return false;
+      if (!groupVouch(ch, online->id, online->lastSeq, online->lastMs, nowMs, r)) return false;
+      groupResponseEncode(r, KEY, KEY_LEN, buf);
+      GroupResponse got;
+      GroupMsg held;
+      if (!groupResponseDecode(buf, sizeof(buf), KEY, KEY_LEN, got) || !n.w.answer(got, nowMs, held)) return false;
+      n.ran.push_back(held.seq);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+static void encodeFrom(Sender &s, uint32_t seq, uint32_t nowMs, uint8_t* out) {
+  s.lastSeq = seq;
+  s.lastMs = nowMs;
+  groupMsgEncode({ s.id, seq, 0, GROUP_ON, 0 }, KEY, KEY_LEN, out);
+}
+
+static void test_copies_and_replays() {
+  Node n;
+  n.self = 0xAAAA0001;
+  n.nextNonce = 100;
+  Sender s = { 0x5E0D0001, 0, 0 };
+  uint8_t pkt[GROUP_MSG_LEN];
+
+  encodeFrom(s, 1, 1000, pkt);
+  TEST_ASSERT_TRUE(deliver(n, pkt, 1000, &s));    // challenged, vouched, ran
+  TEST_ASSERT_EQUAL_UINT32(1, n.challenges);
+  TEST_ASSERT_FALSE(deliver(n, pkt, 1001, &s));   // repeat copy
+  TEST_ASSERT_FALSE(deliver(n, pkt, 1002, &s));
+  TEST_ASSERT_EQUAL_UINT32(1, n.challenges);      // known now: no second challenge
+
+  // Out of order inside the window is fine, once.
+  uint8_t p3[GROUP_MSG_LEN], p2[GROUP_MSG_LEN];
+  encodeFrom(s, 3, 1100, p3);
+  groupMsgEncode({ s.id, 2, 0, GROUP_ON, 0 }, KEY, KEY_LEN, p2);
+  TEST_ASSERT_TRUE(deliver(n, p3, 1100, &s));
+  TEST_ASSERT_TRUE(deliver(n, p2, 1101, &s));
+  TEST_ASSERT_FALSE(deliver(n, p2, 1102, &s));
+
+  // Past the 64-entry window: stale.
+  uint8_t p70[GROUP_MSG_LEN];
+  encodeFrom(s, 70, 1200, p70);
+  TEST_ASSERT_TRUE(deliver(n, p70, 1200, &s));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_STALE, n.w.check(s.id, 4, 1201));
+
+  const uint32_t want[] = { 1, 3, 2, 70 };
+  TEST_ASSERT_EQUAL_size_t(4, n.ran.size());
+  TEST_ASSERT_EQUAL_MEMORY(want, n.ran.data(), sizeof(want));
+}
+
+static void test_replay_after_reboot() {
+  Sender s = { 0x5E0D0002, 0, 0 };
+  uint8_t old[GROUP_MSG_LEN];
+  encodeFrom(s, 1, 1000, old);
+
+  Node n;   // a receiver that just rebooted: empty window
+  n.self = 0xAAAA0002;
+  n.nextNonce = 1;
+  // The captured datagram comes back 10 s later: the sender will not vouch.
+  TEST_ASSERT_FALSE(deliver(n, old, 11000, &s));
+  TEST_ASSERT_FALSE(deliver(n, old, 11001, nullptr));   // sender offline: nobody answers
+  TEST_ASSERT_EQUAL_size_t(0, n.ran.size());
+
+  // The next real command goes through after its own challenge.
+  uint8_t fresh[GROUP_MSG_LEN];
+  encodeFrom(s, 2, 12000, fresh);
+  TEST_ASSERT_TRUE(deliver(n, fresh, 12000, &s));
+  TEST_ASSERT_FALSE(deliver(n, old, 12001, &s));         // and the old one stays dead
+  TEST_ASSERT_EQUAL_size_t(1, n.ran.size());
+}
+
+static void test_replay_after_eviction() {
+  Node n;
+  n.self = 0xAAAA0003;
+  n.nextNonce = 1;
+  Sender victim = { 0x5E0D0100, 0, 0 };
+  uint8_t old[GROUP_MSG_LEN];
+  encodeFrom(victim, 1, 1000, old);
+  TEST_ASSERT_TRUE(deliver(n, old, 1000, &victim));
+
+  // An attacker floods the table with other (captured but valid) senders.
+  for (uint32_t i = 0; i < GROUP_REPLAY_SENDERS; i++) {
+    Sender other = { 0x0E000000 + i, 0, 0 };
+    uint8_t pkt[GROUP_MSG_LEN];
+    encodeFrom(other, 1, 2000 + i, pkt);
+    deliver(n, pkt, 2000 + i, &other);
+  }
+  TEST_ASSERT_EQUAL_UINT8(GROUP_UNKNOWN, n.w.check(victim.id, 1, 5000));
+  TEST_ASSERT_FALSE(deliver(n, old, 5000, &victim));   // forgotten, but still not replayable
+}
+
+static void test_challenge_rules() {
+  GroupReplayWindow w;
+  const GroupMsg m1 = { 0x77, 5, 0, GROUP_TOGGLE, 0 };
+  const GroupMsg m2 = { 0x77, 6, 0, GROUP_OFF, 0 };
+  GroupMsg out;
+
+  // Copies and a newer command share one challenge; the newest is held.
+  const uint32_t nonce = w.challenge(m1, 42, 1000);
+  TEST_ASSERT_EQUAL_UINT32(42, nonce);
+  TEST_ASSERT_EQUAL_UINT32(42, w.challenge(m1, 43, 1001));
+  TEST_ASSERT_EQUAL_UINT32(42, w.challenge(m2, 44, 1002));
+
+  TEST_ASSERT_FALSE(w.answer({ 0x77, 41, 6 }, 1003, out));   // wrong nonce
+  TEST_ASSERT_FALSE(w.answer({ 0x78, 42, 6 }, 1003, out));   // wrong sender
+  TEST_ASSERT_TRUE(w.answer({ 0x77, 42, 6 }, 1004, out));
+  TEST_ASSERT_EQUAL_UINT32(6, out.seq);
+  TEST_ASSERT_EQUAL_UINT8(GROUP_OFF, out.cmd);
+  TEST_ASSERT_FALSE(w.answer({ 0x77, 42, 6 }, 1005, out));   // a replayed response does nothing
+  TEST_ASSERT_EQUAL_UINT8(GROUP_DUPLICATE, w.check(0x77, 6, 1006));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_FRESH, w.check(0x77, 7, 1007));
+
+  // Vouching for a later command opens the window but runs nothing.
+  GroupReplayWindow v;
+  v.challenge({ 0x88, 3, 0, GROUP_ON, 0 }, 9, 1000);
+  TEST_ASSERT_FALSE(v.answer({ 0x88, 9, 4 }, 1001, out));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_DUPLICATE, v.check(0x88, 4, 1002));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_DUPLICATE, v.check(0x88, 3, 1003));   // older than the vouched seq
+  TEST_ASSERT_EQUAL_UINT8(GROUP_FRESH, v.check(0x88, 5, 1004));
+
+  // A late answer is refused.
+  GroupReplayWindow late;
+  late.challenge({ 0x99, 1, 0, GROUP_ON, 0 }, 5, 1000);
+  TEST_ASSERT_FALSE(late.answer({ 0x99, 5, 1 }, 1000 + GROUP_CHALLENGE_MS, out));
+  TEST_ASSERT_EQUAL_UINT8(GROUP_UNKNOWN, late.check(0x99, 1, 4000));
+
+  // Senders vouch only for themselves and only for recent commands.
+  GroupResponse r;
+  TEST_ASSERT_TRUE(groupVouch({ 1, 0x77, 9 }, 0x77, 6, 1000, 1500, r));
+  TEST_ASSERT_EQUAL_UINT32(6, r.seq);
+  TEST_ASSERT_EQUAL_UINT32(9, r.nonce);
+  TEST_ASSERT_FALSE(groupVouch({ 1, 0x78, 9 }, 0x77, 6, 1000, 1500, r));
+  TEST_ASSERT_FALSE(groupVouch({ 1, 0x77, 9 }, 0x77, 6, 1000, 1000 + GROUP_VOUCH_MS, r));
+  TEST_ASSERT_FALSE(groupVouch({ 1, 0x77, 9 }, 0x77, 0, 1000, 1001, r));   // never sent
+}
+
+static void test_many_receivers() {
+  // One multicast command reaches every node; each challenges with its
+  // own nonce and runs it exactly once.
+  Node nodes[3];
+  for (uint32_t i = 0; i < 3; i++) {
+    nodes[i].self = 0xBB000000 + i;
+    nodes[i].nextNonce = 1000 * (i + 1);
+  }
+  Sender s = { 0x5E0D0003, 0, 0 };
+  for (uint32_t seq = 1; seq <= 5; seq++) {
+    uint8_t pkt[GROUP_MSG_LEN];
+    encodeFrom(s, seq, 1000 * seq, pkt);
+    for (int copy = 0; copy < 3; copy++) {
+      for (Node &n : nodes) deliver(n, pkt, 1000 * seq + copy, &s);
+    }
+  }
+  for (Node &n : nodes) {
+    TEST_ASSERT_EQUAL_UINT32(1, n.challenges);
+    TEST_ASSERT_EQUAL_size_t(5, n.ran.size());
+    for (uint32_t i = 0; i < 5; i++) TEST_ASSERT_EQUAL_UINT32(i + 1, n.ran[i]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hmac_rfc4231);
+  RUN_TEST(test_signing);
+  RUN_TEST(test_copies_and_replays);
+  RUN_TEST(test_replay_after_reboot);
+  RUN_TEST(test_replay_after_eviction);
+  RUN_TEST(test_challenge_rules);
+  RUN_TEST(test_many_receivers);
+  return UNITY_END();
+}
@@ -0,0 +1,114 @@
+// LatencyHistogram (histogram.h): bucket boundaries and percentiles.
+//   pio test -e native -f test_histogram
+#include <unity.h>
+
+#include <thread>
+#include <vector>
+
+#include "histogram.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_bucket_boundaries() {
+  // Bucket i holds (2^(i-1), 2^i]; bucket 0 holds 0 and 1.
+  TEST_ASSERT_EQUAL_UINT8(0, LatencyHistogram::bucketFor(0));
+  TEST_ASSERT_EQUAL_UINT8(0, LatencyHistogram::bucketFor(1));
+  TEST_ASSERT_EQUAL_UINT8(1, LatencyHistogram::bucketFor(2));
+  TEST_ASSERT_EQUAL_UINT8(2, LatencyHistogram::bucketFor(3));
+  TEST_ASSERT_EQUAL_UINT8(2, LatencyHistogram::bucketFor(4));
+  TEST_ASSERT_EQUAL_UINT8(3, LatencyHistogram::bucketFor(5));
+  TEST_ASSERT_EQUAL_UINT8(10, LatencyHistogram::bucketFor(1024));
+  TEST_ASSERT_EQUAL_UINT8(11, LatencyHistogram::bucketFor(1025));
+
+  for (uint8_t i = 1; i < LatencyHistogram::BUCKETS; i++) {
+    const uint32_t upper = LatencyHistogram::bucketUpper(i);
+    TEST_ASSERT_EQUAL_UINT8(i, LatencyHistogram::bucketFor(upper));
+    TEST_ASSERT_EQUAL_UINT8(i + 1 < LatencyHistogram::BUCKETS ? i + 1 : LatencyHistogram::BUCKETS,
+                            LatencyHistogram::bucketFor(upper + 1));
+    TEST_ASSERT_EQUAL_UINT8(i, LatencyHistogram::bucketFor(LatencyHistogram::bucketUpper(i - 1) + 1));
+  }
+}
+
+static void test_overflow_bucket() {
+  const uint32_t last = LatencyHistogram::bucketUpper(LatencyHistogram::BUCKETS - 1);
+  TEST_ASSERT_EQUAL_UINT32(1UL << 23, last);
+  TEST_ASSERT_EQUAL_UINT8(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketFor(last));
+  TEST_ASSERT_EQUAL_UINT8(LatencyHistogram::BUCKETS, LatencyHistogram::bucketFor(last + 1));
+  TEST_ASSERT_EQUAL_UINT8(LatencyHistogram::BUCKETS, LatencyHistogram::bucketFor(UINT32_MAX));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, LatencyHistogram::bucketUpper(LatencyHistogram::BUCKETS));
+
+  LatencyHistogram h;
+  h.record(20000000);   // 20 s
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucket(LatencyHistogram::BUCKETS));
+  TEST_ASSERT_EQUAL_UINT32(20000000, h.percentileUs(0.5f));   // overflow reports the max
+}
+
+static void test_counters() {
+  LatencyHistogram h;
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentileUs(0.5f));
+  h.record(10);
+  h.record(100);
+  h.record(1000);
+  TEST_ASSERT_EQUAL_UINT32(3, h.count());
+  TEST_ASSERT_EQUAL(1110, h.sumUs());
+  TEST_ASSERT_EQUAL_UINT32(1000, h.maxUs());
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucket(4));    // 10 in (8, 16]
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucket(7));    // 100 in (64, 128]
+  TEST_ASSERT_EQUAL_UINT32(1, h.bucket(10));   // 1000 in (512, 1024]
+
+  h.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, h.count());
+  TEST_ASSERT_EQUAL(0, h.sumUs());
+  TEST_ASSERT_EQUAL_UINT32(0, h.maxUs());
+  for (uint8_t i = 0; i < LatencyHistogram::SLOTS; i++) TEST_ASSERT_EQUAL_UINT32(0, h.bucket(i));
+}
+
+static void test_percentiles() {
+  // 90 fast samples (~50 us, bucket (32, 64]), 9 slow (~500 us, (256, 512]),
+  // one outlier (5 ms, (4096, 8192]).
+  LatencyHistogram h;
+  for (int i = 0; i < 90; i++) h.record(50);
+  for (int i = 0; i < 9; i++) h.record(500);
+  h.record(5000);
+
+  TEST_ASSERT_EQUAL_UINT32(64, h.percentileUs(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(64, h.percentileUs(0.9f));
+  TEST_ASSERT_EQUAL_UINT32(512, h.percentileUs(0.91f));
+  TEST_ASSERT_EQUAL_UINT32(512, h.percentileUs(0.99f));
+  TEST_ASSERT_EQUAL_UINT32(8192, h.percentileUs(1.0f));
+  TEST_ASSERT_EQUAL_UINT32(64, h.percentileUs(0.0001f));   // at least one sample
+
+  // A percentile is the upper bound of its bucket: never below the true value.
+  LatencyHistogram one;
+  one.record(33);
+  TEST_ASSERT_EQUAL_UINT32(64, one.percentileUs(0.5f));
+}
+
+static void test_concurrent_record() {
+  LatencyHistogram h;
+  const int THREADS = 4, PER = 50000;
+  std::vector<std::thread> ts;
+  for (int t = 0; t < THREADS; t++) {
+    ts.emplace_back([&h, t] {
+      for (int i = 0; i < PER; i++) h.record((uint32_t)(t * 1000 + i % 100));
+    });
+  }
+  for (std::thread &t : ts) t.join();
+
+  TEST_ASSERT_EQUAL_UINT32(THREADS * PER, h.count());
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < LatencyHistogram::SLOTS; i++) total += h.bucket(i);
+  TEST_ASSERT_EQUAL_UINT32(THREADS * PER, total);
+  TEST_ASSERT_EQUAL_UINT32(3099, h.maxUs());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bucket_boundaries);
+  RUN_TEST(test_overflow_bucket);
+  RUN_TEST(test_counters);
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_concurrent_record);
+  return UNITY_END();
+}
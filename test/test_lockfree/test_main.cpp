@@ -0,0 +1,170 @@
+// Stress tests for the lock-free primitives shared between the control
+// and net cores (mpsc.h, seqlock.h, spsc.h), run on the host with real
+// threads: pio test -e native -f test_lockfree
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "mpsc.h"
+#include "seqlock.h"
+#include "spsc.h"
+
+void setUp() {}
+void tearDown() {}
+
+// -------------------- MPSC --------------------
+struct Item {
+  uint32_t producer;
+  uint32_t n;
+};
+
+static const uint32_t MPSC_PRODUCERS = 4;
+static const uint32_t MPSC_ITEMS = 200000;   // per producer
+
+static void test_mpsc_many_producers() {
+  static MpscQueue<Item, 16> q;   // small: producers hit "full" constantly
+  std::atomic<uint32_t> fullHits{0};
+
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < MPSC_PRODUCERS; p++) {
+    producers.emplace_back([p, &fullHits] {
+      for (uint32_t n = 0; n < MPSC_ITEMS; n++) {
+        while (!q.push({ p, n })) {
+          fullHits.fetch_add(1, std::memory_order_relaxed);
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Per producer, items must come out complete and in push order.
+  uint32_t next[MPSC_PRODUCERS] = {};
+  uint32_t total = 0;
+  bool ok = true;
+  while (total < MPSC_PRODUCERS * MPSC_ITEMS) {
+    Item it;
+    if (!q.pop(it)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (it.producer >= MPSC_PRODUCERS || it.n != next[it.producer]) ok = false;
+    else next[it.producer]++;
+    total++;
+  }
+  for (std::thread &t : producers) t.join();
+
+  TEST_ASSERT_TRUE_MESSAGE(ok, "item lost, duplicated or reordered");
+  for (uint32_t p = 0; p < MPSC_PRODUCERS; p++) TEST_ASSERT_EQUAL_UINT32(MPSC_ITEMS, next[p]);
+  Item extra;
+  TEST_ASSERT_FALSE(q.pop(extra));
+  TEST_ASSERT_GREATER_THAN(0, fullHits.load());
+}
+
+static void test_mpsc_full_and_empty() {
+  MpscQueue<Item, 4> q;
+  Item it;
+  TEST_ASSERT_FALSE(q.pop(it));
+  for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(q.push({ 0, i }));
+  TEST_ASSERT_FALSE(q.push({ 0, 4 }));
+  TEST_ASSERT_TRUE(q.pop(it));
+  TEST_ASSERT_EQUAL_UINT32(0, it.n);
+  TEST_ASSERT_TRUE(q.push({ 0, 4 }));
+  for (uint32_t i = 1; i <= 4; i++) {
+    TEST_ASSERT_TRUE(q.pop(it));
+    TEST_ASSERT_EQUAL_UINT32(i, it.n);
+  }
+  TEST_ASSERT_FALSE(q.pop(it));
+}
+
+// -------------------- SPSC --------------------
+static void test_spsc_order() {
+  static SpscQueue<uint32_t, 8> q;
+  const uint32_t N = 200000;
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < N; i++) {
+      while (!q.push(i)) std::this_thread::yield();
+    }
+  });
+  bool ok = true;
+  for (uint32_t want = 0; want < N;) {
+    uint32_t v;
+    if (!q.pop(v)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (v != want) ok = false;
+    want++;
+  }
+  producer.join();
+  TEST_ASSERT_TRUE_MESSAGE(ok, "SPSC reordered or lost an item");
+  TEST_ASSERT_EQUAL_size_t(0, q.size());
+}
+
+// -------------------- Seqlock --------------------
+// Every field carries the same generation; a torn read shows up as a
+// mismatch. 40 bytes: wider than any single atomic store.
+struct Snapshot {
+  uint32_t gen;
+  uint32_t words[8];
+  uint32_t check;
+};
+
+static Snapshot makeSnapshot(uint32_t gen) {
+  Snapshot s;
+  s.gen = gen;
+  for (uint32_t i = 0; i < 8; i++) s.words[i] = gen * 2654435761u + i;
+  s.check = ~gen;
+  return s;
+}
+
+static bool consistent(const Snapshot &s) {
+  for (uint32_t i = 0; i < 8; i++) {
+    if (s.words[i] != s.gen * 2654435761u + i) return false;
+  }
+  return s.check == ~s.gen;
+}
+
+static void test_seqlock_no_torn_reads() {
+  static Seqlock<Snapshot> lock;
+  lock.write(makeSnapshot(0));
+  const uint32_t WRITES = 200000;
+  const int READERS = 3;
+
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> torn{0}, backwards{0}, reads{0};
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < READERS; r++) {
+    readers.emplace_back([&] {
+      uint32_t last = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        const Snapshot s = lock.read();
+        if (!consistent(s)) torn.fetch_add(1);
+        if (s.gen < last) backwards.fetch_add(1);
+        last = s.gen;
+        reads.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+
+  for (uint32_t g = 1; g <= WRITES; g++) lock.write(makeSnapshot(g));
+  done.store(true, std::memory_order_release);
+  for (std::thread &t : readers) t.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+  TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+  TEST_ASSERT_GREATER_THAN(0, reads.load());
+  TEST_ASSERT_EQUAL_UINT32(WRITES + 1, lock.version());
+  TEST_ASSERT_EQUAL_UINT32(WRITES, lock.read().gen);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_mpsc_full_and_empty);
+  RUN_TEST(test_mpsc_many_producers);
+  RUN_TEST(test_spsc_order);
+  RUN_TEST(test_seqlock_no_torn_reads);
+  return UNITY_END();
+}
@@ -0,0 +1,233 @@
+// Generated by make_fixtures.py from tools/otapack.py; do not edit.
+#pragma once
+
+#include <stdint.h>
+
+static const uint32_t FIX_BASE_SIZE = 4600;
+static const uint32_t FIX_NEW_SIZE = 4820;
+
+static const uint8_t SNU_LZSS[1398] = {
+  0x53, 0x4e, 0x55, 0x31, 0x01, 0x00, 0x00, 0x00, 0xd4, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x42, 0x4b, 0xef, 0x16, 0x29, 0x2a, 0xba, 0x6d, 0x16, 0xc5, 0x89, 0x31, 0x7b, 0xd8, 0x45, 0x03,
+  0x1f, 0xa0, 0xab, 0x1e, 0xef, 0xf3, 0x3a, 0xb2, 0x09, 0x52, 0x7b, 0x55, 0xf8, 0xbc, 0x56, 0x2f,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xff, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x72, 0x79, 0x6f, 0xdb, 0x74, 0x61, 0x02, 0x00, 0xff, 0xff,
+  0x0e, 0x04, 0x69, 0x6e, 0xd7, 0x70, 0x75, 0x74, 0x04, 0x02, 0x00, 0x00, 0x00, 0x3c, 0x7e, 0x9f,
+  0x18, 0x72, 0x65, 0x6c, 0x61, 0x15, 0x03, 0x09, 0x02, 0xff, 0xf9, 0xff, 0x13, 0x00, 0x3a, 0x07,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0xff, 0x35, 0x36, 0x37, 0x38, 0x39, 0x6d, 0x71, 0x74, 0xf3, 0x74,
+  0x2f, 0x33, 0x01, 0x30, 0x07, 0x63, 0x6f, 0x61, 0x70, 0x00, 0x23, 0x00, 0x0b, 0x06, 0x2c, 0x07,
+  0x27, 0x01, 0x44, 0x07, 0x3a, 0x02, 0x0e, 0x04, 0x27, 0x01, 0x00, 0x03, 0x01, 0x65, 0x00, 0x16,
+  0x02, 0x63, 0x0a, 0x23, 0x08, 0x4b, 0x0b, 0x73, 0x02, 0x16, 0x01, 0x40, 0x33, 0x02, 0x1f, 0x0b,
+  0x81, 0x05, 0x11, 0x07, 0xd5, 0x0a, 0x04, 0x02, 0xff, 0x00, 0x00, 0x00, 0x51, 0x0b, 0xe7, 0x09,
+  0x19, 0x07, 0xdb, 0x0b, 0x21, 0x00, 0x06, 0x04, 0x3c, 0x19, 0x3d, 0x01, 0x00, 0x31, 0x07, 0x12,
+  0x02, 0x47, 0x0e, 0xd2, 0x0e, 0x85, 0x13, 0x02, 0x00, 0x61, 0x02, 0x3e, 0x0c, 0x00, 0x82, 0x1c,
+  0x32, 0x04, 0xea, 0x02, 0xca, 0x05, 0x39, 0x00, 0x16, 0x04, 0x23, 0x18, 0x0a, 0x04, 0x00, 0xda,
+  0x0d, 0x5d, 0x0c, 0x47, 0x02, 0x44, 0x05, 0x0a, 0x29, 0xa4, 0x18, 0x23, 0x02, 0x29, 0x14, 0x00,
+  0x0b, 0x02, 0x04, 0x02, 0x63, 0x1a, 0x2d, 0x08, 0x88, 0x16, 0xd8, 0x19, 0xa9, 0x05, 0x8b, 0x0b,
+  0x00, 0xe3, 0x15, 0x32, 0x06, 0x23, 0x02, 0x19, 0x01, 0x11, 0x01, 0xee, 0x0e, 0x09, 0x17, 0xfd,
+  0x0d, 0xcc, 0x05, 0x1c, 0x52, 0x2f, 0x61, 0x70, 0x55, 0x01, 0xa8, 0x04, 0xff, 0xff, 0x00, 0x0c,
+  0x04, 0x99, 0x1e, 0x94, 0x06, 0x04, 0x07, 0x2a, 0x04, 0x22, 0x18, 0x86, 0x07, 0xa6, 0x25, 0x30,
+  0x22, 0x2c, 0x23, 0x00, 0x11, 0x07, 0x7f, 0x05, 0xff, 0xff, 0xdc, 0x0a, 0x3d, 0x24, 0xc0, 0x2a,
+  0x00, 0x9e, 0x2c, 0x32, 0x29, 0x2c, 0x01, 0x68, 0x0a, 0x07, 0x00, 0xff, 0xff, 0x58, 0xc5, 0x04,
+  0x34, 0x16, 0x37, 0x2f, 0xff, 0xff, 0x1c, 0x06, 0x64, 0x09, 0x27, 0x20, 0x24, 0x02, 0x04, 0x02,
+  0x22, 0x3b, 0x34, 0x19, 0x57, 0x00, 0x01, 0xfb, 0x07, 0x22, 0x39, 0x08, 0x7a, 0x00, 0xd4, 0x0b,
+  0x0d, 0x07, 0x73, 0x53, 0x05, 0xd1, 0x04, 0x63, 0x13, 0xf0, 0x04, 0x04, 0x7f, 0x29, 0x2c, 0x16,
+  0x35, 0x07, 0x3c, 0xaf, 0x28, 0xda, 0x05, 0xcd, 0x09, 0x82, 0x00, 0x21, 0x76, 0x22, 0x18, 0x16,
+  0x16, 0xee, 0x1f, 0x0b, 0x08, 0x73, 0x71, 0x3f, 0x1a, 0x16, 0x04, 0xfc, 0x0e, 0xaa, 0x02, 0x6a,
+  0x64, 0x36, 0x6e, 0x2c, 0xdf, 0x1c, 0x1d, 0x02, 0x46, 0x01, 0x03, 0x69, 0x6f, 0x84, 0x07, 0xff,
+  0x05, 0x30, 0x02, 0x08, 0x06, 0x0d, 0x10, 0xa3, 0x15, 0x0c, 0x02, 0x00, 0xbb, 0x10, 0x75, 0x61,
+  0x7f, 0x4a, 0x1c, 0x08, 0xdf, 0x0b, 0x25, 0x00, 0x04, 0x13, 0x00, 0x47, 0x01, 0x6e, 0x22, 0x04,
+  0x11, 0x00, 0x34, 0x2c, 0x0e, 0x00, 0x2d, 0x15, 0x84, 0x6a, 0x14, 0x60, 0x13, 0x32, 0xf6, 0x0f,
+  0xbd, 0x1a, 0x8c, 0x05, 0xbb, 0x27, 0x36, 0x00, 0x23, 0x04, 0x75, 0x03, 0x94, 0x05, 0xc3, 0x11,
+  0x64, 0x38, 0x6b, 0x01, 0x00, 0x01, 0x5d, 0x14, 0xe0, 0x0a, 0x01, 0x2c, 0x05, 0xe2, 0x1c, 0x62,
+  0x1b, 0x12, 0x02, 0x3c, 0x7e, 0x19, 0x10, 0x11, 0x07, 0x54, 0x1c, 0x2e, 0x0b, 0x35, 0x27, 0x34,
+  0x2d, 0x08, 0x6d, 0x01, 0x98, 0x27, 0x0c, 0x2e, 0x1a, 0xaa, 0x27, 0x3c, 0x7f, 0xe5, 0x08, 0x11,
+  0x02, 0x4c, 0x02, 0x83, 0x47, 0x84, 0xd7, 0x17, 0xcc, 0x05, 0x3d, 0xc5, 0x56, 0xe7, 0x27, 0x39,
+  0x07, 0x41, 0x2f, 0x38, 0x03, 0x39, 0x01, 0x39, 0x04, 0x20, 0x02, 0x91, 0x14, 0xeb, 0x15, 0x62,
+  0x05, 0x38, 0x37, 0x02, 0x7b, 0x01, 0x70, 0x85, 0x51, 0xac, 0x14, 0xfa, 0x0c, 0xc8, 0x0a, 0x88,
+  0x04, 0xf9, 0x07, 0xc0, 0x30, 0x01, 0x1e, 0x07, 0xb0, 0x14, 0xa6, 0x13, 0x0b, 0x17, 0x20, 0x03,
+  0x01, 0x6c, 0xff, 0xec, 0xf5, 0x54, 0x9a, 0xab, 0x12, 0x8e, 0x4b, 0xff, 0x48, 0x60, 0x79, 0x6d,
+  0x15, 0x24, 0x87, 0x01, 0xff, 0x7c, 0xf5, 0x1e, 0xc2, 0x66, 0x2c, 0x59, 0x1a, 0xff, 0x69, 0xca,
+  0x6e, 0x6e, 0xec, 0xe8, 0x84, 0xa6, 0xff, 0xe7, 0x75, 0x33, 0x64, 0xe6, 0xd2, 0x69, 0x29, 0xff,
+  0xb7, 0x8c, 0x2c, 0x9b, 0x7f, 0xbe, 0x9c, 0x0b, 0xff, 0xdb, 0xca, 0x9b, 0x61, 0x1e, 0x13, 0x82,
+  0x5d, 0xff, 0x22, 0x2b, 0x1b, 0xd0, 0x82, 0x1c, 0x6a, 0x14, 0xff, 0xa8, 0xd5, 0xbd, 0x36, 0x4b,
+  0x67, 0x8f, 0x9d, 0xff, 0x40, 0x5c, 0xaf, 0x37, 0x23, 0xb1, 0xa3, 0xf1, 0xff, 0x7e, 0x18, 0x1c,
+  0xde, 0xfb, 0x75, 0x21, 0xa6, 0xff, 0xd9, 0xf6, 0x6e, 0x03, 0x45, 0x99, 0x7b, 0x7e, 0xff, 0x7d,
+  0x05, 0x7b, 0x9d, 0x4a, 0x10, 0x37, 0x01, 0xff, 0x3b, 0x04, 0xfa, 0xe8, 0xc3, 0x0e, 0xc2, 0x6b,
+  0x3f, 0x15, 0x58, 0x4f, 0x44, 0xf3, 0x29, 0xb9, 0x07, 0x9e, 0x04, 0x00, 0x8d, 0x26, 0x72, 0x2d,
+  0x0f, 0x00, 0x7c, 0x33, 0x93, 0x19, 0x17, 0x12, 0x39, 0x04, 0xef, 0x24, 0x00, 0x21, 0x1c, 0x90,
+  0x66, 0xac, 0x5e, 0x2c, 0x01, 0x21, 0x1b, 0x4b, 0x00, 0x45, 0x48, 0x2d, 0x15, 0x00, 0xa0, 0x38,
+  0x1d, 0x0d, 0x46, 0x35, 0xe5, 0x25, 0x93, 0x37, 0x22, 0x01, 0x6a, 0x52, 0xa8, 0x06, 0x00, 0x7f,
+  0x0e, 0x22, 0x01, 0x4a, 0x33, 0xb2, 0x0c, 0x3f, 0x27, 0x7d, 0x0b, 0xca, 0x1e, 0x23, 0x02, 0x00,
+  0x28, 0x05, 0x61, 0x34, 0x02, 0x16, 0xa4, 0x06, 0xe5, 0x18, 0x4a, 0x14, 0xc6, 0x08, 0x35, 0x04,
+  0x00, 0x23, 0x52, 0xba, 0x04, 0x4c, 0x15, 0x6d, 0x13, 0xec, 0x63, 0xd3, 0x06, 0x0b, 0x37, 0xca,
+  0x47, 0x00, 0x82, 0x12, 0x3f, 0x07, 0x22, 0x07, 0x3f, 0x03, 0x7f, 0x1b, 0xcf, 0x59, 0x0b, 0x1b,
+  0x00, 0x05, 0x00, 0x35, 0x01, 0x03, 0x01, 0x87, 0x05, 0xad, 0x08, 0x00, 0x01, 0x4e, 0x49, 0x79,
+  0x02, 0x45, 0x07, 0x00, 0x73, 0x3c, 0x45, 0x37, 0x27, 0x02, 0xff, 0x27, 0x35, 0x3a, 0x47, 0x01,
+  0x62, 0x04, 0x4a, 0x15, 0x00, 0x33, 0x05, 0x4f, 0x0c, 0x59, 0x44, 0x91, 0x18, 0x11, 0x02, 0x47,
+  0x25, 0xf0, 0x04, 0x75, 0x0a, 0x00, 0xc0, 0x1b, 0xee, 0x4f, 0x4b, 0x46, 0xec, 0x36, 0x22, 0x12,
+  0x02, 0x15, 0xde, 0x22, 0x0c, 0x05, 0x00, 0x53, 0x05, 0x2d, 0x2c, 0x0e, 0x39, 0x5d, 0x02, 0xa1,
+  0x06, 0xaf, 0x04, 0x2f, 0x02, 0x68, 0x23, 0x00, 0x6b, 0x25, 0x68, 0x06, 0x7a, 0x01, 0x05, 0x03,
+  0x65, 0x0a, 0xcc, 0x27, 0x3e, 0x04, 0x6e, 0x07, 0x00, 0x69, 0x09, 0x90, 0x2e, 0x9d, 0x00, 0x98,
+  0x27, 0xc3, 0x16, 0xc0, 0x18, 0x12, 0x32, 0x02, 0x00, 0x00, 0xc6, 0x05, 0x35, 0x05, 0x1d, 0x19,
+  0x2e, 0x08, 0x63, 0x27, 0x04, 0x07, 0x6b, 0xbf, 0x52, 0x03, 0x00, 0x2b, 0x07, 0x4f, 0x16, 0x95,
+  0x14, 0x91, 0x17, 0xb3, 0x16, 0x34, 0x02, 0x6d, 0x0d, 0x0f, 0x02, 0x00, 0x76, 0x13, 0xa6, 0x1f,
+  0x33, 0x01, 0x16, 0x17, 0x67, 0x06, 0x81, 0x03, 0x30, 0x2a, 0x51, 0x04, 0x00, 0x48, 0x17, 0x32,
+  0x19, 0x7a, 0x2e, 0xc9, 0x24, 0x00, 0x05, 0x30, 0x27, 0x26, 0x0b, 0x80, 0x1e, 0x00, 0xb7, 0x08,
+  0x50, 0x0e, 0xcb, 0x15, 0x12, 0x17, 0x00, 0x32, 0x16, 0x05, 0x43, 0x2f, 0x5d, 0x17, 0x00, 0x4b,
+  0x0b, 0x17, 0x07, 0x43, 0x17, 0xc1, 0x0a, 0x4c, 0x33, 0x6f, 0x29, 0x04, 0x02, 0x8e, 0x15, 0x00,
+  0x43, 0x01, 0x1c, 0x09, 0xa9, 0x13, 0xa5, 0x04, 0xa2, 0x16, 0x46, 0x29, 0x43, 0x07, 0xec, 0x14,
+  0x00, 0x7a, 0x19, 0x28, 0x24, 0x57, 0x59, 0x6c, 0x1e, 0x74, 0x3f, 0x5f, 0x5e, 0x59, 0x04, 0xc8,
+  0x17, 0x00, 0x14, 0x14, 0x06, 0x01, 0x4f, 0x09, 0x65, 0x07, 0x84, 0xaf, 0x26, 0x1a, 0x6d, 0x08,
+  0x71, 0x04, 0x00, 0xc1, 0x07, 0x38, 0x0c, 0xdf, 0x07, 0x23, 0xe9, 0xbe, 0x0a, 0x4d, 0x08, 0xe9,
+  0x02, 0x7a, 0x17, 0x00, 0x35, 0x3a, 0x13, 0x1b, 0x5e, 0x15, 0x7f, 0x04, 0x62, 0x14, 0x4a, 0x04,
+  0x54, 0x07, 0x05, 0x51, 0x00, 0x17, 0x07, 0x91, 0x07, 0x1c, 0x23, 0xc1, 0x25, 0x53, 0x04, 0x57,
+  0x06, 0xc3, 0x07, 0x16, 0x05, 0x00, 0x9c, 0x03, 0x3f, 0x02, 0x63, 0x07, 0x26, 0x07, 0xb2, 0x0a,
+  0xde, 0x19, 0x00, 0x01, 0x3b, 0x01, 0x00, 0x53, 0x27, 0xa9, 0x01, 0x24, 0x0a, 0x54, 0x09, 0x66,
+  0x03, 0x68, 0x04, 0x29, 0x01, 0x8e, 0x02, 0x00, 0xcb, 0x06, 0xc9, 0x00, 0xda, 0x07, 0x1a, 0x02,
+  0xc2, 0x1d, 0x33, 0x01, 0x61, 0x0e, 0x10, 0x01, 0x00, 0x28, 0x01, 0xe4, 0x15, 0x5d, 0x06, 0x39,
+  0x04, 0x3f, 0x14, 0x30, 0x07, 0x10, 0x04, 0x7e, 0x26, 0x00, 0x85, 0x09, 0x4c, 0x05, 0x78, 0x14,
+  0x23, 0x00, 0xf1, 0x6d, 0x7b, 0x0a, 0x4a, 0x04, 0x2d, 0x01, 0x00, 0x07, 0x05, 0x5c, 0x2e, 0x7c,
+  0x0b, 0x83, 0x37, 0x3b, 0x00, 0xb7, 0x47, 0x83, 0x02, 0xb4, 0x08, 0x00, 0xbb, 0x07, 0x32, 0x25,
+  0x11, 0x03, 0x15, 0x15, 0x50, 0x07, 0xe2, 0x15, 0x56, 0x14, 0xce, 0x04, 0x00, 0x66, 0x07, 0x1c,
+  0x2e, 0x2b, 0x19, 0xd3, 0x07, 0x8a, 0x1b, 0xfe, 0x04, 0xa2, 0x02, 0xed, 0x0a, 0x00, 0x8d, 0x05,
+  0x2e, 0x02, 0x69, 0x07, 0x1c, 0x25, 0x39, 0x06, 0x34, 0x07, 0x2f, 0x29, 0x55, 0x17, 0x00, 0x05,
+  0x00, 0x0c, 0x04, 0x78, 0x18, 0xd3, 0x1b, 0x1b, 0x39, 0x64, 0x26, 0xed, 0x05, 0xda, 0x09, 0x00,
+  0x2c, 0x01, 0x9a, 0x03, 0x9b, 0x1a,
+};
+
+static const uint8_t SNU_DELTA[1515] = {
+  0x53, 0x4e, 0x55, 0x31, 0x02, 0x00, 0x00, 0x00, 0xd4, 0x12, 0x00, 0x00, 0xf8, 0x11, 0x00, 0x00,
+  0x42, 0x4b, 0xef, 0x16, 0x29, 0x2a, 0xba, 0x6d, 0x16, 0xc5, 0x89, 0x31, 0x7b, 0xd8, 0x45, 0x03,
+  0x1f, 0xa0, 0xab, 0x1e, 0xef, 0xf3, 0x3a, 0xb2, 0x09, 0x52, 0x7b, 0x55, 0xf8, 0xbc, 0x56, 0x2f,
+  0xfc, 0xcd, 0x91, 0x25, 0x5e, 0xdc, 0xb6, 0xb8, 0x99, 0x1d, 0x26, 0x3b, 0xaf, 0x6b, 0xbd, 0xb6,
+  0xf3, 0xfa, 0x50, 0x51, 0xb4, 0x65, 0x2c, 0xc4, 0xfa, 0xea, 0xd8, 0xf7, 0xd2, 0xc3, 0x3d, 0x64,
+  0x43, 0x00, 0x00, 0x00, 0x00, 0xe8, 0x03, 0x00, 0x00, 0x41, 0xe8, 0x03, 0x00, 0x00, 0xe8, 0x03,
+  0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x49, 0x78, 0x00, 0x00, 0x00, 0x01,
+  0x6c, 0xec, 0xf5, 0x54, 0x9a, 0xab, 0x12, 0x8e, 0x4b, 0x48, 0x60, 0x79, 0x6d, 0x15, 0x24, 0x87,
+  0x01, 0x7c, 0xf5, 0x1e, 0xc2, 0x66, 0x2c, 0x59, 0x1a, 0x69, 0xca, 0x6e, 0x6e, 0xec, 0xe8, 0x84,
+  0xa6, 0xe7, 0x75, 0x33, 0x64, 0xe6, 0xd2, 0x69, 0x29, 0xb7, 0x8c, 0x2c, 0x9b, 0x7f, 0xbe, 0x9c,
+  0x0b, 0xdb, 0xca, 0x9b, 0x61, 0x1e, 0x13, 0x82, 0x5d, 0x22, 0x2b, 0x1b, 0xd0, 0x82, 0x1c, 0x6a,
+  0x14, 0xa8, 0xd5, 0xbd, 0x36, 0x4b, 0x67, 0x8f, 0x9d, 0x40, 0x5c, 0xaf, 0x37, 0x23, 0xb1, 0xa3,
+  0xf1, 0x7e, 0x18, 0x1c, 0xde, 0xfb, 0x75, 0x21, 0xa6, 0xd9, 0xf6, 0x6e, 0x03, 0x45, 0x99, 0x7b,
+  0x7e, 0x7d, 0x05, 0x7b, 0x9d, 0x4a, 0x10, 0x37, 0x01, 0x3b, 0x04, 0xfa, 0xe8, 0xc3, 0x0e, 0xc2,
+  0x6b, 0x15, 0x58, 0x4f, 0x44, 0xf3, 0x29, 0x43, 0x98, 0x08, 0x00, 0x00, 0x60, 0x09, 0x00, 0x00,
+  0x49, 0xa9, 0x00, 0x00, 0x00, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x63, 0x6f, 0x61, 0x70, 0x30, 0x31,
+  0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x3c, 0x7e, 0x18,
+  0xff, 0xff, 0x6d, 0x71, 0x74, 0x74, 0x2f, 0xff, 0xff, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x6d, 0x71,
+  0x74, 0x74, 0x2f, 0x6d, 0x71, 0x74, 0x74, 0x2f, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x72, 0x79, 0x6d,
+  0x71, 0x74, 0x74, 0x2f, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x63, 0x6f, 0x61, 0x70, 0x69, 0x6e, 0x70,
+  0x75, 0x74, 0x6f, 0x74, 0x61, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x72, 0x79, 0x3c, 0x7e, 0x18, 0x72,
+  0x65, 0x6c, 0x61, 0x79, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x72, 0x79, 0xff, 0xff, 0x63, 0x6f, 0x61,
+  0x70, 0x6f, 0x74, 0x61, 0x6f, 0x74, 0x61, 0xff, 0xff, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36,
+  0x37, 0x38, 0x39, 0x6f, 0x74, 0x61, 0x6f, 0x74, 0x61, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x72, 0x65,
+  0x6c, 0x61, 0x79, 0x72, 0x65, 0x6c, 0x61, 0x79, 0x6d, 0x71, 0x74, 0x74, 0x2f, 0x69, 0x6e, 0x70,
+  0x75, 0x74, 0x3c, 0x7e, 0x18, 0xff, 0xff, 0x63, 0x6f, 0x61, 0x70, 0x6f, 0x74, 0x61, 0x43, 0xe4,
+  0x04, 0x00, 0x00, 0x1a, 0x00, 0x00, 0x00, 0x49, 0x10, 0x00, 0x00, 0x00, 0x6f, 0x74, 0x61, 0x3c,
+  0x7e, 0x18, 0x6f, 0x74, 0x61, 0x63, 0x6f, 0x61, 0x70, 0x6f, 0x74, 0x61, 0x43, 0xd1, 0x0d, 0x00,
+  0x00, 0x19, 0x00, 0x00, 0x00, 0x49, 0x40, 0x00, 0x00, 0x00, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x6d,
+  0x71, 0x74, 0x74, 0x2f, 0xff, 0xff, 0x63, 0x6f, 0x61, 0x70, 0x6d, 0x71, 0x74, 0x74, 0x2f, 0x72,
+  0x65, 0x6c, 0x61, 0x79, 0x3c, 0x7e, 0x18, 0x6d, 0x71, 0x74, 0x74, 0x2f, 0x68, 0x69, 0x73, 0x74,
+  0x6f, 0x72, 0x79, 0x00, 0x00, 0x00, 0x00, 0x6f, 0x74, 0x61, 0x6f, 0x74, 0x61, 0x3c, 0x7e, 0x18,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x45,
+};
+
+static const uint8_t SNU_DELTA_LZSS[532] = {
+  0x53, 0x4e, 0x55, 0x31, 0x03, 0x00, 0x00, 0x00, 0xd4, 0x12, 0x00, 0x00, 0xf8, 0x11, 0x00, 0x00,
+  0x42, 0x4b, 0xef, 0x16, 0x29, 0x2a, 0xba, 0x6d, 0x16, 0xc5, 0x89, 0x31, 0x7b, 0xd8, 0x45, 0x03,
+  0x1f, 0xa0, 0xab, 0x1e, 0xef, 0xf3, 0x3a, 0xb2, 0x09, 0x52, 0x7b, 0x55, 0xf8, 0xbc, 0x56, 0x2f,
+  0xfc, 0xcd, 0x91, 0x25, 0x5e, 0xdc, 0xb6, 0xb8, 0x99, 0x1d, 0x26, 0x3b, 0xaf, 0x6b, 0xbd, 0xb6,
+  0xf3, 0xfa, 0x50, 0x51, 0xb4, 0x65, 0x2c, 0xc4, 0xfa, 0xea, 0xd8, 0xf7, 0xd2, 0xc3, 0x3d, 0x64,
+  0xfb, 0x43, 0x00, 0x00, 0x00, 0xe8, 0x03, 0x00, 0x00, 0x41, 0x04, 0x04, 0x01, 0x03, 0x01, 0x01,
+  0x11, 0x01, 0x00, 0x0f, 0x00, 0x0f, 0x00, 0x06, 0x31, 0x0f, 0x00, 0x00, 0x0f, 0x00, 0x0b, 0x31,
+  0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x00, 0x31, 0x0f, 0x00, 0x0f,
+  0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x00, 0x0b, 0x31,
+  0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x00, 0x0f,
+  0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x00, 0x31,
+  0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00,
+  0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f,
+  0x00, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00, 0x0b, 0x31, 0x0f, 0x00, 0x0f, 0x00,
+  0x0b, 0xfb, 0x49, 0x78, 0x04, 0x00, 0x01, 0x6c, 0xec, 0xf5, 0x54, 0xff, 0x9a, 0xab, 0x12, 0x8e,
+  0x4b, 0x48, 0x60, 0x79, 0xff, 0x6d, 0x15, 0x24, 0x87, 0x01, 0x7c, 0xf5, 0x1e, 0xff, 0xc2, 0x66,
+  0x2c, 0x59, 0x1a, 0x69, 0xca, 0x6e, 0xff, 0x6e, 0xec, 0xe8, 0x84, 0xa6, 0xe7, 0x75, 0x33, 0xff,
+  0x64, 0xe6, 0xd2, 0x69, 0x29, 0xb7, 0x8c, 0x2c, 0xff, 0x9b, 0x7f, 0xbe, 0x9c, 0x0b, 0xdb, 0xca,
+  0x9b, 0xff, 0x61, 0x1e, 0x13, 0x82, 0x5d, 0x22, 0x2b, 0x1b, 0xff, 0xd0, 0x82, 0x1c, 0x6a, 0x14,
+  0xa8, 0xd5, 0xbd, 0xff, 0x36, 0x4b, 0x67, 0x8f, 0x9d, 0x40, 0x5c, 0xaf, 0xff, 0x37, 0x23, 0xb1,
+  0xa3, 0xf1, 0x7e, 0x18, 0x1c, 0xff, 0xde, 0xfb, 0x75, 0x21, 0xa6, 0xd9, 0xf6, 0x6e, 0xff, 0x03,
+  0x45, 0x99, 0x7b, 0x7e, 0x7d, 0x05, 0x7b, 0xff, 0x9d, 0x4a, 0x10, 0x37, 0x01, 0x3b, 0x04, 0xfa,
+  0xff, 0xe8, 0xc3, 0x0e, 0xc2, 0x6b, 0x15, 0x58, 0x4f, 0xff, 0x44, 0xf3, 0x29, 0x43, 0x98, 0x08,
+  0x00, 0x00, 0xeb, 0x60, 0x09, 0x85, 0x00, 0xa9, 0x85, 0x00, 0x72, 0x65, 0x6c, 0xff, 0x61, 0x79,
+  0x63, 0x6f, 0x61, 0x70, 0x30, 0x31, 0xff, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0xfe,
+  0x12, 0x02, 0x3c, 0x7e, 0x18, 0xff, 0xff, 0x6d, 0x71, 0x1f, 0x74, 0x74, 0x2f, 0xff, 0xff, 0x10,
+  0x02, 0x0b, 0x02, 0x04, 0x02, 0x3f, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x72, 0x10, 0x03, 0x3e, 0x06,
+  0xff, 0x69, 0x6e, 0x70, 0x75, 0x74, 0x6f, 0x74, 0x61, 0x30, 0x1c, 0x04, 0x3e, 0x00, 0x1a, 0x02,
+  0x0e, 0x04, 0xff, 0xff, 0x23, 0x01, 0x1e, 0x00, 0x06, 0x02, 0x00, 0xff, 0xff, 0x6a, 0x07, 0x11,
+  0x03, 0x3b, 0x02, 0x2e, 0x02, 0x69, 0x07, 0xf8, 0x13, 0x02, 0x84, 0x02, 0x39, 0x04, 0x43, 0xe4,
+  0x04, 0x00, 0x00, 0x05, 0x1a, 0x3c, 0x11, 0x10, 0x04, 0x00, 0x10, 0x00, 0x1c, 0x00, 0x05, 0x00,
+  0x1d, 0x05, 0x5f, 0xd1, 0x0d, 0x00, 0x00, 0x19, 0x1d, 0x01, 0x40, 0x04, 0x00, 0x00, 0x3c, 0x02,
+  0xbc, 0x04, 0x20, 0x01, 0xaa, 0x07, 0x34, 0x00, 0xc3, 0x09, 0x8c, 0x11, 0x83, 0x03, 0x04, 0x18,
+  0x00, 0x96, 0x07, 0x45,
+};
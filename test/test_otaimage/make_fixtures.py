@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Regenerates fixtures.h for test_otaimage with tools/otapack.py:
+  python3 test/test_otaimage/make_fixtures.py
+
+The base and new images are built from a small PRNG that test_main.cpp
+mirrors, so only the encoded containers are stored.
+"""
+
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, "..", "..", "tools"))
+import otapack  # noqa: E402
+
+WORDS = [b"relay", b"input", b"mqtt/", b"coap", b"ota", b"history",
+         b"\x00\x00\x00\x00", b"\xff\xff", b"0123456789", b"\x3c\x7e\x18"]
+BASE_SIZE = 4600   # larger than the 4 KB LZSS window
+
+
+class Rng:
+    def __init__(self, seed):
+        self.x = seed
+
+    def next(self):
+        x = self.x
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        self.x = x
+        return x
+
+
+def words(rng, size):
+    out = bytearray()
+    while len(out) < size:
+        out += WORDS[rng.next() % len(WORDS)]
+    return bytes(out[:size])
+
+
+def make_images():
+    rng = Rng(0x5EED1234)
+    base = words(rng, BASE_SIZE)
+    tweaked = bytearray(base[1000:2000])
+    for i in range(0, len(tweaked), 50):
+        tweaked[i] = (tweaked[i] + 1) & 0xFF
+    inserted = bytes(rng.next() & 0xFF for _ in range(120))
+    new = base[:1000] + bytes(tweaked) + inserted + base[2200:] + words(rng, 300)
+    return base, new
+
+
+def ops_used(ops):
+    used, i = set(), 0
+    while True:
+        op = ops[i:i + 1]
+        used.add(op)
+        if op == b"E":
+            return used
+        if op == b"C":
+            i += 9
+        elif op == b"A":
+            i += 9 + int.from_bytes(ops[i + 5:i + 9], "little")
+        else:
+            i += 5 + int.from_bytes(ops[i + 1:i + 5], "little")
+
+
+def c_array(name, blob):
+    lines = [f"static const uint8_t {name}[{len(blob)}] = {{"]
+    for off in range(0, len(blob), 16):
+        lines.append("  " + " ".join(f"0x{b:02x}," for b in blob[off:off + 16]))
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    base, new = make_images()
+    assert ops_used(otapack.make_delta(base, new)) >= {b"C", b"A", b"I", b"E"}, "delta misses an op type"
+
+    fixtures = [
+        ("SNU_LZSS", otapack.build(new)),
+        ("SNU_DELTA", otapack.build(new, base=base, lzss=False)),
+        ("SNU_DELTA_LZSS", otapack.build(new, base=base)),
+    ]
+    for _, blob in fixtures:
+        assert otapack.unpack(blob, base) == new
+
+    with open(os.path.join(HERE, "fixtures.h"), "w") as f:
+        f.write("// Generated by make_fixtures.py from tools/otapack.py; do not edit.\n")
+        f.write("#pragma once\n\n#include <stdint.h>\n\n")
+        f.write(f"static const uint32_t FIX_BASE_SIZE = {len(base)};\n")
+        f.write(f"static const uint32_t FIX_NEW_SIZE = {len(new)};\n\n")
+        f.write("\n\n".join(c_array(name, blob) for name, blob in fixtures) + "\n")
+    for name, blob in fixtures:
+        print(f"{name}: {len(blob)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,204 @@
+// OTA containers (otaimage.h): images encoded by tools/otapack.py decode
+// back byte for byte, in any chunking; truncated and corrupt streams are
+// refused. pio test -e native -f test_otaimage
+// fixtures.h comes from make_fixtures.py (rerun it after changing otapack.py).
+#include <unity.h>
+
+#include <string.h>
+#include <vector>
+
+#include "fixtures.h"
+#include "otaimage.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+void setUp() {}
+void tearDown() {}
+
+// -------------------- Images (mirror make_fixtures.py) --------------------
+static uint32_t rngNext(uint32_t &x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static void appendWords(Bytes &out, uint32_t &rng, size_t size) {
+  static const struct { const char* p; size_t n; } WORDS[] = {
+    { "relay", 5 }, { "input", 5 }, { "mqtt/", 5 }, { "coap", 4 }, { "ota", 3 }, { "history", 7 },
+    { "\x00\x00\x00\x00", 4 }, { "\xff\xff", 2 }, { "0123456789", 10 }, { "\x3c\x7e\x18", 3 },
+  };
+  const size_t end = out.size() + size;
+  while (out.size() < end) {
+    const auto &w = WORDS[rngNext(rng) % (sizeof(WORDS) / sizeof(WORDS[0]))];
+    out.insert(out.end(), (const uint8_t*)w.p, (const uint8_t*)w.p + w.n);
+  }
+  out.resize(end);
+}
+
+static Bytes base_img, new_img;
+
+static void makeImages() {
+  uint32_t rng = 0x5EED1234;
+  appendWords(base_img, rng, FIX_BASE_SIZE);
+
+  new_img.assign(base_img.begin(), base_img.begin() + 1000);
+  for (size_t i = 1000; i < 2000; i++) new_img.push_back(base_img[i] + ((i - 1000) % 50 == 0 ? 1 : 0));
+  for (int i = 0; i < 120; i++) new_img.push_back((uint8_t)rngNext(rng));
+  new_img.insert(new_img.end(), base_img.begin() + 2200, base_img.end());
+  appendWords(new_img, rng, 300);
+}
+
+// -------------------- Decode harness --------------------
+struct Run {
+  Bytes out;
+  const Bytes* base = &base_img;
+  size_t sinkLimit = SIZE_MAX;   // sink fails past this many bytes
+};
+
+static bool sink(const uint8_t* data, size_t len, void* ctx) {
+  Run* r = static_cast<Run*>(ctx);
+  if (r->out.size() + len > r->sinkLimit) return false;
+  r->out.insert(r->out.end(), data, data + len);
+  return true;
+}
+
+static bool baseRead(uint32_t off, uint8_t* buf, size_t len, void* ctx) {
+  const Bytes &b = *static_cast<Run*>(ctx)->base;
+  if (off + len > b.size()) return false;
+  memcpy(buf, b.data() + off, len);
+  return true;
+}
+
+// Feeds the payload in `chunk`-byte pieces; false as soon as write() fails.
+static bool decode(OtaImageDecoder &d, Run &r, const Bytes &blob, size_t chunk) {
+  OtaImageHeader h;
+  TEST_ASSERT_TRUE(otaImageParseHeader(blob.data(), h));
+  d.begin(h, sink, baseRead, &r);
+  for (size_t off = OTA_IMG_HEADER; off < blob.size(); off += chunk) {
+    const size_t n = blob.size() - off < chunk ? blob.size() - off : chunk;
+    if (!d.write(blob.data() + off, n)) return false;
+  }
+  return true;
+}
+
+#define BLOB(a) Bytes((a), (a) + sizeof(a))
+
+static OtaImageDecoder dec;   // 4 KB window: keep it off the stack
+
+// -------------------- Round trip --------------------
+static void test_header() {
+  OtaImageHeader h;
+  TEST_ASSERT_TRUE(otaImageIsContainer(SNU_LZSS, sizeof(SNU_LZSS)));
+  TEST_ASSERT_TRUE(otaImageParseHeader(SNU_DELTA_LZSS, h));
+  TEST_ASSERT_EQUAL_HEX8(OTA_IMG_LZSS | OTA_IMG_DELTA, h.flags);
+  TEST_ASSERT_EQUAL_UINT8(0, h.target);
+  TEST_ASSERT_EQUAL_UINT32(FIX_NEW_SIZE, h.outSize);
+  TEST_ASSERT_EQUAL_UINT32(FIX_BASE_SIZE, h.baseSize);
+
+  Bytes bad = BLOB(SNU_LZSS);
+  bad[0] = 'X';
+  TEST_ASSERT_FALSE(otaImageIsContainer(bad.data(), bad.size()));
+  bad = BLOB(SNU_LZSS);
+  bad[4] |= 0x80;   // unknown flag
+  TEST_ASSERT_FALSE(otaImageParseHeader(bad.data(), h));
+}
+
+static void roundTrip(const Bytes &blob) {
+  static const size_t CHUNKS[] = { 1, 3, 64, 257, 100000 };
+  for (size_t chunk : CHUNKS) {
+    Run r;
+    TEST_ASSERT_TRUE_MESSAGE(decode(dec, r, blob, chunk), dec.error());
+    TEST_ASSERT_TRUE(dec.finished());
+    TEST_ASSERT_EQUAL_UINT32(new_img.size(), dec.produced());
+    TEST_ASSERT_EQUAL_size_t(new_img.size(), r.out.size());
+    TEST_ASSERT_EQUAL_MEMORY(new_img.data(), r.out.data(), new_img.size());
+  }
+}
+
+static void test_lzss()       { roundTrip(BLOB(SNU_LZSS)); }
+static void test_delta()      { roundTrip(BLOB(SNU_DELTA)); }
+static void test_delta_lzss() { roundTrip(BLOB(SNU_DELTA_LZSS)); }
+
+// -------------------- Bad input --------------------
+static void test_truncated() {
+  const Bytes blobs[] = { BLOB(SNU_LZSS), BLOB(SNU_DELTA), BLOB(SNU_DELTA_LZSS) };
+  for (const Bytes &full : blobs) {
+    for (size_t cut : { (size_t)1, (size_t)2, (full.size() - OTA_IMG_HEADER) / 2 }) {
+      const Bytes blob(full.begin(), full.end() - cut);
+      Run r;
+      decode(dec, r, blob, 64);
+      TEST_ASSERT_FALSE(dec.finished());   // a delta cut before 'E' may have all bytes but is not done
+      if (cut > 2) TEST_ASSERT_LESS_THAN_UINT32(new_img.size(), r.out.size());
+    }
+  }
+}
+
+static void test_corrupt_delta() {
+  Bytes blob = BLOB(SNU_DELTA);
+  TEST_ASSERT_EQUAL_HEX8('C', blob[OTA_IMG_HEADER]);   // first op: copy the unchanged head
+
+  Run r;
+  blob[OTA_IMG_HEADER] = 'X';
+  TEST_ASSERT_FALSE(decode(dec, r, blob, 64));
+  TEST_ASSERT_EQUAL_STRING("bad_op", dec.error());
+
+  blob = BLOB(SNU_DELTA);
+  blob[OTA_IMG_HEADER + 8] = 0xFF;   // copy length far past the base
+  TEST_ASSERT_FALSE(decode(dec, r, blob, 64));
+  TEST_ASSERT_EQUAL_STRING("base_range", dec.error());
+
+  blob = BLOB(SNU_DELTA);
+  blob.push_back('E');
+  TEST_ASSERT_FALSE(decode(dec, r, blob, 64));
+  TEST_ASSERT_EQUAL_STRING("trailing_data", dec.error());
+
+  // A shorter running image than the delta was made against.
+  const Bytes shortBase(base_img.begin(), base_img.begin() + 1500);
+  Run s;
+  s.base = &shortBase;
+  TEST_ASSERT_FALSE(decode(dec, s, BLOB(SNU_DELTA_LZSS), 64));
+  TEST_ASSERT_EQUAL_STRING("base_read", dec.error());
+}
+
+static void test_corrupt_lzss() {
+  // Extra literals after the image is complete.
+  Bytes blob = BLOB(SNU_LZSS);
+  blob.push_back(0xFF);
+  blob.push_back(0x00);
+  Run r;
+  TEST_ASSERT_FALSE(decode(dec, r, blob, 64));
+  TEST_ASSERT_EQUAL_STRING("too_long", dec.error());
+
+  // A flipped byte in the middle decodes to something else: the SHA-256
+  // check in ota.cpp is what rejects it, so the output must differ.
+  blob = BLOB(SNU_LZSS);
+  blob[OTA_IMG_HEADER + (blob.size() - OTA_IMG_HEADER) / 2] ^= 0x5A;
+  Run c;
+  const bool ok = decode(dec, c, blob, 64) && dec.finished();
+  TEST_ASSERT_FALSE(ok && c.out == new_img);
+}
+
+static void test_sink_error() {
+  Run r;
+  r.sinkLimit = 1000;
+  TEST_ASSERT_FALSE(decode(dec, r, BLOB(SNU_DELTA_LZSS), 64));
+  TEST_ASSERT_EQUAL_STRING("sink", dec.error());
+  TEST_ASSERT_FALSE(dec.write(SNU_DELTA_LZSS + OTA_IMG_HEADER, 1));   // stays failed
+}
+
+int main() {
+  makeImages();
+  TEST_ASSERT_EQUAL_size_t(FIX_NEW_SIZE, new_img.size());
+
+  UNITY_BEGIN();
+  RUN_TEST(test_header);
+  RUN_TEST(test_lzss);
+  RUN_TEST(test_delta);
+  RUN_TEST(test_delta_lzss);
+  RUN_TEST(test_truncated);
+  RUN_TEST(test_corrupt_delta);
+  RUN_TEST(test_corrupt_lzss);
+  RUN_TEST(test_sink_error);
+  return UNITY_END();
+}
@@ -0,0 +1,285 @@
+// OTA pull body framing (httpbody.h): the pull loop of ota.cpp against a
+// local HTTP server sending chunked, Content-Length and close-delimited
+// responses, plus malformed and truncated chunk streams.
+//   pio test -e native -f test_otapull
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "httpbody.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Pseudo image, same generator as test_otaimage.
+static std::vector<uint8_t> image(size_t n) {
+  std::vector<uint8_t> v(n);
+  uint32_t x = 0x5EED1234;
+  for (size_t i = 0; i < n; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    v[i] = (uint8_t)x;
+  }
+  return v;
+}
+
+static std::string bytes(const std::vector<uint8_t> &v, size_t off, size_t n) {
+  return std::string((const char*)v.data() + off, n);
+}
+
+static std::string chunked(const std::vector<uint8_t> &v, const std::vector<size_t> &sizes, const char* tail) {
+  std::string s;
+  size_t off = 0, i = 0;
+  while (off < v.size()) {
+    const size_t n = std::min(sizes[i++ % sizes.size()], v.size() - off);
+    char line[32];
+    snprintf(line, sizeof(line), i % 3 ? "%zx\r\n" : "%zX;name=val\r\n", n);   // some with an extension
+    s += line;
+    s += bytes(v, off, n);
+    s += "\r\n";
+    off += n;
+  }
+  return s + "0\r\n" + tail;
+}
+
+// -------------------- Local server --------------------
+// Accepts one connection, sends `response` in `slice`-byte writes, and
+// closes only if `close` (keep-alive otherwise, like an HTTP/1.1 server).
+struct Server {
+  int fd = -1;
+  uint16_t port = 0;
+  std::thread th;
+
+  Server(const std::string &response, size_t slice, bool close) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in sa = {};
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sa);
+    TEST_ASSERT_TRUE(bind(fd, (sockaddr*)&sa, sizeof(sa)) == 0);
+    TEST_ASSERT_TRUE(listen(fd, 1) == 0);
+    getsockname(fd, (sockaddr*)&sa, &len);
+    port = ntohs(sa.sin_port);
+
+    th = std::thread([this, response, slice, close] {
+      const int c = accept(fd, nullptr, nullptr);
+      char req[1024];
+      recv(c, req, sizeof(req), 0);   // the GET; not checked
+      for (size_t off = 0; off < response.size(); off += slice) {
+        send(c, response.data() + off, std::min(slice, response.size() - off), MSG_NOSIGNAL);
+        usleep(200);
+      }
+      if (!close) usleep(300 * 1000);   // hold the connection open past the client's read
+      ::close(c);
+    });
+  }
+  ~Server() {
+    th.join();
+    ::close(fd);
+  }
+};
+
+// -------------------- Client (the pull loop) --------------------
+struct Pull {
+  std::vector<uint8_t> body;
+  bool finished = false;
+  bool sawClose = false;
+  std::string error;
+  size_t failAfter = SIZE_MAX;   // sink refuses once this much arrived
+};
+
+static bool sink(const uint8_t* data, size_t len, void* ctx) {
+  Pull* p = static_cast<Pull*>(ctx);
+  if (p->body.size() + len > p->failAfter) return false;
+  p->body.insert(p->body.end(), data, data + len);
+  return true;
+}
+
+// Minimal header parse (HTTPClient's part), then the body loop of pullTask().
+static Pull pull(uint16_t port) {
+  Pull p;
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in sa = {};
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(port);
+  TEST_ASSERT_TRUE(connect(fd, (sockaddr*)&sa, sizeof(sa)) == 0);
+  const char req[] = "GET /fw.bin HTTP/1.0\r\n\r\n";
+  send(fd, req, sizeof(req) - 1, MSG_NOSIGNAL);
+
+  std::string head;
+  char c;
+  while (head.find("\r\n\r\n") == std::string::npos && recv(fd, &c, 1, 0) == 1) head += c;
+  const bool isChunked = head.find("Transfer-Encoding: chunked") != std::string::npos;
+  int64_t size = -1;
+  const size_t cl = head.find("Content-Length: ");
+  if (cl != std::string::npos) size = atoll(head.c_str() + cl + 16);
+
+  HttpBodyDecoder body;
+  body.begin(isChunked, size, sink, &p);
+  uint8_t buf[97];   // odd size: slices never line up with the chunks
+  bool ok = true;
+  while (ok && !body.finished()) {
+    pollfd pf = { fd, POLLIN, 0 };
+    if (poll(&pf, 1, 2000) <= 0) {
+      p.error = "timeout";
+      break;
+    }
+    const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      p.sawClose = true;
+      body.closed();
+      break;
+    }
+    ok = body.write(buf, (size_t)n);
+  }
+  close(fd);
+  p.finished = body.finished();
+  if (body.error()) p.error = body.error();
+  TEST_ASSERT_EQUAL_UINT32(p.body.size(), (uint32_t)body.produced());
+  return p;
+}
+
+static void assertImage(const Pull &p, const std::vector<uint8_t> &img) {
+  TEST_ASSERT_TRUE_MESSAGE(p.finished, p.error.c_str());
+  TEST_ASSERT_EQUAL_size_t(img.size(), p.body.size());
+  TEST_ASSERT_EQUAL_MEMORY(img.data(), p.body.data(), img.size());
+}
+
+static const char* HEAD_CHUNKED = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                                  "Transfer-Encoding: chunked\r\n\r\n";
+
+// -------------------- Tests --------------------
+static void test_chunked_keepalive() {
+  // The server keeps the connection open: the last-chunk alone ends the body.
+  const std::vector<uint8_t> img = image(20000);
+  Server srv(HEAD_CHUNKED + chunked(img, { 4096, 1, 333, 1024 }, "\r\n"), 700, false);
+  const Pull p = pull(srv.port);
+  assertImage(p, img);
+  TEST_ASSERT_FALSE(p.sawClose);
+}
+
+static void test_chunked_trailers() {
+  const std::vector<uint8_t> img = image(5000);
+  Server srv(HEAD_CHUNKED + chunked(img, { 512 }, "X-Checksum: abc\r\nX-More: 1\r\n\r\n"), 61, true);
+  assertImage(pull(srv.port), img);
+}
+
+static void test_content_length() {
+  const std::vector<uint8_t> img = image(12345);
+  Server srv("HTTP/1.0 200 OK\r\nContent-Length: 12345\r\n\r\n" + bytes(img, 0, img.size()), 1000, false);
+  const Pull p = pull(srv.port);
+  assertImage(p, img);
+  TEST_ASSERT_FALSE(p.sawClose);
+}
+
+static void test_until_close() {
+  const std::vector<uint8_t> img = image(7000);
+  Server srv("HTTP/1.0 200 OK\r\n\r\n" + bytes(img, 0, img.size()), 512, true);
+  const Pull p = pull(srv.port);
+  assertImage(p, img);
+  TEST_ASSERT_TRUE(p.sawClose);
+}
+
+static void test_chunked_truncated() {
+  const std::vector<uint8_t> img = image(3000);
+  const std::string full = chunked(img, { 1000 }, "\r\n");
+  Server srv(HEAD_CHUNKED + full.substr(0, full.size() / 2), 256, true);
+  const Pull p = pull(srv.port);
+  TEST_ASSERT_FALSE(p.finished);
+  TEST_ASSERT_EQUAL_STRING("truncated", p.error.c_str());
+}
+
+static void test_content_length_truncated() {
+  const std::vector<uint8_t> img = image(3000);
+  Server srv("HTTP/1.0 200 OK\r\nContent-Length: 4000\r\n\r\n" + bytes(img, 0, img.size()), 256, true);
+  const Pull p = pull(srv.port);
+  TEST_ASSERT_FALSE(p.finished);
+  TEST_ASSERT_EQUAL_STRING("truncated", p.error.c_str());
+}
+
+// -------------------- Decoder only --------------------
+static Pull decode(const std::string &in, bool isChunked, int64_t size, size_t slice) {
+  Pull p;
+  HttpBodyDecoder body;
+  body.begin(isChunked, size, sink, &p);
+  for (size_t off = 0; off < in.size() && !body.finished(); off += slice) {
+    if (!body.write((const uint8_t*)in.data() + off, std::min(slice, in.size() - off))) break;
+  }
+  p.finished = body.finished();
+  if (body.error()) p.error = body.error();
+  return p;
+}
+
+static void test_every_split() {
+  const std::vector<uint8_t> img = image(300);
+  const std::string in = chunked(img, { 7, 100, 1 }, "T: 1\r\n\r\n") + "garbage after the body";
+  for (size_t slice = 1; slice <= 40; slice++) assertImage(decode(in, true, -1, slice), img);
+}
+
+static void test_malformed_chunks() {
+  struct Case { const char* in; const char* error; };
+  const Case cases[] = {
+    { "\r\n", "chunk_size" },                  // no digits
+    { "g\r\nx\r\n", "chunk_size" },
+    { "123456789\r\n", "chunk_size" },          // > 8 hex digits
+    { "3\nabc\r\n", "chunk_size" },             // bare LF
+    { "3\r\nabcd\r\n", "chunk_framing" },       // chunk longer than announced
+    { "3\r\nabc\n0\r\n\r\n", "chunk_framing" },
+    { "0\r\n\rX", "chunk_framing" },
+  };
+  for (const Case &c : cases) {
+    const Pull p = decode(c.in, true, -1, 1);
+    TEST_ASSERT_FALSE(p.finished);
+    TEST_ASSERT_EQUAL_STRING(c.error, p.error.c_str());
+  }
+  // Writes after a failure keep failing.
+  Pull p;
+  HttpBodyDecoder body;
+  body.begin(true, -1, sink, &p);
+  TEST_ASSERT_FALSE(body.write((const uint8_t*)"z", 1));
+  TEST_ASSERT_FALSE(body.write((const uint8_t*)"1\r\n", 3));
+}
+
+static void test_sink_error() {
+  const std::vector<uint8_t> img = image(1000);
+  Pull p;
+  p.failAfter = 600;
+  HttpBodyDecoder body;
+  body.begin(true, -1, sink, &p);
+  const std::string in = chunked(img, { 256 }, "\r\n");
+  TEST_ASSERT_FALSE(body.write((const uint8_t*)in.data(), in.size()));
+  TEST_ASSERT_EQUAL_STRING("sink", body.error());
+  TEST_ASSERT_EQUAL_UINT32(512, (uint32_t)body.produced());
+}
+
+static void test_empty_bodies() {
+  TEST_ASSERT_TRUE(decode("", false, 0, 1).finished);
+  TEST_ASSERT_TRUE(decode("0\r\n\r\n", true, -1, 1).finished);
+  const Pull p = decode("abc", false, 0, 1);   // Content-Length: 0, extra bytes ignored
+  TEST_ASSERT_TRUE(p.finished);
+  TEST_ASSERT_EQUAL_size_t(0, p.body.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunked_keepalive);
+  RUN_TEST(test_chunked_trailers);
+  RUN_TEST(test_content_length);
+  RUN_TEST(test_until_close);
+  RUN_TEST(test_chunked_truncated);
+  RUN_TEST(test_content_length_truncated);
+  RUN_TEST(test_every_split);
+  RUN_TEST(test_malformed_chunks);
+  RUN_TEST(test_sink_error);
+  RUN_TEST(test_empty_bodies);
+  return UNITY_END();
+}
@@ -0,0 +1,298 @@
+// Peer link (peerlink.h) over the POSIX UDP transport (sim/peerudp.h):
+// addresses, message signing, and the receive path of peerbind.cpp
+// (replay window + challenge for unknown senders) between two sockets.
+//   pio test -e native -f test_peerlink
+#include <unity.h>
+
+#include <chrono>
+#include <string.h>
+#include <thread>
+
+#include "groupmsg.h"
+#include "mpsc.h"
+#include "peerlink.h"
+#include "sim/peerudp.h"
+
+void setUp() {}
+void tearDown() {}
+
+static const uint8_t* KEY = (const uint8_t*)"peer-key-0123456789";
+static const size_t KEY_LEN = 19;
+
+// -------------------- Addresses --------------------
+static void test_addr_parse_format() {
+  PeerAddr a;
+  char s[24];
+  TEST_ASSERT_TRUE(peerParseAddr("24:6f:28:aa:bb:cc", a, 4211));
+  TEST_ASSERT_EQUAL_UINT8(PEER_ADDR_ESPNOW, a.kind);
+  peerFormatAddr(a, s, sizeof(s));
+  TEST_ASSERT_EQUAL_STRING("24:6f:28:aa:bb:cc", s);
+
+  TEST_ASSERT_TRUE(peerParseAddr("udp:192.168.1.40", a, 4211));
+  peerFormatAddr(a, s, sizeof(s));
+  TEST_ASSERT_EQUAL_STRING("udp:192.168.1.40:4211", s);
+  TEST_ASSERT_TRUE(peerParseAddr("udp:10.0.0.1:9", a, 4211));
+  peerFormatAddr(a, s, sizeof(s));
+  TEST_ASSERT_EQUAL_STRING("udp:10.0.0.1:9", s);
+
+  TEST_ASSERT_FALSE(peerParseAddr("ff:ff:ff:ff:ff:ff", a, 4211));   // broadcast
+  TEST_ASSERT_FALSE(peerParseAddr("udp:1.2.3.256", a, 4211));
+  TEST_ASSERT_FALSE(peerParseAddr("udp:1.2.3.4:0", a, 4211));
+  TEST_ASSERT_FALSE(peerParseAddr("udp:1.2.3.4:80x", a, 4211));
+  TEST_ASSERT_FALSE(peerParseAddr("24:6f:28:aa:bb", a, 4211));
+}
+
+// -------------------- Messages --------------------
+static void test_msg_round_trip() {
+  const PeerMsg all[] = {
+    { PEER_CMD, PEER_TOGGLE, 0x11223344, 7, 0 },
+    { PEER_ACK, 1, 0x11223344, 7, 0 },
+    { PEER_CHALLENGE, 0, 0x11223344, 0, 0xCAFEF00D },
+    { PEER_RESPONSE, 0, 0x11223344, 7, 0xCAFEF00D },
+  };
+  for (const PeerMsg &m : all) {
+    uint8_t buf[PEER_MSG_LEN];
+    peerMsgEncode(m, KEY, KEY_LEN, buf);
+    TEST_ASSERT_EQUAL_UINT8('S', buf[0]);
+    TEST_ASSERT_EQUAL_UINT8('B', buf[1]);
+
+    PeerMsg d = {};
+    TEST_ASSERT_TRUE(peerMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+    TEST_ASSERT_EQUAL_UINT8(m.type, d.type);
+    TEST_ASSERT_EQUAL_UINT8(m.action, d.action);
+    TEST_ASSERT_EQUAL_HEX32(m.sender, d.sender);
+    TEST_ASSERT_EQUAL_UINT32(m.seq, d.seq);
+    TEST_ASSERT_EQUAL_HEX32(m.nonce, d.nonce);
+  }
+}
+
+static void test_msg_rejects() {
+  uint8_t buf[PEER_MSG_LEN];
+  PeerMsg d;
+  peerMsgEncode({ PEER_CMD, PEER_ON, 1, 2, 0 }, KEY, KEY_LEN, buf);
+  TEST_ASSERT_FALSE(peerMsgDecode(buf, sizeof(buf) - 1, KEY, KEY_LEN, d));
+  TEST_ASSERT_FALSE(peerMsgDecode(buf, sizeof(buf), (const uint8_t*)"other", 5, d));
+  for (size_t i = 0; i < PEER_MSG_LEN; i++) {   // any flipped bit, MAC included
+    buf[i] ^= 0x01;
+    TEST_ASSERT_FALSE(peerMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+    buf[i] ^= 0x01;
+  }
+  TEST_ASSERT_TRUE(peerMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+
+  // Signed, but not a valid action or type.
+  peerMsgEncode({ PEER_CMD, PEER_TOGGLE + 1, 1, 2, 0 }, KEY, KEY_LEN, buf);
+  TEST_ASSERT_FALSE(peerMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+  peerMsgEncode({ 9, 0, 1, 2, 0 }, KEY, KEY_LEN, buf);
+  TEST_ASSERT_FALSE(peerMsgDecode(buf, sizeof(buf), KEY, KEY_LEN, d));
+}
+
+// -------------------- Two nodes over UDP --------------------
+// Each node runs the receive path of peerbind.cpp: the socket thread
+// only queues the datagram, pump() (the "peer task") does the rest.
+// Time is explicit so the vouch window can be stepped over.
+struct Frame {
+  PeerTransport* t;
+  PeerAddr from;
+  uint8_t  data[PEER_MSG_LEN];
+};
+
+struct Node {
+  explicit Node(uint32_t id) : id(id), udp(0, 0x7F000001) {}
+
+  uint32_t id;
+  PosixUdpPeerTransport udp;
+  MpscQueue<Frame, 16> rx;
+  GroupReplayWindow replay;
+
+  // Sender side: latest command to the one peer.
+  uint32_t lastSeq = 0, lastMs = 0;
+  uint32_t acked = 0;
+  // Receiver side.
+  uint32_t applied = 0, duplicates = 0, challenged = 0;
+  uint32_t nonce = 0x1000;
+
+  PeerAddr addr() const {
+    PeerAddr a = {};
+    a.kind = PEER_ADDR_UDP;
+    a.b[0] = 127; a.b[3] = 1;
+    a.b[4] = (uint8_t)(udp.port() >> 8);
+    a.b[5] = (uint8_t)udp.port();
+    return a;
+  }
+
+  void send(const PeerAddr &to, const PeerMsg &m) {
+    uint8_t buf[PEER_MSG_LEN];
+    peerMsgEncode(m, KEY, KEY_LEN, buf);
+    TEST_ASSERT_TRUE(udp.send(to, buf, sizeof(buf)));
+  }
+
+  void command(const PeerAddr &to, uint32_t seq, uint32_t nowMs) {
+    lastSeq = seq;
+    lastMs = nowMs;
+    send(to, { PEER_CMD, PEER_TOGGLE, id, seq, 0 });
+  }
+
+  void handle(const Frame &f, uint32_t nowMs) {
+    PeerMsg m;
+    if (!peerMsgDecode(f.data, PEER_MSG_LEN, KEY, KEY_LEN, m)) return;
+    switch (m.type) {
+      case PEER_CMD:
+        switch (replay.check(m.sender, m.seq, nowMs)) {
+          case GROUP_STALE: return;
+          case GROUP_DUPLICATE: duplicates++; send(f.from, { PEER_ACK, 1, m.sender, m.seq, 0 }); return;
+          case GROUP_UNKNOWN:
+            challenged++;
+            send(f.from, { PEER_CHALLENGE, 0, m.sender, 0,
+                           replay.challenge({ m.sender, m.seq, 0, m.action, 0 }, ++nonce, nowMs) });
+            return;
+          case GROUP_FRESH: applied++; send(f.from, { PEER_ACK, 1, m.sender, m.seq, 0 }); return;
+        }
+        return;
+      case PEER_ACK:
+        if (m.sender == id && m.seq == lastSeq) acked++;
+        return;
+      case PEER_CHALLENGE: {
+        GroupResponse r;
+        if (m.sender == id && groupVouch({ 0, m.sender, m.nonce }, id, lastSeq, lastMs, nowMs, r))
+          send(f.from, { PEER_RESPONSE, 0, id, r.seq, r.nonce });
+        return;
+      }
+      case PEER_RESPONSE: {
+        GroupMsg held;
+        if (!replay.answer({ m.sender, m.nonce, m.seq }, nowMs, held)) return;
+        applied++;
+        send(f.from, { PEER_ACK, 1, held.sender, held.seq, 0 });
+        return;
+      }
+    }
+  }
+
+  bool pump(uint32_t nowMs) {
+    Frame f;
+    bool any = false;
+    while (rx.pop(f)) {
+      handle(f, nowMs);
+      any = true;
+    }
+    return any;
+  }
+};
+
+static Node* nodes[2];
+
+static void onRx(PeerTransport* t, const PeerAddr &from, const uint8_t* data, size_t len) {
+  if (len != PEER_MSG_LEN) return;
+  Frame f;
+  f.t = t;
+  f.from = from;
+  memcpy(f.data, data, PEER_MSG_LEN);
+  (&nodes[0]->udp == t ? nodes[0] : nodes[1])->rx.push(f);
+}
+
+// Runs both "peer tasks" until the link has been quiet for 50 ms.
+static void settle(uint32_t nowMs) {
+  auto quiet = std::chrono::steady_clock::now();
+  for (;;) {
+    const bool a = nodes[0]->pump(nowMs), b = nodes[1]->pump(nowMs);
+    if (a || b) quiet = std::chrono::steady_clock::now();
+    else if (std::chrono::steady_clock::now() - quiet > std::chrono::milliseconds(50)) return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+struct Link {
+  Node s{ 0xA0A0A0A0 }, r{ 0xB0B0B0B0 };
+  Link() {
+    nodes[0] = &s;
+    nodes[1] = &r;
+    TEST_ASSERT_TRUE(s.udp.begin(onRx));
+    TEST_ASSERT_TRUE(r.udp.begin(onRx));
+    TEST_ASSERT_NOT_EQUAL(0, s.udp.port());
+  }
+};
+
+static void test_udp_first_contact_handshake() {
+  Link l;
+  l.s.command(l.r.addr(), 1, 1000);
+  settle(1000);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.challenged);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.applied);   // ran after the response
+  TEST_ASSERT_EQUAL_UINT32(1, l.s.acked);
+
+  // Known now: the next command runs at once, a retry is only re-ACKed.
+  l.s.command(l.r.addr(), 2, 1100);
+  settle(1100);
+  l.s.send(l.r.addr(), { PEER_CMD, PEER_TOGGLE, l.s.id, 2, 0 });
+  settle(1110);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.challenged);
+  TEST_ASSERT_EQUAL_UINT32(2, l.r.applied);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.duplicates);
+  TEST_ASSERT_EQUAL_UINT32(3, l.s.acked);
+}
+
+static void test_udp_replay_after_reboot() {
+  Link l;
+  l.s.command(l.r.addr(), 5, 1000);
+  settle(1000);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.applied);
+  l.s.command(l.r.addr(), 6, 1200);
+  settle(1200);
+  TEST_ASSERT_EQUAL_UINT32(2, l.r.applied);
+
+  // The receiver reboots and an attacker replays the captured seq 5
+  // with the sender's source address, so the challenge reaches it.
+  l.r.replay = GroupReplayWindow();
+  uint8_t capture[PEER_MSG_LEN];
+  peerMsgEncode({ PEER_CMD, PEER_TOGGLE, l.s.id, 5, 0 }, KEY, KEY_LEN, capture);
+  TEST_ASSERT_TRUE(l.s.udp.send(l.r.addr(), capture, sizeof(capture)));
+  settle(1300);
+  TEST_ASSERT_EQUAL_UINT32(2, l.r.applied);   // challenged; the sender vouched for 6, not 5
+
+  // The window opened at 6: the capture is rejected outright now.
+  const uint32_t challenged = l.r.challenged;
+  TEST_ASSERT_TRUE(l.s.udp.send(l.r.addr(), capture, sizeof(capture)));
+  settle(1400);
+  TEST_ASSERT_EQUAL_UINT32(2, l.r.applied);
+  TEST_ASSERT_EQUAL_UINT32(challenged, l.r.challenged);
+}
+
+static void test_udp_no_vouch_when_idle() {
+  Link l;
+  l.s.command(l.r.addr(), 9, 1000);
+  settle(1000);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.applied);
+
+  // Reboot, and a replay of the latest command long after it was sent:
+  // the sender no longer vouches, nothing runs.
+  l.r.replay = GroupReplayWindow();
+  l.s.send(l.r.addr(), { PEER_CMD, PEER_TOGGLE, l.s.id, 9, 0 });
+  settle(1000 + GROUP_VOUCH_MS + 1);
+  TEST_ASSERT_EQUAL_UINT32(1, l.r.applied);
+  TEST_ASSERT_EQUAL_UINT32(2, l.r.challenged);
+}
+
+static void test_udp_end_restart() {
+  PosixUdpPeerTransport t(0, 0x7F000001);
+  TEST_ASSERT_TRUE(t.begin(onRx));
+  const uint16_t port = t.port();
+  t.end();
+  t.end();   // idempotent
+  PeerAddr to = {};
+  to.kind = PEER_ADDR_UDP;
+  TEST_ASSERT_FALSE(t.send(to, (const uint8_t*)"x", 1));
+  TEST_ASSERT_TRUE(t.begin(onRx));
+  TEST_ASSERT_EQUAL_UINT16(port, t.port());   // rebinds the same port
+  t.end();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_addr_parse_format);
+  RUN_TEST(test_msg_round_trip);
+  RUN_TEST(test_msg_rejects);
+  RUN_TEST(test_udp_first_contact_handshake);
+  RUN_TEST(test_udp_replay_after_reboot);
+  RUN_TEST(test_udp_no_vouch_when_idle);
+  RUN_TEST(test_udp_end_restart);
+  return UNITY_END();
+}
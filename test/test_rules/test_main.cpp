@@ -0,0 +1,338 @@
+// Automation rules (rules.h): the text compiler (errors and their line
+// numbers, size limits, bytecode layout) and the VM (dispatch,
+// condition short-circuit, corrupt programs).
+//   pio test -e native -f test_rules
+#include <unity.h>
+
+#include <string.h>
+#include <string>
+
+#include "rules.h"
+
+void setUp() {}
+void tearDown() {}
+
+// -------------------- Host --------------------
+// Records every action; counts condition lookups.
+struct Host {
+  bool relay = false;
+  bool closed = false;
+  int relayReads = 0;
+  int inputReads = 0;
+  std::string log;
+};
+
+static RuleHost hostFor(Host &h) {
+  RuleHost r;
+  r.ctx = &h;
+  r.relay = [](void* c) { Host* h = (Host*)c; h->relayReads++; return h->relay; };
+  r.inputClosed = [](void* c) { Host* h = (Host*)c; h->inputReads++; return h->closed; };
+  r.setRelay = [](void* c, bool on) { ((Host*)c)->log += on ? "on;" : "off;"; };
+  r.toggle = [](void* c) { ((Host*)c)->log += "toggle;"; };
+  r.pulse = [](void* c, uint32_t ms) { ((Host*)c)->log += "pulse " + std::to_string(ms) + ";"; };
+  r.timerStart = [](void* c, uint8_t t, uint32_t ms) {
+    ((Host*)c)->log += "start " + std::to_string(t) + " " + std::to_string(ms) + ";";
+  };
+  r.timerCancel = [](void* c, uint8_t t) { ((Host*)c)->log += "cancel " + std::to_string(t) + ";"; };
+  return r;
+}
+
+static RuleProgram compiled(const char* text) {
+  RuleProgram p;
+  RuleError err;
+  TEST_ASSERT_TRUE_MESSAGE(rulesCompile(text, p, err), err.msg);
+  return p;
+}
+
+static std::string run(const RuleProgram &p, uint8_t trigger, uint32_t arg, Host &h, uint16_t* actions = nullptr) {
+  h.log.clear();
+  const uint16_t n = rulesRun(p, trigger, arg, hostFor(h));
+  if (actions) *actions = n;
+  return h.log;
+}
+
+static uint32_t hashOf(const char* s) {
+  return rulesHash(s, strlen(s));
+}
+
+// -------------------- Compiler --------------------
+static void test_compile_valid() {
+  const RuleProgram p = compiled(
+      "# wall switch\r\n"
+      "on input press do relay toggle\r\n"
+      "\n"
+      "   # indented comment\n"
+      "on input release do relay on\n"
+      "on input short if relay on do relay off   # trailing comment\n"
+      "on input long 1500 do pulse 250, timer 2 start 86400000\n"
+      "on relay on if input open and relay on do timer 1 start 1000\n"
+      "on relay off do timer 1 cancel;timer 4 cancel\n"
+      "on timer 1 do relay off\n"
+      "on mqtt \"open sesame\" do relay on ; pulse 10\n"
+      "\ton\tboot\tdo\trelay\toff");   // tabs, no final newline
+  TEST_ASSERT_EQUAL_UINT8(9, p.rules);
+
+  Host h;
+  TEST_ASSERT_EQUAL_STRING("toggle;", run(p, TRIG_PRESS, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("on;", run(p, TRIG_RELEASE, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_SHORT, 0, h).c_str());   // relay is off
+  h.relay = true;
+  TEST_ASSERT_EQUAL_STRING("off;", run(p, TRIG_SHORT, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("pulse 250;start 1 86400000;", run(p, TRIG_LONG, 1500, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("start 0 1000;", run(p, TRIG_RELAY_ON, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("cancel 0;cancel 3;", run(p, TRIG_RELAY_OFF, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("off;", run(p, TRIG_TIMER, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("on;pulse 10;", run(p, TRIG_MQTT, hashOf("open sesame"), h).c_str());
+  TEST_ASSERT_EQUAL_STRING("off;", run(p, TRIG_BOOT, 0, h).c_str());
+
+  // Empty programs are valid.
+  TEST_ASSERT_EQUAL_UINT8(0, compiled("").rules);
+  TEST_ASSERT_EQUAL_UINT8(0, compiled("# nothing\n\n  \n").rules);
+  RuleProgram q;
+  RuleError err;
+  TEST_ASSERT_TRUE(rulesCompile(nullptr, q, err));
+  TEST_ASSERT_EQUAL_UINT16(0, q.len);
+}
+
+static void test_bytecode_layout() {
+  // trigger, LEB128 arg, body length, body
+  const RuleProgram p = compiled("on input long 300 do pulse 200\non timer 3 do timer 3 cancel\n");
+  const uint8_t want[] = {
+    TRIG_LONG, 0xAC, 0x02, 3, OP_PULSE, 0xC8, 0x01,
+    TRIG_TIMER, 2, 2, OP_TIMER_CANCEL, 2,
+  };
+  TEST_ASSERT_EQUAL_UINT16(sizeof(want), p.len);
+  TEST_ASSERT_EQUAL_MEMORY(want, p.code, sizeof(want));
+  TEST_ASSERT_EQUAL_UINT8(2, p.rules);
+}
+
+static void test_compile_errors() {
+  struct Case { const char* text; uint16_t line; const char* msg; };
+  const Case cases[] = {
+    { "on", 1, "missing trigger" },
+    { "when boot do relay on", 1, "expected 'on'" },
+    { "on sunrise do relay on", 1, "unknown trigger" },
+    { "\n# ok so far\non input press do relay toggle\non input hold do relay on", 4, "input: press/release/short/long" },
+    { "on input", 1, "input: press/release/short/long" },
+    { "on input long do relay on", 1, "input long: ms 1-60000" },
+    { "on input long 0 do relay on", 1, "input long: ms 1-60000" },
+    { "on input long 60001 do relay on", 1, "input long: ms 1-60000" },
+    { "on input long 1e3 do relay on", 1, "input long: ms 1-60000" },
+    { "on relay dimmed do relay on", 1, "relay: on/off" },
+    { "on timer 0 do relay on", 1, "timer: 1-4" },
+    { "on timer 5 do relay on", 1, "timer: 1-4" },
+    { "on mqtt open do relay on", 1, "mqtt: quoted payload" },
+    { "on mqtt \"open do relay on", 1, "mqtt: quoted payload" },   // unterminated
+    { "on boot relay on", 1, "expected 'if' or 'do'" },
+    { "on boot", 1, "expected 'if' or 'do'" },
+    { "on boot if", 1, "missing condition" },
+    { "on boot if relay", 1, "incomplete condition" },
+    { "on boot if relay maybe do relay on", 1, "unknown condition" },
+    { "on boot if relay on or input open do relay off", 1, "expected 'and' or 'do'" },
+    { "on boot if relay on", 1, "expected 'and' or 'do'" },
+    { "on boot do", 1, "no action" },
+    { "on boot do ; ,", 1, "no action" },
+    { "on boot do dance", 1, "unknown action" },
+    { "on boot do relay on; dance", 1, "unknown action" },
+    { "on boot do relay", 1, "relay: on/off/toggle" },
+    { "on boot do relay flip", 1, "relay: on/off/toggle" },
+    { "on boot do pulse 9", 1, "pulse: ms 10-60000" },
+    { "on boot do pulse 60001", 1, "pulse: ms 10-60000" },
+    { "on boot do pulse 1234567890", 1, "pulse: ms 10-60000" },   // more than 9 digits
+    { "on boot do pulse \"100\"", 1, "pulse: ms 10-60000" },
+    { "on boot do timer 9 start 10", 1, "timer: 1-4" },
+    { "on boot do timer 1", 1, "timer: start/cancel" },
+    { "on boot do timer 1 stop", 1, "timer: start/cancel" },
+    { "on boot do timer 1 start", 1, "timer start: ms" },
+    { "on boot do timer 1 start 0", 1, "timer start: ms" },
+    { "on boot do timer 1 start 86400001", 1, "timer start: ms" },
+    { "on boot do relay on\r\non boot do relay on\r\non boot do relay sideways\r\n", 3, "relay: on/off/toggle" },
+  };
+
+  for (const Case &c : cases) {
+    RuleProgram p = compiled("on boot do relay on");
+    const RuleProgram before = p;
+    RuleError err;
+    const bool ok = rulesCompile(c.text, p, err);
+    if (ok) TEST_FAIL_MESSAGE(c.text);
+    TEST_ASSERT_EQUAL_UINT16(c.line, err.line);
+    TEST_ASSERT_EQUAL_STRING(c.msg, err.msg);
+    TEST_ASSERT_EQUAL_MEMORY(&before, &p, sizeof(p));   // untouched on failure
+  }
+}
+
+static void test_rule_too_long() {
+  // Body limit: 64 bytes = 64 one-byte actions.
+  std::string body = "on boot do";
+  for (int i = 0; i < 64; i++) body += " relay on;";
+  TEST_ASSERT_EQUAL_UINT16(3 + 64, compiled(body.c_str()).len);
+
+  RuleProgram p;
+  RuleError err;
+  const std::string text = "on boot do relay on\n" + body + " relay off\n";
+  TEST_ASSERT_FALSE(rulesCompile(text.c_str(), p, err));
+  TEST_ASSERT_EQUAL_UINT16(2, err.line);
+  TEST_ASSERT_EQUAL_STRING("rule too long", err.msg);
+}
+
+static void test_program_too_large() {
+  // Each rule is 4 bytes: trigger, arg 0, length 1, one action.
+  std::string text;
+  for (size_t i = 0; i < RULES_MAX_BYTES / 4; i++) text += "on input press do relay toggle\n";
+  const RuleProgram full = compiled(text.c_str());
+  TEST_ASSERT_EQUAL_UINT16(RULES_MAX_BYTES, full.len);
+  TEST_ASSERT_EQUAL_UINT8(RULES_MAX_BYTES / 4, full.rules);
+
+  // Blank and comment lines still count for the line number.
+  text += "\n# one more\non boot do relay on\n";
+  RuleProgram p;
+  RuleError err;
+  TEST_ASSERT_FALSE(rulesCompile(text.c_str(), p, err));
+  TEST_ASSERT_EQUAL_UINT16(RULES_MAX_BYTES / 4 + 3, err.line);
+  TEST_ASSERT_EQUAL_STRING("program too large", err.msg);
+}
+
+static void test_long_thresholds() {
+  const char* four =
+      "on input long 3000 do relay off\n"
+      "on input long 500 do pulse 100\n"
+      "on input long 3000 if relay on do relay off\n"   // same threshold again
+      "on input long 10000 do timer 1 start 5\n"
+      "on input long 1000 do relay on\n";
+  const RuleProgram p = compiled(four);
+  uint32_t th[RULES_LONG_MAX];
+  TEST_ASSERT_EQUAL_UINT8(4, rulesLongThresholds(p, th));
+  TEST_ASSERT_EQUAL_UINT32(500, th[0]);
+  TEST_ASSERT_EQUAL_UINT32(1000, th[1]);
+  TEST_ASSERT_EQUAL_UINT32(3000, th[2]);
+  TEST_ASSERT_EQUAL_UINT32(10000, th[3]);
+
+  // A fifth distinct threshold is a whole-program error (line 0).
+  RuleProgram q = compiled("on boot do relay on");
+  const RuleProgram before = q;
+  RuleError err;
+  const std::string five = std::string(four) + "on input long 2000 do relay toggle\n";
+  TEST_ASSERT_FALSE(rulesCompile(five.c_str(), q, err));
+  TEST_ASSERT_EQUAL_UINT16(0, err.line);
+  TEST_ASSERT_EQUAL_STRING("at most 4 long-press thresholds", err.msg);
+  TEST_ASSERT_EQUAL_MEMORY(&before, &q, sizeof(q));
+
+  TEST_ASSERT_EQUAL_UINT8(0, rulesLongThresholds(compiled("on input press do relay on"), th));
+}
+
+// -------------------- VM --------------------
+static void test_run_dispatch() {
+  const RuleProgram p = compiled(
+      "on input press do relay on\n"
+      "on input press do pulse 100\n"            // every matching rule runs, in order
+      "on input long 1000 do relay off\n"
+      "on input long 2000 do relay toggle\n"
+      "on timer 2 do timer 2 start 60\n"
+      "on mqtt \"on\" do relay on\n"
+      "on mqtt \"off\" do relay off\n");
+  Host h;
+  uint16_t n = 0;
+  TEST_ASSERT_EQUAL_STRING("on;pulse 100;", run(p, TRIG_PRESS, 0, h, &n).c_str());
+  TEST_ASSERT_EQUAL_UINT16(2, n);
+  TEST_ASSERT_EQUAL_STRING("off;", run(p, TRIG_LONG, 1000, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("toggle;", run(p, TRIG_LONG, 2000, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_LONG, 1500, h, &n).c_str());   // args must match exactly
+  TEST_ASSERT_EQUAL_UINT16(0, n);
+  TEST_ASSERT_EQUAL_STRING("start 1 60;", run(p, TRIG_TIMER, 1, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_TIMER, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("off;", run(p, TRIG_MQTT, hashOf("off"), h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_MQTT, hashOf("OFF"), h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_RELEASE, 0, h).c_str());
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_BOOT, 0, h).c_str());
+}
+
+static void test_condition_short_circuit() {
+  const RuleProgram p = compiled("on input press if relay on and input closed do relay off; pulse 50\n"
+                                 "on input press do relay toggle\n");
+  Host h;
+  uint16_t n = 0;
+
+  // First condition false: the second is never looked up, the next rule still runs.
+  TEST_ASSERT_EQUAL_STRING("toggle;", run(p, TRIG_PRESS, 0, h, &n).c_str());
+  TEST_ASSERT_EQUAL_UINT16(1, n);
+  TEST_ASSERT_EQUAL_INT(1, h.relayReads);
+  TEST_ASSERT_EQUAL_INT(0, h.inputReads);
+
+  h.relay = true;
+  h.relayReads = h.inputReads = 0;
+  TEST_ASSERT_EQUAL_STRING("toggle;", run(p, TRIG_PRESS, 0, h).c_str());
+  TEST_ASSERT_EQUAL_INT(1, h.relayReads);
+  TEST_ASSERT_EQUAL_INT(1, h.inputReads);
+
+  h.closed = true;
+  TEST_ASSERT_EQUAL_STRING("off;pulse 50;toggle;", run(p, TRIG_PRESS, 0, h, &n).c_str());
+  TEST_ASSERT_EQUAL_UINT16(3, n);
+
+  // Other rules' conditions are not evaluated at all.
+  h.relayReads = h.inputReads = 0;
+  run(p, TRIG_RELEASE, 0, h);
+  TEST_ASSERT_EQUAL_INT(0, h.relayReads + h.inputReads);
+}
+
+static RuleProgram raw(std::initializer_list<uint8_t> bytes) {
+  RuleProgram p = {};
+  for (uint8_t b : bytes) p.code[p.len++] = b;
+  p.rules = 1;
+  return p;
+}
+
+static void test_corrupt_bytecode() {
+  Host h;
+  uint16_t n = 0;
+
+  // Unknown op: actions before it ran, nothing after it, not even later rules.
+  RuleProgram p = raw({ TRIG_PRESS, 0, 3, OP_RELAY_ON, 0x7F, OP_RELAY_OFF, TRIG_PRESS, 0, 1, OP_RELAY_TOGGLE });
+  TEST_ASSERT_EQUAL_STRING("on;", run(p, TRIG_PRESS, 0, h, &n).c_str());
+  TEST_ASSERT_EQUAL_UINT16(1, n);
+
+  // Body length past the end of the program: the rule does not run.
+  p = raw({ TRIG_PRESS, 0, 9, OP_RELAY_ON, OP_RELAY_OFF });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_PRESS, 0, h).c_str());
+
+  // Trigger argument LEB128 that never ends, or a missing body length.
+  p = raw({ TRIG_LONG, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01, 1, OP_RELAY_ON });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_LONG, 0, h).c_str());
+  p = raw({ TRIG_LONG, 0x88 });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_LONG, 8, h).c_str());
+  p = raw({ TRIG_PRESS, 0 });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_PRESS, 0, h).c_str());
+
+  // Operands cut off by the end of the body (not read from the next rule).
+  p = raw({ TRIG_PRESS, 0, 2, OP_PULSE, 0xE8, 0x07, TRIG_PRESS, 0, 1, OP_RELAY_ON });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_PRESS, 0, h).c_str());
+  p = raw({ TRIG_PRESS, 0, 1, OP_TIMER_START, TRIG_PRESS, 0, 1, OP_RELAY_ON });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_PRESS, 0, h).c_str());
+  p = raw({ TRIG_PRESS, 0, 2, OP_TIMER_START, 0, TRIG_PRESS });
+  TEST_ASSERT_EQUAL_STRING("", run(p, TRIG_PRESS, 0, h).c_str());
+  p = raw({ TRIG_PRESS, 0, 2, OP_RELAY_ON, OP_TIMER_CANCEL });
+  TEST_ASSERT_EQUAL_STRING("on;", run(p, TRIG_PRESS, 0, h).c_str());
+
+  // Timer numbers out of range are skipped, not passed to the host.
+  p = raw({ TRIG_PRESS, 0, 6, OP_TIMER_START, 9, 5, OP_TIMER_CANCEL, 200, OP_RELAY_ON });
+  TEST_ASSERT_EQUAL_STRING("on;", run(p, TRIG_PRESS, 0, h, &n).c_str());
+
+  // The threshold scan stops at the same places.
+  uint32_t th[RULES_LONG_MAX];
+  p = raw({ TRIG_LONG, 0x64, 1, OP_RELAY_ON, TRIG_LONG, 0x80 });
+  TEST_ASSERT_EQUAL_UINT8(1, rulesLongThresholds(p, th));
+  TEST_ASSERT_EQUAL_UINT32(100, th[0]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_compile_valid);
+  RUN_TEST(test_bytecode_layout);
+  RUN_TEST(test_compile_errors);
+  RUN_TEST(test_rule_too_long);
+  RUN_TEST(test_program_too_large);
+  RUN_TEST(test_long_thresholds);
+  RUN_TEST(test_run_dispatch);
+  RUN_TEST(test_condition_short_circuit);
+  RUN_TEST(test_corrupt_bytecode);
+  return UNITY_END();
+}
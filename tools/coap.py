@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""
+Minimal CoAP client for the SwitchNode /relay and /input resources
+(standard library only; libcoap's coap-client works too).
+
+  python3 tools/coap.py <node> get relay
+  python3 tools/coap.py <node> put relay toggle        # 1|0|on|off|true|false|toggle
+  python3 tools/coap.py <node> post relay              # toggle
+  python3 tools/coap.py <node> observe relay --seconds 60
+  python3 tools/coap.py <node> discover                # /.well-known/core
+
+Requests are CON (--non for NON) and print the response code, payload
+and round-trip time. `observe` registers with Observe=0, ACKs CON
+notifications, prints each one with its sequence number and
+deregisters (Observe=1) on exit. Wire format: src/coap.h.
+"""
+
+import argparse
+import os
+import socket
+import struct
+import sys
+import time
+
+CON, NON, ACK, RST = range(4)
+TYPES = ["CON", "NON", "ACK", "RST"]
+METHODS = {"get": 1, "post": 2, "put": 3, "delete": 4}
+OPT_OBSERVE, OPT_URI_PATH, OPT_CONTENT_FORMAT, OPT_ACCEPT = 6, 11, 12, 17
+
+
+def code_str(code):
+    return f"{code >> 5}.{code & 0x1F:02d}"
+
+
+def uint_bytes(v):
+    return v.to_bytes((v.bit_length() + 7) // 8, "big") if v else b""
+
+
+def ext(v):
+    if v < 13:
+        return v, b""
+    if v < 269:
+        return 13, bytes([v - 13])
+    return 14, struct.pack(">H", v - 269)
+
+
+def encode(mtype, code, mid, token, options=(), payload=b""):
+    out = bytearray([0x40 | mtype << 4 | len(token), code]) + struct.pack(">H", mid) + token
+    last = 0
+    for num, val in sorted(options, key=lambda o: o[0]):
+        d, dx = ext(num - last)
+        n, nx = ext(len(val))
+        out += bytes([d << 4 | n]) + dx + nx + val
+        last = num
+    if payload:
+        out += b"\xff" + payload
+    return bytes(out)
+
+
+def decode(data):
+    if len(data) < 4 or data[0] >> 6 != 1:
+        return None
+    mtype, tkl = (data[0] >> 4) & 3, data[0] & 0x0F
+    code, mid = data[1], struct.unpack(">H", data[2:4])[0]
+    token, i = data[4:4 + tkl], 4 + tkl
+    opts, num, payload = {}, 0, b""
+    while i < len(data):
+        if data[i] == 0xFF:
+            payload = data[i + 1:]
+            break
+        d, n = data[i] >> 4, data[i] & 0x0F
+        i += 1
+        vals = []
+        for v in (d, n):
+            if v == 13:
+                v, i = data[i] + 13, i + 1
+            elif v == 14:
+                v, i = struct.unpack(">H", data[i:i + 2])[0] + 269, i + 2
+            vals.append(v)
+        num += vals[0]
+        opts.setdefault(num, []).append(data[i:i + vals[1]])
+        i += vals[1]
+    return {"type": mtype, "code": code, "mid": mid, "token": token, "opts": opts, "payload": payload}
+
+
+def opt_uint(msg, num):
+    v = msg["opts"].get(num)
+    return int.from_bytes(v[0], "big") if v else None
+
+
+class Client:
+    def __init__(self, host, port, timeout):
+        self.addr = (socket.gethostbyname(host), port)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.mid = int.from_bytes(os.urandom(2), "big")
+
+    def next_mid(self):
+        self.mid = (self.mid + 1) & 0xFFFF
+        return self.mid
+
+    def request(self, mtype, code, path, payload=b"", observe=None, token=None, tries=4):
+        token = token or os.urandom(4)
+        opts = [(OPT_URI_PATH, seg.encode()) for seg in path.strip("/").split("/") if seg]
+        if observe is not None:
+            opts.append((OPT_OBSERVE, uint_bytes(observe)))
+        pkt = encode(mtype, code, self.next_mid(), token, opts, payload)
+        for _ in range(tries if mtype == CON else 1):
+            t0 = time.monotonic()
+            self.sock.sendto(pkt, self.addr)
+            deadline = t0 + self.sock.gettimeout()
+            while time.monotonic() < deadline:
+                try:
+                    data, _ = self.sock.recvfrom(1500)
+                except socket.timeout:
+                    break
+                msg = decode(data)
+                if msg and msg["token"] == token:
+                    return msg, token, (time.monotonic() - t0) * 1000
+        return None, token, None
+
+    def ack(self, msg):
+        self.sock.sendto(encode(ACK, 0, msg["mid"], b""), self.addr)
+
+
+def show(msg, rtt=None):
+    extra = f" obs={opt_uint(msg, OPT_OBSERVE)}" if OPT_OBSERVE in msg["opts"] else ""
+    ms = f" {rtt:.1f} ms" if rtt is not None else ""
+    body = msg["payload"].decode(errors="replace")
+    print(f"{TYPES[msg['type']]} {code_str(msg['code'])}{extra}{ms} {body}".rstrip())
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("command", choices=list(METHODS) + ["observe", "discover"])
+    ap.add_argument("path", nargs="?", default="relay")
+    ap.add_argument("value", nargs="?", default="", help="PUT payload")
+    ap.add_argument("--port", type=int, default=5683)
+    ap.add_argument("--non", action="store_true", help="send NON instead of CON")
+    ap.add_argument("--timeout", type=float, default=2.0)
+    ap.add_argument("--seconds", type=float, default=0, help="observe duration (0 = until Ctrl-C)")
+    args = ap.parse_args()
+
+    c = Client(args.host, args.port, args.timeout)
+    mtype = NON if args.non else CON
+
+    if args.command == "discover":
+        msg, _, rtt = c.request(mtype, METHODS["get"], ".well-known/core")
+    elif args.command != "observe":
+        msg, _, rtt = c.request(mtype, METHODS[args.command], args.path, args.value.encode())
+    else:
+        msg, token, rtt = c.request(mtype, METHODS["get"], args.path, observe=0)
+        if msg is None:
+            print("no response")
+            return 1
+        show(msg, rtt)
+        if OPT_OBSERVE not in msg["opts"]:
+            print("not registered (observer table full?)")
+            return 1
+        end = time.monotonic() + args.seconds if args.seconds else None
+        c.sock.settimeout(0.5)
+        try:
+            while end is None or time.monotonic() < end:
+                try:
+                    data, _ = c.sock.recvfrom(1500)
+                except socket.timeout:
+                    continue
+                n = decode(data)
+                if not n:
+                    continue
+                if n["token"] != token:
+                    if n["type"] == CON:
+                        c.sock.sendto(encode(RST, 0, n["mid"], b""), c.addr)
+                    continue
+                if n["type"] == CON:
+                    c.ack(n)
+                print(time.strftime("%H:%M:%S"), end=" ")
+                show(n)
+        except KeyboardInterrupt:
+            pass
+        c.sock.settimeout(args.timeout)
+        c.request(mtype, METHODS["get"], args.path, observe=1, token=token)
+        return 0
+
+    if msg is None:
+        print("no response")
+        return 1
+    show(msg, rtt)
+    return 0 if msg["code"] >> 5 == 2 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
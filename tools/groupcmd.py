@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Sends and watches SwitchNode multicast group commands (standard library only).
+
+  python3 tools/groupcmd.py --key <key> on  --group 1
+  python3 tools/groupcmd.py --key <key> off                  # group 0 = every node
+  python3 tools/groupcmd.py --key <key> scene 2 --group 3
+  python3 tools/groupcmd.py --key <key> listen               # print verified traffic
+
+Wire format and replay rules: src/groupmsg.h. Each invocation is a new
+sender (random id, seq from 1), so receivers never see a reused seq.
+Nodes that do not know a sender challenge it before running its
+command; after sending, this tool answers challenges for --wait seconds.
+`listen` verifies signatures and shows what a node would drop as a copy
+or a replay, which makes it handy next to several nodes or simulator
+instances on one host.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+
+MAGIC = b"SNG1"
+CHALLENGE = b"SNC1"
+RESPONSE = b"SNR1"
+BODY = struct.Struct(">4sIIHBB")
+HANDSHAKE = struct.Struct(">4sIII")
+MAC_LEN = 16
+CMDS = ["off", "on", "toggle", "scene"]
+
+
+def encode(key, sender, seq, group, cmd, arg=0):
+    body = BODY.pack(MAGIC, sender, seq, group, cmd, arg)
+    return body + hmac.new(key, body, hashlib.sha256).digest()[:MAC_LEN]
+
+
+def verified(key, data, magic):
+    if len(data) != BODY.size + MAC_LEN or data[:4] != magic:
+        return False
+    body, tag = data[:BODY.size], data[BODY.size:]
+    return hmac.compare_digest(hmac.new(key, body, hashlib.sha256).digest()[:MAC_LEN], tag)
+
+
+def decode(key, data):
+    if not verified(key, data, MAGIC):
+        return None
+    _, sender, seq, group, cmd, arg = BODY.unpack(data[:BODY.size])
+    return sender, seq, group, cmd, arg
+
+
+def answer_challenges(sock, key, sender, seq, wait):
+    """Vouches for our command to every node that challenges it."""
+    deadline = time.monotonic() + wait
+    answered = 0
+    while True:
+        left = deadline - time.monotonic()
+        if left <= 0:
+            return answered
+        sock.settimeout(left)
+        try:
+            data, src = sock.recvfrom(64)
+        except socket.timeout:
+            return answered
+        if not verified(key, data, CHALLENGE):
+            continue
+        _, challenger, target, nonce = HANDSHAKE.unpack(data[:HANDSHAKE.size])
+        if target != sender:
+            continue
+        body = HANDSHAKE.pack(RESPONSE, sender, nonce, seq)
+        sock.sendto(body + hmac.new(key, body, hashlib.sha256).digest()[:MAC_LEN], src)
+        answered += 1
+
+
+def cmd_send(args):
+    cmd = CMDS.index(args.command)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, args.ttl)
+    if args.interface:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(args.interface))
+    sender = int.from_bytes(os.urandom(4), "big") or 1
+    key = args.key.encode()
+    pkt = encode(key, sender, 1, args.group, cmd, args.scene or 0)
+    for _ in range(args.repeat):
+        sock.sendto(pkt, (args.addr, args.port))
+    print(f"sent {args.command} group={args.group} x{args.repeat} to {args.addr}:{args.port} sender={sender:08x}")
+    # Every node sees a new sender here, so each one challenges it first.
+    n = answer_challenges(sock, key, sender, 1, args.wait)
+    print(f"answered {n} challenge(s)")
+
+
+def cmd_listen(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.bind(("", args.port))
+    iface = socket.inet_aton(args.interface or "0.0.0.0")
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(args.addr) + iface)
+
+    key = args.key.encode()
+    windows = {}   # sender -> (top, seen bitmap), same 64-entry window as the firmware
+    print(f"listening on {args.addr}:{args.port}")
+    while True:
+        data, src = sock.recvfrom(64)
+        t = time.strftime("%H:%M:%S")
+        if verified(key, data, CHALLENGE) or verified(key, data, RESPONSE):
+            continue   # unicast handshakes only show up here on the sender's host
+        msg = decode(key, data)
+        if msg is None:
+            print(f"{t} {src[0]} rejected (bad signature/format)")
+            continue
+        sender, seq, group, cmd, arg = msg
+        top, seen = windows.get(sender, (None, 0))
+        if top is None:
+            windows[sender] = (seq, 1)
+            verdict = "new sender: nodes challenge it"
+        elif seq > top:
+            shift = seq - top
+            seen = 1 if shift >= 64 else ((seen << shift) | 1) & (2**64 - 1)
+            windows[sender] = (seq, seen)
+            verdict = "fresh"
+        elif top - seq >= 64:
+            verdict = "stale"
+        elif seen & (1 << (top - seq)):
+            verdict = "duplicate"
+        else:
+            windows[sender] = (top, seen | (1 << (top - seq)))
+            verdict = "fresh"
+        name = CMDS[cmd] if cmd < len(CMDS) else str(cmd)
+        extra = f" {arg}" if name == "scene" else ""
+        print(f"{t} {src[0]} sender={sender:08x} seq={seq} group={group} {name}{extra} [{verdict}]")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("command", choices=CMDS + ["listen"])
+    ap.add_argument("scene", nargs="?", type=int, help="scene number 0-7 (scene only)")
+    ap.add_argument("--key", required=True, help="shared key configured at /api/group")
+    ap.add_argument("--group", type=int, default=0, help="0 = every node on the address")
+    ap.add_argument("--addr", default="239.255.83.78")
+    ap.add_argument("--port", type=int, default=4210)
+    ap.add_argument("--repeat", type=int, default=3)
+    ap.add_argument("--ttl", type=int, default=1)
+    ap.add_argument("--wait", type=float, default=1.0, help="seconds to answer challenges after sending")
+    ap.add_argument("--interface", help="local IPv4 address of the interface to use")
+    args = ap.parse_args()
+
+    if args.command == "scene" and (args.scene is None or not 0 <= args.scene < 8):
+        ap.error("scene needs a number 0-7")
+    try:
+        (cmd_listen if args.command == "listen" else cmd_send)(args)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+Pulls the relay/input event history from a SwitchNode (standard library only).
+
+  python3 tools/history.py switchnode-XXXXXX.local
+  python3 tools/history.py 192.168.1.50 --since 2h --csv > events.csv
+  python3 tools/history.py 192.168.1.50 --after 1200       # only newer than seq 1200
+
+Uses the binary export (GET /api/history?format=bin, see src/history.h):
+after the "SNH1" magic, each event is
+  varint   seq delta
+  varint   zigzag boot delta
+  varint   zigzag time delta (ms)
+  u8       type (bit 0: 0 relay, 1 input) | old << 1 | new << 2 | uptime << 3 | source << 4
+with deltas against the previous event (the first against zero).
+"""
+
+import argparse
+import base64
+import datetime
+import http.client
+import sys
+import time
+import urllib.parse
+
+MAGIC = b"SNH1"
+SOURCES = ["boot", "web", "mqtt", "input", "group", "peer", "rule", "coap"]
+
+
+def varint(buf, i):
+    v, shift = 0, 0
+    while True:
+        b = buf[i]
+        i += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, i
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def decode(blob):
+    if blob[:4] != MAGIC:
+        raise ValueError("not an SNH1 history export")
+    events = []
+    seq, boot, tms = 0, 0, 0
+    i = 4
+    while i < len(blob):
+        d, i = varint(blob, i)
+        seq += d
+        d, i = varint(blob, i)
+        boot = (boot + unzigzag(d)) & 0xFFFF
+        d, i = varint(blob, i)
+        tms += unzigzag(d)
+        b = blob[i]
+        i += 1
+        src = b >> 4
+        events.append({
+            "seq": seq,
+            "boot": boot,
+            "tms": tms,
+            "type": "input" if b & 0x01 else "relay",
+            "old": bool(b & 0x02),
+            "new": bool(b & 0x04),
+            "uptime": bool(b & 0x08),
+            "src": SOURCES[src] if src < len(SOURCES) else str(src),
+        })
+    return events
+
+
+def parse_since(s):
+    units = {"s": 1, "m": 60, "h": 3600, "d": 86400}
+    if s[-1] in units:
+        return int(time.time() - float(s[:-1]) * units[s[-1]])
+    return int(s)
+
+
+def fmt_time(e):
+    if e["uptime"]:
+        return f"+{e['tms'] / 1000:.3f}s"
+    t = datetime.datetime.fromtimestamp(e["tms"] / 1000, datetime.timezone.utc)
+    return t.strftime("%Y-%m-%d %H:%M:%S.") + f"{e['tms'] % 1000:03d}Z"
+
+
+def state_str(e, v):
+    if e["type"] == "input":
+        return "pressed" if v else "open"
+    return "on" if v else "off"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("--user", default="admin")
+    ap.add_argument("--password", default="switchnode")
+    ap.add_argument("--since", help="Unix time or a relative age (30m, 2h, 7d)")
+    ap.add_argument("--until", type=int, help="Unix time")
+    ap.add_argument("--after", type=int, help="only events with a higher seq")
+    ap.add_argument("--limit", type=int)
+    ap.add_argument("--csv", action="store_true")
+    args = ap.parse_args()
+
+    q = {"format": "bin"}
+    if args.since:
+        q["from"] = parse_since(args.since)
+    if args.until:
+        q["to"] = args.until
+    if args.after is not None:
+        q["after"] = args.after
+    if args.limit:
+        q["limit"] = args.limit
+
+    auth = base64.b64encode(f"{args.user}:{args.password}".encode()).decode()
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=30)
+    conn.request("GET", "/api/history?" + urllib.parse.urlencode(q), headers={"Authorization": f"Basic {auth}"})
+    resp = conn.getresponse()
+    blob = resp.read()
+    if resp.status != 200:
+        sys.exit(f"HTTP {resp.status}: {blob[:200]!r}")
+
+    events = decode(blob)
+    if args.csv:
+        print("seq,boot,time_ms,uptime,type,source,old,new")
+        for e in events:
+            print(f"{e['seq']},{e['boot']},{e['tms']},{int(e['uptime'])},{e['type']},{e['src']},"
+                  f"{int(e['old'])},{int(e['new'])}")
+    else:
+        for e in events:
+            print(f"{e['seq']:>7} boot {e['boot']:<4} {fmt_time(e):>24}  {e['type']:<5} "
+                  f"{state_str(e, e['old']):>7} -> {state_str(e, e['new']):<7} ({e['src']})")
+    print(f"{len(events)} event(s), {len(blob)} bytes ({len(blob) / max(len(events), 1):.1f} per event)",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,284 @@
+#!/usr/bin/env python3
+"""
+HTTP load generator for the SwitchNode web server.
+
+Opens N concurrent clients against a device and reports, per endpoint:
+requests, throughput, 503 rejections, errors and p50/p99 latency, plus the
+firmware-side time from the Server-Timing header.
+
+  python3 tools/loadgen.py switchnode-XXXXXX.local -c 8 -d 20
+  python3 tools/loadgen.py 192.168.1.50 --paths status,relay --keepalive
+  python3 tools/loadgen.py 192.168.1.50 --encodings -n 200
+
+--encodings fetches the JSON APIs as both application/json and
+application/cbor and compares body size and device-side serialization
+time (the "ser" metric of Server-Timing).
+
+Standard library only. Each request uses a new connection unless
+--keepalive is given (the server closes after each response either way;
+the option exercises the idle-timeout path).
+"""
+
+import argparse
+import asyncio
+import base64
+import json
+import struct
+import random
+import re
+import time
+
+ENDPOINTS = {
+    "status": ("GET", "/api/status", None),
+    "relay": ("POST", "/api/relay", lambda: "state=" + random.choice(("on", "off"))),
+    "index": ("GET", "/", None),
+    "settings": ("GET", "/settings", None),
+}
+
+ENCODING_PATHS = ["/api/status", "/api/mqtt", "/api/log", "/api/http", "/api/latency"]
+
+SERVER_TIMING = re.compile(rb"server-timing:\s*app;dur=([0-9.]+)", re.I)
+SER_TIMING = re.compile(rb"ser;dur=([0-9.]+)", re.I)
+
+
+class Stats:
+    def __init__(self):
+        self.lat_ms = []
+        self.app_ms = []
+        self.rejected = 0
+        self.errors = 0
+        self.bytes = 0
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    s = sorted(values)
+    k = min(len(s) - 1, max(0, int(round(p / 100.0 * (len(s) - 1)))))
+    return s[k]
+
+
+def cbor_decode(data):
+    """Minimal CBOR decoder (definite lengths, JSON data model)."""
+    def head(i):
+        ib = data[i]
+        major, info = ib >> 5, ib & 0x1F
+        if info < 24:
+            return major, info, info, i + 1
+        n = 1 << (info - 24)
+        return major, info, int.from_bytes(data[i + 1:i + 1 + n], "big"), i + 1 + n
+
+    def item(i):
+        major, info, arg, i = head(i)
+        if major == 0:
+            return arg, i
+        if major == 1:
+            return -1 - arg, i
+        if major in (2, 3):
+            return data[i:i + arg].decode(), i + arg
+        if major == 4:
+            out = []
+            for _ in range(arg):
+                v, i = item(i)
+                out.append(v)
+            return out, i
+        if major == 5:
+            out = {}
+            for _ in range(arg):
+                k, i = item(i)
+                out[k], i = item(i)
+            return out, i
+        if major == 7:
+            if info in (20, 21):
+                return info == 21, i
+            if info in (22, 23):
+                return None, i
+            if info == 25:
+                return struct.unpack(">e", arg.to_bytes(2, "big"))[0], i
+            if info == 26:
+                return struct.unpack(">f", arg.to_bytes(4, "big"))[0], i
+            if info == 27:
+                return struct.unpack(">d", arg.to_bytes(8, "big"))[0], i
+        raise ValueError(f"unsupported CBOR item major={major} info={info}")
+
+    value, end = item(0)
+    if end != len(data):
+        raise ValueError("trailing bytes")
+    return value
+
+
+def build_request(host, method, path, body, auth, keepalive, accept=None):
+    lines = [
+        f"{method} {path} HTTP/1.1",
+        f"Host: {host}",
+        f"Authorization: Basic {auth}",
+        "Connection: " + ("keep-alive" if keepalive else "close"),
+    ]
+    if accept:
+        lines.append(f"Accept: {accept}")
+    payload = b""
+    if body is not None:
+        payload = body.encode()
+        lines.append("Content-Type: application/x-www-form-urlencoded")
+        lines.append(f"Content-Length: {len(payload)}")
+    return ("\r\n".join(lines) + "\r\n\r\n").encode() + payload
+
+
+async def read_response(reader):
+    head = await reader.readuntil(b"\r\n\r\n")
+    status = int(head.split(b" ", 2)[1])
+    m = re.search(rb"content-length:\s*(\d+)", head, re.I)
+    if m:
+        body = await reader.readexactly(int(m.group(1)))
+    elif re.search(rb"transfer-encoding:\s*chunked", head, re.I):
+        body = b""
+        while True:
+            size = int((await reader.readuntil(b"\r\n")).strip() or b"0", 16)
+            chunk = await reader.readexactly(size + 2)
+            if size == 0:
+                break
+            body += chunk[:-2]
+    else:
+        body = await reader.read()
+    return status, head, body
+
+
+async def worker(args, auth, names, stats, deadline):
+    conn = None
+    while time.monotonic() < deadline:
+        name = random.choice(names)
+        method, path, body = ENDPOINTS[name]
+        if callable(body):
+            body = body()
+        st = stats[name]
+        t0 = time.perf_counter()
+        try:
+            if conn is None:
+                conn = await asyncio.wait_for(
+                    asyncio.open_connection(args.host, args.port), args.timeout)
+            reader, writer = conn
+            writer.write(build_request(args.host, method, path, body, auth, args.keepalive))
+            await writer.drain()
+            status, head, data = await asyncio.wait_for(read_response(reader), args.timeout)
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError, IndexError):
+            st.errors += 1
+            if conn:
+                conn[1].close()
+            conn = None
+            await asyncio.sleep(0.05)
+            continue
+
+        elapsed = (time.perf_counter() - t0) * 1000.0
+        if status == 503:
+            st.rejected += 1
+        elif status >= 400:
+            st.errors += 1
+        else:
+            st.lat_ms.append(elapsed)
+            st.bytes += len(data)
+            m = SERVER_TIMING.search(head)
+            if m:
+                st.app_ms.append(float(m.group(1)))
+
+        if not args.keepalive or b"connection: close" in head.lower():
+            conn[1].close()
+            conn = None
+        if args.think:
+            await asyncio.sleep(args.think / 1000.0)
+
+    if conn:
+        conn[1].close()
+
+
+async def fetch_once(args, auth, path, accept):
+    reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+    try:
+        writer.write(build_request(args.host, "GET", path, None, auth, False, accept))
+        await writer.drain()
+        t0 = time.perf_counter()
+        status, head, body = await asyncio.wait_for(read_response(reader), args.timeout)
+        return status, head, body, (time.perf_counter() - t0) * 1000.0
+    finally:
+        writer.close()
+
+
+async def run_encodings(args):
+    auth = base64.b64encode(f"{args.user}:{args.password}".encode()).decode()
+    print(f"{args.host}:{args.port}  samples={args.samples} per path and encoding")
+    print(f"{'path':<14} {'enc':<5} {'bytes':>6} {'ser p50':>8} {'ser p99':>8} {'rtt p50':>8} {'match':>6}")
+    for path in ENCODING_PATHS:
+        decoded = {}
+        for enc, accept in (("json", "application/json"), ("cbor", "application/cbor")):
+            sizes, ser, rtt = [], [], []
+            for _ in range(args.samples):
+                try:
+                    status, head, body, ms = await fetch_once(args, auth, path, accept)
+                except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError):
+                    continue
+                if status != 200:
+                    continue
+                sizes.append(len(body))
+                rtt.append(ms)
+                m = SER_TIMING.search(head)
+                if m:
+                    ser.append(float(m.group(1)))
+                decoded[enc] = json.loads(body) if enc == "json" else cbor_decode(body)
+            match = ""
+            if enc == "cbor" and "json" in decoded and "cbor" in decoded:
+                match = "yes" if set(decoded["json"]) == set(decoded["cbor"]) else "keys!"
+            avg = sum(sizes) / len(sizes) if sizes else 0
+            print(f"{path:<14} {enc:<5} {avg:>6.0f} {percentile(ser, 50):>8.3f} "
+                  f"{percentile(ser, 99):>8.3f} {percentile(rtt, 50):>8.1f} {match:>6}")
+
+
+async def run(args):
+    if args.encodings:
+        await run_encodings(args)
+        return
+
+    names = [n.strip() for n in args.paths.split(",") if n.strip()]
+    for n in names:
+        if n not in ENDPOINTS:
+            raise SystemExit(f"unknown endpoint '{n}' (known: {', '.join(ENDPOINTS)})")
+    auth = base64.b64encode(f"{args.user}:{args.password}".encode()).decode()
+    stats = {n: Stats() for n in names}
+
+    t0 = time.monotonic()
+    deadline = t0 + args.duration
+    await asyncio.gather(*(worker(args, auth, names, stats, deadline) for _ in range(args.concurrency)))
+    wall = time.monotonic() - t0
+
+    print(f"{args.host}:{args.port}  clients={args.concurrency}  duration={wall:.1f}s")
+    print(f"{'endpoint':<10} {'ok':>7} {'req/s':>8} {'503':>6} {'err':>6} "
+          f"{'p50 ms':>8} {'p99 ms':>8} {'app p50':>8} {'app p99':>8}")
+    total = 0
+    for n in names:
+        s = stats[n]
+        ok = len(s.lat_ms)
+        total += ok
+        print(f"{n:<10} {ok:>7} {ok / wall:>8.1f} {s.rejected:>6} {s.errors:>6} "
+              f"{percentile(s.lat_ms, 50):>8.1f} {percentile(s.lat_ms, 99):>8.1f} "
+              f"{percentile(s.app_ms, 50):>8.2f} {percentile(s.app_ms, 99):>8.2f}")
+    print(f"{'total':<10} {total:>7} {total / wall:>8.1f}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("-c", "--concurrency", type=int, default=4)
+    ap.add_argument("-d", "--duration", type=float, default=10.0, help="seconds")
+    ap.add_argument("--paths", default="status,relay,index,settings",
+                    help="comma list of: " + ",".join(ENDPOINTS))
+    ap.add_argument("--user", default="admin")
+    ap.add_argument("--password", default="switchnode")
+    ap.add_argument("--timeout", type=float, default=5.0)
+    ap.add_argument("--think", type=float, default=0.0, help="ms pause between requests per client")
+    ap.add_argument("--keepalive", action="store_true")
+    ap.add_argument("--encodings", action="store_true", help="compare JSON vs CBOR instead of load")
+    ap.add_argument("-n", "--samples", type=int, default=50, help="requests per path/encoding (--encodings)")
+    asyncio.run(run(ap.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
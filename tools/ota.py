@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""
+OTA helper for SwitchNode (standard library only).
+
+Upload an image over HTTP (streamed, with its SHA-256):
+  python3 tools/ota.py upload switchnode-XXXXXX.local .pio/build/esp32dev/firmware.bin
+  python3 tools/ota.py upload 192.168.1.50 .pio/build/esp32dev/littlefs.bin --target fs
+
+Serve an image from this machine for an MQTT-triggered pull:
+  python3 tools/ota.py serve .pio/build/esp32dev/firmware.bin --port 8000
+  It prints the JSON to publish on <cmdTopic>/ota, e.g.
+  mosquitto_pub -t home/relay/ota -m '{"url":"http://192.168.1.10:8000/firmware.bin",...}'
+
+Both report throughput; the device reports its own in GET /api/ota and
+on <cmdTopic>/ota/status.
+
+Compressed or delta containers from tools/otapack.py (*.snu) are sent the
+same way; the sha256 passed along is the one of the image they decode to.
+"""
+
+import argparse
+import base64
+import hashlib
+import http.client
+import http.server
+import json
+import os
+import socket
+import sys
+import time
+
+
+def sha256_file(path):
+    h = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(65536), b""):
+            h.update(chunk)
+    return h.hexdigest()
+
+
+def image_sha256(path):
+    """Digest the device will verify: the decoded image for a container."""
+    with open(path, "rb") as f:
+        head = f.read(80)
+    if head[:4] == b"SNU1" and len(head) == 80:
+        return head[16:48].hex()
+    return sha256_file(path)
+
+
+def local_ip():
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        s.connect(("10.255.255.255", 1))
+        return s.getsockname()[0]
+    except OSError:
+        return "127.0.0.1"
+    finally:
+        s.close()
+
+
+def cmd_upload(args):
+    size = os.path.getsize(args.image)
+    digest = image_sha256(args.image)
+    auth = base64.b64encode(f"{args.user}:{args.password}".encode()).decode()
+    path = f"/api/ota?target={args.target}&sha256={digest}"
+
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    conn.putrequest("POST", path)
+    conn.putheader("Authorization", f"Basic {auth}")
+    conn.putheader("Content-Type", "application/octet-stream")
+    conn.putheader("Content-Length", str(size))
+    conn.endheaders()
+
+    t0 = time.monotonic()
+    sent = 0
+    with open(args.image, "rb") as f:
+        for chunk in iter(lambda: f.read(4096), b""):
+            conn.send(chunk)
+            sent += len(chunk)
+            pct = 100 * sent // size if size else 100
+            print(f"\r{sent}/{size} bytes ({pct}%)", end="", file=sys.stderr)
+    print(file=sys.stderr)
+
+    resp = conn.getresponse()
+    body = resp.read()
+    dt = time.monotonic() - t0
+    print(f"HTTP {resp.status} after {dt:.1f}s, {size / dt / 1024:.1f} KiB/s client-side")
+    try:
+        print(json.dumps(json.loads(body), indent=2))
+    except ValueError:
+        print(body.decode(errors="replace"))
+    return 0 if resp.status == 200 else 1
+
+
+def cmd_serve(args):
+    directory = os.path.dirname(os.path.abspath(args.image))
+    name = os.path.basename(args.image)
+    url = f"http://{args.advertise or local_ip()}:{args.port}/{name}"
+    payload = {"url": url, "sha256": image_sha256(args.image), "target": args.target}
+
+    print("Publish on <cmdTopic>/ota:")
+    print(json.dumps(payload))
+
+    class Handler(http.server.SimpleHTTPRequestHandler):
+        def __init__(self, *a, **kw):
+            super().__init__(*a, directory=directory, **kw)
+
+        def copyfile(self, source, outputfile):
+            t0 = time.monotonic()
+            n = 0
+            for chunk in iter(lambda: source.read(16384), b""):
+                outputfile.write(chunk)
+                n += len(chunk)
+            dt = time.monotonic() - t0
+            print(f"sent {n} bytes to {self.client_address[0]} in {dt:.1f}s "
+                  f"({n / max(dt, 1e-6) / 1024:.1f} KiB/s)")
+
+    with http.server.ThreadingHTTPServer(("", args.port), Handler) as srv:
+        srv.serve_forever()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    up = sub.add_parser("upload", help="POST an image to /api/ota")
+    up.add_argument("host")
+    up.add_argument("image")
+    up.add_argument("--port", type=int, default=80)
+    up.add_argument("--target", choices=["app", "fs"], default="app")
+    up.add_argument("--user", default="admin")
+    up.add_argument("--password", default="switchnode")
+    up.add_argument("--timeout", type=float, default=60.0)
+    up.set_defaults(fn=cmd_upload)
+
+    sv = sub.add_parser("serve", help="serve an image for MQTT-triggered pull")
+    sv.add_argument("image")
+    sv.add_argument("--port", type=int, default=8000)
+    sv.add_argument("--target", choices=["app", "fs"], default="app")
+    sv.add_argument("--advertise", help="host/IP to put in the URL (default: this machine's LAN IP)")
+    sv.set_defaults(fn=cmd_serve)
+
+    args = ap.parse_args()
+    sys.exit(args.fn(args) or 0)
+
+
+if __name__ == "__main__":
+    main()
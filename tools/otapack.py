@@ -0,0 +1,329 @@
+#!/usr/bin/env python3
+"""
+Builds compressed and delta OTA images for SwitchNode (standard library only).
+
+  python3 tools/otapack.py compress firmware.bin firmware.snu
+  python3 tools/otapack.py compress littlefs.bin littlefs.snu --target fs
+  python3 tools/otapack.py delta old/firmware.bin firmware.bin firmware-delta.snu
+  python3 tools/otapack.py info firmware-delta.snu
+  python3 tools/otapack.py verify firmware-delta.snu --base old/firmware.bin
+
+The container ("SNU1", see src/otaimage.h) carries the SHA-256 of the
+reconstructed image; the device checks it before switching partitions.
+A delta is made against the firmware the device is *running* (its exact
+firmware.bin) and also records that image's SHA-256, so the device
+refuses a patch made for a different base.
+
+Compression is LZSS with a 4 KB window (byte-oriented, heatshrink-like
+in footprint). Deltas are bsdiff-like copy/add/insert ops, LZSS-compressed
+unless --no-lzss is given.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = b"SNU1"
+FLAG_LZSS = 0x01
+FLAG_DELTA = 0x02
+HEADER = struct.Struct("<4sBBHII32s32s")
+TARGETS = {"app": 0, "fs": 1}
+
+WINDOW = 4096
+MIN_MATCH = 3
+MAX_MATCH = 18
+MAX_CHAIN = 16
+
+BLOCK = 16          # delta: bytes hashed per base block
+BLOCK_STEP = 8      # delta: base block spacing
+MIN_COPY = 24       # delta: shortest exact match worth an op
+
+
+# -------------------- LZSS --------------------
+def lzss_compress(data):
+    out = bytearray()
+    heads = {}
+    n = len(data)
+    i = 0
+    while i < n:
+        flag_at = len(out)
+        out.append(0)
+        flags = 0
+        for bit in range(8):
+            if i >= n:
+                break
+            best_len, best_dist = 0, 0
+            if i + MIN_MATCH <= n:
+                key = data[i:i + MIN_MATCH]
+                chain = heads.get(key)
+                if chain:
+                    limit = min(MAX_MATCH, n - i)
+                    for p in reversed(chain):
+                        dist = i - p
+                        if dist > WINDOW:
+                            break
+                        length = MIN_MATCH
+                        while length < limit and data[p + length] == data[i + length]:
+                            length += 1
+                        if length > best_len:
+                            best_len, best_dist = length, dist
+                            if length == limit:
+                                break
+            if best_len >= MIN_MATCH:
+                d = best_dist - 1
+                out.append(d & 0xFF)
+                out.append(((d >> 8) << 4) | (best_len - MIN_MATCH))
+                step = best_len
+            else:
+                flags |= 1 << bit
+                out.append(data[i])
+                step = 1
+            for k in range(i, min(i + step, n - MIN_MATCH + 1)):
+                chain = heads.setdefault(data[k:k + MIN_MATCH], [])
+                chain.append(k)
+                if len(chain) > MAX_CHAIN:
+                    del chain[0]
+            i += step
+        out[flag_at] = flags
+    return bytes(out)
+
+
+def lzss_decompress(data, size):
+    out = bytearray()
+    i = 0
+    while len(out) < size and i < len(data):
+        flags = data[i]
+        i += 1
+        for bit in range(8):
+            if len(out) >= size or i >= len(data):
+                break
+            if flags & (1 << bit):
+                out.append(data[i])
+                i += 1
+            else:
+                lo, hi = data[i], data[i + 1]
+                i += 2
+                dist = (((hi >> 4) << 8) | lo) + 1
+                for _ in range((hi & 0x0F) + MIN_MATCH):
+                    out.append(out[-dist] if dist <= len(out) else 0)
+    return bytes(out)
+
+
+# -------------------- Delta --------------------
+def make_delta(base, new):
+    index = {}
+    for off in range(0, len(base) - BLOCK + 1, BLOCK_STEP):
+        index.setdefault(base[off:off + BLOCK], off)
+
+    ops = bytearray()
+    pending = bytearray()
+
+    def flush_insert():
+        if pending:
+            ops.extend(b"I" + struct.pack("<I", len(pending)) + pending)
+            pending.clear()
+
+    i = 0
+    n = len(new)
+    while i < n:
+        off = index.get(new[i:i + BLOCK]) if i + BLOCK <= n else None
+        if off is None:
+            pending.append(new[i])
+            i += 1
+            continue
+
+        # Extend the exact match backwards into pending bytes, then forwards.
+        back = 0
+        while back < len(pending) and off - back > 0 and base[off - back - 1] == pending[-back - 1]:
+            back += 1
+        length = BLOCK
+        while i + length < n and off + length < len(base) and new[i + length] == base[off + length]:
+            length += 1
+        if length + back < MIN_COPY:
+            pending.append(new[i])
+            i += 1
+            continue
+        if back:
+            del pending[-back:]
+        flush_insert()
+        ops.extend(b"C" + struct.pack("<II", off - back, length + back))
+        i += length
+        off += length
+
+        # Approximate extension (bsdiff): keep pairing with the base while at
+        # least half the bytes still match; the differences are stored as
+        # small adds that compress well.
+        score, best, best_len = 0, 0, 0
+        k = 0
+        while i + k < n and off + k < len(base) and k < 65536:
+            score += 1 if new[i + k] == base[off + k] else -1
+            k += 1
+            if score > best:
+                best, best_len = score, k
+            if score < best - 32:
+                break
+        if best_len >= 8:
+            diff = bytes((new[i + j] - base[off + j]) & 0xFF for j in range(best_len))
+            ops.extend(b"A" + struct.pack("<II", off, best_len) + diff)
+            i += best_len
+
+    flush_insert()
+    ops.extend(b"E")
+    return bytes(ops)
+
+
+def apply_delta(base, ops):
+    out = bytearray()
+    i = 0
+    while True:
+        op = ops[i:i + 1]
+        i += 1
+        if op == b"E":
+            return bytes(out)
+        if op == b"C":
+            off, length = struct.unpack_from("<II", ops, i)
+            i += 8
+            out += base[off:off + length]
+        elif op == b"A":
+            off, length = struct.unpack_from("<II", ops, i)
+            i += 8
+            out += bytes((base[off + j] + ops[i + j]) & 0xFF for j in range(length))
+            i += length
+        elif op == b"I":
+            (length,) = struct.unpack_from("<I", ops, i)
+            i += 4
+            out += ops[i:i + length]
+            i += length
+        else:
+            raise ValueError(f"bad delta op {op!r} at {i - 1}")
+
+
+# -------------------- Container --------------------
+def build(image, target="app", base=None, lzss=True):
+    flags = 0
+    payload = image
+    base_size, base_sha = 0, bytes(32)
+    if base is not None:
+        flags |= FLAG_DELTA
+        payload = make_delta(base, image)
+        base_size, base_sha = len(base), hashlib.sha256(base).digest()
+    if lzss:
+        flags |= FLAG_LZSS
+        payload = lzss_compress(payload)
+    header = HEADER.pack(MAGIC, flags, TARGETS[target], 0, len(image), base_size,
+                         hashlib.sha256(image).digest(), base_sha)
+    return header + payload
+
+
+def parse_header(blob):
+    if len(blob) < HEADER.size or blob[:4] != MAGIC:
+        raise ValueError("not an SNU1 container")
+    magic, flags, target, _, out_size, base_size, out_sha, base_sha = HEADER.unpack_from(blob)
+    return {
+        "flags": flags, "target": target, "out_size": out_size, "base_size": base_size,
+        "out_sha": out_sha.hex(), "base_sha": base_sha.hex(),
+    }
+
+
+def encoding_name(flags):
+    parts = (["delta"] if flags & FLAG_DELTA else []) + (["lzss"] if flags & FLAG_LZSS else [])
+    return "+".join(parts) or "raw"
+
+
+def unpack(blob, base=None):
+    h = parse_header(blob)
+    payload = blob[HEADER.size:]
+    if h["flags"] & FLAG_LZSS:
+        # The delta stream's size is not stored; decode until the input ends.
+        size = h["out_size"] if not h["flags"] & FLAG_DELTA else 1 << 31
+        payload = lzss_decompress(payload, size)
+    if h["flags"] & FLAG_DELTA:
+        if base is None:
+            raise ValueError("delta image needs --base")
+        if hashlib.sha256(base[:h["base_size"]]).hexdigest() != h["base_sha"]:
+            raise ValueError("base image does not match the one the delta was made against")
+        payload = apply_delta(base, payload)
+    if hashlib.sha256(payload).hexdigest() != h["out_sha"]:
+        raise ValueError("sha256 mismatch after decoding")
+    return payload
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_container(path, blob, image_size):
+    with open(path, "wb") as f:
+        f.write(blob)
+    h = parse_header(blob)
+    print(f"{path}: {encoding_name(h['flags'])}, {len(blob)} bytes "
+          f"({100.0 * len(blob) / max(image_size, 1):.1f}% of {image_size}), sha256 {h['out_sha']}")
+
+
+def cmd_compress(args):
+    image = read(args.image)
+    write_container(args.out, build(image, args.target), len(image))
+
+
+def cmd_delta(args):
+    image = read(args.image)
+    write_container(args.out, build(image, "app", base=read(args.base), lzss=not args.no_lzss), len(image))
+
+
+def cmd_info(args):
+    blob = read(args.image)
+    h = parse_header(blob)
+    target = {v: k for k, v in TARGETS.items()}.get(h["target"], "?")
+    print(f"encoding {encoding_name(h['flags'])}, target {target}, {len(blob)} bytes -> {h['out_size']}")
+    print(f"image sha256 {h['out_sha']}")
+    if h["flags"] & FLAG_DELTA:
+        print(f"base  sha256 {h['base_sha']} ({h['base_size']} bytes)")
+
+
+def cmd_verify(args):
+    blob = read(args.image)
+    image = unpack(blob, read(args.base) if args.base else None)
+    if args.out:
+        with open(args.out, "wb") as f:
+            f.write(image)
+    print(f"ok: {len(image)} bytes, sha256 {hashlib.sha256(image).hexdigest()}")
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    c = sub.add_parser("compress", help="LZSS-compress an image")
+    c.add_argument("image")
+    c.add_argument("out")
+    c.add_argument("--target", choices=list(TARGETS), default="app")
+    c.set_defaults(fn=cmd_compress)
+
+    d = sub.add_parser("delta", help="patch from the running firmware to a new one")
+    d.add_argument("base", help="firmware.bin the device is running")
+    d.add_argument("image", help="new firmware.bin")
+    d.add_argument("out")
+    d.add_argument("--no-lzss", action="store_true")
+    d.set_defaults(fn=cmd_delta)
+
+    i = sub.add_parser("info", help="print a container header")
+    i.add_argument("image")
+    i.set_defaults(fn=cmd_info)
+
+    v = sub.add_parser("verify", help="decode a container on this machine and check its hash")
+    v.add_argument("image")
+    v.add_argument("--base")
+    v.add_argument("--out", help="write the decoded image here")
+    v.set_defaults(fn=cmd_verify)
+
+    args = ap.parse_args()
+    try:
+        args.fn(args)
+    except ValueError as e:
+        sys.exit(f"error: {e}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,56 @@
+"""
+PlatformIO post-build hook: OTA artifacts next to firmware.bin / littlefs.bin.
+
+  firmware.snu        LZSS-compressed firmware
+  firmware-delta.snu  delta from custom_ota_base (or $OTA_BASE) to this build
+  littlefs.snu        LZSS-compressed filesystem image (pio run -t buildfs)
+
+Upload any of them with tools/ota.py like a plain .bin. For the delta, the
+base must be the exact firmware.bin the device is running; keep a copy of
+each release you flash.
+
+Registered in platformio.ini:  extra_scripts = post:tools/pio_ota.py
+"""
+
+import os
+import sys
+
+Import("env")  # noqa: F821  (provided by SCons)
+
+sys.path.insert(0, os.path.join(env["PROJECT_DIR"], "tools"))  # noqa: F821
+import otapack  # noqa: E402
+
+
+def _base_path():
+    base = os.environ.get("OTA_BASE") or env.GetProjectOption("custom_ota_base", "")  # noqa: F821
+    if base and not os.path.isabs(base):
+        base = os.path.join(env["PROJECT_DIR"], base)  # noqa: F821
+    return base
+
+
+def _pack(image_path, target, with_delta):
+    with open(image_path, "rb") as f:
+        image = f.read()
+    stem = os.path.splitext(image_path)[0]
+    otapack.write_container(stem + ".snu", otapack.build(image, target), len(image))
+
+    base = _base_path() if with_delta else ""
+    if base:
+        if not os.path.isfile(base):
+            print(f"pio_ota: base image {base} not found, skipping delta")
+            return
+        with open(base, "rb") as f:
+            otapack.write_container(stem + "-delta.snu", otapack.build(image, target, base=f.read()),
+                                    len(image))
+
+
+def firmware_artifacts(source, target, env):
+    _pack(target[0].get_abspath(), "app", True)
+
+
+def fs_artifacts(source, target, env):
+    _pack(target[0].get_abspath(), "fs", False)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", firmware_artifacts)  # noqa: F821
+env.AddPostAction("$BUILD_DIR/littlefs.bin", fs_artifacts)  # noqa: F821
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Captures raw input traces from a SwitchNode for the debounce bench
+(standard library only).
+
+  python3 tools/trace.py <node> record -o switch1.trace --seconds 30
+  python3 tools/trace.py <node> status
+  python3 tools/trace.py <node> fetch -o switch1.trace   # last capture
+  python3 tools/trace.py <node> stop
+
+`record` starts a capture (POST /api/trace), prints progress while you
+press the switch, then saves the text dump (GET /api/trace?format=text,
+format in src/inputtrace.h). Replay the files with the native bench:
+
+  pio run -e native_bench && .pio/build/native_bench/program *.trace
+"""
+
+import argparse
+import base64
+import http.client
+import json
+import sys
+import time
+import urllib.parse
+
+
+class Node:
+    def __init__(self, host, port, user, password):
+        self.host, self.port = host, port
+        self.auth = "Basic " + base64.b64encode(f"{user}:{password}".encode()).decode()
+
+    def request(self, method, path, form=None):
+        conn = http.client.HTTPConnection(self.host, self.port, timeout=30)
+        headers = {"Authorization": self.auth}
+        body = None
+        if form is not None:
+            body = urllib.parse.urlencode(form)
+            headers["Content-Type"] = "application/x-www-form-urlencoded"
+        conn.request(method, path, body=body, headers=headers)
+        resp = conn.getresponse()
+        data = resp.read()
+        if resp.status != 200:
+            sys.exit(f"{method} {path}: HTTP {resp.status}: {data[:200].decode(errors='replace')}")
+        return data
+
+    def status(self):
+        return json.loads(self.request("GET", "/api/trace"))
+
+
+def show(st):
+    pct = 100.0 * st["samples"] / st["target"] if st["target"] else 0
+    state = "running" if st["running"] else "idle"
+    extra = " (buffer full)" if st["overflow"] else ""
+    print(f"{state}: {pct:5.1f}% of {st['target']} samples at {st['period_us']} us, "
+          f"{st['edges']}/{st['max_edges']} edges{extra}")
+
+
+def fetch(node, out):
+    data = node.request("GET", "/api/trace?format=text")
+    if out == "-":
+        sys.stdout.write(data.decode())
+    else:
+        with open(out, "wb") as f:
+            f.write(data)
+        edges = sum(1 for line in data.splitlines() if line[:1].isdigit())
+        print(f"{out}: {edges} edges, {len(data)} bytes", file=sys.stderr)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("host")
+    ap.add_argument("command", choices=["record", "status", "fetch", "stop"])
+    ap.add_argument("-o", "--output", default="-", help="trace file (default: stdout)")
+    ap.add_argument("--seconds", type=int, default=10, help="capture length (max 300)")
+    ap.add_argument("--period-us", type=int, default=50, help="sample period, 10-1000 us")
+    ap.add_argument("--port", type=int, default=80)
+    ap.add_argument("--user", default="admin")
+    ap.add_argument("--password", default="switchnode")
+    args = ap.parse_args()
+
+    node = Node(args.host, args.port, args.user, args.password)
+    if args.command == "status":
+        show(node.status())
+    elif args.command == "stop":
+        node.request("POST", "/api/trace", {"stop": 1})
+    elif args.command == "fetch":
+        fetch(node, args.output)
+    else:
+        node.request("POST", "/api/trace", {"period_us": args.period_us, "seconds": args.seconds})
+        print(f"capturing for {args.seconds} s, operate the switch now", file=sys.stderr)
+        st = {}
+        try:
+            while True:
+                time.sleep(1)
+                st = node.status()
+                if not st["running"]:
+                    break
+                print(f"\r{st['samples'] * st['period_us'] / 1e6:5.1f} s, {st['edges']} edges", end="",
+                      file=sys.stderr)
+        except KeyboardInterrupt:
+            node.request("POST", "/api/trace", {"stop": 1})
+        print(file=sys.stderr)
+        if st.get("overflow"):
+            print("edge buffer full: capture ended early", file=sys.stderr)
+        fetch(node, args.output)
+
+
+if __name__ == "__main__":
+    main()